@@ -24,6 +24,7 @@
 #include "common/utils/HexFile.h"
 #include "common/utils/FormatableString.h"
 #include "common/utils/BootloaderInterface.h"
+#include "common/utils/MultiBootloaderInterface.h"
 #include "transport/dashel_plugins/dashel-plugins.h"
 #include <iostream>
 #include <fstream>
@@ -31,7 +32,9 @@
 #include <iterator>
 #include <cassert>
 #include <cstring>
+#include <cctype>
 #include <memory>
+#include <map>
 
 namespace Aseba 
 {
@@ -47,12 +50,14 @@ namespace Aseba
 		stream << "* usermsg: user message [type] [word0] ... [wordN]\n";
 		stream << "* rdpage : bootloader read page [dest] [page number]\n";
 		stream << "* rdpageusb : bootloader read page usb [dest] [page number]\n";
-		stream << "* whex : write hex file [dest] [file name] [reset]\n";
+		stream << "* whex : write hex file [dest] [file name] [reset] [diff]\n";
 		stream << "* rhex : read hex file [source] [file name]\n";
 		stream << "* eb: exit from bootloader, go back into user mode [dest]\n";
 		stream << "* sb: switch into bootloader: reboot node, then enter bootloader for a while [dest]\n";
 		stream << "* sleep: put the vm to sleep [dest]\n";
-		stream << "* wusb : write hex file to [dest] [file name] [reset]\n";
+		stream << "* wusb : write hex file to [dest] [file name] [reset] [diff]\n";
+		stream << "* mwhex : write hex file to several nodes at once [file name] [reset] [diff] [dest] ... [dest]\n";
+		stream << "  with diff, whex, wusb and mwhex only write the pages that differ from the ones on the node\n";
 	}
 
 	//! Show usage
@@ -177,6 +182,16 @@ namespace Aseba
 			cout << "In bootloader, about to write " << pagesCount << " pages" << endl;
 		}
 
+		virtual void writeHexUnchangedPages(unsigned pagesCount)
+		{
+			cout << pagesCount << " pages unchanged, skipping them" << endl;
+		}
+
+		virtual void writeHexPipelined(unsigned frameSize, unsigned windowSize)
+		{
+			cout << "Using pipelined protocol, frames of " << frameSize << " bytes, window of " << windowSize << " pages" << endl;
+		}
+
 		virtual void writeHexWritten()
 		{
 			cout << "Write completed" << endl;
@@ -193,6 +208,92 @@ namespace Aseba
 		}
 	};
 
+	class CmdMultiBootloaderInterface:public MultiBootloaderInterface
+	{
+	public:
+		CmdMultiBootloaderInterface(const string& hexFileName, bool reset):
+			MultiBootloaderInterface(hexFileName, reset, false)
+		{}
+
+	protected:
+		// only report changes of status, not every page
+		map<unsigned, Status> lastStatus;
+
+		virtual void nodeProgress(const Report& report)
+		{
+			auto it(lastStatus.find(report.dest));
+			if (it != lastStatus.end() && it->second == report.status)
+				return;
+			lastStatus[report.dest] = report.status;
+
+			cout << "Node " << report.dest << ": ";
+			switch (report.status)
+			{
+				case Status::ENTERING_BOOTLOADER: cout << "entering bootloader"; break;
+				case Status::COMPARING: cout << "comparing pages with the ones on the node"; break;
+				case Status::WRITING:
+					cout << "writing " << report.pagesCount << " pages" << (report.pipelined ? " (pipelined)" : "");
+					if (report.pagesUnchanged)
+						cout << ", " << report.pagesUnchanged << " unchanged";
+					break;
+				case Status::DONE: cout << "done in " << report.duration << " ms"; break;
+				case Status::FAILED: cout << "failed after " << report.pagesWritten << " pages, " << report.error; break;
+			}
+			cout << endl;
+		}
+	};
+
+	//! Process the mwhex command, which needs its own connection to target, return the number of arguments eaten (not counting the command itself)
+	int processMultiFlashCommand(const char *target, int argc, char *argv[])
+	{
+		// first arg is file name, then optional reset and diff, then all following numbers are destinations
+		if (argc < 3)
+			errorMissingArgument(argv[0]);
+		int argEaten = 1;
+		bool reset = 0;
+		bool diff = 0;
+		if (!strcmp(argv[argEaten + 1], "reset"))
+		{
+			reset = 1;
+			argEaten += 1;
+		}
+		if (argc > argEaten + 1 && !strcmp(argv[argEaten + 1], "diff"))
+		{
+			diff = 1;
+			argEaten += 1;
+		}
+		vector<unsigned> dests;
+		while (argEaten + 1 < argc && isdigit(argv[argEaten + 1][0]))
+			dests.push_back(atoi(argv[++argEaten]));
+		if (dests.empty())
+			errorMissingArgument(argv[0]);
+
+		try
+		{
+			CmdMultiBootloaderInterface bootloader(argv[1], reset);
+			bootloader.setDifferential(diff);
+			Stream* stream(bootloader.connect(target));
+			for (const auto dest: dests)
+				bootloader.addTarget(stream, dest);
+			const UnifiedTime startTime;
+			const bool success(bootloader.flash());
+
+			// summary
+			unsigned doneCount(0);
+			for (const auto& report: bootloader.getReports())
+				if (report.status == MultiBootloaderInterface::Status::DONE)
+					++doneCount;
+			cout << doneCount << " of " << dests.size() << " nodes flashed in " << (UnifiedTime() - startTime).value << " ms" << endl;
+			if (!success)
+				errorBootloader("some nodes could not be flashed");
+		}
+		catch (HexFile::Error &e)
+		{
+			errorHexFile(e.toString());
+		}
+		return argEaten;
+	}
+
 	//! Process a command, return the number of arguments eaten (not counting the command itself)
 	int processCommand(Stream* stream, int argc, char *argv[])
 	{
@@ -281,21 +382,28 @@ namespace Aseba
 		else if (strcmp(cmd, "whex") == 0)
 		{
 			bool reset = 0;
+			bool diff = 0;
 			// first arg is dest, second is file name
 			if (argc < 3)
 				errorMissingArgument(argv[0]);
 			argEaten = 2;
 
-			if (argc > 3 && !strcmp(argv[3], "reset")) 
+			if (argc > argEaten + 1 && !strcmp(argv[argEaten + 1], "reset"))
 			{
 				reset = 1;
-				argEaten = 3;
+				argEaten += 1;
+			}
+			if (argc > argEaten + 1 && !strcmp(argv[argEaten + 1], "diff"))
+			{
+				diff = 1;
+				argEaten += 1;
 			}
 
 			// try to write hex file
 			try
 			{
 				CmdBootloaderInterface bootloader(stream, atoi(argv[1]));
+				bootloader.setDifferential(diff);
 				bootloader.writeHex(argv[2], reset, false);
 			}
 			catch (HexFile::Error &e)
@@ -306,17 +414,24 @@ namespace Aseba
 		else if (strcmp(cmd,"wusb") == 0)
 		{
 			bool reset = 0;
+			bool diff = 0;
 			if (argc < 3)
 				errorMissingArgument(argv[0]);
 			argEaten = 2;
-			if(argc > 3 && !strcmp(argv[3], "reset"))
+			if(argc > argEaten + 1 && !strcmp(argv[argEaten + 1], "reset"))
 			{
 				reset = 1;
-				argEaten = 3;
+				argEaten += 1;
+			}
+			if(argc > argEaten + 1 && !strcmp(argv[argEaten + 1], "diff"))
+			{
+				diff = 1;
+				argEaten += 1;
 			}
 			try
 			{
 				CmdBootloaderInterface bootloader(stream, atoi(argv[1]));
+				bootloader.setDifferential(diff);
 				bootloader.writeHex(argv[2], reset, true);
 			}
 			catch (HexFile::Error &e)
@@ -443,6 +558,17 @@ int main(int argc, char *argv[])
 			Aseba::dumpVersion(std::cout);
 			return 0;
 		}
+		else if (strcmp(arg, "mwhex") == 0)
+		{
+			try
+			{
+				argCounter += Aseba::processMultiFlashCommand(target, argc - argCounter, &argv[argCounter]);
+			}
+			catch (Dashel::DashelException& e)
+			{
+				Aseba::errorServerDisconnected();
+			}
+		}
 		else
 		{
 			Dashel::Hub client;
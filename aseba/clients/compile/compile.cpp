@@ -0,0 +1,667 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <dashel/dashel.h>
+#include "common/consts.h"
+#include "common/msg/msg.h"
+#include "common/msg/NodesManager.h"
+#include "common/utils/utils.h"
+#include "compiler/compiler.h"
+#include "compiler/compilation-cache.h"
+#include "transport/dashel_plugins/dashel-plugins.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDomDocument>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace Aseba
+{
+	using namespace Dashel;
+	using namespace std;
+
+	/**
+	\defgroup compile Batch compiler
+	*/
+	/*@{*/
+
+	//! Product identifier and firmware version of a node, as read from its _productId and _fwversion variables, -1 if unknown
+	struct FirmwareId
+	{
+		int productId = -1;
+		int firmwareVersion = -1;
+
+		bool isComplete() const { return productId >= 0 && firmwareVersion >= 0; }
+	};
+
+	//! A target description along with the identification of the firmware it was saved from
+	struct SavedDescription
+	{
+		TargetDescription description;
+		FirmwareId firmwareId;
+	};
+
+	//! Rebuilds target descriptions out of description messages, either read from a file or received from a network
+	class DescriptionsCollector: public Hub, public NodesManager
+	{
+	public:
+		//! Descriptions of all nodes whose description is complete, by node id
+		map<unsigned, TargetDescription> descriptions;
+		//! Firmware identification of the nodes, by node id, filled from Variables messages once their description is complete
+		map<unsigned, FirmwareId> firmwareIds;
+
+	protected:
+		Stream* target = nullptr;
+
+	public:
+		//! Read all description and firmware identification messages from a file, as written by save()
+		void load(const string& fileName)
+		{
+			Stream* stream(connect("file:" + fileName + ";mode=read"));
+			while (true)
+			{
+				unique_ptr<Message> message;
+				try
+				{
+					message.reset(Message::receive(stream));
+				}
+				catch (const DashelException&)
+				{
+					// end of file
+					break;
+				}
+				processMessage(message.get());
+				recordFirmwareId(message.get());
+			}
+			closeStream(stream);
+		}
+
+		//! Connect to a network and wait up to timeout ms for the descriptions of its nodes
+		void fetch(const string& targetName, int timeout)
+		{
+			target = connect(targetName);
+			pingNetwork();
+			const UnifiedTime start;
+			while ((UnifiedTime() - start).value < UnifiedTime::Value(timeout))
+				step(50);
+			closeStream(target);
+			target = nullptr;
+		}
+
+		//! Write all complete descriptions as a sequence of description messages, each followed by the known firmware identification variables
+		void save(const string& fileName)
+		{
+			Stream* stream(connect("file:" + fileName + ";mode=write"));
+			for (const auto& node: descriptions)
+			{
+				Description description;
+				static_cast<TargetDescription&>(description) = node.second;
+				description.source = node.first;
+				description.serialize(stream);
+				for (const auto& variable: node.second.namedVariables)
+				{
+					NamedVariableDescription message;
+					static_cast<TargetDescription::NamedVariable&>(message) = variable;
+					message.source = node.first;
+					message.serialize(stream);
+				}
+				for (const auto& event: node.second.localEvents)
+				{
+					LocalEventDescription message;
+					static_cast<TargetDescription::LocalEvent&>(message) = event;
+					message.source = node.first;
+					message.serialize(stream);
+				}
+				for (const auto& function: node.second.nativeFunctions)
+				{
+					NativeFunctionDescription message;
+					static_cast<TargetDescription::NativeFunction&>(message) = function;
+					message.source = node.first;
+					message.serialize(stream);
+				}
+				const auto firmwareIdIt(firmwareIds.find(node.first));
+				if (firmwareIdIt != firmwareIds.end())
+				{
+					saveVariable(stream, node.first, "_productId", firmwareIdIt->second.productId);
+					saveVariable(stream, node.first, "_fwversion", firmwareIdIt->second.firmwareVersion);
+				}
+			}
+			stream->flush();
+			closeStream(stream);
+		}
+
+	protected:
+		//! Write the value of a named variable of a node as a Variables message, if it is known
+		void saveVariable(Stream* stream, unsigned nodeId, const string& name, int value)
+		{
+			bool ok;
+			const unsigned pos(getVariablePos(nodeId, name, &ok));
+			if (!ok || value < 0)
+				return;
+			Variables message;
+			message.source = nodeId;
+			message.start = pos;
+			message.variables.push_back(value);
+			message.serialize(stream);
+		}
+
+		//! If message holds the _productId or _fwversion variable of a described node, record its value
+		void recordFirmwareId(const Message* message)
+		{
+			const auto* variables(dynamic_cast<const Variables*>(message));
+			if (!variables || descriptions.find(variables->source) == descriptions.end())
+				return;
+			const auto valueOf = [&](const string& name, int& value)
+			{
+				bool ok;
+				const unsigned pos(getVariablePos(variables->source, name, &ok));
+				if (ok && pos >= variables->start && pos < variables->start + variables->variables.size())
+					value = variables->variables[pos - variables->start];
+			};
+			FirmwareId& firmwareId(firmwareIds[variables->source]);
+			valueOf("_productId", firmwareId.productId);
+			valueOf("_fwversion", firmwareId.firmwareVersion);
+		}
+
+		// from Hub
+		void incomingData(Stream *stream) override
+		{
+			unique_ptr<Message> message(Message::receive(stream));
+			processMessage(message.get());
+			recordFirmwareId(message.get());
+		}
+
+		// from NodesManager
+		void sendMessage(const Message& message) override
+		{
+			if (target)
+			{
+				message.serialize(target);
+				target->flush();
+			}
+		}
+
+		void nodeDescriptionReceived(unsigned nodeId) override
+		{
+			descriptions[nodeId] = *getDescription(nodeId);
+
+			// ask for the firmware identification, needed in the header of .abo files
+			for (const string name: { "_productId", "_fwversion" })
+			{
+				bool ok;
+				const unsigned pos(getVariablePos(nodeId, name, &ok));
+				if (ok)
+					sendMessage(GetVariables(nodeId, pos, 1));
+			}
+		}
+	};
+
+	//! The compilation of the program of one node of one .aesl file
+	struct Job
+	{
+		// inputs
+		string fileName; //!< name of the .aesl file
+		wstring nodeName; //!< name of the node in the .aesl file
+		unsigned nodeId; //!< id of the node in the .aesl file
+		wstring source; //!< program of this node
+		shared_ptr<const CommonDefinitions> commonDefinitions; //!< events and constants of the .aesl file
+		const TargetDescription* targetDescription; //!< description matching nodeName, or nullptr if none
+		FirmwareId firmwareId; //!< firmware identification of the description matching nodeName
+		bool nameRepeats = false; //!< whether another node of the .aesl file has the same name, for instance several robots of the same kind
+
+		// outputs
+		bool success = false;
+		Error error;
+		BytecodeVector bytecode;
+		unsigned allocatedVariablesCount = 0;
+		double duration = 0; //!< compilation time in ms
+	};
+
+	//! Parse an .aesl file and add one job per node program; return false on error
+	bool addJobs(vector<Job>& jobs, const string& fileName, const vector<SavedDescription>& savedDescriptions)
+	{
+		QFile file(QString::fromStdString(fileName));
+		if (!file.open(QFile::ReadOnly))
+		{
+			cerr << "Cannot open file " << fileName << endl;
+			return false;
+		}
+		QDomDocument document("aesl-source");
+		QString errorMsg;
+		int errorLine;
+		int errorColumn;
+		if (!document.setContent(&file, false, &errorMsg, &errorLine, &errorColumn))
+		{
+			cerr << "Error in XML source file " << fileName << ": " << errorMsg.toStdString() << " at line " << errorLine << ", column " << errorColumn << endl;
+			return false;
+		}
+
+		// the common definitions are shared by all nodes, so collect them first
+		auto commonDefinitions(make_shared<CommonDefinitions>());
+		for (QDomElement element(document.documentElement().firstChildElement()); !element.isNull(); element = element.nextSiblingElement())
+		{
+			if (element.tagName() == "event")
+				commonDefinitions->events.push_back(NamedValue(element.attribute("name").toStdWString(), element.attribute("size").toInt()));
+			else if (element.tagName() == "constant")
+				commonDefinitions->constants.push_back(NamedValue(element.attribute("name").toStdWString(), element.attribute("value").toInt()));
+		}
+
+		// the output files are named after the nodes, with their id if several nodes share a name
+		const size_t firstJob(jobs.size());
+		map<wstring, unsigned> nodeNamesCount;
+		for (QDomElement element(document.documentElement().firstChildElement("node")); !element.isNull(); element = element.nextSiblingElement("node"))
+		{
+			Job job;
+			job.fileName = fileName;
+			job.nodeName = element.attribute("name").toStdWString();
+			job.nodeId = element.attribute("nodeId", "0").toUInt();
+			++nodeNamesCount[job.nodeName];
+			job.source = element.firstChild().toText().data().toStdWString();
+			job.commonDefinitions = commonDefinitions;
+			job.targetDescription = nullptr;
+			for (const auto& savedDescription: savedDescriptions)
+			{
+				if (savedDescription.description.name == job.nodeName)
+				{
+					job.targetDescription = &savedDescription.description;
+					job.firmwareId = savedDescription.firmwareId;
+					break;
+				}
+			}
+			jobs.push_back(move(job));
+		}
+		for (size_t i = firstJob; i < jobs.size(); ++i)
+			jobs[i].nameRepeats = nodeNamesCount[jobs[i].nodeName] > 1;
+		return true;
+	}
+
+	//! Compile all jobs using threadCount threads, sharing cache
+	void compileJobs(vector<Job>& jobs, unsigned threadCount, CompilationCache& cache)
+	{
+		atomic<size_t> nextJob(0);
+		auto worker = [&]()
+		{
+			// each job is compiled by its own compiler, so threads do not share any state but the cache
+			for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+			{
+				Job& job(jobs[i]);
+				if (!job.targetDescription)
+				{
+					job.error = Error(SourcePos(), L"No target description for node " + job.nodeName);
+					continue;
+				}
+				const auto start(chrono::steady_clock::now());
+				Compiler compiler;
+				compiler.setTargetDescription(job.targetDescription);
+				compiler.setCommonDefinitions(job.commonDefinitions.get());
+				compiler.setCompilationCache(&cache);
+				job.success = compiler.compile(job.source, job.bytecode, job.allocatedVariablesCount, job.error);
+				job.duration = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			}
+		};
+
+		vector<thread> threads;
+		for (unsigned i = 1; i < threadCount; ++i)
+			threads.emplace_back(worker);
+		worker();
+		for (auto& thread: threads)
+			thread.join();
+	}
+
+	//! Write a 16-bit little-endian value
+	void write16(ostream& stream, uint16_t v)
+	{
+		const char bytes[2] = { char(v & 0xff), char(v >> 8) };
+		stream.write(bytes, 2);
+	}
+
+	//! Return the base name of the output files of a job, file-name or file-name-id if the name of the node repeats
+	string outputBaseName(const string& outputDirectory, const Job& job)
+	{
+		const string fileBaseName(QFileInfo(QString::fromStdString(job.fileName)).completeBaseName().toStdString());
+		const string baseName(outputDirectory + "/" + fileBaseName + "-" + WStringToUTF8(job.nodeName));
+		return job.nameRepeats ? baseName + "-" + to_string(job.nodeId) : baseName;
+	}
+
+	//! Write the bytecode of a job as an Aseba Binary Object, see AS001 at https://aseba.wikidot.com/asebaspecifications; the firmware identification of the job must be complete
+	bool writeAbo(const string& fileName, const Job& job)
+	{
+		assert(job.firmwareId.isComplete());
+		ofstream file(fileName, ios::out | ios::binary | ios::trunc);
+		if (!file)
+			return false;
+
+		// header
+		file.write("ABO", 4);
+		write16(file, 0); // binary format version
+		write16(file, job.targetDescription->protocolVersion);
+		write16(file, job.firmwareId.productId);
+		write16(file, job.firmwareId.firmwareVersion);
+		write16(file, job.nodeId);
+		write16(file, crcXModem(0, job.nodeName));
+		write16(file, job.targetDescription->crc());
+
+		// bytecode
+		write16(file, job.bytecode.size());
+		uint16_t crc(0);
+		for (const auto& element: job.bytecode)
+		{
+			write16(file, element.bytecode);
+			crc = crcXModem(crc, element.bytecode);
+		}
+		write16(file, crc);
+		return bool(file);
+	}
+
+	//! Write the bytecode of a job as plain text, in hexadecimal words, eight per line; this is not the Intel HEX format
+	bool writeText(const string& fileName, const Job& job)
+	{
+		ofstream file(fileName, ios::out | ios::trunc);
+		if (!file)
+			return false;
+		file << hex << setfill('0');
+		for (size_t i = 0; i < job.bytecode.size(); ++i)
+			file << setw(4) << job.bytecode[i].bytecode << (((i % 8) == 7 || i + 1 == job.bytecode.size()) ? '\n' : ' ');
+		return bool(file);
+	}
+
+	//! Return s as a JSON string literal
+	string jsonString(const string& s)
+	{
+		ostringstream oss;
+		oss << '"';
+		for (const unsigned char c: s)
+		{
+			switch (c)
+			{
+				case '"': oss << "\\\""; break;
+				case '\\': oss << "\\\\"; break;
+				case '\n': oss << "\\n"; break;
+				case '\t': oss << "\\t"; break;
+				default:
+					if (c < 0x20)
+						oss << "\\u" << hex << setw(4) << setfill('0') << unsigned(c) << dec;
+					else
+						oss << c;
+			}
+		}
+		oss << '"';
+		return oss.str();
+	}
+
+	//! Write the JSON report of all jobs
+	void writeReport(ostream& stream, const vector<Job>& jobs, unsigned threadCount, double duration, const CompilationCache& cache)
+	{
+		stream << "{\n";
+		stream << "\t\"threads\": " << threadCount << ",\n";
+		stream << "\t\"durationMs\": " << duration << ",\n";
+		stream << "\t\"cacheHits\": " << cache.hits() << ",\n";
+		stream << "\t\"cacheMisses\": " << cache.misses() << ",\n";
+		stream << "\t\"results\": [";
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			const Job& job(jobs[i]);
+			stream << (i ? ",\n" : "\n");
+			stream << "\t\t{ \"file\": " << jsonString(job.fileName);
+			stream << ", \"node\": " << jsonString(WStringToUTF8(job.nodeName));
+			stream << ", \"nodeId\": " << job.nodeId;
+			stream << ", \"success\": " << (job.success ? "true" : "false");
+			if (job.success)
+			{
+				const TargetDescription& description(*job.targetDescription);
+				stream << ", \"bytecodeSize\": " << job.bytecode.size();
+				stream << ", \"bytecodeCapacity\": " << description.bytecodeSize;
+				stream << ", \"variablesSize\": " << job.allocatedVariablesCount;
+				stream << ", \"variablesCapacity\": " << description.variablesSize;
+				stream << ", \"stackDepth\": " << job.bytecode.maxStackDepth;
+				stream << ", \"stackCapacity\": " << description.stackSize;
+			}
+			else
+			{
+				stream << ", \"error\": " << jsonString(WStringToUTF8(job.error.toWString()));
+			}
+			stream << ", \"durationMs\": " << job.duration << " }";
+		}
+		stream << "\n\t]\n";
+		stream << "}" << endl;
+	}
+
+	//! Show usage
+	void dumpHelp(ostream &stream, const char *programName)
+	{
+		stream << "Aseba compiler, compile .aesl programs for saved target descriptions, usage:\n";
+		stream << programName << " [options] -d descriptions [-d descriptions ...] file.aesl ...\n";
+		stream << programName << " --save-descriptions target descriptions\n";
+		stream << "Options:\n";
+		stream << "    -d, --descriptions FILE   : read target descriptions from FILE\n";
+		stream << "    -o, --output DIR          : write one .abo file per compiled node into DIR, named file-node, or file-node-id if several nodes share a name\n";
+		stream << "    -t, --text                : write bytecode as hexadecimal words, eight per line, in .txt files instead of .abo\n";
+		stream << "    -p, --product-id N        : write N as product identifier in .abo files, instead of the saved _productId\n";
+		stream << "    -f, --firmware-version N  : write N as firmware version in .abo files, instead of the saved _fwversion\n";
+		stream << "    -r, --report FILE         : write the JSON report into FILE instead of standard output\n";
+		stream << "    -j, --jobs N              : number of compilation threads (default: number of cores)\n";
+		stream << "    -c, --cache DIR           : keep compilation results in DIR across runs\n";
+		stream << "    -s, --save-descriptions TARGET FILE : save the descriptions of the nodes of TARGET into FILE\n";
+		stream << "    -h, --help                : shows this help\n";
+		stream << "    -V, --version             : shows the version number\n";
+		stream << "Report bugs to: aseba-dev@gna.org" << std::endl;
+	}
+
+	//! Show version
+	void dumpVersion(std::ostream &stream)
+	{
+		stream << "Aseba compiler " << ASEBA_VERSION << std::endl;
+		stream << "Aseba protocol " << ASEBA_PROTOCOL_VERSION << std::endl;
+		stream << "Licence LGPLv3: GNU LGPL version 3 <http://www.gnu.org/licenses/lgpl.html>\n";
+	}
+
+	//! Produce an error message and dump help and quit
+	void errorMissingArgument(const char *programName)
+	{
+		std::cerr << "Error, missing argument.\n";
+		dumpHelp(std::cerr, programName);
+		exit(4);
+	}
+
+	/*@}*/
+}
+
+int main(int argc, char *argv[])
+{
+	Dashel::initPlugins();
+
+	std::vector<std::string> descriptionFiles;
+	std::vector<std::string> sourceFiles;
+	std::string outputDirectory;
+	std::string reportFileName;
+	std::string cacheDirectory;
+	bool text(false);
+	Aseba::FirmwareId firmwareIdOverride;
+	unsigned threadCount(std::max(1u, std::thread::hardware_concurrency()));
+
+	int argCounter = 1;
+	while (argCounter < argc)
+	{
+		const char *arg = argv[argCounter];
+		const bool hasNext(argCounter + 1 < argc);
+		if ((strcmp(arg, "-d") == 0) || (strcmp(arg, "--descriptions") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			descriptionFiles.push_back(argv[++argCounter]);
+		}
+		else if ((strcmp(arg, "-o") == 0) || (strcmp(arg, "--output") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			outputDirectory = argv[++argCounter];
+		}
+		else if ((strcmp(arg, "-t") == 0) || (strcmp(arg, "--text") == 0))
+		{
+			text = true;
+		}
+		else if ((strcmp(arg, "-p") == 0) || (strcmp(arg, "--product-id") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			firmwareIdOverride.productId = std::max(0, atoi(argv[++argCounter]));
+		}
+		else if ((strcmp(arg, "-f") == 0) || (strcmp(arg, "--firmware-version") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			firmwareIdOverride.firmwareVersion = std::max(0, atoi(argv[++argCounter]));
+		}
+		else if ((strcmp(arg, "-r") == 0) || (strcmp(arg, "--report") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			reportFileName = argv[++argCounter];
+		}
+		else if ((strcmp(arg, "-j") == 0) || (strcmp(arg, "--jobs") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			threadCount = std::max(1, atoi(argv[++argCounter]));
+		}
+		else if ((strcmp(arg, "-c") == 0) || (strcmp(arg, "--cache") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			cacheDirectory = argv[++argCounter];
+		}
+		else if ((strcmp(arg, "-s") == 0) || (strcmp(arg, "--save-descriptions") == 0))
+		{
+			if (argCounter + 2 >= argc)
+				Aseba::errorMissingArgument(argv[0]);
+			try
+			{
+				Aseba::DescriptionsCollector collector;
+				collector.fetch(argv[argCounter + 1], 3000);
+				collector.save(argv[argCounter + 2]);
+				std::cerr << collector.descriptions.size() << " descriptions saved" << std::endl;
+				return collector.descriptions.empty() ? 1 : 0;
+			}
+			catch (const Dashel::DashelException& e)
+			{
+				std::cerr << "Error while fetching descriptions: " << e.what() << std::endl;
+				return 2;
+			}
+		}
+		else if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			Aseba::dumpHelp(std::cout, argv[0]);
+			return 0;
+		}
+		else if ((strcmp(arg, "-V") == 0) || (strcmp(arg, "--version") == 0))
+		{
+			Aseba::dumpVersion(std::cout);
+			return 0;
+		}
+		else
+		{
+			sourceFiles.push_back(arg);
+		}
+		argCounter++;
+	}
+
+	if (sourceFiles.empty() || descriptionFiles.empty())
+	{
+		Aseba::dumpHelp(std::cerr, argv[0]);
+		return 1;
+	}
+
+	// load descriptions
+	std::vector<Aseba::SavedDescription> savedDescriptions;
+	for (const auto& fileName: descriptionFiles)
+	{
+		try
+		{
+			Aseba::DescriptionsCollector collector;
+			collector.load(fileName);
+			for (const auto& description: collector.descriptions)
+				savedDescriptions.push_back({ description.second, collector.firmwareIds[description.first] });
+		}
+		catch (const Dashel::DashelException& e)
+		{
+			std::cerr << "Cannot read descriptions from " << fileName << ": " << e.what() << std::endl;
+			return 2;
+		}
+	}
+
+	// parse sources
+	std::vector<Aseba::Job> jobs;
+	for (const auto& fileName: sourceFiles)
+		if (!Aseba::addJobs(jobs, fileName, savedDescriptions))
+			return 2;
+	for (auto& job: jobs)
+	{
+		if (firmwareIdOverride.productId >= 0)
+			job.firmwareId.productId = firmwareIdOverride.productId;
+		if (firmwareIdOverride.firmwareVersion >= 0)
+			job.firmwareId.firmwareVersion = firmwareIdOverride.firmwareVersion;
+	}
+
+	// compile
+	Aseba::CompilationCache cache(256, cacheDirectory);
+	threadCount = std::min<unsigned>(threadCount, std::max<size_t>(1, jobs.size()));
+	const auto start(std::chrono::steady_clock::now());
+	Aseba::compileJobs(jobs, threadCount, cache);
+	const double duration(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+	// write results
+	bool allSucceeded(true);
+	for (const auto& job: jobs)
+	{
+		allSucceeded = allSucceeded && job.success;
+		if (!job.success || outputDirectory.empty())
+			continue;
+		const std::string baseName(Aseba::outputBaseName(outputDirectory, job));
+		if (!text && !job.firmwareId.isComplete())
+		{
+			std::cerr << "Unknown product identifier or firmware version for " << baseName << ", save descriptions from a running node or use --product-id and --firmware-version" << std::endl;
+			return 2;
+		}
+		const bool written(text ? Aseba::writeText(baseName + ".txt", job) : Aseba::writeAbo(baseName + ".abo", job));
+		if (!written)
+		{
+			std::cerr << "Cannot write output for " << baseName << std::endl;
+			return 2;
+		}
+	}
+
+	if (reportFileName.empty())
+		Aseba::writeReport(std::cout, jobs, threadCount, duration, cache);
+	else
+	{
+		std::ofstream report(reportFileName);
+		Aseba::writeReport(report, jobs, threadCount, duration, cache);
+	}
+
+	return allSucceeded ? 0 : 3;
+}
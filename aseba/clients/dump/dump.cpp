@@ -20,11 +20,15 @@
 #include <dashel/dashel.h>
 #include "common/consts.h"
 #include "common/msg/msg.h"
+#include "common/msg/endian.h"
+#include "common/msg/CaptureFile.h"
 #include "common/utils/utils.h"
 #include "transport/dashel_plugins/dashel-plugins.h"
 #include <time.h>
 #include <iostream>
 #include <cstring>
+#include <memory>
+#include <stdexcept>
 
 namespace Aseba
 {
@@ -37,28 +41,51 @@ namespace Aseba
 	/*@{*/
 
 	//! A simple message dumper.
-	//! This class calls Aseba::Message::dump() for each message
+	//! This class calls Aseba::Message::dump() for each message, or writes them to a binary capture
 	class Dump : public Hub
 	{
 	private:
 		bool rawTime; //!< should displayed timestamps be of the form sec:usec since 1970
+		std::unique_ptr<CaptureWriter> capture; //!< if set, messages are written there instead of being printed
 
 	public:
-		Dump(bool rawTime) :
+		Dump(bool rawTime, const char* captureFile = nullptr, bool compress = false) :
 			rawTime(rawTime)
 		{
+			if (captureFile)
+				capture.reset(new CaptureWriter(captureFile, compress));
 		}
 
 	protected:
 
 		void connectionCreated(Stream *stream)
 		{
-			dumpTime(cout, rawTime);
-			cout << stream->getTargetName()  << " connection created." << endl;
+			ostream& out(capture ? cerr : cout);
+			dumpTime(out, rawTime);
+			out << stream->getTargetName()  << " connection created." << endl;
 		}
 
 		void incomingData(Stream *stream)
 		{
+			if (capture)
+			{
+				// store the frame as it is, without deserializing it
+				uint16_t len, source, type;
+				stream->read(&len, 2);
+				swapEndian(len);
+				stream->read(&source, 2);
+				swapEndian(source);
+				stream->read(&type, 2);
+				swapEndian(type);
+				uint8_t payload[ASEBA_MAX_EVENT_ARG_SIZE];
+				if (len > sizeof(payload))
+					throw runtime_error("Received a message larger than the maximum packet size");
+				if (len)
+					stream->read(payload, len);
+				capture->write(capture->elapsed(), source, type, payload, len);
+				return;
+			}
+
 			Message *message = Message::receive(stream);
 
 			dumpTime(cout, rawTime);
@@ -72,14 +99,34 @@ namespace Aseba
 
 		void connectionClosed(Stream *stream, bool abnormal)
 		{
-			dumpTime(cout);
-			cout << stream->getTargetName() << " connection closed";
+			ostream& out(capture ? cerr : cout);
+			dumpTime(out);
+			out << stream->getTargetName() << " connection closed";
 			if (abnormal)
-				cout << " : " << stream->getFailReason();
-			cout << "." << endl;
+				out << " : " << stream->getFailReason();
+			out << "." << endl;
+			if (capture)
+				capture->flush();
 		}
 	};
 
+	//! Print the content of a binary capture as asebadump would have printed the messages
+	void dumpCapture(const char* captureFile, bool rawTime)
+	{
+		CaptureReader reader(captureFile);
+		if (reader.isIndexRebuilt())
+			cerr << "Warning: capture was interrupted, the last messages might be missing" << endl;
+
+		CaptureReader::Record record;
+		while (reader.next(record))
+		{
+			const UnifiedTime time(reader.getStartTime() + UnifiedTime(record.time / 1000));
+			cout << (rawTime ? time.toRawTimeString() : time.toHumanReadableStringFromEpoch()) << " ";
+			record.createMessage()->dump(wcout);
+			cout << endl;
+		}
+	}
+
 	/*@}*/
 }
 
@@ -91,6 +138,9 @@ void dumpHelp(std::ostream &stream, const char *programName)
 	stream << programName << " [options] [targets]*\n";
 	stream << "Options:\n";
 	stream << "--rawtime       : shows time in the form of sec:usec since 1970\n";
+	stream << "--capture FILE  : writes messages to the binary capture FILE instead of printing them\n";
+	stream << "--compress      : compresses the binary capture\n";
+	stream << "--read FILE     : prints the messages of the binary capture FILE and quits\n";
 	stream << "-h, --help      : shows this help\n";
 	stream << "-V, --version   : shows the version number\n";
 	stream << "Targets are any valid Dashel targets." << std::endl << std::endl;
@@ -109,6 +159,9 @@ int main(int argc, char *argv[])
 {
 	Dashel::initPlugins();
 	bool rawTime = false;
+	const char* captureFile = nullptr;
+	bool compress = false;
+	const char* readFile = nullptr;
 	std::vector<std::string> targets;
 
 	int argCounter = 1;
@@ -121,6 +174,23 @@ int main(int argc, char *argv[])
 		{
 			rawTime = true;
 		}
+		else if ((strcmp(arg, "--capture") == 0) || (strcmp(arg, "--read") == 0))
+		{
+			argCounter++;
+			if (argCounter >= argc)
+			{
+				dumpHelp(std::cerr, argv[0]);
+				return 1;
+			}
+			if (strcmp(arg, "--capture") == 0)
+				captureFile = argv[argCounter];
+			else
+				readFile = argv[argCounter];
+		}
+		else if (strcmp(arg, "--compress") == 0)
+		{
+			compress = true;
+		}
 		else if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
 		{
 			dumpHelp(std::cout, argv[0]);
@@ -143,7 +213,12 @@ int main(int argc, char *argv[])
 
 	try
 	{
-		Aseba::Dump dump(rawTime);
+		if (readFile)
+		{
+			Aseba::dumpCapture(readFile, rawTime);
+			return 0;
+		}
+		Aseba::Dump dump(rawTime, captureFile, compress);
 		for (size_t i = 0; i < targets.size(); i++)
 			dump.connect(targets[i]);
 		dump.run();
@@ -152,6 +227,11 @@ int main(int argc, char *argv[])
 	{
 		std::cerr << e.what() << std::endl;
 	}
+	catch(const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
 
 	return 0;
 }
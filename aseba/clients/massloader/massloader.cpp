@@ -27,6 +27,7 @@
 #include "common/msg/NodesManager.h"
 #include "common/utils/utils.h"
 #include "compiler/compiler.h"
+#include "compiler/compilation-cache.h"
 #include "transport/dashel_plugins/dashel-plugins.h"
 #include <QCoreApplication>
 #include <QString>
@@ -45,6 +46,7 @@ namespace Aseba
 		QString fileName;
 		bool once;
 		Stream* stream;
+		CompilationCache compilationCache; //!< the same program is loaded again and again on identical targets
 
 	public:
 		MassLoader(const QString& fileName, bool once):fileName(fileName),once(once),stream(nullptr) {}
@@ -197,6 +199,7 @@ namespace Aseba
 						Compiler compiler;
 						compiler.setTargetDescription(getDescription(nodeId));
 						compiler.setCommonDefinitions(&commonDefinitions);
+						compiler.setCompilationCache(&compilationCache);
 						bool result = compiler.compile(is, bytecode, allocatedVariablesCount, error);
 
 						if (result)
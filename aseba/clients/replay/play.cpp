@@ -20,6 +20,8 @@
 #include <dashel/dashel.h>
 #include "common/consts.h"
 #include "common/msg/msg.h"
+#include "common/msg/endian.h"
+#include "common/msg/CaptureFile.h"
 #include "common/utils/utils.h"
 #include "transport/dashel_plugins/dashel-plugins.h"
 #include <time.h>
@@ -27,6 +29,12 @@
 #include <cstring>
 #include <string>
 #include <deque>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
 
 namespace Aseba
 {
@@ -39,31 +47,106 @@ namespace Aseba
 	/*@{*/
 
 	//! A message player
-	//! This class replay saved user messages
+	//! This class replay saved user messages, from text recorded by asebarec or from a binary capture of asebadump
 	class Player : public Hub
 	{
 	private:
 		typedef deque<string> StringList;
 
 		bool respectTimings;
-		int speedFactor;
+		double speedFactor;
 		Stream* in;
 		string line;
 		UnifiedTime lastTimeStamp;
 		UnifiedTime lastEventTime;
 
 	public:
-		Player(const char* inputFile, bool respectTimings, int speedFactor) :
+		//! Create a player reading text from inputFile or stdin if null, or nothing if capture is true, see playCapture()
+		Player(const char* inputFile, bool respectTimings, double speedFactor, bool capture = false) :
 			respectTimings(respectTimings),
 			speedFactor(speedFactor),
+			in(nullptr),
 			lastTimeStamp(0)
 		{
+			if (capture)
+				return;
 			if (inputFile)
 				in = connect("file:" + string(inputFile) + ";mode=read");
 			else
 				in = connect("stdin:");
 		}
 
+		//! Send the messages of reader from time from to time to, in µs since the start of the capture
+		void playCapture(CaptureReader& reader, uint64_t from, uint64_t to)
+		{
+			reader.seek(from);
+			const auto start(chrono::steady_clock::now());
+			CaptureReader::Record record;
+			unsigned sentCount(0);
+			while (reader.next(record) && record.time <= to)
+			{
+				if (respectTimings)
+				{
+					const auto due(start + chrono::microseconds(static_cast<uint64_t>((record.time - from) / speedFactor)));
+					if (chrono::steady_clock::now() < due)
+						waitUntil(due);
+				}
+				// as fast as possible, only look at targets from time to time
+				else if (++sentCount % 256 == 0)
+				{
+					flushTargets();
+					step(0);
+				}
+				sendRecord(record);
+			}
+			flushTargets();
+		}
+
+		//! Write record on all connected streams, without deserializing it
+		void sendRecord(const CaptureReader::Record& record)
+		{
+			const uint16_t header[3] = {
+				swapEndianCopy(record.length),
+				swapEndianCopy(record.source),
+				swapEndianCopy(record.type)
+			};
+			for (StreamsSet::iterator it = dataStreams.begin(); it != dataStreams.end();++it)
+			{
+				Stream* destStream(*it);
+				if (destStream != in)
+				{
+					destStream->write(header, sizeof(header));
+					if (record.length)
+						destStream->write(record.payload, record.length);
+				}
+			}
+		}
+
+		//! Flush all connected streams
+		void flushTargets()
+		{
+			for (StreamsSet::iterator it = dataStreams.begin(); it != dataStreams.end();++it)
+				if (*it != in)
+					(*it)->flush();
+		}
+
+		//! Process data from targets until due
+		void waitUntil(chrono::steady_clock::time_point due)
+		{
+			flushTargets();
+			while (true)
+			{
+				const auto now(chrono::steady_clock::now());
+				if (now >= due)
+					return;
+				const auto ms(chrono::duration_cast<chrono::milliseconds>(due - now).count());
+				if (ms > 0)
+					step(int(ms));
+				else
+					this_thread::sleep_until(due);
+			}
+		}
+
 		StringList tokenize(const string& input)
 		{
 			StringList list;
@@ -120,8 +203,7 @@ namespace Aseba
 				const UnifiedTime deltaTimeStamp(timeStamp - lastTimeStamp);
 				if (lostTime < deltaTimeStamp)
 				{
-					UnifiedTime waitTime(deltaTimeStamp - lostTime);
-					waitTime /= speedFactor;
+					const UnifiedTime waitTime(static_cast<UnifiedTime::Value>((deltaTimeStamp - lostTime).value / speedFactor));
 					waitTime.sleep();
 				}
 			}
@@ -183,7 +265,10 @@ void dumpHelp(std::ostream &stream, const char *programName)
 	stream << "--fast          : replay messages twice the speed of real time\n";
 	stream << "--faster        : replay messages four times the speed of real time\n";
 	stream << "--fastest       : replay messages as fast as possible\n";
-	stream << "-f INPUT_FILE   : open INPUT_FILE instead of stdin\n";
+	stream << "--speed FACTOR  : replay messages FACTOR times the speed of real time\n";
+	stream << "--from SECONDS  : start at SECONDS from the beginning, for binary captures\n";
+	stream << "--to SECONDS    : stop at SECONDS from the beginning, for binary captures\n";
+	stream << "-f INPUT_FILE   : open INPUT_FILE instead of stdin, either text or a binary capture of asebadump\n";
 	stream << "-h, --help      : shows this help\n";
 	stream << "-V, --version   : shows the version number\n";
 	stream << "Targets are any valid Dashel targets." << std::endl;
@@ -202,7 +287,9 @@ int main(int argc, char *argv[])
 {
 	Dashel::initPlugins();
 	bool respectTimings = true;
-	int speedFactor = 1;
+	double speedFactor = 1;
+	double from = 0;
+	double to = -1;
 	std::vector<std::string> targets;
 	const char* inputFile = 0;
 
@@ -224,6 +311,29 @@ int main(int argc, char *argv[])
 		{
 			speedFactor = 4;
 		}
+		else if ((strcmp(arg, "--speed") == 0) || (strcmp(arg, "--from") == 0) || (strcmp(arg, "--to") == 0))
+		{
+			argCounter++;
+			if (argCounter >= argc)
+			{
+				dumpHelp(std::cout, argv[0]);
+				return 1;
+			}
+			const double value(atof(argv[argCounter]));
+			if (strcmp(arg, "--speed") == 0)
+			{
+				if (value <= 0)
+				{
+					std::cerr << "Speed factor must be positive" << std::endl;
+					return 1;
+				}
+				speedFactor = value;
+			}
+			else if (strcmp(arg, "--from") == 0)
+				from = value;
+			else
+				to = value;
+		}
 		else if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
 		{
 			dumpHelp(std::cout, argv[0]);
@@ -257,15 +367,32 @@ int main(int argc, char *argv[])
 
 	try
 	{
-		Aseba::Player player(inputFile, respectTimings, speedFactor);
+		// binary captures are read directly, text through a Dashel stream
+		std::unique_ptr<Aseba::CaptureReader> capture;
+		if (inputFile && Aseba::Capture::isCaptureFile(inputFile))
+			capture.reset(new Aseba::CaptureReader(inputFile));
+
+		Aseba::Player player(inputFile, respectTimings, speedFactor, capture != nullptr);
 		for (size_t i = 0; i < targets.size(); i++)
 			player.connect(targets[i]);
-		player.run();
+		if (capture)
+		{
+			const uint64_t fromTime(static_cast<uint64_t>(std::max(from, 0.) * 1e6));
+			const uint64_t toTime(to < 0 ? capture->getEndTime() : static_cast<uint64_t>(to * 1e6));
+			player.playCapture(*capture, fromTime, toTime);
+		}
+		else
+			player.run();
 	}
 	catch(Dashel::DashelException e)
 	{
 		std::cerr << e.what() << std::endl;
 	}
+	catch(const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
 
 	return 0;
 }
@@ -0,0 +1,297 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CaptureStatistics.h"
+#include "common/msg/msg.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace Aseba
+{
+	using namespace std;
+
+	/** \addtogroup stats */
+	/*@{*/
+
+	static const char* requestNames[REQUEST_KINDS_COUNT] = {
+		"GetVariables -> Variables",
+		"GetChangedVariables -> ChangedVariables",
+		"BreakpointSet -> BreakpointSetResult"
+	};
+
+	void Statistics::process(const CaptureReader::Record& record)
+	{
+		++recordsCount;
+		firstTime = min(firstTime, record.time);
+		lastTime = max(lastTime, record.time);
+
+		const unique_ptr<Message> message(record.createMessage());
+		Traffic& typeTraffic(traffic[{record.source, record.type}]);
+		if (typeTraffic.name.empty())
+			typeTraffic.name = message->getName();
+		++typeTraffic.count;
+		typeTraffic.bytes += record.length;
+
+		// requests
+		if (const auto* getVariables = dynamic_cast<const GetVariables*>(message.get()))
+			exchanges.push_back({record.time, RequestKey(GET_VARIABLES, getVariables->dest, getVariables->start), getVariables->length, true});
+		else if (const auto* getChangedVariables = dynamic_cast<const GetChangedVariables*>(message.get()))
+			exchanges.push_back({record.time, RequestKey(GET_CHANGED_VARIABLES, getChangedVariables->dest, getChangedVariables->start), 0, true});
+		else if (const auto* breakpointSet = dynamic_cast<const BreakpointSet*>(message.get()))
+			exchanges.push_back({record.time, RequestKey(BREAKPOINT_SET, breakpointSet->dest, breakpointSet->pc), 0, true});
+		// replies
+		else if (const auto* variables = dynamic_cast<const Variables*>(message.get()))
+			exchanges.push_back({record.time, RequestKey(GET_VARIABLES, record.source, variables->start), uint16_t(variables->variables.size()), false});
+		else if (const auto* changedVariables = dynamic_cast<const ChangedVariables*>(message.get()))
+			exchanges.push_back({record.time, RequestKey(GET_CHANGED_VARIABLES, record.source, changedVariables->start), 0, false});
+		else if (const auto* breakpointSetResult = dynamic_cast<const BreakpointSetResult*>(message.get()))
+		{
+			exchanges.push_back({record.time, RequestKey(BREAKPOINT_SET, record.source, breakpointSetResult->pc), 0, false});
+			if (!breakpointSetResult->success)
+				++errors[{record.source, "breakpoint not set"}];
+		}
+		// errors
+		else if (dynamic_cast<const ArrayAccessOutOfBounds*>(message.get()) ||
+			dynamic_cast<const DivisionByZero*>(message.get()) ||
+			dynamic_cast<const EventExecutionKilled*>(message.get()) ||
+			dynamic_cast<const NodeSpecificError*>(message.get()))
+			++errors[{record.source, message->getName()}];
+	}
+
+	void Statistics::merge(Statistics& next)
+	{
+		recordsCount += next.recordsCount;
+		firstTime = min(firstTime, next.firstTime);
+		lastTime = max(lastTime, next.lastTime);
+		for (const auto& typeTraffic: next.traffic)
+		{
+			Traffic& merged(traffic[typeTraffic.first]);
+			merged.name = typeTraffic.second.name;
+			merged.count += typeTraffic.second.count;
+			merged.bytes += typeTraffic.second.bytes;
+		}
+		for (const auto& error: next.errors)
+			errors[error.first] += error.second;
+
+		// requests and replies are paired in the order of the whole capture, whatever the parts
+		pairExchanges(next.exchanges);
+		next.exchanges.clear();
+		next.exchanges.shrink_to_fit();
+	}
+
+	void Statistics::finish()
+	{
+		pairExchanges(exchanges);
+		exchanges.clear();
+		for (const auto& requests: pending)
+			unanswered[get<0>(requests.first)] += requests.second.size();
+		pending.clear();
+		for (const auto& replies: splitReplies)
+			unanswered[get<0>(replies.first)] += replies.second.size();
+		splitReplies.clear();
+	}
+
+	void Statistics::pairExchanges(const vector<Exchange>& partExchanges)
+	{
+		for (const auto& exchange: partExchanges)
+		{
+			if (exchange.request)
+				pending[exchange.key].push_back({exchange.time, exchange.length});
+			else
+				pairReply(exchange);
+		}
+	}
+
+	void Statistics::pairReply(const Exchange& reply)
+	{
+		const unsigned kind(get<0>(reply.key));
+
+		// continuation of a reply split in several messages
+		const auto splitIt(splitReplies.find(reply.key));
+		if (splitIt != splitReplies.end())
+		{
+			auto& replies(splitIt->second);
+			while (!replies.empty() && replies.front().requestTime + timeout < reply.time)
+			{
+				++unanswered[kind];
+				replies.pop_front();
+			}
+			if (!replies.empty())
+			{
+				const SplitReply split(replies.front());
+				replies.pop_front();
+				const uint32_t nextStart(get<2>(reply.key) + reply.length);
+				if (nextStart >= split.end || reply.length == 0)
+					latencies[kind].push_back(reply.time - split.requestTime);
+				else
+					splitReplies[RequestKey(kind, get<1>(reply.key), uint16_t(nextStart))].push_back(split);
+				return;
+			}
+		}
+
+		// first message of a reply
+		const auto requestsIt(pending.find(reply.key));
+		if (requestsIt != pending.end())
+		{
+			auto& requests(requestsIt->second);
+			while (!requests.empty() && requests.front().time + timeout < reply.time)
+			{
+				++unanswered[kind];
+				requests.pop_front();
+			}
+			if (!requests.empty())
+			{
+				const Request request(requests.front());
+				requests.pop_front();
+				if (reply.length > 0 && reply.length < request.length)
+				{
+					const uint32_t start(get<2>(reply.key));
+					splitReplies[RequestKey(kind, get<1>(reply.key), uint16_t(start + reply.length))].push_back({request.time, start + request.length});
+				}
+				else
+					latencies[kind].push_back(reply.time - request.time);
+				return;
+			}
+		}
+		++unsolicited[kind];
+	}
+
+	//! Compute the statistics of the capture in fileName, processing chunks with threadCount threads
+	Statistics computeStatistics(const string& fileName, unsigned threadCount, uint64_t timeout)
+	{
+		CaptureReader reader(fileName);
+		if (reader.isIndexRebuilt())
+			cerr << "Warning: capture was interrupted, the last messages might be missing" << endl;
+
+		// contiguous ranges of chunks, more than threads to balance the load
+		const size_t chunksCount(reader.getChunksCount());
+		const size_t partsCount(min<size_t>(chunksCount, threadCount * 4));
+		vector<Statistics> parts(partsCount, Statistics(timeout));
+		atomic<size_t> nextPart(0);
+		vector<exception_ptr> failures(threadCount);
+		const auto work([&](unsigned threadIndex) {
+			try
+			{
+				// every thread has its own mapping of the file and position in it
+				CaptureReader threadReader(fileName);
+				CaptureReader::Record record;
+				for (size_t part = nextPart++; part < partsCount; part = nextPart++)
+				{
+					for (size_t chunk = part * chunksCount / partsCount; chunk < (part + 1) * chunksCount / partsCount; ++chunk)
+					{
+						threadReader.seekChunk(chunk);
+						while (threadReader.nextInChunk(record))
+							parts[part].process(record);
+					}
+				}
+			}
+			catch (...)
+			{
+				failures[threadIndex] = current_exception();
+			}
+		});
+		vector<thread> threads;
+		for (unsigned i = 1; i < min<size_t>(threadCount, partsCount); ++i)
+			threads.emplace_back(work, i);
+		work(0);
+		for (auto& thread: threads)
+			thread.join();
+		for (const auto& failure: failures)
+			if (failure)
+				rethrow_exception(failure);
+
+		Statistics statistics(timeout);
+		for (auto& part: parts)
+			statistics.merge(part);
+		statistics.finish();
+		return statistics;
+	}
+
+	//! Return the value at fraction p of sorted values, 0 if empty
+	static double percentile(const vector<uint64_t>& values, double p)
+	{
+		if (values.empty())
+			return 0;
+		return values[min(values.size() - 1, size_t(p * values.size()))];
+	}
+
+	//! Print statistics as text tables
+	void writeReport(ostream& stream, Statistics& statistics)
+	{
+		const double duration(statistics.recordsCount ? (statistics.lastTime - statistics.firstTime) / 1e6 : 0);
+		const auto rate([=](uint64_t count) { return duration > 0 ? count / duration : 0.; });
+		stream << fixed << setprecision(1);
+		stream << statistics.recordsCount << " messages over " << duration << " s\n";
+
+		stream << "\nTraffic by node:\n";
+		stream << setw(8) << "node" << setw(12) << "messages" << setw(12) << "msg/s" << setw(14) << "bytes" << setw(12) << "bytes/s" << "\n";
+		map<uint16_t, Statistics::Traffic> nodesTraffic;
+		for (const auto& typeTraffic: statistics.traffic)
+		{
+			auto& nodeTraffic(nodesTraffic[typeTraffic.first.first]);
+			nodeTraffic.count += typeTraffic.second.count;
+			nodeTraffic.bytes += typeTraffic.second.bytes;
+		}
+		for (const auto& nodeTraffic: nodesTraffic)
+			stream << setw(8) << nodeTraffic.first << setw(12) << nodeTraffic.second.count << setw(12) << rate(nodeTraffic.second.count) << setw(14) << nodeTraffic.second.bytes << setw(12) << rate(nodeTraffic.second.bytes) << "\n";
+
+		stream << "\nTraffic by node and type, most frequent first:\n";
+		stream << setw(8) << "node" << setw(8) << "type" << "  " << left << setw(26) << "name" << right << setw(12) << "messages" << setw(12) << "msg/s" << setw(14) << "bytes" << setw(12) << "bytes/s" << "\n";
+		vector<pair<pair<uint16_t, uint16_t>, Statistics::Traffic>> sortedTraffic(statistics.traffic.begin(), statistics.traffic.end());
+		stable_sort(sortedTraffic.begin(), sortedTraffic.end(), [](const pair<pair<uint16_t, uint16_t>, Statistics::Traffic>& a, const pair<pair<uint16_t, uint16_t>, Statistics::Traffic>& b) {
+			return a.second.count > b.second.count;
+		});
+		for (const auto& typeTraffic: sortedTraffic)
+		{
+			stream << setw(8) << typeTraffic.first.first << "    " << hex << setfill('0') << setw(4) << typeTraffic.first.second << dec << setfill(' ');
+			stream << "  " << left << setw(26) << typeTraffic.second.name << right;
+			stream << setw(12) << typeTraffic.second.count << setw(12) << rate(typeTraffic.second.count) << setw(14) << typeTraffic.second.bytes << setw(12) << rate(typeTraffic.second.bytes) << "\n";
+		}
+
+		stream << "\nRound-trip latencies in ms:\n";
+		stream << left << setw(42) << "request" << right << setw(10) << "replies" << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "max" << setw(12) << "unanswered" << setw(13) << "unsolicited" << "\n";
+		stream << setprecision(2);
+		for (unsigned kind = 0; kind < REQUEST_KINDS_COUNT; ++kind)
+		{
+			auto& latencies(statistics.latencies[kind]);
+			sort(latencies.begin(), latencies.end());
+			stream << left << setw(42) << requestNames[kind] << right << setw(10) << latencies.size();
+			for (const double p: { 0.5, 0.9, 0.99, 1. })
+				stream << setw(10) << percentile(latencies, p) / 1000;
+			stream << setw(12) << statistics.unanswered[kind] << setw(13) << statistics.unsolicited[kind] << "\n";
+		}
+
+		stream << "\nErrors:\n";
+		if (statistics.errors.empty())
+			stream << "none\n";
+		else
+			stream << setw(8) << "node" << "  " << left << setw(26) << "error" << right << setw(12) << "count" << "\n";
+		for (const auto& error: statistics.errors)
+			stream << setw(8) << error.first.first << "  " << left << setw(26) << error.first.second << right << setw(12) << error.second << "\n";
+		stream << flush;
+	}
+
+	/*@}*/
+} // namespace Aseba
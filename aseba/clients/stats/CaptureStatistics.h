@@ -0,0 +1,129 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_CAPTURE_STATISTICS_H
+#define ASEBA_CAPTURE_STATISTICS_H
+
+#include "common/msg/CaptureFile.h"
+#include <deque>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Aseba
+{
+	/**
+	\defgroup stats Statistics of captures
+	*/
+	/*@{*/
+
+	//! Requests whose latency is measured, by pairing them with their reply
+	enum RequestKind
+	{
+		GET_VARIABLES = 0,
+		GET_CHANGED_VARIABLES,
+		BREAKPOINT_SET,
+		REQUEST_KINDS_COUNT
+	};
+
+	//! Statistics of a part of a capture, parts being merged in time order
+	/**
+		Records of parts can be processed in parallel, but requests and replies are only paired
+		when parts are merged, in time order, so that results do not depend on how the capture
+		was split. A Statistics either processes records or merges parts.
+	*/
+	class Statistics
+	{
+	public:
+		//! Traffic of a given type of messages from a given source
+		struct Traffic
+		{
+			std::string name;
+			uint64_t count = 0;
+			uint64_t bytes = 0;
+		};
+		//! Request of a given kind, to a given node, for a given address
+		typedef std::tuple<unsigned, uint16_t, uint16_t> RequestKey;
+
+		uint64_t recordsCount = 0;
+		uint64_t firstTime = std::numeric_limits<uint64_t>::max(); //!< time of the first record in µs
+		uint64_t lastTime = 0; //!< time of the last record in µs
+		std::map<std::pair<uint16_t, uint16_t>, Traffic> traffic; //!< by source and type
+		std::map<std::pair<uint16_t, std::string>, uint64_t> errors; //!< by source and name of error
+		std::vector<uint64_t> latencies[REQUEST_KINDS_COUNT]; //!< in µs, until the last part of the reply
+		uint64_t unanswered[REQUEST_KINDS_COUNT] = {}; //!< requests whose reply did not come within the timeout
+		uint64_t unsolicited[REQUEST_KINDS_COUNT] = {}; //!< replies to requests that were not seen, or sent by nodes on their own
+
+	protected:
+		//! A request or a reply, to be paired once parts are merged
+		struct Exchange
+		{
+			uint64_t time;
+			RequestKey key;
+			uint16_t length; //!< number of variables asked or received, 0 for other kinds
+			bool request;
+		};
+		//! A request waiting for its reply
+		struct Request
+		{
+			uint64_t time;
+			uint16_t length;
+		};
+		//! A request whose reply is split in several messages, waiting for the next one
+		struct SplitReply
+		{
+			uint64_t requestTime;
+			uint32_t end; //!< address after the last variable asked
+		};
+
+		uint64_t timeout; //!< time in µs after which requests are considered unanswered
+		std::vector<Exchange> exchanges; //!< requests and replies of this part, in time order
+		std::map<RequestKey, std::deque<Request>> pending; //!< requests waiting for their reply, oldest first
+		std::map<RequestKey, std::deque<SplitReply>> splitReplies; //!< by the address of the next part of the reply, oldest first
+
+	public:
+		explicit Statistics(uint64_t timeout): timeout(timeout) {}
+
+		//! Account for record
+		void process(const CaptureReader::Record& record);
+		//! Add the statistics of next, which is the part of the capture following the previous merged one
+		void merge(Statistics& next);
+		//! Consider requests still pending as unanswered, once all parts are merged
+		void finish();
+
+	protected:
+		//! Pair requests and replies of a part following the ones already paired
+		void pairExchanges(const std::vector<Exchange>& partExchanges);
+		//! Pair reply with the oldest request or partial reply it continues, or count it as unsolicited
+		void pairReply(const Exchange& reply);
+	};
+
+	//! Compute the statistics of the capture in fileName, processing chunks with threadCount threads
+	Statistics computeStatistics(const std::string& fileName, unsigned threadCount, uint64_t timeout);
+
+	//! Print statistics as text tables
+	void writeReport(std::ostream& stream, Statistics& statistics);
+
+	/*@}*/
+} // namespace Aseba
+
+#endif // ASEBA_CAPTURE_STATISTICS_H
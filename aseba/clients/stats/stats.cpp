@@ -0,0 +1,109 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/consts.h"
+#include "CaptureStatistics.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+//! Show usage
+void dumpHelp(std::ostream &stream, const char *programName)
+{
+	stream << "Aseba stats, print statistics of binary captures written by asebadump --capture, usage:\n";
+	stream << programName << " [options] capture\n";
+	stream << "Options:\n";
+	stream << "-j, --jobs N    : number of threads (default: number of cores)\n";
+	stream << "--timeout MS    : time after which requests are considered unanswered (default: 1000)\n";
+	stream << "-h, --help      : shows this help\n";
+	stream << "-V, --version   : shows the version number\n";
+	stream << "Report bugs to: aseba-dev@gna.org" << std::endl;
+}
+
+//! Show version
+void dumpVersion(std::ostream &stream)
+{
+	stream << "Aseba stats " << ASEBA_VERSION << std::endl;
+	stream << "Aseba protocol " << ASEBA_PROTOCOL_VERSION << std::endl;
+	stream << "Licence LGPLv3: GNU LGPL version 3 <http://www.gnu.org/licenses/lgpl.html>\n";
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned threadCount(std::max(1u, std::thread::hardware_concurrency()));
+	unsigned timeout(1000);
+	const char* fileName(nullptr);
+
+	int argCounter = 1;
+	while (argCounter < argc)
+	{
+		const char *arg = argv[argCounter];
+		if ((strcmp(arg, "-j") == 0) || (strcmp(arg, "--jobs") == 0) || (strcmp(arg, "--timeout") == 0))
+		{
+			argCounter++;
+			if (argCounter >= argc)
+			{
+				dumpHelp(std::cerr, argv[0]);
+				return 1;
+			}
+			const int value(std::max(1, atoi(argv[argCounter])));
+			if (strcmp(arg, "--timeout") == 0)
+				timeout = value;
+			else
+				threadCount = value;
+		}
+		else if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			dumpHelp(std::cout, argv[0]);
+			return 0;
+		}
+		else if ((strcmp(arg, "-V") == 0) || (strcmp(arg, "--version") == 0))
+		{
+			dumpVersion(std::cout);
+			return 0;
+		}
+		else
+		{
+			fileName = arg;
+		}
+		argCounter++;
+	}
+
+	if (!fileName)
+	{
+		dumpHelp(std::cerr, argv[0]);
+		return 1;
+	}
+
+	try
+	{
+		Aseba::Statistics statistics(Aseba::computeStatistics(fileName, threadCount, uint64_t(timeout) * 1000));
+		Aseba::writeReport(std::cout, statistics);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -21,6 +21,7 @@
 #include "common/msg/msg.h"
 #include "common/utils/utils.h"
 #include <algorithm>
+#include <iterator>
 #include <iostream>
 #include <ostream>
 #include <sstream>
@@ -30,6 +31,7 @@
 #include <QLibraryInfo>
 #include <QHostInfo>
 #include <QNetworkInterface>
+#include <QStandardPaths>
 #include <stdexcept>
 #include <regex>
 
@@ -352,7 +354,10 @@ namespace Aseba
 
 	DashelInterface::DashelInterface(QVector<QTranslator*> translators, const QString& commandLineTarget) :
 		isRunning(true),
-		stream(0)
+		stream(0),
+		userEvents(16384),
+		userEventsDropped(0),
+		userEventsNotified(false)
 	{
 		// first use local name
 		const QString& systemLocale(QLocale::system().name());
@@ -362,6 +367,11 @@ namespace Aseba
 		translators[2]->load(QString(":/compiler_") + systemLocale);
 		translators[3]->load(QString(":/qtabout_") + systemLocale);
 
+		// reuse the descriptions of nodes seen in previous sessions, to connect faster
+		const QString descriptionsDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/descriptions");
+		if (QDir().mkpath(descriptionsDirectory))
+			setDescriptionsCacheDirectory(QDir::toNativeSeparators(descriptionsDirectory).toLocal8Bit().constData());
+
 		// try to connect to cammand line target, if any
 		DashelConnectionDialog targetSelector;
 		language = targetSelector.getLocaleName();
@@ -464,11 +474,67 @@ namespace Aseba
 
 	void DashelInterface::incomingData(Stream *stream)
 	{
-
 		Message *message = Message::receive(stream);
+
+		// the hub is locked while in incomingData(), so recording cannot change meanwhile
+		if (recording)
+		{
+			try
+			{
+				recording->write(recording->elapsed(), *message);
+			}
+			catch (const std::runtime_error& e)
+			{
+				recording.reset();
+				emit recordingFailed(QString::fromLocal8Bit(e.what()));
+			}
+		}
+
+		// user events go through the ring buffer, and the gui thread is only notified when it has read the previous ones
+		UserMessage *userMessage = dynamic_cast<UserMessage *>(message);
+		if (userMessage)
+		{
+			// the source is kept for the gui thread to update the nodes manager, as processMessage() would have
+			UserEvent event = { userMessage->type, QDateTime::currentMSecsSinceEpoch(), std::move(userMessage->data), userMessage->source };
+			delete message;
+			if (!userEvents.push(std::move(event)))
+				++userEventsDropped;
+			if (!userEventsNotified.exchange(true))
+				emit userEventsAvailable();
+			return;
+		}
+
 		emit messageAvailable(message);
 	}
 
+	//! Start writing all incoming messages to fileName, return the error if any
+	QString DashelInterface::startRecording(const QString& fileName)
+	{
+		std::unique_ptr<CaptureWriter> writer;
+		try
+		{
+			writer.reset(new CaptureWriter(fileName.toLocal8Bit().constData(), Capture::isCompressionSupported()));
+		}
+		catch (const std::runtime_error& e)
+		{
+			return QString::fromLocal8Bit(e.what());
+		}
+		lock();
+		recording.swap(writer);
+		unlock();
+		// writer now holds the previous recording, if any, which is closed outside the lock
+		return QString();
+	}
+
+	//! Stop writing incoming messages, closing the capture
+	void DashelInterface::stopRecording()
+	{
+		std::unique_ptr<CaptureWriter> writer;
+		lock();
+		recording.swap(writer);
+		unlock();
+	}
+
 	void DashelInterface::connectionClosed(Stream* stream, bool abnormal)
 	{
 		Q_UNUSED(stream);
@@ -569,6 +635,8 @@ namespace Aseba
 
 		// we connect the events from the stream listening thread to slots living in our gui thread
 		connect(&dashelInterface, SIGNAL(messageAvailable(Message *)), SLOT(messageFromDashel(Message *)), Qt::QueuedConnection);
+		connect(&dashelInterface, SIGNAL(userEventsAvailable()), SLOT(userEventsAvailable()), Qt::QueuedConnection);
+		connect(&dashelInterface, SIGNAL(recordingFailed(const QString&)), SIGNAL(recordingFailed(const QString&)), Qt::QueuedConnection);
 		connect(&dashelInterface, SIGNAL(dashelDisconnection()), SLOT(disconnectionFromDashel()), Qt::QueuedConnection);
 
 		// we also connect to the description manager to know when we have a new node available
@@ -578,7 +646,9 @@ namespace Aseba
 		connect(&dashelInterface, SIGNAL(nodeDisconnectedSignal(unsigned)), SIGNAL(nodeDisconnected(unsigned)));
 
 		// table for handling incoming messages
+		messagesHandlersMap[ASEBA_MESSAGE_NODE_PRESENT] = &Aseba::DashelTarget::receivedNodePresent;
 		messagesHandlersMap[ASEBA_MESSAGE_VARIABLES] = &Aseba::DashelTarget::receivedVariables;
+		messagesHandlersMap[ASEBA_MESSAGE_CHANGED_VARIABLES] = &Aseba::DashelTarget::receivedChangedVariables;
 		messagesHandlersMap[ASEBA_MESSAGE_ARRAY_ACCESS_OUT_OF_BOUNDS] = &Aseba::DashelTarget::receivedArrayAccessOutOfBounds;
 		messagesHandlersMap[ASEBA_MESSAGE_DIVISION_BY_ZERO] = &Aseba::DashelTarget::receivedDivisionByZero;
 		messagesHandlersMap[ASEBA_MESSAGE_EVENT_EXECUTION_KILLED] = &Aseba::DashelTarget::receivedEventExecutionKilled;
@@ -726,13 +796,13 @@ namespace Aseba
 				while (length > variablesPayloadSize)
 				{
 					getVariablesCounter++;
-					GetVariables(node, start, variablesPayloadSize).serialize(dashelInterface.stream);
+					variablesMirror.getVariablesRequest(node, start, variablesPayloadSize)->serialize(dashelInterface.stream);
 					start += variablesPayloadSize;
 					length -= variablesPayloadSize;
 				}
 
 				getVariablesCounter++;
-				GetVariables(node, start, length).serialize(dashelInterface.stream);
+				variablesMirror.getVariablesRequest(node, start, length)->serialize(dashelInterface.stream);
 				dashelInterface.stream->flush();
 				dashelInterface.unlock();
 			}
@@ -863,23 +933,46 @@ namespace Aseba
 		writeBlocked = false;
 	}
 
+	QString DashelTarget::startRecording(const QString& fileName)
+	{
+		return dashelInterface.startRecording(fileName);
+	}
+
+	void DashelTarget::stopRecording()
+	{
+		dashelInterface.stopRecording();
+	}
+
+	void DashelTarget::userEventsAvailable()
+	{
+		// wait a bit so that events arriving meanwhile are processed together
+		if (!userEventsTimer.isActive())
+			userEventsTimer.start(50);
+	}
+
 	void DashelTarget::updateUserEvents()
 	{
-		// send only 20 latest user events
-		if (userEventsQueue.size() > 20)
-			emit userEventsDropped(userEventsQueue.size() - 20);
-		while (userEventsQueue.size() > 20)
-		{
-			delete userEventsQueue.head();
-			userEventsQueue.dequeue();
-		}
+		// clear the flag before reading, so that events pushed after the read notify us again
+		dashelInterface.userEventsNotified = false;
+		UserEvents events;
+		events.reserve(dashelInterface.userEvents.size());
+		dashelInterface.userEvents.pop(std::back_inserter(events), dashelInterface.userEvents.capacity());
 
-		while (!userEventsQueue.isEmpty())
-		{
-			emit userEvent(userEventsQueue.head()->type, userEventsQueue.head()->data);
-			delete userEventsQueue.head();
-			userEventsQueue.dequeue();
-		}
+		const unsigned dropped(dashelInterface.userEventsDropped.exchange(0));
+		if (dropped)
+			emit userEventsDropped(dropped);
+
+		if (events.empty())
+			return;
+
+		// user events do not go through processMessage(), so mark their nodes as seen before anyone handles them
+		if (!writeBlocked)
+			for (const auto& event: events)
+				dashelInterface.nodeSeen(event.source);
+
+		emit userEvents(events);
+		for (const auto& event: events)
+			emit userEvent(event.id, event.data);
 	}
 
 	//! regularly probe aseba network for new connections
@@ -890,7 +983,6 @@ namespace Aseba
 
 	void DashelTarget::messageFromDashel(Message *message)
 	{
-		bool deleteMessage = true;
 		//message->dump(std::cout);
 		//std::cout << std::endl;
 
@@ -898,29 +990,14 @@ namespace Aseba
 		if (!writeBlocked)
 			dashelInterface.processMessage(message);
 
-		// see if we have a registered handler for this message
+		// see if we have a registered handler for this message; user messages do not come here, see DashelInterface::incomingData()
 		MessagesHandlersMap::const_iterator messageHandler = messagesHandlersMap.find(message->type);
-		if (messageHandler == messagesHandlersMap.end())
-		{
-			UserMessage *userMessage = dynamic_cast<UserMessage *>(message);
-			if (userMessage)
-			{
-				userEventsQueue.enqueue(userMessage);
-				if (!userEventsTimer.isActive())
-					userEventsTimer.start(50);
-				deleteMessage = false;
-			}
-			/*else
-				qDebug() << QString("Unhandeled non user message of type 0x%0 received from %1").arg(message->type, 6).arg(message->source);*/
-		}
-		else
-		{
+		if (messageHandler != messagesHandlersMap.end())
 			(this->*(messageHandler->second))(message);
-		}
+		/*else
+			qDebug() << QString("Unhandeled message of type 0x%0 received from %1").arg(message->type, 6).arg(message->source);*/
 
-		// if required, garbage collect this message
-		if (deleteMessage)
-			delete message;
+		delete message;
 	}
 
 
@@ -959,6 +1036,8 @@ namespace Aseba
 		// show a dialog box that is trying to reconnect
 		ReconnectionDialog reconnectionDialog(dashelInterface);
 		reconnectionDialog.exec();
+		// we might have missed changes of variables while disconnected
+		variablesMirror.reset();
 	}
 
 	void DashelTarget::nodeDescriptionReceived(unsigned nodeId)
@@ -969,6 +1048,11 @@ namespace Aseba
 		node.lineInNext = 0;
 	}
 
+	void DashelTarget::receivedNodePresent(Message *message)
+	{
+		variablesMirror.processMessage(message);
+	}
+
 	void DashelTarget::receivedVariables(Message *message)
 	{
 		VariablesCounter++;
@@ -979,6 +1063,16 @@ namespace Aseba
 		emit variablesMemoryChanged(variables->source, variables->start, variables->variables);
 	}
 
+	void DashelTarget::receivedChangedVariables(Message *message)
+	{
+		VariablesCounter++;
+
+		// only the variables that changed are sent, rebuild the others from the previous answers
+		std::unique_ptr<Variables> variables(variablesMirror.processMessage(message));
+		if (variables)
+			emit variablesMemoryChanged(variables->source, variables->start, variables->variables);
+	}
+
 	void DashelTarget::receivedArrayAccessOutOfBounds(Message *message)
 	{
 		ArrayAccessOutOfBounds *aa = polymorphic_downcast<ArrayAccessOutOfBounds *>(message);
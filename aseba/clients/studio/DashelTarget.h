@@ -23,9 +23,11 @@
 #include "Target.h"
 #include "common/consts.h"
 #include "common/msg/NodesManager.h"
+#include "common/msg/VariablesMirror.h"
+#include "common/msg/CaptureFile.h"
+#include "common/utils/SpscRingBuffer.h"
 #include <QString>
 #include <QDialog>
-#include <QQueue>
 #include <QTimer>
 #include <QThread>
 #include <QTime>
@@ -34,6 +36,8 @@
 #include <QVariant>
 #include <QMessageBox>
 #include <map>
+#include <atomic>
+#include <memory>
 #include <dashel/dashel.h>
 #ifdef ZEROCONF_SUPPORT
 #include "common/zeroconf/zeroconf-qt.h"
@@ -110,15 +114,28 @@ namespace Aseba
 		std::string lastConnectedTargetName;
 		QString language;
 
+		// user events bypass the queue of Qt events, which is too slow for high rates
+		SpscRingBuffer<UserEvent> userEvents; //!< user events received by this thread, waiting for the gui thread
+		std::atomic<unsigned> userEventsDropped; //!< number of user events dropped because userEvents was full
+		std::atomic<bool> userEventsNotified; //!< whether userEventsAvailable() was emitted and the gui thread has not read userEvents yet
+
+	protected:
+		std::unique_ptr<CaptureWriter> recording; //!< if set, all incoming messages are written there; protected by the lock of the hub
+
 	public:
 		DashelInterface(QVector<QTranslator*> translators, const QString& commandLineTarget);
 		bool attemptToReconnect();
 
+		QString startRecording(const QString& fileName);
+		void stopRecording();
+
 		// from Dashel::Hub
 		virtual void stop();
 
 	signals:
 		void messageAvailable(Message *message);
+		void userEventsAvailable();
+		void recordingFailed(const QString& error);
 		void dashelDisconnection();
 		void nodeDescriptionReceivedSignal(unsigned nodeId);
 		void nodeConnectedSignal(unsigned nodeId);
@@ -179,10 +196,10 @@ namespace Aseba
 		DashelInterface dashelInterface;
 
 		MessagesHandlersMap messagesHandlersMap;
+		VariablesMirror variablesMirror; //!< copy of the variables of nodes, to read only the changed ones
 
-		QQueue<UserMessage *> userEventsQueue;
 		NodesMap nodes;
-		QTimer userEventsTimer;
+		QTimer userEventsTimer; //!< delays the reading of user events, to process them in batches
 		// Note: this timer is here rather than in DashelInterface because writeBlocked is here, if wiretBlocked is removed, this timer should be moved
 		QTimer listNodesTimer;
 		bool writeBlocked; //!< true if write is being blocked by invasive plugins, false if write is allowed
@@ -218,11 +235,15 @@ namespace Aseba
 		virtual void clearBreakpoint(unsigned node, unsigned line);
 		virtual void clearBreakpoints(unsigned node);
 
+		virtual QString startRecording(const QString& fileName);
+		virtual void stopRecording();
+
 	protected:
 		virtual void blockWrite();
 		virtual void unblockWrite();
 
 	protected slots:
+		void userEventsAvailable();
 		void updateUserEvents();
 		void listNodes();
 		void messageFromDashel(Message *message);
@@ -233,7 +254,9 @@ namespace Aseba
 		void receivedDescription(Message *message);
 		void receivedLocalEventDescription(Message *message);
 		void receivedNativeFunctionDescription(Message *message);
+		void receivedNodePresent(Message *message);
 		void receivedVariables(Message *message);
+		void receivedChangedVariables(Message *message);
 		void receivedArrayAccessOutOfBounds(Message *message);
 		void receivedDivisionByZero(Message *message);
 		void receivedEventExecutionKilled(Message *message);
@@ -29,63 +29,71 @@
 #include <QFileDialog>
 #include <QSettings>
 #include <QStandardPaths>
+#include <QDateTime>
 #include <QtDebug>
+#include <algorithm>
 
 #include <qwt_plot.h>
 #include <qwt_plot_curve.h>
 #include <qwt_legend.h>
 
-#if QWT_VERSION >= 0x060000
-	#include <qwt_series_data.h>
-#else
-	#include <qwt_data.h>
-#endif
-
 namespace Aseba
 {
 	/** \addtogroup studio */
 	/*@{*/
 
-	#if QWT_VERSION >= 0x060000
-	class EventDataWrapper : public QwtSeriesData<QPointF>
-	{
-	private:
-		std::deque<double>& _x;
-		std::deque<int16_t>& _y;
-
-	public:
-		EventDataWrapper(std::deque<double>& _x, std::deque<int16_t>& _y) :
-			_x(_x),
-			_y(_y)
-		{ }
-		virtual QRectF boundingRect () const { return qwtBoundingRect(*this); }
-		virtual QPointF sample (size_t i) const { return QPointF(_x[i], double(_y[i])); }
-		virtual size_t size () const { return _x.size(); }
-	};
-	#else
-	class EventDataWrapper : public QwtData
+	//! Reduce the samples in times and values to at most two per bucket, the minimum and the maximum, so that peaks remain visible at any rate
+	static void decimateMinMax(const std::deque<double>& times, const std::deque<int16_t>& values, size_t bucketsCount, QVector<double>& x, QVector<double>& y)
 	{
-	private:
-		std::deque<double>& _x;
-		std::deque<int16_t>& _y;
-
-	public:
-		EventDataWrapper(std::deque<double>& _x, std::deque<int16_t>& _y) :
-			_x(_x),
-			_y(_y)
-		{ }
-		virtual QwtData *   copy () const { return new EventDataWrapper(*this); }
-		virtual size_t   size () const { return _x.size(); }
-		virtual double x (size_t i) const { return _x[i]; }
-		virtual double y (size_t i) const { return (double)_y[i]; }
-	};
-	#endif
+		x.clear();
+		y.clear();
+		if (times.size() <= 2 * bucketsCount)
+		{
+			for (size_t i = 0; i < times.size(); ++i)
+			{
+				x.push_back(times[i]);
+				y.push_back(values[i]);
+			}
+			return;
+		}
+
+		const double start(times.front());
+		const double bucketDuration((times.back() - start) / bucketsCount);
+		const auto bucketOf = [&](size_t i) {
+			return bucketDuration > 0 ? std::min(bucketsCount - 1, size_t((times[i] - start) / bucketDuration)) : 0;
+		};
+		size_t i(0);
+		while (i < times.size())
+		{
+			const size_t bucket(bucketOf(i));
+			size_t minIndex(i), maxIndex(i);
+			size_t j(i + 1);
+			for (; j < times.size() && bucketOf(j) == bucket; ++j)
+			{
+				if (values[j] < values[minIndex])
+					minIndex = j;
+				if (values[j] > values[maxIndex])
+					maxIndex = j;
+			}
+			// keep the extrema in their time order, so that the curve does not go back
+			const size_t first(std::min(minIndex, maxIndex));
+			const size_t second(std::max(minIndex, maxIndex));
+			x.push_back(times[first]);
+			y.push_back(values[first]);
+			if (second != first)
+			{
+				x.push_back(times[second]);
+				y.push_back(values[second]);
+			}
+			i = j;
+		}
+	}
 
 	EventViewer::EventViewer(unsigned eventId, const QString& eventName, unsigned eventVariablesCount, MainWindow::EventViewers* eventsViewers) :
 		eventId(eventId),
 		eventsViewers(eventsViewers),
 		values(eventVariablesCount),
-		startingTime(QTime::currentTime())
+		startingTime(QDateTime::currentMSecsSinceEpoch())
 	{
 		QSettings settings;
 
@@ -102,13 +110,9 @@ namespace Aseba
 		for (size_t i = 0; i < values.size(); i++)
 		{
 			QwtPlotCurve *curve = new QwtPlotCurve(QString("%0").arg(i));
-			#if QWT_VERSION >= 0x060000
-			curve->setData(new EventDataWrapper(timeStamps, values[i]));
-			#else
-			curve->setData(EventDataWrapper(timeStamps, values[i]));
-			#endif
 			curve->attach(plot);
 			curve->setPen(QPen(QColor::fromHsv((i * 360) / values.size(), 255, 100), 2));
+			curves.push_back(curve);
 		}
 
 		QVBoxLayout *layout = new QVBoxLayout(this);
@@ -161,15 +165,38 @@ namespace Aseba
 			eventsViewers->remove(eventId, this);
 	}
 
-	void EventViewer::addData(const VariablesDataVector& data)
+	//! Add the values of events that are ours, and replot once
+	void EventViewer::addEvents(const UserEvents& events)
 	{
-		const double elapsedTime = (double)startingTime.msecsTo(QTime::currentTime()) / 1000.;
+		bool added(false);
+		for (const auto& event: events)
+		{
+			if (event.id != eventId)
+				continue;
+			timeStamps.push_back(double(event.time - startingTime) / 1000.);
+			for (size_t i = 0; i < values.size(); i++)
+			{
+				if (i < event.data.size())
+				{
+					values[i].push_back(event.data[i]);
+				}
+				else
+				{
+					values[i].push_back(0);
+				}
+			}
+			added = true;
+		}
+		if (!added)
+			return;
+
 		if (timeWindowCheckBox->isChecked())
 		{
 			// remove old data
+			const double lastTime(timeStamps.back());
 			while (
 				(!timeStamps.empty()) &&
-				(elapsedTime - timeStamps[0] > timeWindowLength->value())
+				(lastTime - timeStamps[0] > timeWindowLength->value())
 			)
 			{
 				timeStamps.pop_front();
@@ -178,18 +205,22 @@ namespace Aseba
 			}
 		}
 
+		updateCurves();
+	}
 
-		timeStamps.push_back(elapsedTime);
-		for (size_t i = 0; i < values.size(); i++)
+	//! Give the curves the extrema of the values for every pixel of the plot, as more points would not be visible
+	void EventViewer::updateCurves()
+	{
+		const size_t bucketsCount(std::max(1, plot->canvas()->width()));
+		QVector<double> x, y;
+		for (size_t i = 0; i < curves.size(); i++)
 		{
-			if (i < data.size())
-			{
-				values[i].push_back(data[i]);
-			}
-			else
-			{
-				values[i].push_back(0);
-			}
+			decimateMinMax(timeStamps, values[i], bucketsCount, x, y);
+			#if QWT_VERSION >= 0x060000
+			curves[i]->setSamples(x, y);
+			#else
+			curves[i]->setData(x, y);
+			#endif
 		}
 		plot->replot();
 	}
@@ -221,8 +252,8 @@ namespace Aseba
 		for (size_t i = 0; i < values.size(); i++)
 			values[i].clear();
 		timeStamps.clear();
-		startingTime = QTime::currentTime();
-		plot->replot();
+		startingTime = QDateTime::currentMSecsSinceEpoch();
+		updateCurves();
 	}
 
 	void EventViewer::saveToFile()
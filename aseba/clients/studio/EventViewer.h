@@ -27,12 +27,13 @@
 #endif // _MSC_VER
 
 #include <deque>
-#include <QTime>
+#include <vector>
 
 #include "MainWindow.h"
 #include "common/types.h"
 
 class QwtPlot;
+class QwtPlotCurve;
 class QDoubleSpinBox;
 class QPushButton;
 class QCheckBox;
@@ -57,16 +58,20 @@ namespace Aseba
 		QCheckBox *timeWindowCheckBox;
 		QDoubleSpinBox *timeWindowLength;
 
-		std::vector<std::deque<int16_t> > values;
-		std::deque<double> timeStamps;
-		QTime startingTime;
+		std::vector<QwtPlotCurve*> curves;
+		std::vector<std::deque<int16_t> > values; //!< all received values, per variable, shown decimated by curves
+		std::deque<double> timeStamps; //!< in s since startingTime
+		qint64 startingTime; //!< in ms since 1970
 
 	public:
 		EventViewer(unsigned eventId, const QString& eventName, unsigned eventVariablesCount, MainWindow::EventViewers* eventsViewers);
 		virtual ~EventViewer();
 
 		void detachFromMain() { eventsViewers=0; }
-		void addData(const VariablesDataVector& data);
+		void addEvents(const UserEvents& events);
+
+	protected:
+		void updateCurves();
 
 	protected slots:
 		void pauseRunCapture();
@@ -27,6 +27,7 @@
 #include "FindDialog.h"
 #include "ModelAggregator.h"
 #include "translations/CompilerTranslator.h"
+#include "compiler/compilation-cache.h"
 #include "common/consts.h"
 #include "common/productids.h"
 #include "common/utils/utils.h"
@@ -34,6 +35,7 @@
 #include <QtGui>
 #include <QtWidgets>
 #include <QtXml>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <cassert>
@@ -341,6 +343,9 @@ namespace Aseba
 		target(target),
 		commonDefinitions(commonDefinitions),
 		mainWindow(mainWindow),
+		refreshTimer(0),
+		refreshPendingCount(0),
+		refreshRoundTrip(0),
 		currentPC(0),
 		previousMode(Target::EXECUTION_UNKNOWN),
 		showHidden(mainWindow->showHiddenAct->isChecked()),
@@ -645,52 +650,81 @@ namespace Aseba
 			autoRefreshMemoryCheck->setChecked(true);
 	}
 
+	// automatic refresh of variables, only one request is in flight at a time
+	static const int refreshTick = 50; //!< ms between checks whether to refresh
+	static const int refreshMinPeriod = 200; //!< ms between refreshes on fast links, 5 Hz
+	static const int refreshMaxPeriod = 5000; //!< ms between refreshes on the slowest links
+	static const unsigned refreshMergedGap = 8; //!< variables between two ranges read anyway, as cheaper than another request
+
 	void NodeTab::timerEvent ( QTimerEvent * event )
 	{
-		if (mainWindow->nodes->currentWidget() != this)
+		if (event->timerId() != refreshTimer)
 			return;
 
-		// only fetch what is visible
-		const QList<TargetVariablesModel::Variable> variables(variablesModel->getVariables());
-		assert(variables.size() == variablesModel->rowCount());
+		// wait for the previous refresh, unless it took so long that it was likely lost
+		const qint64 elapsed(refreshRequestTime.isValid() ? refreshRequestTime.elapsed() : refreshMaxPeriod);
+		const int period(qBound(refreshMinPeriod, 2 * refreshRoundTrip, refreshMaxPeriod));
+		if (refreshPendingCount != 0)
+		{
+			if (elapsed < 2 * period)
+				return;
+			refreshRoundTrip = std::min<qint64>(std::max<qint64>(2 * refreshRoundTrip, elapsed), refreshMaxPeriod);
+		}
+		else if (elapsed < period)
+			return;
 
-		unsigned currentReqCount(0);
-		unsigned currentReqPos(0);
-		for (int i = 0; i < variables.size(); ++i)
+		refreshRanges = getVariablesToRefresh();
+		refreshPendingCount = 0;
+		for (size_t i = 0; i < refreshRanges.size(); ++i)
 		{
-			const TargetVariablesModel::Variable& var(variables[i]);
-			if  (((var.value.size() == 1) ||
-				 (vmMemoryView->isExpanded(variablesModel->index(i, 0)))
-				 ) &&
-				 (!vmMemoryView->isRowHidden(i, QModelIndex()))
-				)
+			target->getVariables(id, refreshRanges[i].first, refreshRanges[i].second);
+			refreshPendingCount += refreshRanges[i].second;
+		}
+		refreshRequestTime.start();
+	}
+
+	//! Return the ranges of variables shown by the memory view or subscribed by plugins, merged and sorted by address
+	std::vector<std::pair<unsigned, unsigned> > NodeTab::getVariablesToRefresh() const
+	{
+		typedef std::pair<unsigned, unsigned> Range;
+		std::vector<Range> ranges;
+		const QList<TargetVariablesModel::Variable>& variables(vmMemoryModel->getVariables());
+
+		// rows scrolled into view, if the tab is shown
+		if (mainWindow->nodes->currentWidget() == this && !mainWindow->isMinimized() && vmMemoryView->isVisible())
+		{
+			const int viewHeight(vmMemoryView->viewport()->height());
+			for (QModelIndex index = vmMemoryView->indexAt(QPoint(0, 0)); index.isValid(); index = vmMemoryView->indexBelow(index))
 			{
-				if (currentReqCount == 0)
-				{
-					// new request
-					currentReqPos = var.pos;
-					currentReqCount = var.value.size();
-				}
-				else if (currentReqPos + currentReqCount == var.pos)
-				{
-					// continuous, append
-					currentReqCount += var.value.size();
-				}
-				else
-				{
-					// flush and reset
-					target->getVariables(id, currentReqPos, currentReqCount);
-					// new request
-					currentReqPos = var.pos;
-					currentReqCount = var.value.size();
-				}
+				if (vmMemoryView->visualRect(index).top() >= viewHeight)
+					break;
+				if (index.parent().isValid())
+					ranges.push_back(Range(variables[index.parent().row()].pos + index.row(), 1));
+				else if (variables[index.row()].value.size() == 1)
+					ranges.push_back(Range(variables[index.row()].pos, 1));
 			}
 		}
-		if (currentReqCount != 0)
+
+		// variables plugins listen to, even when the tab is hidden
+		const QStringList subscribed(vmMemoryModel->getSubscribedVariables(this));
+		for (int i = 0; i < subscribed.size(); ++i)
+		{
+			const unsigned size(vmMemoryModel->getVariableSize(subscribed[i]));
+			if (size != 0)
+				ranges.push_back(Range(vmMemoryModel->getVariablePos(subscribed[i]), size));
+		}
+
+		// merge overlapping and close ranges
+		std::sort(ranges.begin(), ranges.end());
+		std::vector<Range> merged;
+		for (size_t i = 0; i < ranges.size(); ++i)
 		{
-			// flush request
-			target->getVariables(id, currentReqPos, currentReqCount);
+			if (!merged.empty() && ranges[i].first <= merged.back().first + merged.back().second + refreshMergedGap)
+				merged.back().second = std::max(merged.back().second, ranges[i].first + ranges[i].second - merged.back().first);
+			else
+				merged.push_back(ranges[i]);
 		}
+		return merged;
 	}
 
 	void NodeTab::variableValueUpdated(const QString& name, const VariablesDataVector& values)
@@ -811,12 +845,15 @@ namespace Aseba
 		if (state == Qt::Checked)
 		{
 			refreshMemoryButton->setEnabled(false);
-			refreshTimer = startTimer(200); // 5 Hz
+			refreshPendingCount = 0;
+			refreshRequestTime.invalidate();
+			refreshTimer = startTimer(refreshTick); // the rate follows the round-trip time, see timerEvent()
 		}
 		else
 		{
 			refreshMemoryButton->setEnabled(true);
 			killTimer(refreshTimer);
+			refreshTimer = 0;
 			refreshMemoryClicked();
 		}
 	}
@@ -1043,12 +1080,16 @@ namespace Aseba
 
 	NodeTab::CompilationResult* compilationThread(const TargetDescription targetDescription, const CommonDefinitions commonDefinitions, QString source, bool dump)
 	{
+		// shared by all tabs, as several nodes often run the same program; compilations with dump bypass it
+		static CompilationCache compilationCache;
+
 		NodeTab::CompilationResult* result(new NodeTab::CompilationResult(dump));
 
 		Compiler compiler;
 		compiler.setTargetDescription(&targetDescription);
 		compiler.setCommonDefinitions(&commonDefinitions);
 		compiler.setTranslateCallback(CompilerTranslator::translate);
+		compiler.setCompilationCache(&compilationCache);
 
 		std::wistringstream is(source.toStdWString());
 
@@ -1276,6 +1317,24 @@ namespace Aseba
 */
 	void NodeTab::variablesMemoryChanged(unsigned start, const VariablesDataVector &variables)
 	{
+		// if this is part of the last automatic refresh, measure its round trip once complete
+		if (refreshPendingCount != 0)
+		{
+			for (size_t i = 0; i < refreshRanges.size(); ++i)
+			{
+				if (start >= refreshRanges[i].first && start + variables.size() <= refreshRanges[i].first + refreshRanges[i].second)
+				{
+					refreshPendingCount -= std::min<unsigned>(refreshPendingCount, variables.size());
+					if (refreshPendingCount == 0)
+					{
+						const int roundTrip(refreshRequestTime.elapsed());
+						refreshRoundTrip = refreshRoundTrip == 0 ? roundTrip : (7 * refreshRoundTrip + roundTrip) / 8;
+					}
+					break;
+				}
+			}
+		}
+
 		// update memory view
 		vmMemoryModel->setVariablesData(start, variables);
 	}
@@ -2549,6 +2608,32 @@ namespace Aseba
 			polymorphic_downcast<NodeTab *>(nodes->currentWidget())->recompile();
 	}
 
+	//! Start or stop writing all incoming messages to a binary capture, which keeps the events that the gui drops at high rates
+	void MainWindow::recordMessages(bool record)
+	{
+		if (!record)
+		{
+			target->stopRecording();
+			return;
+		}
+
+		const QString fileName(QFileDialog::getSaveFileName(this, tr("Record incoming messages"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation), tr("Aseba captures (*.aesc);;All Files (*)")));
+		QString error;
+		if (!fileName.isEmpty())
+			error = target->startRecording(fileName);
+		if (fileName.isEmpty() || !error.isEmpty())
+			recordMessagesAct->setChecked(false);
+		if (!error.isEmpty())
+			QMessageBox::warning(this, tr("Cannot record incoming messages"), tr("Cannot record incoming messages to %0: %1").arg(fileName).arg(error));
+	}
+
+	//! Recording incoming messages stopped because of error
+	void MainWindow::recordingFailed(const QString &error)
+	{
+		recordMessagesAct->setChecked(false);
+		QMessageBox::warning(this, tr("Recording stopped"), tr("Recording incoming messages stopped: %0").arg(error));
+	}
+
 	void MainWindow::compilationMessagesWasHidden()
 	{
 		showCompilationMsg->setChecked(false);
@@ -2792,34 +2877,51 @@ namespace Aseba
 		regenerateHelpMenu();
 	}
 
-	//! A user event has arrived from the network.
+	//! A user event has arrived from the network, or was sent by us.
 	void MainWindow::userEvent(unsigned id, const VariablesDataVector &data)
-	{	
-		if (eventsDescriptionsModel->isVisible(id)) 
-		{	
-			QString text = QTime::currentTime().toString("hh:mm:ss.zzz");
+	{
+		userEvents(UserEvents(1, UserEvent{ id, QDateTime::currentMSecsSinceEpoch(), data }));
+	}
 
-			if (id < commonDefinitions.events.size())
-					text += QString("\n%0 : ").arg(QString::fromStdWString(commonDefinitions.events[id].name));
-			else
-				text += tr("\nevent %0 : ").arg(id);
+	//! User events have arrived from the network, show them all at once.
+	void MainWindow::userEvents(const UserEvents &events)
+	{
+		// only the last visible events remain in the logger, so only create items for them
+		const int loggerSize(50);
+		std::vector<const UserEvent*> logged;
+		for (auto it = events.rbegin(); it != events.rend() && logged.size() < size_t(loggerSize); ++it)
+			if (eventsDescriptionsModel->isVisible(it->id))
+				logged.push_back(&(*it));
+
+		if (!logged.empty())
+		{
+			logger->setUpdatesEnabled(false);
+			for (auto it = logged.rbegin(); it != logged.rend(); ++it)
+			{
+				const UserEvent& event(**it);
+				QString text = QDateTime::fromMSecsSinceEpoch(event.time).time().toString("hh:mm:ss.zzz");
+
+				if (event.id < commonDefinitions.events.size())
+					text += QString("\n%0 : ").arg(QString::fromStdWString(commonDefinitions.events[event.id].name));
+				else
+					text += tr("\nevent %0 : ").arg(event.id);
 
-			for (size_t i = 0; i < data.size(); i++)
-				text += QString("%0 ").arg(data[i]);
+				for (size_t i = 0; i < event.data.size(); i++)
+					text += QString("%0 ").arg(event.data[i]);
 
-			if (logger->count() > 50)
+				new QListWidgetItem(QIcon(":/images/info.png"), text, logger);
+			}
+			while (logger->count() > loggerSize)
 				delete logger->takeItem(0);
-			QListWidgetItem * item = new QListWidgetItem(QIcon(":/images/info.png"), text, logger);
+			logger->setUpdatesEnabled(true);
 			logger->scrollToBottom();
-			Q_UNUSED(item);
 		}
 
 		#ifdef HAVE_QWT
 
-		// iterate over all viewer for this event
-		QList<EventViewer*> viewers = eventsViewers.values(id);
-		for (int i = 0; i < viewers.size(); ++i)
-			viewers.at(i)->addData(data);
+		// give all events to every viewer, so that each one replots once
+		for (EventViewers::iterator it = eventsViewers.begin(); it != eventsViewers.end(); ++it)
+			it.value()->addEvents(events);
 
 		#endif // HAVE_QWT
 	}
@@ -3256,7 +3358,8 @@ namespace Aseba
 		connect(target, SIGNAL(nodeConnected(unsigned)), SLOT(nodeConnected(unsigned)));
 		connect(target, SIGNAL(nodeDisconnected(unsigned)), SLOT(nodeDisconnected(unsigned)));
 
-		connect(target, SIGNAL(userEvent(unsigned, const VariablesDataVector &)), SLOT(userEvent(unsigned, const VariablesDataVector &)));
+		connect(target, SIGNAL(userEvents(const UserEvents &)), SLOT(userEvents(const UserEvents &)));
+		connect(target, SIGNAL(recordingFailed(const QString &)), SLOT(recordingFailed(const QString &)));
 		connect(target, SIGNAL(userEventsDropped(unsigned)), SLOT(userEventsDropped(unsigned)));
 		connect(target, SIGNAL(arrayAccessOutOfBounds(unsigned, unsigned, unsigned, unsigned)), SLOT(arrayAccessOutOfBounds(unsigned, unsigned, unsigned, unsigned)));
 		connect(target, SIGNAL(divisionByZero(unsigned, unsigned)), SLOT(divisionByZero(unsigned, unsigned)));
@@ -3614,6 +3717,11 @@ namespace Aseba
 		toolMenu->addMenu(rebootMenu);
 		saveBytecodeMenu = new QMenu(tr("Save the binary code..."), toolMenu);
 		toolMenu->addMenu(saveBytecodeMenu);
+		toolMenu->addSeparator();
+		recordMessagesAct = new QAction(tr("&Record incoming messages..."), this);
+		recordMessagesAct->setCheckable(true);
+		toolMenu->addAction(recordMessagesAct);
+		connect(recordMessagesAct, SIGNAL(triggered(bool)), SLOT(recordMessages(bool)));
 
 		// Help menu
 		helpMenu = new QMenu(tr("&Help"), this);
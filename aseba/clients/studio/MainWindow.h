@@ -30,6 +30,7 @@
 #include <QMultiMap>
 #include <QTabWidget>
 #include <QCloseEvent>
+#include <QElapsedTimer>
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QToolButton>
@@ -226,6 +227,7 @@ namespace Aseba
 
 	protected:
 		virtual void timerEvent ( QTimerEvent * event );
+		std::vector<std::pair<unsigned, unsigned> > getVariablesToRefresh() const;
 		virtual void variableValueUpdated(const QString& name, const VariablesDataVector& values);
 		void setupWidgets();
 		void setupConnections();
@@ -352,6 +354,10 @@ namespace Aseba
 		NodeToolInterfaces tools;
 
 		int refreshTimer; //!< id of timer for auto refresh of variables, if active
+		QElapsedTimer refreshRequestTime; //!< time since the last automatic refresh request
+		unsigned refreshPendingCount; //!< number of variables of the last automatic refresh not received yet
+		std::vector<std::pair<unsigned, unsigned> > refreshRanges; //!< start and length of the ranges read by the last automatic refresh
+		int refreshRoundTrip; //!< smoothed round-trip time of automatic refreshes in ms, 0 if not measured yet
 
 		QString lastCompiledSource; //!< content of last source considered for compilation following a textChanged signal
 		int errorPos; //!< position of last error, -1 if compilation was success
@@ -465,6 +471,9 @@ namespace Aseba
 
 		void userEventsDropped(unsigned amount);
 		void userEvent(unsigned id, const VariablesDataVector &data);
+		void userEvents(const UserEvents &events);
+		void recordMessages(bool record);
+		void recordingFailed(const QString &error);
 		void arrayAccessOutOfBounds(unsigned node, unsigned line, unsigned size, unsigned index);
 		void divisionByZero(unsigned node, unsigned line);
 		void eventExecutionKilled(unsigned node, unsigned line);
@@ -594,6 +603,7 @@ namespace Aseba
 		QAction *showKeywordsAct; 
 		QAction* showCompilationMsg;
 		QAction* showMemoryUsageAct;
+		QAction* recordMessagesAct;
 
 		// gui helper stuff
 		CompilationLogDialog *compilationMessageBox; //!< box to show last compilation messages
@@ -22,6 +22,7 @@
 
 #include <QObject>
 #include <valarray>
+#include <vector>
 #include "compiler/compiler.h"
 #include "common/msg/msg.h"
 
@@ -32,6 +33,17 @@ namespace Aseba
 
 	struct TargetDescription;
 
+	//! A user event received from the network
+	struct UserEvent
+	{
+		unsigned id; //!< identifier of the event
+		qint64 time; //!< reception time, in ms since 1970
+		VariablesDataVector data; //!< content of the event
+		unsigned source = 0; //!< node that sent the event, 0 if it was sent by us
+	};
+	//! User events, in their order of reception
+	typedef std::vector<UserEvent> UserEvents;
+
 	//! The interface to an aseba network. Used to interact with the nodes
 	/*! The target is responsible for maintaining the state of the network, querying new nodes, etc.
 	*/
@@ -61,8 +73,12 @@ namespace Aseba
 
 		//! A user event has arrived from the network.
 		void userEvent(unsigned id, const VariablesDataVector data);
-		//! Some user events have been dropped, i.e. not sent to the gui
+		//! User events have arrived from the network, emitted at most every few tens of ms, before userEvent() for each of them
+		void userEvents(const UserEvents &events);
+		//! Some user events have been dropped because they arrived faster than the gui could take them
 		void userEventsDropped(unsigned amount);
+		//! Recording incoming messages stopped because of error
+		void recordingFailed(const QString &error);
 
 		//! A node did an access out of array bounds exception.
 		void arrayAccessOutOfBounds(unsigned node, unsigned line, unsigned size, unsigned index);
@@ -154,6 +170,14 @@ namespace Aseba
 		//! Remove all breakpoints in a node
 		virtual void clearBreakpoints(unsigned node) = 0;
 
+		// recording
+
+		//! Start writing all incoming messages to a binary capture in fileName; return an empty string on success, or the error otherwise
+		virtual QString startRecording(const QString& fileName) = 0;
+
+		//! Stop writing incoming messages, closing the capture
+		virtual void stopRecording() = 0;
+
 	protected:
 		friend class ThymioBootloaderDialog;
 		friend class ThymioVisualProgramming;
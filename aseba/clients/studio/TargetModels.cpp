@@ -20,6 +20,7 @@
 #include "TargetModels.h"
 #include <QtDebug>
 #include <QtWidgets>
+#include <algorithm>
 
 namespace Aseba
 {
@@ -305,6 +306,25 @@ namespace Aseba
 		return VariablesDataVector();
 	}
 
+	//! Return the names of the variables that listeners other than except subscribed to
+	QStringList TargetVariablesModel::getSubscribedVariables(const VariableListener* except) const
+	{
+		QStringList names;
+		for (VariableListenersByName::const_iterator it = variableListenersByName.constBegin(); it != variableListenersByName.constEnd(); ++it)
+		{
+			const QList<VariableListener*>& listeners(it.value());
+			for (int i = 0; i < listeners.size(); ++i)
+			{
+				if (listeners[i] != except)
+				{
+					names.push_back(it.key());
+					break;
+				}
+			}
+		}
+		return names;
+	}
+
 	void TargetVariablesModel::updateVariablesStructure(const VariablesMap *variablesMap)
 	{
 		// Build a new list of variables
@@ -383,51 +403,44 @@ namespace Aseba
 
 	void TargetVariablesModel::setVariablesData(unsigned start, const VariablesDataVector &data)
 	{
-		size_t dataLength = data.size();
-		for (int i = 0; i < variables.size(); ++i)
+		const unsigned dataEnd(start + data.size());
+
+		// variables are sorted by address, so the first one that may overlap is the last one starting at or before start
+		QList<Variable>::iterator first(std::upper_bound(variables.begin(), variables.end(), start,
+			[](unsigned address, const Variable& var) { return address < var.pos; }));
+		if (first != variables.begin())
+			--first;
+
+		int firstChanged(-1);
+		int lastChanged(-1);
+		for (int i = first - variables.begin(); i < variables.size() && variables[i].pos < dataEnd; ++i)
 		{
 			Variable &var = variables[i];
-			int varLen = (int)var.value.size();
-			int varStart = (int)start - (int)var.pos;
-			int copyLen = (int)dataLength;
-			int copyStart = 0;
-			// crop data before us
-			if (varStart < 0)
-			{
-				copyLen += varStart;
-				copyStart -= varStart;
-				varStart = 0;
-			}
+			const unsigned copyStart(std::max(start, var.pos));
+			const unsigned copyEnd(std::min(dataEnd, unsigned(var.pos + var.value.size())));
 			// if nothing to copy, continue
-			if (copyLen <= 0)
-				continue;
-			// crop data after us
-			if (varStart + copyLen > varLen)
-			{
-				copyLen = varLen - varStart;
-			}
-			// if nothing to copy, continue
-			if (copyLen <= 0)
+			if (copyStart >= copyEnd)
 				continue;
 
 			// copy
-			copy(data.begin() + copyStart, data.begin() + copyStart + copyLen, var.value.begin() + varStart);
-
-			// notify gui
-			QModelIndex parentIndex = index(i, 0);
-			emit dataChanged(index(varStart, 0, parentIndex), index(varStart + copyLen, 0, parentIndex));
-
-			// and notify view plugins
-			for (VariableListenersNameMap::iterator it = variableListenersMap.begin(); it != variableListenersMap.end(); ++it)
+			copy(data.begin() + (copyStart - start), data.begin() + (copyEnd - start), var.value.begin() + (copyStart - var.pos));
+			if (firstChanged < 0)
+				firstChanged = i;
+			lastChanged = i;
+
+			// notify view plugins, from a copy as they might unsubscribe meanwhile
+			const VariableListenersByName::const_iterator listenersIt(variableListenersByName.constFind(var.name));
+			if (listenersIt != variableListenersByName.constEnd())
 			{
-				QStringList &list = it.value();
-				for (int v = 0; v < list.size(); v++)
-				{
-					if (list[v] == var.name)
-						it.key()->variableValueUpdated(var.name, var.value);
-				}
+				const QList<VariableListener*> listeners(listenersIt.value());
+				for (int l = 0; l < listeners.size(); ++l)
+					listeners[l]->variableValueUpdated(var.name, var.value);
 			}
 		}
+
+		// notify gui once for all changed variables, views then repaint the visible rows including the children
+		if (firstChanged >= 0)
+			emit dataChanged(index(firstChanged, 0), index(lastChanged, 1));
 	}
 
 	bool TargetVariablesModel::setVariableValues(const QString& name, const VariablesDataVector& values)
@@ -447,13 +460,14 @@ namespace Aseba
 
 	void TargetVariablesModel::unsubscribeViewPlugin(VariableListener* listener)
 	{
-		variableListenersMap.remove(listener);
+		unsubscribeToVariablesOfInterest(listener);
 	}
 
 	bool TargetVariablesModel::subscribeToVariableOfInterest(VariableListener* listener, const QString& name)
 	{
 		QStringList &list = variableListenersMap[listener];
 		list.push_back(name);
+		variableListenersByName[name].push_back(listener);
 		for (int i = 0; i < variables.size(); i++)
 			if (variables[i].name == name)
 				return true;
@@ -464,12 +478,27 @@ namespace Aseba
 	{
 		QStringList &list = variableListenersMap[listener];
 		list.removeAll(name);
+		removeListenerByName(listener, name);
 	}
 
 	void TargetVariablesModel::unsubscribeToVariablesOfInterest(VariableListener* plugin)
 	{
 		if (variableListenersMap.contains(plugin))
-			variableListenersMap.remove(plugin);
+		{
+			const QStringList list(variableListenersMap.take(plugin));
+			for (int i = 0; i < list.size(); ++i)
+				removeListenerByName(plugin, list[i]);
+		}
+	}
+
+	void TargetVariablesModel::removeListenerByName(VariableListener* listener, const QString& name)
+	{
+		VariableListenersByName::iterator it(variableListenersByName.find(name));
+		if (it == variableListenersByName.end())
+			return;
+		it.value().removeAll(listener);
+		if (it.value().isEmpty())
+			variableListenersByName.erase(it);
 	}
 
 	struct TargetFunctionsModel::TreeItem
@@ -25,6 +25,7 @@
 #include <QStringListModel>
 #include <QVector>
 #include <QList>
+#include <QHash>
 #include <QString>
 #include <QStringList>
 #include <QRegExp>
@@ -64,8 +65,6 @@ namespace Aseba
 	{
 		Q_OBJECT
 
-		// FIXME: uses map for fast variable access
-
 	public:
 		// variables
 		struct Variable
@@ -99,6 +98,7 @@ namespace Aseba
 		unsigned getVariablePos(const QString& name) const;
 		unsigned getVariableSize(const QString& name) const;
 		VariablesDataVector getVariableValue(const QString& name) const;
+		QStringList getSubscribedVariables(const VariableListener* except = 0) const;
 
 	public slots:
 		void updateVariablesStructure(const VariablesMap *variablesMap);
@@ -121,13 +121,17 @@ namespace Aseba
 		void unsubscribeToVariableOfInterest(VariableListener* plugin, const QString& name);
 		//! Unsubscribe to all variables of interest for a given plugin
 		void unsubscribeToVariablesOfInterest(VariableListener* plugin);
+		//! Remove one subscription of listener from variableListenersByName
+		void removeListenerByName(VariableListener* listener, const QString& name);
 
 	private:
-		QList<Variable> variables;
+		QList<Variable> variables; //!< sorted by address, setVariablesData() relies on it to find variables by bisection
 
 		// VariablesViewPlugin API 
 		typedef QMap<VariableListener*, QStringList> VariableListenersNameMap;
 		VariableListenersNameMap variableListenersMap;
+		typedef QHash<QString, QList<VariableListener*> > VariableListenersByName;
+		VariableListenersByName variableListenersByName; //!< listeners of every variable, once per subscription, the reverse of variableListenersMap
 	};
 
 	class TargetFunctionsModel: public QAbstractItemModel
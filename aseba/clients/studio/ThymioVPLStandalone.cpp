@@ -466,6 +466,7 @@ namespace Aseba
 			compiler.setTargetDescription(target->getDescription(id));
 			compiler.setTranslateCallback(CompilerTranslator::translate);
 			compiler.setCommonDefinitions(&commonDefinitions);
+			compiler.setCompilationCache(&compilationCache);
 
 			std::wistringstream is(editor->toPlainText().toStdWString());
 
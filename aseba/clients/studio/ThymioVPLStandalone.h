@@ -23,6 +23,7 @@
 #include "Plugin.h"
 #include "Target.h"
 #include "TargetModels.h"
+#include "compiler/compilation-cache.h"
 #include <QSplitter>
 
 class QTranslator;
@@ -110,6 +111,7 @@ namespace Aseba
 		AeslEditor* editor; //! viewer of code produced by VPL
 		BytecodeVector bytecode; //!< bytecode resulting of last successfull compilation
 		unsigned allocatedVariablesCount; //!< number of allocated variables
+		CompilationCache compilationCache; //!< VPL regenerates identical code often, avoid recompiling it
 		int getDescriptionTimer; //!< timer to periodically get description after a reconnection
 		QString fileName; //!< file name of last saved/opened file
 	};
@@ -6,6 +6,7 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QProgressBar>
+#include <QCheckBox>
 #include <QLineEdit>
 #include <QLabel>
 #include <QGroupBox>
@@ -85,6 +86,11 @@ namespace Aseba
 		this->pagesDoneCount = 0;
 	}
 
+	void QtBootloaderInterface::writeHexUnchangedPages(unsigned pagesCount)
+	{
+		qDebug() << "Skipping" << pagesCount << "unchanged pages";
+	}
+
 	void QtBootloaderInterface::writePageStart(unsigned pageNumber, const uint8_t* data, bool simple)
 	{
 		pagesDoneCount += 1;
@@ -147,6 +153,10 @@ namespace Aseba
 		connect(fileGroupBox, SIGNAL(clicked(bool)), SLOT(fileGroupChecked(bool)));
 		mainLayout->addWidget(fileGroupBox);
 
+		// only write changed pages
+		differentialCheckBox = new QCheckBox(tr("Only write the parts of the firmware that changed"), this);
+		mainLayout->addWidget(differentialCheckBox);
+
 		// progress bar
 		progressBar = new QProgressBar(this);
 		progressBar->setValue(0);
@@ -342,6 +352,7 @@ namespace Aseba
 		flashButton->setEnabled(false);
 		officialGroupBox->setEnabled(false);
 		fileGroupBox->setEnabled(false);
+		differentialCheckBox->setEnabled(false);
 
 		// start flash thread
 		Q_ASSERT(!flashFuture.isRunning());
@@ -350,11 +361,11 @@ namespace Aseba
 			hexFileName = officialHexFile.fileName().toStdString();
 		else
 			hexFileName = lineEdit->text().toLocal8Bit().constData();
-		flashFuture = QtConcurrent::run(this, &ThymioUpgraderDialog::flashThread, target, hexFileName);
+		flashFuture = QtConcurrent::run(this, &ThymioUpgraderDialog::flashThread, target, hexFileName, differentialCheckBox->isChecked());
 		flashFutureWatcher.setFuture(flashFuture);
 	}
 
-	ThymioUpgraderDialog::FlashResult ThymioUpgraderDialog::flashThread(const std::string& _target, const std::string& hexFileName) const
+	ThymioUpgraderDialog::FlashResult ThymioUpgraderDialog::flashThread(const std::string& _target, const std::string& hexFileName, bool differential) const
 	{
 		// open stream
 		MessageHub hub;
@@ -377,6 +388,7 @@ namespace Aseba
 			// then flash
 			QtBootloaderInterface bootloaderInterface(stream, nodeId, 1);
 			connect(&bootloaderInterface, SIGNAL(flashProgress(int)), this, SLOT(flashProgress(int)), Qt::QueuedConnection);
+			bootloaderInterface.setDifferential(differential);
 			bootloaderInterface.writeHex(hexFileName, true, true);
 		}
 		catch (HexFile::Error& e)
@@ -409,6 +421,7 @@ namespace Aseba
 		quitButton->setEnabled(true);
 		officialGroupBox->setEnabled(true);
 		fileGroupBox->setEnabled(true);
+		differentialCheckBox->setEnabled(true);
 		setupFlashButtonState();
 
 		// handle flash result
@@ -13,6 +13,7 @@ class QHBoxLayout;
 class QLabel;
 class QProgressBar;
 class QPushButton;
+class QCheckBox;
 class QLineEdit;
 class QListWidget;
 class QGroupBox;
@@ -35,6 +36,7 @@ namespace Aseba
 
 	protected:
 		virtual void writeHexGotDescription(unsigned pagesCount);
+		virtual void writeHexUnchangedPages(unsigned pagesCount);
 		virtual void writePageStart(unsigned pageNumber, const uint8_t* data, bool simple);
 		virtual void errorWritePageNonFatal(unsigned pageNumber);
 
@@ -85,6 +87,7 @@ namespace Aseba
 		QLabel* nodeIdText;
 		QLineEdit* lineEdit;
 		QPushButton* fileButton;
+		QCheckBox* differentialCheckBox;
 		QProgressBar* progressBar;
 		QPushButton* flashButton;
 		QPushButton* quitButton;
@@ -99,7 +102,7 @@ namespace Aseba
 	private:
 		unsigned readId(MessageHub& hub, Dashel::Stream* stream) const;
 		void readIdVersion();
-		FlashResult flashThread(const std::string& _target, const std::string& hexFileName) const;
+		FlashResult flashThread(const std::string& _target, const std::string& hexFileName, bool differential) const;
 		void networkError();
 		QString versionDevStatusToString(unsigned version, unsigned devStatus) const;
 		void selectOfficialFirmware();
@@ -157,6 +157,13 @@ typedef enum
 	ASEBA_MESSAGE_BOOTLOADER_PAGE_DATA_READ,
 	ASEBA_MESSAGE_BOOTLOADER_ACK,
 
+	/* from bootloader control program to a specific node, extended protocol */
+	ASEBA_MESSAGE_BOOTLOADER_PAGE_DATA_WRITE_BLOCK,
+	ASEBA_MESSAGE_BOOTLOADER_GET_PAGE_CHECKSUMS,
+
+	/* from node to bootloader control program, extended protocol */
+	ASEBA_MESSAGE_BOOTLOADER_PAGE_CHECKSUMS,
+
 	/* from a specific node */
 	ASEBA_MESSAGE_DESCRIPTION = 0x9000,
 	ASEBA_MESSAGE_NAMED_VARIABLE_DESCRIPTION,
@@ -171,6 +178,8 @@ typedef enum
 	ASEBA_MESSAGE_EXECUTION_STATE_CHANGED,
 	ASEBA_MESSAGE_BREAKPOINT_SET_RESULT,
 	ASEBA_MESSAGE_NODE_PRESENT,
+	ASEBA_MESSAGE_CHANGED_VARIABLES,
+	ASEBA_MESSAGE_TAGGED_VARIABLES,
 
 	/* from IDE to all nodes */
 	ASEBA_MESSAGE_GET_DESCRIPTION = 0xA000,
@@ -196,9 +205,24 @@ typedef enum
 	/* from IDE to all nodes, here because it was added later */
 	ASEBA_MESSAGE_LIST_NODES,
 
+	/* from IDE to a specific node, here because it was added later */
+	ASEBA_MESSAGE_GET_CHANGED_VARIABLES,
+	ASEBA_MESSAGE_WATCH_VARIABLES,
+	ASEBA_MESSAGE_UNWATCH_VARIABLES,
+	ASEBA_MESSAGE_GET_TAGGED_VARIABLES,
+
 	ASEBA_MESSAGE_INVALID = 0xFFFF
 } AsebaSystemMessagesTypes;
 
+/*! Optional features of nodes, announced after the protocol version in ASEBA_MESSAGE_NODE_PRESENT */
+typedef enum
+{
+	ASEBA_NODE_FEATURE_CHANGED_VARIABLES = 1 << 0,	/*!< answers ASEBA_MESSAGE_GET_CHANGED_VARIABLES */
+	ASEBA_NODE_FEATURE_WATCH_VARIABLES = 1 << 1,	/*!< sends variables registered with ASEBA_MESSAGE_WATCH_VARIABLES when they change */
+	ASEBA_NODE_FEATURE_TAGGED_VARIABLES = 1 << 2,	/*!< answers ASEBA_MESSAGE_GET_TAGGED_VARIABLES */
+	ASEBA_NODE_FEATURE_DESCRIPTION_HASH = 1 << 3	/*!< sends a hash of its description after the features, so that hosts can reuse a saved copy */
+} AsebaNodeFeatures;
+
 /*! Identifiers for destinations */
 typedef enum
 {
@@ -0,0 +1,483 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CaptureFile.h"
+#include "../utils/FormatableString.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else // WIN32
+#include <fstream>
+#include <iterator>
+#endif // WIN32
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif // HAVE_ZLIB
+
+namespace Aseba
+{
+	using namespace std;
+
+	static const char fileMagic[] = "ASEBACAP";
+	static const char chunkMagic[] = "CHNK";
+	static const char indexMagic[] = "INDX";
+	static const char endMagic[] = "ASEBAEND";
+	static const size_t fileHeaderSize(24);
+	static const size_t chunkHeaderSize(36);
+	static const size_t recordHeaderSize(10);
+	static const size_t indexEntrySize(28);
+	static const size_t trailerSize(16);
+	//! Chunks are written at least this often, in µs, so that an interrupted capture loses little
+	static const uint64_t maxChunkDuration(1000000);
+
+	enum Compression
+	{
+		COMPRESSION_NONE = 0,
+		COMPRESSION_ZLIB = 1
+	};
+
+	// little-endian encoding, independent of the host
+
+	static void put16(vector<uint8_t>& buffer, uint16_t value)
+	{
+		buffer.push_back(value);
+		buffer.push_back(value >> 8);
+	}
+
+	static void put32(vector<uint8_t>& buffer, uint32_t value)
+	{
+		put16(buffer, value);
+		put16(buffer, value >> 16);
+	}
+
+	static void put64(vector<uint8_t>& buffer, uint64_t value)
+	{
+		put32(buffer, value);
+		put32(buffer, value >> 32);
+	}
+
+	static uint16_t get16(const uint8_t* data)
+	{
+		return data[0] | (data[1] << 8);
+	}
+
+	static uint32_t get32(const uint8_t* data)
+	{
+		return get16(data) | (uint32_t(get16(data + 2)) << 16);
+	}
+
+	static uint64_t get64(const uint8_t* data)
+	{
+		return get32(data) | (uint64_t(get32(data + 4)) << 32);
+	}
+
+	bool Capture::isCompressionSupported()
+	{
+		#ifdef HAVE_ZLIB
+		return true;
+		#else // HAVE_ZLIB
+		return false;
+		#endif // HAVE_ZLIB
+	}
+
+	bool Capture::isCaptureFile(const std::string& fileName)
+	{
+		FILE* file(fopen(fileName.c_str(), "rb"));
+		if (!file)
+			return false;
+		char magic[8];
+		const bool isCapture(fread(magic, 1, 8, file) == 8 && memcmp(magic, fileMagic, 8) == 0);
+		fclose(file);
+		return isCapture;
+	}
+
+	CaptureWriter::CaptureWriter(const std::string& fileName, bool compress, size_t chunkSize):
+		file(fopen(fileName.c_str(), "wb")),
+		compress(compress),
+		chunkSize(chunkSize),
+		start(chrono::steady_clock::now())
+	{
+		if (!file)
+			throw runtime_error(FormatableString("Cannot create capture file %0").arg(fileName));
+		if (compress && !Capture::isCompressionSupported())
+		{
+			fclose(file);
+			throw runtime_error("Compressed captures are not supported by this build");
+		}
+
+		vector<uint8_t> header(fileMagic, fileMagic + 8);
+		put16(header, Capture::version);
+		put16(header, 0);
+		put32(header, 0);
+		put64(header, UnifiedTime().value);
+		writeBytes(header.data(), header.size());
+		chunk.reserve(chunkSize + recordHeaderSize + ASEBA_MAX_EVENT_ARG_SIZE);
+	}
+
+	CaptureWriter::~CaptureWriter()
+	{
+		try
+		{
+			close();
+		}
+		catch (const runtime_error&)
+		{
+			// nothing sensible to do in a destructor, the index will be rebuilt by readers
+		}
+	}
+
+	uint64_t CaptureWriter::elapsed() const
+	{
+		return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	}
+
+	void CaptureWriter::write(uint64_t time, uint16_t source, uint16_t type, const uint8_t* payload, uint16_t length)
+	{
+		assert(file);
+		assert(time >= chunkLastTime);
+
+		// start a new chunk if the current one is full or would span too much time
+		if (chunkRecordsCount != 0 && (chunk.size() >= chunkSize || time - chunkFirstTime >= maxChunkDuration))
+			writeChunk();
+		if (chunkRecordsCount == 0)
+			chunkFirstTime = time;
+
+		put32(chunk, static_cast<uint32_t>(time - chunkFirstTime));
+		put16(chunk, source);
+		put16(chunk, type);
+		put16(chunk, length);
+		chunk.insert(chunk.end(), payload, payload + length);
+		chunkLastTime = time;
+		++chunkRecordsCount;
+	}
+
+	void CaptureWriter::write(uint64_t time, const Message& message)
+	{
+		Message::SerializationBuffer buffer;
+		message.serializeSpecific(buffer);
+		write(time, message.source, message.type, buffer.rawData.data(), static_cast<uint16_t>(buffer.rawData.size()));
+	}
+
+	void CaptureWriter::flush()
+	{
+		assert(file);
+		if (chunkRecordsCount != 0)
+			writeChunk();
+		fflush(file);
+	}
+
+	void CaptureWriter::close()
+	{
+		if (!file)
+			return;
+		if (chunkRecordsCount != 0)
+			writeChunk();
+
+		const uint64_t indexOffset(fileSize);
+		vector<uint8_t> trailer(indexMagic, indexMagic + 4);
+		put32(trailer, chunksCount);
+		trailer.insert(trailer.end(), index.begin(), index.end());
+		put64(trailer, indexOffset);
+		trailer.insert(trailer.end(), endMagic, endMagic + 8);
+		writeBytes(trailer.data(), trailer.size());
+
+		const bool failed(fclose(file) != 0);
+		file = nullptr;
+		if (failed)
+			throw runtime_error("Cannot close capture file");
+	}
+
+	//! Write the current chunk, compressed if requested, and add it to the index
+	void CaptureWriter::writeChunk()
+	{
+		const uint8_t* stored(chunk.data());
+		size_t storedSize(chunk.size());
+		uint8_t compression(COMPRESSION_NONE);
+
+		#ifdef HAVE_ZLIB
+		vector<uint8_t> compressed;
+		if (compress)
+		{
+			uLongf compressedSize(compressBound(chunk.size()));
+			compressed.resize(compressedSize);
+			if (compress2(compressed.data(), &compressedSize, chunk.data(), chunk.size(), Z_BEST_SPEED) != Z_OK)
+				throw runtime_error("Cannot compress capture chunk");
+			// keep incompressible chunks as they are
+			if (compressedSize < chunk.size())
+			{
+				stored = compressed.data();
+				storedSize = compressedSize;
+				compression = COMPRESSION_ZLIB;
+			}
+		}
+		#endif // HAVE_ZLIB
+
+		put64(index, fileSize);
+		put64(index, chunkFirstTime);
+		put64(index, chunkLastTime);
+		put32(index, chunkRecordsCount);
+		++chunksCount;
+
+		vector<uint8_t> header(chunkMagic, chunkMagic + 4);
+		header.push_back(compression);
+		header.insert(header.end(), 3, 0);
+		put32(header, storedSize);
+		put32(header, chunk.size());
+		put32(header, chunkRecordsCount);
+		put64(header, chunkFirstTime);
+		put64(header, chunkLastTime);
+		writeBytes(header.data(), header.size());
+		writeBytes(stored, storedSize);
+
+		chunk.clear();
+		chunkRecordsCount = 0;
+	}
+
+	void CaptureWriter::writeBytes(const void* data, size_t size)
+	{
+		if (fwrite(data, 1, size, file) != size)
+			throw runtime_error("Cannot write to capture file");
+		fileSize += size;
+	}
+
+	//
+
+	std::unique_ptr<Message> CaptureReader::Record::createMessage() const
+	{
+		Message::SerializationBuffer buffer;
+		buffer.rawData.assign(payload, payload + length);
+		return std::unique_ptr<Message>(Message::create(source, type, buffer));
+	}
+
+	CaptureReader::CaptureReader(const std::string& fileName)
+	{
+		#ifndef WIN32
+		const int fd(open(fileName.c_str(), O_RDONLY));
+		if (fd < 0)
+			throw runtime_error(FormatableString("Cannot open capture file %0").arg(fileName));
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0)
+		{
+			::close(fd);
+			throw runtime_error(FormatableString("Cannot read capture file %0").arg(fileName));
+		}
+		size = fileStat.st_size;
+		if (size > 0)
+		{
+			void* mapped(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+			if (mapped == MAP_FAILED)
+			{
+				::close(fd);
+				throw runtime_error(FormatableString("Cannot map capture file %0").arg(fileName));
+			}
+			// captures are mostly read from start to end
+			madvise(mapped, size, MADV_SEQUENTIAL);
+			data = static_cast<const uint8_t*>(mapped);
+		}
+		// the mapping stays valid once the file is closed
+		::close(fd);
+		#else // WIN32
+		ifstream file(fileName, ios::binary);
+		if (!file)
+			throw runtime_error(FormatableString("Cannot open capture file %0").arg(fileName));
+		fileCopy.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+		data = fileCopy.data();
+		size = fileCopy.size();
+		#endif // WIN32
+
+		try
+		{
+			if (size < fileHeaderSize || memcmp(data, fileMagic, 8) != 0)
+				throw runtime_error(FormatableString("%0 is not an Aseba capture").arg(fileName));
+			if (get16(data + 8) > Capture::version)
+				throw runtime_error(FormatableString("%0 has a capture format too recent for this version").arg(fileName));
+			startTime = UnifiedTime(get64(data + 16));
+
+			if (!readIndex())
+				rebuildIndex();
+			seek(0);
+		}
+		catch (...)
+		{
+			unmap();
+			throw;
+		}
+	}
+
+	CaptureReader::~CaptureReader()
+	{
+		unmap();
+	}
+
+	void CaptureReader::unmap()
+	{
+		#ifndef WIN32
+		if (data)
+			munmap(const_cast<uint8_t*>(data), size);
+		#endif // WIN32
+		data = nullptr;
+	}
+
+	//! Read the index at the end of the file, return false if there is none or it is invalid
+	bool CaptureReader::readIndex()
+	{
+		if (size < fileHeaderSize + trailerSize || memcmp(data + size - 8, endMagic, 8) != 0)
+			return false;
+		const uint64_t indexOffset(get64(data + size - trailerSize));
+		if (indexOffset < fileHeaderSize || indexOffset + 8 > size - trailerSize || memcmp(data + indexOffset, indexMagic, 4) != 0)
+			return false;
+		const uint32_t count(get32(data + indexOffset + 4));
+		if (indexOffset + 8 + uint64_t(count) * indexEntrySize != size - trailerSize)
+			return false;
+
+		chunks.reserve(count);
+		for (const uint8_t* entry = data + indexOffset + 8; entry < data + size - trailerSize; entry += indexEntrySize)
+		{
+			const Chunk chunk = { get64(entry), get64(entry + 8), get64(entry + 16), get32(entry + 24) };
+			if (chunk.offset + chunkHeaderSize > indexOffset)
+			{
+				chunks.clear();
+				return false;
+			}
+			chunks.push_back(chunk);
+		}
+		return true;
+	}
+
+	//! Find chunks by walking through their headers, for captures that were interrupted
+	void CaptureReader::rebuildIndex()
+	{
+		indexRebuilt = true;
+		uint64_t offset(fileHeaderSize);
+		while (offset + chunkHeaderSize <= size && memcmp(data + offset, chunkMagic, 4) == 0)
+		{
+			const uint8_t* header(data + offset);
+			const uint64_t storedSize(get32(header + 8));
+			if (offset + chunkHeaderSize + storedSize > size)
+				break;
+			chunks.push_back({ offset, get64(header + 20), get64(header + 28), get32(header + 16) });
+			offset += chunkHeaderSize + storedSize;
+		}
+	}
+
+	uint64_t CaptureReader::getEndTime() const
+	{
+		return chunks.empty() ? 0 : chunks.back().lastTime;
+	}
+
+	uint64_t CaptureReader::getRecordsCount() const
+	{
+		uint64_t count(0);
+		for (const auto& chunk: chunks)
+			count += chunk.recordsCount;
+		return count;
+	}
+
+	//! Make chunkData point to the records of chunk chunkIndex, uncompressing them if needed
+	void CaptureReader::loadChunk(size_t chunkIndex)
+	{
+		this->chunkIndex = chunkIndex;
+		chunkData = nullptr;
+		chunkSize = 0;
+		chunkPos = 0;
+		if (chunkIndex >= chunks.size())
+			return;
+
+		const uint8_t* header(data + chunks[chunkIndex].offset);
+		const uint8_t compression(header[4]);
+		const size_t storedSize(get32(header + 8));
+		const uint8_t* stored(header + chunkHeaderSize);
+		if (memcmp(header, chunkMagic, 4) != 0 || stored + storedSize > data + size)
+			throw runtime_error("Corrupted chunk in capture");
+
+		if (compression == COMPRESSION_NONE)
+		{
+			chunkData = stored;
+			chunkSize = storedSize;
+		}
+		#ifdef HAVE_ZLIB
+		else if (compression == COMPRESSION_ZLIB)
+		{
+			const size_t rawSize(get32(header + 12));
+			uncompressed.resize(rawSize);
+			uLongf uncompressedSize(rawSize);
+			if (uncompress(uncompressed.data(), &uncompressedSize, stored, storedSize) != Z_OK || uncompressedSize != rawSize)
+				throw runtime_error("Corrupted compressed chunk in capture");
+			chunkData = uncompressed.data();
+			chunkSize = rawSize;
+		}
+		#endif // HAVE_ZLIB
+		else
+			throw runtime_error("Capture uses a compression not supported by this build");
+	}
+
+	void CaptureReader::seek(uint64_t time)
+	{
+		// the first chunk that ends at or after time holds the record
+		const auto chunkIt(lower_bound(chunks.begin(), chunks.end(), time, [](const Chunk& chunk, uint64_t time) {
+			return chunk.lastTime < time;
+		}));
+		loadChunk(chunkIt - chunks.begin());
+		if (!chunkData)
+			return;
+
+		// skip the records of the chunk that are before time
+		const uint64_t firstTime(chunkIt->firstTime);
+		while (chunkPos + recordHeaderSize <= chunkSize && firstTime + get32(chunkData + chunkPos) < time)
+			chunkPos += recordHeaderSize + get16(chunkData + chunkPos + 8);
+	}
+
+	void CaptureReader::seekChunk(size_t chunkIndex)
+	{
+		loadChunk(chunkIndex);
+	}
+
+	bool CaptureReader::next(Record& record)
+	{
+		while (!nextInChunk(record))
+		{
+			if (chunkIndex >= chunks.size())
+				return false;
+			loadChunk(chunkIndex + 1);
+		}
+		return true;
+	}
+
+	bool CaptureReader::nextInChunk(Record& record)
+	{
+		if (chunkPos + recordHeaderSize > chunkSize)
+			return false;
+
+		const uint8_t* header(chunkData + chunkPos);
+		record.time = chunks[chunkIndex].firstTime + get32(header);
+		record.source = get16(header + 4);
+		record.type = get16(header + 6);
+		record.length = get16(header + 8);
+		record.payload = header + recordHeaderSize;
+		if (chunkPos + recordHeaderSize + record.length > chunkSize)
+			throw runtime_error("Corrupted record in capture");
+		chunkPos += recordHeaderSize + record.length;
+		return true;
+	}
+} // namespace Aseba
@@ -0,0 +1,187 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_CAPTURE_FILE_H
+#define ASEBA_CAPTURE_FILE_H
+
+#include "msg.h"
+#include "../utils/utils.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Aseba
+{
+	/** \addtogroup msg */
+	/*@{*/
+
+	/**
+		Binary captures of Aseba messages, as written by asebadump --capture and read by asebaplay.
+
+		All integers are little endian. A file starts with a header:
+		- "ASEBACAP", format version (uint16), reserved (uint16 + uint32),
+		  wall-clock time of the start of the capture in ms since 1970 (uint64).
+
+		It is followed by chunks, each with a header:
+		- "CHNK", compression (uint8, 0 for none, 1 for zlib), reserved (3 bytes),
+		  stored size (uint32), raw size (uint32), number of records (uint32),
+		  time of the first and of the last record (uint64 each),
+		and then the stored data, which once uncompressed is a sequence of records:
+		- time relative to the first record of the chunk (uint32),
+		  source (uint16), type (uint16), payload length (uint16), payload.
+
+		Times are in µs since the start of the capture, measured with a monotonic clock.
+		Payloads are the raw content of the messages, as produced by Message::serializeSpecific().
+
+		When the capture is closed, an index of the chunks follows:
+		- "INDX", number of chunks (uint32), and for every chunk its offset in the file (uint64),
+		  time of its first and last records (uint64 each) and number of records (uint32),
+		- offset of the index (uint64), "ASEBAEND".
+		If a capture was interrupted before writing its index, readers rebuild it from
+		the chunk headers and ignore the last chunk if it is incomplete.
+	*/
+	namespace Capture
+	{
+		//! Current version of the format
+		static const uint16_t version = 1;
+		//! Whether this build can write and read compressed chunks
+		bool isCompressionSupported();
+		//! Return whether fileName starts like a binary capture
+		bool isCaptureFile(const std::string& fileName);
+	}
+
+	//! Write messages to a binary capture, see Capture
+	class CaptureWriter
+	{
+	public:
+		//! Create fileName; compress chunks if compress is true, throw std::runtime_error on failure
+		CaptureWriter(const std::string& fileName, bool compress = false, size_t chunkSize = 64*1024);
+		//! Close the capture if not done yet
+		~CaptureWriter();
+
+		//! Return the time in µs since the creation of this writer, to timestamp messages as they arrive
+		uint64_t elapsed() const;
+		//! Add a message received at time in µs, which must not be before the time of the previous message
+		void write(uint64_t time, uint16_t source, uint16_t type, const uint8_t* payload, uint16_t length);
+		//! Add message received at time in µs
+		void write(uint64_t time, const Message& message);
+		//! Write pending messages to the file, so that readers see them
+		void flush();
+		//! Write pending messages and the index, and close the file; done by the destructor otherwise
+		void close();
+
+	protected:
+		void writeChunk();
+		void writeBytes(const void* data, size_t size);
+
+	protected:
+		FILE* file;
+		const bool compress;
+		const size_t chunkSize;
+		const std::chrono::steady_clock::time_point start;
+		uint64_t fileSize = 0; //!< number of bytes written, offset of the next chunk
+		std::vector<uint8_t> chunk; //!< records of the current chunk
+		uint64_t chunkFirstTime = 0;
+		uint64_t chunkLastTime = 0;
+		uint32_t chunkRecordsCount = 0;
+		std::vector<uint8_t> index; //!< entries of the index of chunks already written
+		uint32_t chunksCount = 0;
+	};
+
+	//! Read a binary capture by mapping it in memory, see Capture
+	class CaptureReader
+	{
+	public:
+		//! A message in the capture
+		struct Record
+		{
+			uint64_t time; //!< in µs since the start of the capture
+			uint16_t source;
+			uint16_t type;
+			uint16_t length; //!< length of payload in bytes
+			const uint8_t* payload; //!< valid until the reader moves to another chunk
+
+			//! Deserialize the message
+			std::unique_ptr<Message> createMessage() const;
+		};
+
+	public:
+		//! Open fileName, throw std::runtime_error if it is not a valid capture
+		explicit CaptureReader(const std::string& fileName);
+		~CaptureReader();
+		CaptureReader(const CaptureReader&) = delete;
+		CaptureReader& operator=(const CaptureReader&) = delete;
+
+		//! Return the wall-clock time when the capture started
+		UnifiedTime getStartTime() const { return startTime; }
+		//! Return the time of the last record in µs since the start of the capture
+		uint64_t getEndTime() const;
+		//! Return the number of chunks
+		size_t getChunksCount() const { return chunks.size(); }
+		//! Return the number of records
+		uint64_t getRecordsCount() const;
+		//! Return whether the index was missing and rebuilt from the chunks
+		bool isIndexRebuilt() const { return indexRebuilt; }
+
+		//! Move to the first record at or after time in µs since the start of the capture
+		void seek(uint64_t time);
+		//! Read the next record into record, return false at the end of the capture
+		bool next(Record& record);
+
+		//! Move to the first record of chunk chunkIndex, to process chunks independently
+		void seekChunk(size_t chunkIndex);
+		//! Read the next record of the current chunk into record, return false at the end of the chunk
+		bool nextInChunk(Record& record);
+
+	protected:
+		//! Position and time span of a chunk in the file
+		struct Chunk
+		{
+			uint64_t offset;
+			uint64_t firstTime;
+			uint64_t lastTime;
+			uint32_t recordsCount;
+		};
+
+		bool readIndex();
+		void rebuildIndex();
+		void loadChunk(size_t chunkIndex);
+		void unmap();
+
+	protected:
+		const uint8_t* data = nullptr; //!< content of the file
+		size_t size = 0;
+		std::vector<uint8_t> fileCopy; //!< content of the file on systems without mmap
+		UnifiedTime startTime;
+		std::vector<Chunk> chunks;
+		bool indexRebuilt = false;
+
+		size_t chunkIndex = 0; //!< chunk being read
+		const uint8_t* chunkData = nullptr; //!< records of the chunk being read, in the file or in uncompressed
+		size_t chunkSize = 0;
+		size_t chunkPos = 0; //!< position of the next record in chunkData
+		std::vector<uint8_t> uncompressed; //!< records of the chunk being read, if compressed
+	};
+
+	/*@}*/
+} // namespace Aseba
+
+#endif // ASEBA_CAPTURE_FILE_H
@@ -0,0 +1,212 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DescriptionsCache.h"
+#include "msg.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <sstream>
+
+namespace Aseba
+{
+	using namespace std;
+
+	// a file is the magic followed by records, each being the size of a message, its type and its payload
+	static const char magic[8] = { 'A', 'S', 'E', 'B', 'A', 'D', 'S', 'C' };
+
+	//! Append message to records, as a node sends it
+	static void addRecord(vector<uint8_t>& records, const Message& message)
+	{
+		Message::SerializationBuffer buffer;
+		message.serializeSpecific(buffer);
+		const size_t size(buffer.rawData.size() + 2);
+		records.push_back(uint8_t(size));
+		records.push_back(uint8_t(size >> 8));
+		records.push_back(uint8_t(message.type));
+		records.push_back(uint8_t(message.type >> 8));
+		records.insert(records.end(), buffer.rawData.begin(), buffer.rawData.end());
+	}
+
+	DescriptionsCache::DescriptionsCache(std::string directory):
+		directory(std::move(directory))
+	{
+	}
+
+	bool DescriptionsCache::load(uint16_t protocolVersion, uint32_t hash, TargetDescription& description) const
+	{
+		ifstream file(fileName(protocolVersion, hash), ios::binary);
+		if (!file)
+			return false;
+		vector<uint8_t> content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+		if (content.size() < sizeof(magic) || memcmp(content.data(), magic, sizeof(magic)) != 0)
+			return false;
+		const vector<uint8_t> records(content.begin() + sizeof(magic), content.end());
+		if (hashRecords(records) != hash)
+			return false;
+
+		// the content is what the node sent, rebuild the description like NodesManager does
+		size_t pos(0);
+		size_t namedVariablesCount(0), localEventsCount(0), nativeFunctionsCount(0);
+		bool hasDescription(false);
+		while (pos < records.size())
+		{
+			const size_t size(records[pos] | (records[pos + 1] << 8));
+			const uint16_t type(records[pos + 2] | (records[pos + 3] << 8));
+			Message::SerializationBuffer buffer;
+			buffer.rawData.assign(records.begin() + pos + 4, records.begin() + pos + 2 + size);
+			pos += 2 + size;
+			const unique_ptr<Message> message(Message::create(0, type, buffer));
+
+			const auto* descriptionMessage(dynamic_cast<const Description*>(message.get()));
+			if (descriptionMessage && !hasDescription)
+			{
+				description = *descriptionMessage;
+				hasDescription = true;
+				continue;
+			}
+			if (!hasDescription)
+				return false;
+			const auto* namedVariable(dynamic_cast<const NamedVariableDescription*>(message.get()));
+			if (namedVariable && namedVariablesCount < description.namedVariables.size())
+			{
+				description.namedVariables[namedVariablesCount++] = *namedVariable;
+				continue;
+			}
+			const auto* localEvent(dynamic_cast<const LocalEventDescription*>(message.get()));
+			if (localEvent && localEventsCount < description.localEvents.size())
+			{
+				description.localEvents[localEventsCount++] = *localEvent;
+				continue;
+			}
+			const auto* nativeFunction(dynamic_cast<const NativeFunctionDescription*>(message.get()));
+			if (nativeFunction && nativeFunctionsCount < description.nativeFunctions.size())
+			{
+				description.nativeFunctions[nativeFunctionsCount++] = *nativeFunction;
+				continue;
+			}
+			return false;
+		}
+		return hasDescription &&
+			description.protocolVersion == protocolVersion &&
+			namedVariablesCount == description.namedVariables.size() &&
+			localEventsCount == description.localEvents.size() &&
+			nativeFunctionsCount == description.nativeFunctions.size();
+	}
+
+	bool DescriptionsCache::save(uint32_t hash, const TargetDescription& description) const
+	{
+		const vector<uint8_t> records(serialize(description));
+		if (hashRecords(records) != hash)
+			return false;
+
+		// write to another file first, so that other hosts never read a partial file
+		const string finalName(fileName(description.protocolVersion, hash));
+		const string tempName(finalName + ".tmp");
+		{
+			ofstream file(tempName, ios::binary | ios::trunc);
+			file.write(magic, sizeof(magic));
+			file.write(reinterpret_cast<const char*>(records.data()), records.size());
+			if (!file)
+			{
+				file.close();
+				remove(tempName.c_str());
+				return false;
+			}
+		}
+		// on Windows, rename does not replace existing files
+		if (rename(tempName.c_str(), finalName.c_str()) != 0)
+		{
+			remove(finalName.c_str());
+			if (rename(tempName.c_str(), finalName.c_str()) != 0)
+			{
+				remove(tempName.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t DescriptionsCache::computeHash(const TargetDescription& description)
+	{
+		return hashRecords(serialize(description));
+	}
+
+	std::string DescriptionsCache::fileName(uint16_t protocolVersion, uint32_t hash) const
+	{
+		ostringstream name;
+		name << directory << "/description-" << protocolVersion << "-" << hex << setw(8) << setfill('0') << hash << ".bin";
+		return name.str();
+	}
+
+	std::vector<uint8_t> DescriptionsCache::serialize(const TargetDescription& description)
+	{
+		vector<uint8_t> records;
+
+		Description descriptionMessage;
+		static_cast<TargetDescription&>(descriptionMessage) = description;
+		addRecord(records, descriptionMessage);
+		for (const auto& variable: description.namedVariables)
+		{
+			NamedVariableDescription message;
+			static_cast<TargetDescription::NamedVariable&>(message) = variable;
+			addRecord(records, message);
+		}
+		for (const auto& event: description.localEvents)
+		{
+			LocalEventDescription message;
+			static_cast<TargetDescription::LocalEvent&>(message) = event;
+			addRecord(records, message);
+		}
+		for (const auto& function: description.nativeFunctions)
+		{
+			NativeFunctionDescription message;
+			static_cast<TargetDescription::NativeFunction&>(message) = function;
+			addRecord(records, message);
+		}
+		return records;
+	}
+
+	uint32_t DescriptionsCache::hashRecords(const std::vector<uint8_t>& records)
+	{
+		// 32-bit FNV-1a over the types and payloads, like AsebaComputeDescriptionHash() of vm-buffer.c
+		uint32_t hash(2166136261u);
+		size_t pos(0);
+		while (pos + 2 <= records.size())
+		{
+			const size_t size(records[pos] | (records[pos + 1] << 8));
+			pos += 2;
+			// truncated records never match
+			if (size < 2 || pos + size > records.size())
+				return 0;
+			for (size_t i = pos; i < pos + size; ++i)
+			{
+				hash ^= records[i];
+				hash *= 16777619u;
+			}
+			pos += size;
+		}
+		if (pos != records.size())
+			return 0;
+		return hash ? hash : 1;
+	}
+} // namespace Aseba
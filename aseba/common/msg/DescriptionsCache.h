@@ -0,0 +1,70 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_DESCRIPTIONS_CACHE_H
+#define ASEBA_DESCRIPTIONS_CACHE_H
+
+#include "TargetDescription.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Aseba
+{
+	/** \addtogroup msg */
+	/*@{*/
+
+	//! Descriptions of nodes saved in a directory, so that they need not be received again from nodes announcing a description hash
+	/**
+		Nodes with the NodePresent::DESCRIPTION_HASH feature announce the 32-bit FNV-1a hash of the
+		messages making up their description, each one being its type followed by its payload, as
+		sent on the wire. As this covers the name, the protocol version and all the content of
+		the description, a file per protocol version and hash is enough to tell nodes apart.
+
+		Files hold these messages, and are only used if they hash to the expected value,
+		so that truncated or stale files are ignored. A description is only saved if it
+		hashes to what the node announced, which is the case unless its strings are not valid UTF-8.
+	*/
+	class DescriptionsCache
+	{
+	public:
+		//! Use directory, which must exist, to read and write descriptions
+		explicit DescriptionsCache(std::string directory);
+
+		//! Read the description with hash into description, return false if it is not saved or invalid
+		bool load(uint16_t protocolVersion, uint32_t hash, TargetDescription& description) const;
+		//! Save description with hash, return false if it does not match hash or on write errors
+		bool save(uint32_t hash, const TargetDescription& description) const;
+
+		//! Return the hash of the description messages of description, as announced by nodes
+		static uint32_t computeHash(const TargetDescription& description);
+
+	protected:
+		std::string fileName(uint16_t protocolVersion, uint32_t hash) const;
+		static std::vector<uint8_t> serialize(const TargetDescription& description);
+		static uint32_t hashRecords(const std::vector<uint8_t>& records);
+
+	protected:
+		const std::string directory;
+	};
+
+	/*@}*/
+} // namespace Aseba
+
+#endif // ASEBA_DESCRIPTIONS_CACHE_H
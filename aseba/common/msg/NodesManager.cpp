@@ -19,7 +19,9 @@
 
 #include "NodesManager.h"
 #include "msg.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -56,22 +58,34 @@ namespace Aseba
 			if (node.second.protocolVersion >= 5 && (now - node.second.lastSeen) > delayToDisconnect && node.second.connected)
 			{
 				node.second.connected = false;
+				failReads(node.first);
 				nodeDisconnected(node.first);
 			}
 			// is this node connected?
 			isAnyConnected = isAnyConnected || node.second.connected;
 		}
 
-		// if no node is connected, broadcast get description as well, for old targets (protocol 4)
-		if (!isAnyConnected)
+		// reads whose answer was lost will never complete
+		failReads(ASEBA_DEST_INVALID, delayToDisconnect.value);
+
+		// if no node is connected, broadcast get description as well, for old targets (protocol 4);
+		// with saved descriptions, only do so once nodes had a chance to answer ListNodes without any answering,
+		// as otherwise all nodes would send their description
+		if (!isAnyConnected && (!descriptionsCache || (listNodesSent && nodesFeatures.empty())))
 		{
 			GetDescription getDescription;
 			sendMessage(getDescription);
 		}
+		listNodesSent = true;
 	}
 
 	void NodesManager::processMessage(const Message* message)
 	{
+		// record the optional features of nodes, which come before their description
+		const auto *nodePresent = dynamic_cast<const NodePresent *>(message);
+		if (nodePresent)
+			nodesFeatures[nodePresent->source] = nodePresent->features;
+
 		// check whether the node is known
 		auto nodeIt(nodes.find(message->source));
 		if (nodeIt == nodes.end())
@@ -82,6 +96,24 @@ namespace Aseba
 			if ((message->type == ASEBA_MESSAGE_NODE_PRESENT) &&
 				mismatchingNodes.find(message->source) == mismatchingNodes.end())
 			{
+				// a description saved in a previous session saves receiving it again
+				if (descriptionsCache && (nodePresent->features & NodePresent::DESCRIPTION_HASH))
+				{
+					TargetDescription description;
+					if (descriptionsCache->load(nodePresent->version, nodePresent->descriptionHash, description) &&
+						description.protocolVersion >= ASEBA_MIN_TARGET_PROTOCOL_VERSION &&
+						description.protocolVersion <= ASEBA_PROTOCOL_VERSION)
+					{
+						Node& node(nodes[message->source] = Node(description));
+						nodesByName[WStringToUTF8(node.name)].insert(message->source);
+						node.namedVariablesReceptionCounter = node.namedVariables.size();
+						node.localEventsReceptionCounter = node.localEvents.size();
+						node.nativeFunctionReceptionCounter = node.nativeFunctions.size();
+						checkIfNodeDescriptionComplete(message->source, node);
+						return;
+					}
+					descriptionsToSave[message->source] = nodePresent->descriptionHash;
+				}
 				GetNodeDescription getNodeDescription(message->source);
 				sendMessage(getNodeDescription);
 			}
@@ -91,19 +123,8 @@ namespace Aseba
 		}
 		else
 		{
-			// node is known, check if connected...
-			if (!nodeIt->second.connected)
-			{
-				// if not, build complete, set as connected and notify client
-				nodeIt->second.connected = true;
-				if (nodeIt->second.isComplete())
-				{
-					// only notify connections of completed known nodes
-					nodeConnected(nodeIt->first);
-				}
-			}
-			// update last seen time
-			nodeIt->second.lastSeen = UnifiedTime();
+			// node is known, update its connection state
+			nodeSeen(nodeIt->first, nodeIt->second);
 		}
 
 		// if we have a disconnection message
@@ -114,7 +135,42 @@ namespace Aseba
 			{
 				auto nodeIt = nodes.find(disconnected->source);
 				assert (nodeIt != nodes.end());
+				const auto nameIt(nodesByName.find(WStringToUTF8(nodeIt->second.name)));
+				if (nameIt != nodesByName.end())
+				{
+					nameIt->second.erase(nodeIt->first);
+					if (nameIt->second.empty())
+						nodesByName.erase(nameIt);
+				}
 				nodes.erase(nodeIt);
+				failReads(disconnected->source);
+			}
+		}
+
+		// if we have an answer to readVariables()
+		{
+			const auto *taggedVariables = dynamic_cast<const TaggedVariables *>(message);
+			if (taggedVariables)
+			{
+				auto readIt = pendingReads.find(taggedVariables->tag);
+				if (readIt != pendingReads.end() && readIt->second.nodeId == taggedVariables->source && readIt->second.tagged)
+					receiveVariables(readIt, taggedVariables->start, taggedVariables->variables);
+			}
+			// without tag, the answer could be for any read of these variables
+			const auto *variables = dynamic_cast<const Variables *>(message);
+			if (variables)
+			{
+				// callbacks may start new reads, which this answer must not complete
+				vector<uint16_t> tags;
+				for (const auto& read: pendingReads)
+					if (read.second.nodeId == variables->source && !read.second.tagged)
+						tags.push_back(read.first);
+				for (const auto tag: tags)
+				{
+					auto readIt = pendingReads.find(tag);
+					if (readIt != pendingReads.end())
+						receiveVariables(readIt, variables->start, variables->variables);
+				}
 			}
 		}
 
@@ -140,6 +196,7 @@ namespace Aseba
 
 				// create node and copy description into it
 				nodes[description->source] = Node(*description);
+				nodesByName[WStringToUTF8(description->name)].insert(description->source);
 				checkIfNodeDescriptionComplete(description->source, nodes[description->source]);
 			}
 		}
@@ -196,12 +253,49 @@ namespace Aseba
 		}
 	}
 
-	void NodesManager::checkIfNodeDescriptionComplete(unsigned id, const Node& description)
+	void NodesManager::nodeSeen(unsigned nodeId)
+	{
+		auto nodeIt(nodes.find(nodeId));
+		if (nodeIt != nodes.end())
+			nodeSeen(nodeId, nodeIt->second);
+	}
+
+	void NodesManager::nodeSeen(unsigned nodeId, Node& node)
+	{
+		// node is known, check if connected...
+		if (!node.connected)
+		{
+			// if not, build complete, set as connected and notify client
+			node.connected = true;
+			if (node.isComplete())
+			{
+				// only notify connections of completed known nodes
+				sendWatches(nodeId);
+				nodeConnected(nodeId);
+			}
+		}
+		// update last seen time
+		node.lastSeen = UnifiedTime();
+	}
+
+	void NodesManager::checkIfNodeDescriptionComplete(unsigned id, Node& description)
 	{
+		if (description.isComplete() && description.variablesIndex.empty())
+			description.buildNamesIndex();
+
 		// we will call the virtual function only when we have received all local events and native functions
 		if (description.isComplete() && description.connected)
 		{
+			const auto hashIt(descriptionsToSave.find(id));
+			if (hashIt != descriptionsToSave.end())
+			{
+				if (descriptionsCache)
+					descriptionsCache->save(hashIt->second, description);
+				descriptionsToSave.erase(hashIt);
+			}
+
 			nodeDescriptionReceived(id);
+			sendWatches(id);
 			nodeConnected(id);
 		}
 	}
@@ -221,33 +315,29 @@ namespace Aseba
 
 	unsigned NodesManager::getNodeId(const std::wstring& name, unsigned preferedId, bool *ok) const
 	{
-		// search for the first node with a given name
-		bool found(false);
-		unsigned foundId(0);
-		for (const auto & node : nodes)
-		{
-			if (node.second.name == name)
-			{
-				if (ok)
-					*ok = true;
+		return getNodeId(WStringToUTF8(name), preferedId, ok);
+	}
 
-				if (node.first == preferedId)
-					return node.first;
-				else if (!found)
-					foundId = node.first;
+	unsigned NodesManager::getNodeId(const std::string& name, unsigned preferedId, bool *ok) const
+	{
+		const auto nameIt(nodesByName.find(name));
 
-				found = true;
-			}
+		// node not found
+		if (nameIt == nodesByName.end())
+		{
+			if (ok)
+				*ok = false;
+			return 0xFFFFFFFF;
 		}
 
-		// node found, but with another id than prefered
-		if (found)
-			return foundId;
-
-		// node not found
 		if (ok)
-			*ok = false;
-		return 0xFFFFFFFF;
+			*ok = true;
+
+		// either the prefered id or the first found
+		const set<unsigned>& ids(nameIt->second);
+		if (ids.find(preferedId) != ids.end())
+			return preferedId;
+		return *ids.begin();
 	}
 
 	const TargetDescription * NodesManager::getDescription(unsigned nodeId, bool *ok) const
@@ -268,23 +358,20 @@ namespace Aseba
 	}
 
 	unsigned NodesManager::getVariablePos(unsigned nodeId, const std::wstring& name, bool *ok) const
+	{
+		return getVariablePos(nodeId, WStringToUTF8(name), ok);
+	}
+
+	unsigned NodesManager::getVariablePos(unsigned nodeId, const std::string& name, bool *ok) const
 	{
 		auto nodeIt = nodes.find(nodeId);
+		unsigned pos, size;
 
-		// node not found
-		if (nodeIt != nodes.end())
+		if (nodeIt != nodes.end() && nodeIt->second.findVariable(name, pos, size))
 		{
-			size_t pos = 0;
-			for (const auto & namedVariable : nodeIt->second.namedVariables)
-			{
-				if (namedVariable.name == name)
-				{
-					if (ok)
-						*ok = true;
-					return pos;
-				}
-				pos += namedVariable.size;
-			}
+			if (ok)
+				*ok = true;
+			return pos;
 		}
 
 		// node not found or variable not found
@@ -294,21 +381,20 @@ namespace Aseba
 	}
 
 	unsigned NodesManager::getVariableSize(unsigned nodeId, const std::wstring& name, bool *ok) const
+	{
+		return getVariableSize(nodeId, WStringToUTF8(name), ok);
+	}
+
+	unsigned NodesManager::getVariableSize(unsigned nodeId, const std::string& name, bool *ok) const
 	{
 		auto nodeIt = nodes.find(nodeId);
+		unsigned pos, size;
 
-		// node not found
-		if (nodeIt != nodes.end())
+		if (nodeIt != nodes.end() && nodeIt->second.findVariable(name, pos, size))
 		{
-			for (const auto & namedVariable : nodeIt->second.namedVariables)
-			{
-				if (namedVariable.name == name)
-				{
-					if (ok)
-						*ok = true;
-					return namedVariable.size;
-				}
-			}
+			if (ok)
+				*ok = true;
+			return size;
 		}
 
 		// node not found or variable not found
@@ -320,5 +406,167 @@ namespace Aseba
 	void NodesManager::reset()
 	{
 		nodes.clear();
+		nodesByName.clear();
+		nodesFeatures.clear();
+		descriptionsToSave.clear();
+		listNodesSent = false;
+		failReads(ASEBA_DEST_INVALID);
+	}
+
+	void NodesManager::setDescriptionsCacheDirectory(const std::string& directory)
+	{
+		if (directory.empty())
+			descriptionsCache.reset();
+		else
+			descriptionsCache.reset(new DescriptionsCache(directory));
+	}
+
+	bool NodesManager::supportsWatchVariables(unsigned nodeId) const
+	{
+		const auto featuresIt(nodesFeatures.find(nodeId));
+		return featuresIt != nodesFeatures.end() && (featuresIt->second & NodePresent::WATCH_VARIABLES);
+	}
+
+	bool NodesManager::watchVariables(unsigned nodeId, uint16_t start, uint16_t length, uint16_t period)
+	{
+		if (!supportsWatchVariables(nodeId))
+			return false;
+
+		// a range already watched gets a new period
+		auto& nodeWatches(watches[nodeId]);
+		const auto watchIt(find_if(nodeWatches.begin(), nodeWatches.end(), [=](const Watch& watch) {
+			return watch.start == start && watch.length == length;
+		}));
+		if (watchIt == nodeWatches.end())
+			nodeWatches.push_back({start, length, period});
+		else
+			watchIt->period = period;
+
+		WatchVariables watchVariables(nodeId, start, length, period);
+		sendMessage(watchVariables);
+		return true;
+	}
+
+	void NodesManager::unwatchVariables(unsigned nodeId, uint16_t start, uint16_t length)
+	{
+		auto& nodeWatches(watches[nodeId]);
+		nodeWatches.erase(remove_if(nodeWatches.begin(), nodeWatches.end(), [=](const Watch& watch) {
+			return length == 0 || (watch.start == start && watch.length == length);
+		}), nodeWatches.end());
+
+		UnwatchVariables unwatchVariables(nodeId, start, length);
+		sendMessage(unwatchVariables);
+	}
+
+	bool NodesManager::supportsTaggedVariables(unsigned nodeId) const
+	{
+		const auto featuresIt(nodesFeatures.find(nodeId));
+		return featuresIt != nodesFeatures.end() && (featuresIt->second & NodePresent::TAGGED_VARIABLES);
+	}
+
+	uint16_t NodesManager::readVariables(unsigned nodeId, uint16_t start, uint16_t length, ReadVariablesCallback callback)
+	{
+		// skip tags still in use, for instance by a read of a node that does not answer
+		uint16_t tag(nextReadTag++);
+		while (pendingReads.find(tag) != pendingReads.end())
+			tag = nextReadTag++;
+
+		if (length == 0)
+		{
+			callback(true, VariablesDataVector());
+			return tag;
+		}
+
+		PendingRead& read(pendingReads[tag]);
+		read.nodeId = nodeId;
+		read.start = start;
+		read.tagged = supportsTaggedVariables(nodeId);
+		read.values.resize(length);
+		read.received.assign(length, false);
+		read.missingCount = length;
+		read.callback = move(callback);
+
+		if (read.tagged)
+		{
+			GetTaggedVariables getTaggedVariables(nodeId, start, length, tag);
+			sendMessage(getTaggedVariables);
+		}
+		else
+		{
+			GetVariables getVariables(nodeId, start, length);
+			sendMessage(getVariables);
+		}
+		return tag;
+	}
+
+	std::future<VariablesDataVector> NodesManager::readVariables(unsigned nodeId, uint16_t start, uint16_t length)
+	{
+		auto promise(make_shared<std::promise<VariablesDataVector>>());
+		auto future(promise->get_future());
+		readVariables(nodeId, start, length, [promise](bool ok, const VariablesDataVector& values) {
+			if (ok)
+				promise->set_value(values);
+			else
+				promise->set_exception(make_exception_ptr(runtime_error("Node did not answer to the read of variables")));
+		});
+		return future;
+	}
+
+	void NodesManager::receiveVariables(std::map<uint16_t, PendingRead>::iterator readIt, uint16_t start, const VariablesDataVector& variables)
+	{
+		// only keep the part of the answer within the read
+		PendingRead& read(readIt->second);
+		const size_t readEnd(read.start + read.values.size());
+		const size_t begin(max<size_t>(start, read.start));
+		const size_t end(min<size_t>(start + variables.size(), readEnd));
+		for (size_t pos = begin; pos < end; ++pos)
+		{
+			const size_t i(pos - read.start);
+			read.values[i] = variables[pos - start];
+			if (!read.received[i])
+			{
+				read.received[i] = true;
+				--read.missingCount;
+			}
+		}
+		if (read.missingCount != 0)
+			return;
+
+		// the callback may start new reads, so remove this one first
+		const ReadVariablesCallback callback(move(read.callback));
+		const VariablesDataVector values(move(read.values));
+		pendingReads.erase(readIt);
+		callback(true, values);
+	}
+
+	void NodesManager::failReads(unsigned nodeId, UnifiedTime::Value timeout)
+	{
+		const UnifiedTime now;
+		vector<ReadVariablesCallback> callbacks;
+		for (auto readIt = pendingReads.begin(); readIt != pendingReads.end();)
+		{
+			const PendingRead& read(readIt->second);
+			if ((nodeId == ASEBA_DEST_INVALID || read.nodeId == nodeId) && (timeout == 0 || (now - read.sent).value > timeout))
+			{
+				callbacks.push_back(move(readIt->second.callback));
+				readIt = pendingReads.erase(readIt);
+			}
+			else
+				++readIt;
+		}
+		for (const auto& callback: callbacks)
+			callback(false, VariablesDataVector());
+	}
+
+	void NodesManager::sendWatches(unsigned nodeId)
+	{
+		const auto watchesIt(watches.find(nodeId));
+		if (watchesIt == watches.end() || !supportsWatchVariables(nodeId))
+			return;
+		for (const auto& watch: watchesIt->second)
+		{
+			WatchVariables watchVariables(nodeId, watch.start, watch.length, watch.period);
+			sendMessage(watchVariables);
+		}
 	}
 } // namespace Aseba
@@ -21,9 +21,16 @@
 #define ASEBA_DESCRIPTIONS_MANAGER_H
 
 #include "msg.h"
+#include "DescriptionsCache.h"
 #include "../utils/utils.h"
 #include <string>
 #include <set>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <functional>
+#include <future>
+#include <memory>
 
 namespace Aseba
 {
@@ -31,7 +38,9 @@ namespace Aseba
 	/*@{*/
 
 	//! This helper class builds complete descriptions out of multiple message parts.
-	//! For now, it does not support the disconnection of a whole network nor the update of the description of any node
+	//! For now, it does not support the disconnection of a whole network nor the update of the description of any node.
+	//! It is not thread-safe: programs using it from several threads must serialize all calls, including processMessage(),
+	//! for instance under the lock of their hub; callbacks run within these calls, hence with the lock held
 	class NodesManager
 	{
 	protected:
@@ -54,6 +63,41 @@ namespace Aseba
 		typedef std::map<unsigned, Node> NodesMap;
 		NodesMap nodes; //!< all known nodes descriptions and connection status
 		std::set<unsigned> mismatchingNodes; //<! seen nodes with mismatching protocol versions
+		std::unordered_map<std::string, std::set<unsigned>> nodesByName; //!< ids of known nodes by UTF-8 name, for getNodeId()
+
+		//! Variables a node sends when they change, see watchVariables()
+		struct Watch
+		{
+			uint16_t start;
+			uint16_t length;
+			uint16_t period;
+		};
+		std::map<unsigned, uint16_t> nodesFeatures; //!< optional features announced by nodes, bitfield of NodePresent::Feature
+		std::map<unsigned, std::vector<Watch>> watches; //!< variables watched on each node, watched again when the node connects
+
+		std::unique_ptr<DescriptionsCache> descriptionsCache; //!< saved descriptions, nullptr if not used
+		std::map<unsigned, uint32_t> descriptionsToSave; //!< hash of the descriptions being received from nodes, to save them once complete
+		bool listNodesSent{false}; //!< whether pingNetwork() was called since the last reset()
+
+	public:
+		//! Function called with the values read by readVariables(), ok being false and values empty if the node did not answer
+		typedef std::function<void(bool ok, const VariablesDataVector& values)> ReadVariablesCallback;
+
+	protected:
+		//! Variables asked by readVariables() and not fully received yet
+		struct PendingRead
+		{
+			unsigned nodeId;
+			uint16_t start;
+			bool tagged; //!< whether GetTaggedVariables was sent; otherwise, any Variables of the range answers it
+			VariablesDataVector values;
+			std::vector<bool> received; //!< which of values have been received
+			size_t missingCount; //!< number of values not received yet
+			UnifiedTime sent; //!< when the request was sent, to fail it if no answer comes
+			ReadVariablesCallback callback;
+		};
+		std::map<uint16_t, PendingRead> pendingReads; //!< reads waiting for their answer, by tag; like all members, only accessed by serialized calls
+		uint16_t nextReadTag{0}; //!< tag of the next read, if not in use
 
 	public:
 		//! Virtual destructor
@@ -63,23 +107,56 @@ namespace Aseba
 		void pingNetwork();
 		//! Process a message and request and reconstruct descriptions if relevant
 		void processMessage(const Message* message);
+		//! Record that a message was received from a known node, connecting it again if needed, as processMessage() does for all messages; for messages handled elsewhere
+		void nodeSeen(unsigned nodeId);
 
 		//! Return the name corresponding to a node identifier; if invalid, return the empty string
 		std::wstring getNodeName(unsigned nodeId) const;
 		//! Return the id of the node corresponding to name and set ok to true, if provided; if invalid, return 0xFFFFFFFF and set ok to false. If several nodes have this name, either return preferedId if it exists otherwise return the first found.
 		unsigned getNodeId(const std::wstring& name, unsigned preferedId = 0, bool *ok = nullptr) const;
+		//! Return the id of the node corresponding to UTF-8 name, as getNodeId() above, without converting name
+		unsigned getNodeId(const std::string& name, unsigned preferedId = 0, bool *ok = nullptr) const;
 		//! Return the description of a node and set ok to true, if provided; if invalid, return 0 and set ok to false
 		const TargetDescription *getDescription(unsigned nodeId, bool *ok = nullptr) const;
 		//! Return the position of a variable and set ok to true, if provided; if invalid, return 0xFFFFFFFF and set ok to false
 		unsigned getVariablePos(unsigned nodeId, const std::wstring& name, bool *ok = nullptr) const;
+		//! Return the position of a variable with UTF-8 name, as getVariablePos() above, in constant time once the description of the node is complete
+		unsigned getVariablePos(unsigned nodeId, const std::string& name, bool *ok = nullptr) const;
 		//! Return the length of a variable and set ok to true, if provided; if invalid, return 0xFFFFFFFF and set ok to false
 		unsigned getVariableSize(unsigned nodeId, const std::wstring& name, bool *ok = nullptr) const;
+		//! Return the length of a variable with UTF-8 name, as getVariableSize() above, in constant time once the description of the node is complete
+		unsigned getVariableSize(unsigned nodeId, const std::string& name, bool *ok = nullptr) const;
 		//! Reset all descriptions, for instance when a network was disconnected and is reconnected
 		void reset();
+		//! Save the descriptions of nodes announcing a description hash in directory, which must exist, and reuse them instead of asking nodes for their description; an empty directory stops doing so
+		void setDescriptionsCacheDirectory(const std::string& directory);
+
+		//! Return whether a node announced that it can send variables when they change
+		bool supportsWatchVariables(unsigned nodeId) const;
+		//! Ask a node to send length variables from start when they change, at most every period ms, and again each time it connects; return false if the node does not support it, in which case the variables must be polled
+		bool watchVariables(unsigned nodeId, uint16_t start, uint16_t length, uint16_t period);
+		//! Stop watching variables set by watchVariables(), all of those of the node if length is 0
+		void unwatchVariables(unsigned nodeId, uint16_t start = 0, uint16_t length = 0);
+
+		//! Return whether a node announced that it tags its answers to reads of variables
+		bool supportsTaggedVariables(unsigned nodeId) const;
+		//! Read length variables from start on a node and call callback with their values when they arrive, or after a timeout; return the tag of the request. Any number of reads can be in flight, but only nodes supporting tagged variables tell apart overlapping ones; others answer all pending reads of the same variables with their first answer
+		uint16_t readVariables(unsigned nodeId, uint16_t start, uint16_t length, ReadVariablesCallback callback);
+		//! Read length variables from start on a node, the future holding a std::runtime_error if the node does not answer.
+		//! processMessage() must keep being called from another thread while waiting for it, so the caller must not hold the lock serializing calls to this object while waiting
+		std::future<VariablesDataVector> readVariables(unsigned nodeId, uint16_t start, uint16_t length);
 
 	protected:
+		//! Update the last time node was seen, and notify its connection if it was disconnected
+		void nodeSeen(unsigned nodeId, Node& node);
 		//! Check if a node description has been fully received, and if so, call the nodeDescriptionReceived() virtual function
-		void checkIfNodeDescriptionComplete(unsigned id, const Node& description);
+		void checkIfNodeDescriptionComplete(unsigned id, Node& description);
+		//! Send the watches of a node, for instance when it connects after having lost them
+		void sendWatches(unsigned nodeId);
+		//! Copy variables received from the node of a pending read, and call its callback if they were the last ones missing
+		void receiveVariables(std::map<uint16_t, PendingRead>::iterator readIt, uint16_t start, const VariablesDataVector& variables);
+		//! Fail the reads of a node, of all nodes if nodeId is ASEBA_DEST_INVALID, or only those sent more than timeout ago if timeout is not 0
+		void failReads(unsigned nodeId, UnifiedTime::Value timeout = 0);
 
 		//! Virtual function that is called when a message must be sent
 		virtual void sendMessage(const Message& message) = 0;
@@ -22,6 +22,15 @@
 
 namespace Aseba
 {
+	VariablesIndex indexVariablesMap(const VariablesMap& variablesMap)
+	{
+		VariablesIndex variablesIndex;
+		variablesIndex.reserve(variablesMap.size());
+		for (const auto& variable : variablesMap)
+			variablesIndex.emplace(WStringToUTF8(variable.first), variable.second);
+		return variablesIndex;
+	}
+
 	//! Compute the XModem CRC of the description, as defined in AS001 at https://aseba.wikidot.com/asebaspecifications
 	uint16_t TargetDescription::crc() const
 	{
@@ -74,4 +83,44 @@ namespace Aseba
 		}
 		return functionsMap;
 	}
+
+	//! Keep the first of variables with the same name, as a search in namedVariables does
+	void TargetDescription::buildNamesIndex()
+	{
+		variablesIndex.clear();
+		variablesIndex.reserve(namedVariables.size());
+		unsigned pos(0);
+		for (const auto & namedVariable : namedVariables)
+		{
+			variablesIndex.emplace(WStringToUTF8(namedVariable.name), std::make_pair(pos, namedVariable.size));
+			pos += namedVariable.size;
+		}
+	}
+
+	//! Use variablesIndex if built, otherwise search namedVariables, for instance while the description is being received
+	bool TargetDescription::findVariable(const std::string& name, unsigned& pos, unsigned& size) const
+	{
+		if (!variablesIndex.empty())
+		{
+			const auto variableIt(variablesIndex.find(name));
+			if (variableIt == variablesIndex.end())
+				return false;
+			pos = variableIt->second.first;
+			size = variableIt->second.second;
+			return true;
+		}
+
+		unsigned variablePos(0);
+		for (const auto & namedVariable : namedVariables)
+		{
+			if (WStringToUTF8(namedVariable.name) == name)
+			{
+				pos = variablePos;
+				size = namedVariable.size;
+				return true;
+			}
+			variablePos += namedVariable.size;
+		}
+		return false;
+	}
 } // namespace Aseba
@@ -22,6 +22,7 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace Aseba
@@ -35,6 +36,12 @@ namespace Aseba
 	//! Lookup table for functions (name => id in target description)
 	using FunctionsMap = std::map<std::wstring, unsigned>;
 
+	//! Hashed lookup table for variables (UTF-8 name => (pos, size)), for names coming from network requests
+	using VariablesIndex = std::unordered_map<std::string, std::pair<unsigned, unsigned> >;
+
+	//! Return a VariablesIndex with the content of variablesMap, to convert its names only once
+	VariablesIndex indexVariablesMap(const VariablesMap& variablesMap);
+
 	//! Description of target VM
 	struct TargetDescription
 	{
@@ -84,10 +91,16 @@ namespace Aseba
 		std::vector<LocalEvent> localEvents; //!< events available locally on target
 		std::vector<NativeFunction> nativeFunctions; //!< native functions
 
+		VariablesIndex variablesIndex; //!< named variables by UTF-8 name, filled by buildNamesIndex()
+
 		TargetDescription()  = default;
 		uint16_t crc() const;
 		VariablesMap getVariablesMap(unsigned& freeVariableIndex) const;
 		FunctionsMap getFunctionsMap() const;
+		//! Fill variablesIndex out of namedVariables; to be called once the description is complete
+		void buildNamesIndex();
+		//! Set pos and size of the variable with UTF-8 name and return true; return false if there is none
+		bool findVariable(const std::string& name, unsigned& pos, unsigned& size) const;
 	};
 
 	/*@}*/
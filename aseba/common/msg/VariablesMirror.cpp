@@ -0,0 +1,130 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "VariablesMirror.h"
+#include <algorithm>
+#include <bitset>
+#include <numeric>
+
+namespace Aseba
+{
+	std::unique_ptr<Variables> VariablesMirror::processMessage(const Message* message)
+	{
+		const auto* nodePresent(dynamic_cast<const NodePresent*>(message));
+		if (nodePresent)
+		{
+			nodes[nodePresent->source].features = nodePresent->features;
+			return nullptr;
+		}
+
+		const auto* changedVariables(dynamic_cast<const ChangedVariables*>(message));
+		if (!changedVariables)
+			return nullptr;
+
+		Node& node(nodes[changedVariables->source]);
+		if (!processChangedVariables(node, changedVariables))
+			return nullptr;
+
+		// the message is only useful if we know all the variables it covers
+		const size_t start(changedVariables->start);
+		const size_t end(start + changedVariables->length);
+		if (!std::all_of(node.valid.begin() + start, node.valid.begin() + end, [](bool valid) { return valid; }))
+			return nullptr;
+
+		std::unique_ptr<Variables> variables(new Variables);
+		variables->source = changedVariables->source;
+		variables->start = changedVariables->start;
+		variables->variables.assign(node.values.begin() + start, node.values.begin() + end);
+		return variables;
+	}
+
+	//! Apply changedVariables to the copy of node, return false if it is malformed
+	bool VariablesMirror::processChangedVariables(Node& node, const ChangedVariables* changedVariables)
+	{
+		// generations follow each other, skipping 0, otherwise we missed some changes
+		uint16_t expectedGeneration(node.generation + 1);
+		if (expectedGeneration == 0)
+			expectedGeneration = 1;
+		if (node.generation == 0 || changedVariables->generation != expectedGeneration)
+			std::fill(node.valid.begin(), node.valid.end(), false);
+		node.generation = changedVariables->generation;
+
+		const size_t start(changedVariables->start);
+		const size_t end(start + changedVariables->length);
+		if (node.values.size() < end)
+		{
+			node.values.resize(end);
+			node.valid.resize(end, false);
+		}
+
+		size_t valueIndex(0);
+		for (uint16_t i = 0; i < changedVariables->length; ++i)
+		{
+			if (!changedVariables->isChanged(i))
+				continue;
+			if (valueIndex == changedVariables->values.size())
+				break;
+			node.values[start + i] = changedVariables->values[valueIndex++];
+			node.valid[start + i] = true;
+		}
+
+		// a mask not matching the values means the copy cannot be trusted any more
+		const size_t changedCount(std::accumulate(changedVariables->mask.begin(), changedVariables->mask.end(), size_t(0), [](size_t count, uint16_t word) {
+			return count + std::bitset<16>(word).count();
+		}));
+		if (changedCount != changedVariables->values.size())
+		{
+			node.generation = 0;
+			std::fill(node.valid.begin(), node.valid.end(), false);
+			return false;
+		}
+		return true;
+	}
+
+	bool VariablesMirror::supportsChangedVariables(unsigned nodeId) const
+	{
+		const auto nodeIt(nodes.find(nodeId));
+		return nodeIt != nodes.end() && (nodeIt->second.features & NodePresent::CHANGED_VARIABLES);
+	}
+
+	std::unique_ptr<CmdMessage> VariablesMirror::getVariablesRequest(unsigned nodeId, uint16_t start, uint16_t length) const
+	{
+		const auto nodeIt(nodes.find(nodeId));
+		if (nodeIt == nodes.end() || !(nodeIt->second.features & NodePresent::CHANGED_VARIABLES))
+			return std::unique_ptr<CmdMessage>(new GetVariables(nodeId, start, length));
+
+		// ask for changes only if we know all requested variables, otherwise for all of them
+		const Node& node(nodeIt->second);
+		const size_t end(size_t(start) + length);
+		uint16_t generation(0);
+		if (node.generation != 0 && node.valid.size() >= end && std::all_of(node.valid.begin() + start, node.valid.begin() + end, [](bool valid) { return valid; }))
+			generation = node.generation;
+		return std::unique_ptr<CmdMessage>(new GetChangedVariables(nodeId, start, length, generation));
+	}
+
+	void VariablesMirror::reset(unsigned nodeId)
+	{
+		nodes.erase(nodeId);
+	}
+
+	void VariablesMirror::reset()
+	{
+		nodes.clear();
+	}
+} // namespace Aseba
@@ -0,0 +1,80 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_VARIABLES_MIRROR_H
+#define ASEBA_VARIABLES_MIRROR_H
+
+#include "msg.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Aseba
+{
+	/** \addtogroup msg */
+	/*@{*/
+
+	//! Copy of the variables of nodes, rebuilt from ChangedVariables to read variables with GetChangedVariables
+	/**
+		Nodes send ChangedVariables to all hosts, and only include the variables that changed
+		since their previous ChangedVariables. By processing all messages from the network,
+		this class keeps a copy of the variables each node last sent, and turns every
+		ChangedVariables into the Variables it stands for. If a generation is missing,
+		for instance because the node was reset or messages were lost, the copy is discarded
+		and the next request asks the node for all variables.
+
+		It also records the features nodes announce in NodePresent, so that readers can
+		fall back to GetVariables for nodes that do not support GetChangedVariables.
+	*/
+	class VariablesMirror
+	{
+	protected:
+		//! Copy of the variables of a node
+		struct Node
+		{
+			uint16_t features = 0; //!< bitfield of NodePresent::Feature
+			uint16_t generation = 0; //!< generation of the last ChangedVariables received, 0 if none
+			VariablesDataVector values; //!< variables as of generation
+			std::vector<bool> valid; //!< whether the corresponding value is known
+		};
+		typedef std::map<unsigned, Node> NodesMap;
+		NodesMap nodes;
+
+	public:
+		//! Process a message from the network; if it is a ChangedVariables whose variables are all known, return the equivalent Variables
+		std::unique_ptr<Variables> processMessage(const Message* message);
+
+		//! Return whether nodeId announced support for GetChangedVariables
+		bool supportsChangedVariables(unsigned nodeId) const;
+		//! Return a message reading length variables from start on nodeId, GetChangedVariables if supported, GetVariables otherwise
+		std::unique_ptr<CmdMessage> getVariablesRequest(unsigned nodeId, uint16_t start, uint16_t length) const;
+
+		//! Forget the variables and features of nodeId
+		void reset(unsigned nodeId);
+		//! Forget all nodes, for instance when a network was disconnected and is reconnected
+		void reset();
+
+	protected:
+		bool processChangedVariables(Node& node, const ChangedVariables* changedVariables);
+	};
+
+	/*@}*/
+} // namespace Aseba
+
+#endif // ASEBA_VARIABLES_MIRROR_H
@@ -44,6 +44,7 @@ namespace Aseba
 			registerMessageType<BootloaderDescription>(ASEBA_MESSAGE_BOOTLOADER_DESCRIPTION);
 			registerMessageType<BootloaderDataRead>(ASEBA_MESSAGE_BOOTLOADER_PAGE_DATA_READ);
 			registerMessageType<BootloaderAck>(ASEBA_MESSAGE_BOOTLOADER_ACK);
+			registerMessageType<BootloaderPageChecksums>(ASEBA_MESSAGE_BOOTLOADER_PAGE_CHECKSUMS);
 
 			registerMessageType<ListNodes>(ASEBA_MESSAGE_LIST_NODES);
 
@@ -58,6 +59,8 @@ namespace Aseba
 			registerMessageType<NativeFunctionDescription>(ASEBA_MESSAGE_NATIVE_FUNCTION_DESCRIPTION);
 			registerMessageType<Disconnected>(ASEBA_MESSAGE_DISCONNECTED);
 			registerMessageType<Variables>(ASEBA_MESSAGE_VARIABLES);
+			registerMessageType<ChangedVariables>(ASEBA_MESSAGE_CHANGED_VARIABLES);
+			registerMessageType<TaggedVariables>(ASEBA_MESSAGE_TAGGED_VARIABLES);
 			registerMessageType<ArrayAccessOutOfBounds>(ASEBA_MESSAGE_ARRAY_ACCESS_OUT_OF_BOUNDS);
 			registerMessageType<DivisionByZero>(ASEBA_MESSAGE_DIVISION_BY_ZERO);
 			registerMessageType<EventExecutionKilled>(ASEBA_MESSAGE_EVENT_EXECUTION_KILLED);
@@ -69,6 +72,8 @@ namespace Aseba
 			registerMessageType<BootloaderReadPage>(ASEBA_MESSAGE_BOOTLOADER_READ_PAGE);
 			registerMessageType<BootloaderWritePage>(ASEBA_MESSAGE_BOOTLOADER_WRITE_PAGE);
 			registerMessageType<BootloaderPageDataWrite>(ASEBA_MESSAGE_BOOTLOADER_PAGE_DATA_WRITE);
+			registerMessageType<BootloaderPageDataWriteBlock>(ASEBA_MESSAGE_BOOTLOADER_PAGE_DATA_WRITE_BLOCK);
+			registerMessageType<BootloaderGetPageChecksums>(ASEBA_MESSAGE_BOOTLOADER_GET_PAGE_CHECKSUMS);
 
 			registerMessageType<SetBytecode>(ASEBA_MESSAGE_SET_BYTECODE);
 			registerMessageType<Reset>(ASEBA_MESSAGE_RESET);
@@ -81,6 +86,10 @@ namespace Aseba
 			registerMessageType<BreakpointClear>(ASEBA_MESSAGE_BREAKPOINT_CLEAR);
 			registerMessageType<BreakpointClearAll>(ASEBA_MESSAGE_BREAKPOINT_CLEAR_ALL);
 			registerMessageType<GetVariables>(ASEBA_MESSAGE_GET_VARIABLES);
+			registerMessageType<GetChangedVariables>(ASEBA_MESSAGE_GET_CHANGED_VARIABLES);
+			registerMessageType<WatchVariables>(ASEBA_MESSAGE_WATCH_VARIABLES);
+			registerMessageType<UnwatchVariables>(ASEBA_MESSAGE_UNWATCH_VARIABLES);
+			registerMessageType<GetTaggedVariables>(ASEBA_MESSAGE_GET_TAGGED_VARIABLES);
 			registerMessageType<SetVariables>(ASEBA_MESSAGE_SET_VARIABLES);
 			registerMessageType<WriteBytecode>(ASEBA_MESSAGE_WRITE_BYTECODE);
 			registerMessageType<Reboot>(ASEBA_MESSAGE_REBOOT);
@@ -400,6 +409,14 @@ namespace Aseba
 		buffer.add(pageSize);
 		buffer.add(pagesStart);
 		buffer.add(pagesCount);
+		// only bootloaders supporting the extended protocol send the extension
+		if (windowSize != 0 || features != 0)
+		{
+			buffer.add(maxFrameSize);
+			buffer.add(windowSize);
+		}
+		if (features != 0)
+			buffer.add(features);
 	}
 
 	void BootloaderDescription::deserializeSpecific(SerializationBuffer& buffer)
@@ -407,11 +424,25 @@ namespace Aseba
 		pageSize = buffer.get<uint16_t>();
 		pagesStart = buffer.get<uint16_t>();
 		pagesCount = buffer.get<uint16_t>();
+		maxFrameSize = 0;
+		windowSize = 0;
+		features = 0;
+		if (buffer.readPos + 4 <= buffer.rawData.size())
+		{
+			maxFrameSize = buffer.get<uint16_t>();
+			windowSize = buffer.get<uint16_t>();
+		}
+		if (buffer.readPos + 2 <= buffer.rawData.size())
+			features = buffer.get<uint16_t>();
 	}
 
 	void BootloaderDescription::dumpSpecific(wostream &stream) const
 	{
 		stream << pagesCount << " pages of size " << pageSize << " starting at page " << pagesStart;
+		if (windowSize != 0)
+			stream << ", pipelined with frames of " << maxFrameSize << " bytes and window of " << windowSize << " pages";
+		if (features & PAGE_CHECKSUMS)
+			stream << ", page checksums";
 	}
 
 	bool operator ==(const BootloaderDescription &lhs, const BootloaderDescription &rhs)
@@ -420,7 +451,10 @@ namespace Aseba
 			static_cast<const Message&>(lhs) == static_cast<const Message&>(rhs) &&
 			lhs.pageSize == rhs.pageSize &&
 			lhs.pagesStart == rhs.pagesStart &&
-			lhs.pagesCount == rhs.pagesCount
+			lhs.pagesCount == rhs.pagesCount &&
+			lhs.maxFrameSize == rhs.maxFrameSize &&
+			lhs.windowSize == rhs.windowSize &&
+			lhs.features == rhs.features
 		;
 	}
 
@@ -459,14 +493,16 @@ namespace Aseba
 	void BootloaderAck::serializeSpecific(SerializationBuffer& buffer) const
 	{
 		buffer.add(static_cast<uint16_t>(errorCode));
-		if (errorCode == ErrorCode::PROGRAMMING_FAILED)
+		// the pipelined protocol also gives the page number of successful acknowledgements
+		if (errorCode == ErrorCode::PROGRAMMING_FAILED || errorAddress != 0)
 			buffer.add(errorAddress);
 	}
 
 	void BootloaderAck::deserializeSpecific(SerializationBuffer& buffer)
 	{
 		errorCode = static_cast<ErrorCode>(buffer.get<uint16_t>());
-		if (errorCode == ErrorCode::PROGRAMMING_FAILED)
+		errorAddress = 0;
+		if (buffer.readPos < buffer.rawData.size())
 			errorAddress = buffer.get<uint16_t>();
 	}
 
@@ -494,6 +530,37 @@ namespace Aseba
 
 	//
 
+	void BootloaderPageChecksums::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		buffer.add(pagesStart);
+		for (const auto checksum: checksums)
+			buffer.add(checksum);
+	}
+
+	void BootloaderPageChecksums::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		pagesStart = buffer.get<uint16_t>();
+		checksums.resize((buffer.rawData.size() - buffer.readPos) / 4);
+		for (auto& checksum: checksums)
+			checksum = buffer.get<uint32_t>();
+	}
+
+	void BootloaderPageChecksums::dumpSpecific(wostream &stream) const
+	{
+		stream << checksums.size() << " checksums starting at page " << pagesStart;
+	}
+
+	bool operator ==(const BootloaderPageChecksums &lhs, const BootloaderPageChecksums &rhs)
+	{
+		return
+			static_cast<const Message&>(lhs) == static_cast<const Message&>(rhs) &&
+			lhs.pagesStart == rhs.pagesStart &&
+			lhs.checksums == rhs.checksums
+		;
+	}
+
+	//
+
 	void ListNodes::serializeSpecific(SerializationBuffer& buffer) const
 	{
 		buffer.add(version);
@@ -522,23 +589,44 @@ namespace Aseba
 	void NodePresent::serializeSpecific(SerializationBuffer& buffer) const
 	{
 		buffer.add(version);
+		// only nodes with optional features send them
+		if (features != 0)
+			buffer.add(features);
+		if (features & DESCRIPTION_HASH)
+			buffer.add(descriptionHash);
 	}
 
 	void NodePresent::deserializeSpecific(SerializationBuffer& buffer)
 	{
 		version = buffer.get<uint16_t>();
+		features = 0;
+		if (buffer.readPos + 2 <= buffer.rawData.size())
+			features = buffer.get<uint16_t>();
+		descriptionHash = 0;
+		if ((features & DESCRIPTION_HASH) && buffer.readPos + 4 <= buffer.rawData.size())
+			descriptionHash = buffer.get<uint32_t>();
 	}
 
 	void NodePresent::dumpSpecific(std::wostream  &stream) const
 	{
 		stream << "protocol version " << version;
+		if (features & CHANGED_VARIABLES)
+			stream << ", changed variables";
+		if (features & WATCH_VARIABLES)
+			stream << ", watch variables";
+		if (features & TAGGED_VARIABLES)
+			stream << ", tagged variables";
+		if (features & DESCRIPTION_HASH)
+			stream << ", description hash " << hex << descriptionHash << dec;
 	}
 
 	bool operator ==(const NodePresent &lhs, const NodePresent &rhs)
 	{
 		return
 			static_cast<const Message&>(lhs) == static_cast<const Message&>(rhs) &&
-			lhs.version == rhs.version
+			lhs.version == rhs.version &&
+			lhs.features == rhs.features &&
+			lhs.descriptionHash == rhs.descriptionHash
 		;
 	}
 
@@ -818,6 +906,83 @@ namespace Aseba
 
 	//
 
+	void ChangedVariables::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		buffer.add(start);
+		buffer.add(length);
+		buffer.add(generation);
+		for (const auto word: mask)
+			buffer.add(word);
+		for (const auto value: values)
+			buffer.add(value);
+	}
+
+	void ChangedVariables::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		start = buffer.get<uint16_t>();
+		length = buffer.get<uint16_t>();
+		generation = buffer.get<uint16_t>();
+		mask.resize((length + 15) / 16);
+		for (auto& word: mask)
+			word = buffer.get<uint16_t>();
+		values.resize((buffer.rawData.size() - buffer.readPos) / 2);
+		for (auto& value: values)
+			value = buffer.get<int16_t>();
+	}
+
+	void ChangedVariables::dumpSpecific(wostream &stream) const
+	{
+		stream << "start " << start << ", length " << length << ", generation " << generation << ", " << values.size() << " changed";
+	}
+
+	bool operator ==(const ChangedVariables &lhs, const ChangedVariables &rhs)
+	{
+		return
+			static_cast<const Message&>(lhs) == static_cast<const Message&>(rhs) &&
+			lhs.start == rhs.start &&
+			lhs.length == rhs.length &&
+			lhs.generation == rhs.generation &&
+			lhs.mask == rhs.mask &&
+			lhs.values == rhs.values
+		;
+	}
+
+	//
+
+	void TaggedVariables::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		buffer.add(tag);
+		buffer.add(start);
+		for (const auto variable: variables)
+			buffer.add(variable);
+	}
+
+	void TaggedVariables::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		tag = buffer.get<uint16_t>();
+		start = buffer.get<uint16_t>();
+		variables.resize((buffer.rawData.size() - buffer.readPos) / 2);
+		for (auto& variable: variables)
+			variable = buffer.get<int16_t>();
+	}
+
+	void TaggedVariables::dumpSpecific(wostream &stream) const
+	{
+		stream << "tag " << tag << ", start " << start << ", variables vector of size " << variables.size();
+	}
+
+	bool operator ==(const TaggedVariables &lhs, const TaggedVariables &rhs)
+	{
+		return
+			static_cast<const Message&>(lhs) == static_cast<const Message&>(rhs) &&
+			lhs.tag == rhs.tag &&
+			lhs.start == rhs.start &&
+			lhs.variables == rhs.variables
+		;
+	}
+
+	//
+
 	void ArrayAccessOutOfBounds::serializeSpecific(SerializationBuffer& buffer) const
 	{
 		buffer.add(pc);
@@ -1090,6 +1255,80 @@ namespace Aseba
 
 	//
 
+	void BootloaderPageDataWriteBlock::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		CmdMessage::serializeSpecific(buffer);
+
+		buffer.add(pageNumber);
+		buffer.add(offset);
+		for (const auto byte: data)
+			buffer.add(byte);
+	}
+
+	void BootloaderPageDataWriteBlock::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		CmdMessage::deserializeSpecific(buffer);
+
+		pageNumber = buffer.get<uint16_t>();
+		offset = buffer.get<uint16_t>();
+		data.resize(buffer.rawData.size() - buffer.readPos);
+		for (auto& byte: data)
+			byte = buffer.get<uint8_t>();
+	}
+
+	void BootloaderPageDataWriteBlock::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+
+		stream << data.size() << " bytes for page " << pageNumber << " at offset " << offset;
+	}
+
+	bool operator ==(const BootloaderPageDataWriteBlock &lhs, const BootloaderPageDataWriteBlock &rhs)
+	{
+		return
+			static_cast<const CmdMessage&>(lhs) == static_cast<const CmdMessage&>(rhs) &&
+			lhs.pageNumber == rhs.pageNumber &&
+			lhs.offset == rhs.offset &&
+			lhs.data == rhs.data
+		;
+	}
+
+	//
+
+	void BootloaderGetPageChecksums::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		CmdMessage::serializeSpecific(buffer);
+
+		buffer.add(pagesStart);
+		buffer.add(pagesCount);
+	}
+
+	void BootloaderGetPageChecksums::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		CmdMessage::deserializeSpecific(buffer);
+
+		pagesStart = buffer.get<uint16_t>();
+		pagesCount = buffer.get<uint16_t>();
+	}
+
+	void BootloaderGetPageChecksums::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+
+		stream << pagesCount << " pages starting at " << pagesStart;
+	}
+
+	bool operator ==(const BootloaderGetPageChecksums &lhs, const BootloaderGetPageChecksums &rhs)
+	{
+		return
+			static_cast<const CmdMessage&>(lhs) == static_cast<const CmdMessage&>(rhs) &&
+			lhs.pagesStart == rhs.pagesStart &&
+			lhs.pagesCount == rhs.pagesCount
+		;
+	}
+
+	//
+
 	void SetBytecode::serializeSpecific(SerializationBuffer& buffer) const
 	{
 		CmdMessage::serializeSpecific(buffer);
@@ -1329,6 +1568,182 @@ namespace Aseba
 
 	//
 
+	GetChangedVariables::GetChangedVariables(uint16_t dest, uint16_t start, uint16_t length, uint16_t generation) :
+		CmdMessage(ASEBA_MESSAGE_GET_CHANGED_VARIABLES, dest),
+		start(start),
+		length(length),
+		generation(generation)
+	{
+	}
+
+	void GetChangedVariables::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		CmdMessage::serializeSpecific(buffer);
+
+		buffer.add(start);
+		buffer.add(length);
+		buffer.add(generation);
+	}
+
+	void GetChangedVariables::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		CmdMessage::deserializeSpecific(buffer);
+
+		start = buffer.get<uint16_t>();
+		length = buffer.get<uint16_t>();
+		generation = buffer.get<uint16_t>();
+	}
+
+	void GetChangedVariables::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+
+		stream << "start " << start << ", length " << length << ", since generation " << generation;
+	}
+
+	bool operator ==(const GetChangedVariables &lhs, const GetChangedVariables &rhs)
+	{
+		return
+			static_cast<const CmdMessage&>(lhs) == static_cast<const CmdMessage&>(rhs) &&
+			lhs.start == rhs.start &&
+			lhs.length == rhs.length &&
+			lhs.generation == rhs.generation
+		;
+	}
+
+	//
+
+	WatchVariables::WatchVariables(uint16_t dest, uint16_t start, uint16_t length, uint16_t period) :
+		CmdMessage(ASEBA_MESSAGE_WATCH_VARIABLES, dest),
+		start(start),
+		length(length),
+		period(period)
+	{
+	}
+
+	void WatchVariables::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		CmdMessage::serializeSpecific(buffer);
+
+		buffer.add(start);
+		buffer.add(length);
+		buffer.add(period);
+	}
+
+	void WatchVariables::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		CmdMessage::deserializeSpecific(buffer);
+
+		start = buffer.get<uint16_t>();
+		length = buffer.get<uint16_t>();
+		period = buffer.get<uint16_t>();
+	}
+
+	void WatchVariables::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+
+		stream << "start " << start << ", length " << length << ", period " << period << " ms";
+	}
+
+	bool operator ==(const WatchVariables &lhs, const WatchVariables &rhs)
+	{
+		return
+			static_cast<const CmdMessage&>(lhs) == static_cast<const CmdMessage&>(rhs) &&
+			lhs.start == rhs.start &&
+			lhs.length == rhs.length &&
+			lhs.period == rhs.period
+		;
+	}
+
+	//
+
+	UnwatchVariables::UnwatchVariables(uint16_t dest, uint16_t start, uint16_t length) :
+		CmdMessage(ASEBA_MESSAGE_UNWATCH_VARIABLES, dest),
+		start(start),
+		length(length)
+	{
+	}
+
+	void UnwatchVariables::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		CmdMessage::serializeSpecific(buffer);
+
+		buffer.add(start);
+		buffer.add(length);
+	}
+
+	void UnwatchVariables::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		CmdMessage::deserializeSpecific(buffer);
+
+		start = buffer.get<uint16_t>();
+		length = buffer.get<uint16_t>();
+	}
+
+	void UnwatchVariables::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+
+		stream << "start " << start << ", length " << length;
+	}
+
+	bool operator ==(const UnwatchVariables &lhs, const UnwatchVariables &rhs)
+	{
+		return
+			static_cast<const CmdMessage&>(lhs) == static_cast<const CmdMessage&>(rhs) &&
+			lhs.start == rhs.start &&
+			lhs.length == rhs.length
+		;
+	}
+
+	//
+
+	GetTaggedVariables::GetTaggedVariables(uint16_t dest, uint16_t start, uint16_t length, uint16_t tag) :
+		CmdMessage(ASEBA_MESSAGE_GET_TAGGED_VARIABLES, dest),
+		start(start),
+		length(length),
+		tag(tag)
+	{
+	}
+
+	void GetTaggedVariables::serializeSpecific(SerializationBuffer& buffer) const
+	{
+		CmdMessage::serializeSpecific(buffer);
+
+		buffer.add(start);
+		buffer.add(length);
+		buffer.add(tag);
+	}
+
+	void GetTaggedVariables::deserializeSpecific(SerializationBuffer& buffer)
+	{
+		CmdMessage::deserializeSpecific(buffer);
+
+		start = buffer.get<uint16_t>();
+		length = buffer.get<uint16_t>();
+		tag = buffer.get<uint16_t>();
+	}
+
+	void GetTaggedVariables::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+
+		stream << "start " << start << ", length " << length << ", tag " << tag;
+	}
+
+	bool operator ==(const GetTaggedVariables &lhs, const GetTaggedVariables &rhs)
+	{
+		return
+			static_cast<const CmdMessage&>(lhs) == static_cast<const CmdMessage&>(rhs) &&
+			lhs.start == rhs.start &&
+			lhs.length == rhs.length &&
+			lhs.tag == rhs.tag
+		;
+	}
+
+	//
+
 	SetVariables::SetVariables(uint16_t dest, uint16_t start, VariablesDataVector variables) :
 		CmdMessage(ASEBA_MESSAGE_SET_VARIABLES, dest),
 		start(start),
@@ -92,6 +92,8 @@ namespace Aseba
 		static Message *create(uint16_t source, uint16_t type, SerializationBuffer& buffer);
 		Message* clone() const;
 		void dump(std::wostream &stream) const;
+		//! Return a human-readable name of the type of this message
+		const char* getName() const { return *this; }
 
 		// purely-virtual methods for children
 
@@ -144,12 +146,28 @@ namespace Aseba
 	bool operator ==(const CmdMessage &lhs, const CmdMessage &rhs);
 
 	//! Message for bootloader: description of the flash memory layout
+	/**
+		Bootloaders supporting the pipelined protocol append the maximum size of
+		a BootloaderPageDataWriteBlock frame and the number of pages they can
+		buffer, and optionally a bitfield of other supported features;
+		older bootloaders do not send these and leave them at 0.
+	*/
 	class BootloaderDescription : public Message
 	{
+	public:
+		//! Optional features of the bootloader
+		enum Feature: uint16_t
+		{
+			PAGE_CHECKSUMS = 1 << 0 //!< answers BootloaderGetPageChecksums
+		};
+
 	public:
 		uint16_t pageSize;
 		uint16_t pagesStart;
 		uint16_t pagesCount;
+		uint16_t maxFrameSize = 0; //!< maximum number of data bytes in a BootloaderPageDataWriteBlock, 0 if pipelining is not supported
+		uint16_t windowSize = 0; //!< maximum number of pages being written at the same time, 0 if pipelining is not supported
+		uint16_t features = 0; //!< bitfield of supported Feature
 
 	public:
 		BootloaderDescription() : Message(ASEBA_MESSAGE_BOOTLOADER_DESCRIPTION) { }
@@ -195,7 +213,7 @@ namespace Aseba
 
 	public:
 		ErrorCode errorCode;
-		uint16_t errorAddress;
+		uint16_t errorAddress = 0; //!< address of the failure, or number of the page in the pipelined protocol
 
 	public:
 		BootloaderAck() : Message(ASEBA_MESSAGE_BOOTLOADER_ACK) { }
@@ -209,6 +227,25 @@ namespace Aseba
 
 	bool operator ==(const BootloaderAck &lhs, const BootloaderAck &rhs);
 
+	//! Message for bootloader: CRC-32 (as crc32Ieee()) of the content of consecutive pages of flash
+	class BootloaderPageChecksums : public Message
+	{
+	public:
+		uint16_t pagesStart = 0; //!< page of the first checksum
+		std::vector<uint32_t> checksums;
+
+	public:
+		BootloaderPageChecksums() : Message(ASEBA_MESSAGE_BOOTLOADER_PAGE_CHECKSUMS) { }
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "bootloader page checksums"; }
+	};
+
+	bool operator ==(const BootloaderPageChecksums &lhs, const BootloaderPageChecksums &rhs);
+
 	//! Request nodes to notify their presence
 	class ListNodes : public Message
 	{
@@ -228,10 +265,27 @@ namespace Aseba
 	bool operator ==(const ListNodes &lhs, const ListNodes &rhs);
 
 	//! Answer of a node notifying its presence
+	/**
+		Nodes can announce a bitfield of optional features after their protocol version;
+		older nodes do not send it and leave it at 0. Nodes with the DESCRIPTION_HASH feature
+		follow it with a hash of their description, see DescriptionsCache.
+	*/
 	class NodePresent : public Message
 	{
+	public:
+		//! Optional features of the node
+		enum Feature: uint16_t
+		{
+			CHANGED_VARIABLES = ASEBA_NODE_FEATURE_CHANGED_VARIABLES, //!< answers GetChangedVariables
+			WATCH_VARIABLES = ASEBA_NODE_FEATURE_WATCH_VARIABLES, //!< sends variables registered with WatchVariables when they change
+			TAGGED_VARIABLES = ASEBA_NODE_FEATURE_TAGGED_VARIABLES, //!< answers GetTaggedVariables
+			DESCRIPTION_HASH = ASEBA_NODE_FEATURE_DESCRIPTION_HASH //!< announces descriptionHash
+		};
+
 	public:
 		uint16_t version = ASEBA_PROTOCOL_VERSION;
+		uint16_t features = 0; //!< bitfield of supported Feature
+		uint32_t descriptionHash = 0; //!< 32-bit FNV-1a of the description messages of the node, if features has DESCRIPTION_HASH
 
 	public:
 		NodePresent() : Message(ASEBA_MESSAGE_NODE_PRESENT) { }
@@ -375,6 +429,63 @@ namespace Aseba
 
 	bool operator ==(const Variables &lhs, const Variables &rhs);
 
+	//! Content of the variables that changed since a previous ChangedVariables, answer to GetChangedVariables
+	/**
+		Bit i of mask, word i / 16 and bit i % 16, is set if variable start + i is sent,
+		the values of the set bits following in order in values. A variable not sent has
+		the value it had in the last ChangedVariables of the node including it.
+		Nodes number these messages with a generation that increases by one each time,
+		so a receiver seeing every one of them can keep a copy of the variables,
+		see VariablesMirror.
+	*/
+	class ChangedVariables : public Message
+	{
+	public:
+		uint16_t start;
+		uint16_t length;
+		uint16_t generation; //!< number of this message, never 0
+		std::vector<uint16_t> mask; //!< (length + 15) / 16 words, one bit per variable
+		VariablesDataVector values; //!< values of the variables whose bit is set in mask
+
+	public:
+		ChangedVariables() : Message(ASEBA_MESSAGE_CHANGED_VARIABLES) { }
+
+		//! Return whether variable start + i is in values
+		bool isChanged(uint16_t i) const { return (mask[i / 16] >> (i % 16)) & 1; }
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "changed variables"; }
+	};
+
+	bool operator ==(const ChangedVariables &lhs, const ChangedVariables &rhs);
+
+	//! Content of some variables, answer to the GetTaggedVariables with the same tag
+	/**
+		Nodes may split their answer in several messages with the same tag,
+		the requester knowing from the range it asked for when all have arrived.
+	*/
+	class TaggedVariables : public Message
+	{
+	public:
+		uint16_t tag;
+		uint16_t start;
+		VariablesDataVector variables;
+
+	public:
+		TaggedVariables() : Message(ASEBA_MESSAGE_TAGGED_VARIABLES) { }
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "tagged variables"; }
+	};
+
+	bool operator ==(const TaggedVariables &lhs, const TaggedVariables &rhs);
+
 	//! Exception: an array acces attempted to read past memory
 	class ArrayAccessOutOfBounds : public Message
 	{
@@ -554,6 +665,45 @@ namespace Aseba
 
 	bool operator ==(const BootloaderPageDataWrite &lhs, const BootloaderPageDataWrite &rhs);
 
+	//! Message for bootloader: a block of data of a given page, for the pipelined protocol
+	class BootloaderPageDataWriteBlock : public CmdMessage
+	{
+	public:
+		uint16_t pageNumber = 0;
+		uint16_t offset = 0; //!< position of data within the page, in bytes
+		std::vector<uint8_t> data;
+
+	public:
+		BootloaderPageDataWriteBlock(uint16_t dest = ASEBA_DEST_INVALID) : CmdMessage(ASEBA_MESSAGE_BOOTLOADER_PAGE_DATA_WRITE_BLOCK, dest) { }
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "bootloader page data write block"; }
+	};
+
+	bool operator ==(const BootloaderPageDataWriteBlock &lhs, const BootloaderPageDataWriteBlock &rhs);
+
+	//! Message for bootloader: request the checksums of consecutive pages of flash, answered by BootloaderPageChecksums
+	class BootloaderGetPageChecksums : public CmdMessage
+	{
+	public:
+		uint16_t pagesStart = 0;
+		uint16_t pagesCount = 0;
+
+	public:
+		BootloaderGetPageChecksums(uint16_t dest = ASEBA_DEST_INVALID) : CmdMessage(ASEBA_MESSAGE_BOOTLOADER_GET_PAGE_CHECKSUMS, dest) { }
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "bootloader get page checksums"; }
+	};
+
+	bool operator ==(const BootloaderGetPageChecksums &lhs, const BootloaderGetPageChecksums &rhs);
+
 	//! Upload bytecode to a node
 	class SetBytecode : public CmdMessage
 	{
@@ -721,6 +871,104 @@ namespace Aseba
 
 	bool operator ==(const GetVariables &lhs, const GetVariables &rhs);
 
+	//! Read the variables of a node that changed since a given ChangedVariables
+	/**
+		The node answers with ChangedVariables, including all variables if generation is 0,
+		or with Variables if it does not support this message, see NodePresent::Feature.
+	*/
+	class GetChangedVariables : public CmdMessage
+	{
+	public:
+		uint16_t start;
+		uint16_t length;
+		uint16_t generation; //!< generation of the ChangedVariables known by the requester, 0 for none
+
+	public:
+		GetChangedVariables() : CmdMessage(ASEBA_MESSAGE_GET_CHANGED_VARIABLES, ASEBA_DEST_INVALID) { }
+		GetChangedVariables(uint16_t dest, uint16_t start, uint16_t length, uint16_t generation = 0);
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "get changed variables"; }
+	};
+
+	bool operator ==(const GetChangedVariables &lhs, const GetChangedVariables &rhs);
+
+	//! Read some variables from a node, tagging the request so that its answer can be told apart from others
+	/**
+		The node answers with TaggedVariables carrying the same tag. Nodes that do not support
+		this message ignore it, see NodePresent::Feature; GetVariables must be used for them.
+	*/
+	class GetTaggedVariables : public CmdMessage
+	{
+	public:
+		uint16_t start;
+		uint16_t length;
+		uint16_t tag; //!< chosen by the requester, copied in the answer
+
+	public:
+		GetTaggedVariables() : CmdMessage(ASEBA_MESSAGE_GET_TAGGED_VARIABLES, ASEBA_DEST_INVALID) { }
+		GetTaggedVariables(uint16_t dest, uint16_t start, uint16_t length, uint16_t tag);
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "get tagged variables"; }
+	};
+
+	bool operator ==(const GetTaggedVariables &lhs, const GetTaggedVariables &rhs);
+
+	//! Ask a node to send some variables when they change
+	/**
+		The node answers with Variables holding their current values, and then sends Variables
+		again each time they change, but not more often than every period ms. Watching the same
+		variables again changes the period. Nodes have a limited number of watches, and ignore
+		this message if they are all in use or if they do not support it, see NodePresent::Feature.
+		Watches are lost when the node reboots.
+	*/
+	class WatchVariables : public CmdMessage
+	{
+	public:
+		uint16_t start;
+		uint16_t length;
+		uint16_t period; //!< minimum time between two sends, in ms
+
+	public:
+		WatchVariables() : CmdMessage(ASEBA_MESSAGE_WATCH_VARIABLES, ASEBA_DEST_INVALID) { }
+		WatchVariables(uint16_t dest, uint16_t start, uint16_t length, uint16_t period);
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "watch variables"; }
+	};
+
+	bool operator ==(const WatchVariables &lhs, const WatchVariables &rhs);
+
+	//! Stop sending variables set with WatchVariables, all of them if length is 0
+	class UnwatchVariables : public CmdMessage
+	{
+	public:
+		uint16_t start;
+		uint16_t length;
+
+	public:
+		UnwatchVariables() : CmdMessage(ASEBA_MESSAGE_UNWATCH_VARIABLES, ASEBA_DEST_INVALID) { }
+		UnwatchVariables(uint16_t dest, uint16_t start, uint16_t length);
+
+	protected:
+		void serializeSpecific(SerializationBuffer& buffer) const override;
+		void deserializeSpecific(SerializationBuffer& buffer) override;
+		void dumpSpecific(std::wostream &stream) const override;
+		operator const char * () const override { return "unwatch variables"; }
+	};
+
+	bool operator ==(const UnwatchVariables &lhs, const UnwatchVariables &rhs);
+
 	//! Set some variables on a node
 	class SetVariables : public CmdMessage
 	{
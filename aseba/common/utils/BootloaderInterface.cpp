@@ -27,19 +27,29 @@
 #include <memory>
 #include <algorithm>
 #include <iterator>
+#include <deque>
+#include <set>
 
 namespace Aseba 
 {
 	using namespace Dashel;
 	using namespace std;
 
+	//! Number of times a page is sent with the pipelined protocol before giving up
+	static const unsigned PAGE_ATTEMPTS_COUNT = 3;
+
 	BootloaderInterface::BootloaderInterface(Stream* stream, int dest) :
 		stream(stream),
 		dest(dest),
 		bootloaderDest(dest),
 		pageSize(0),
 		pagesStart(0),
-		pagesCount(0)
+		pagesCount(0),
+		maxFrameSize(0),
+		windowSize(0),
+		features(0),
+		pipeliningAllowed(true),
+		differential(false)
 	{
 
 	}
@@ -50,7 +60,12 @@ namespace Aseba
 		bootloaderDest(bootloaderDest),
 		pageSize(0),
 		pagesStart(0),
-		pagesCount(0)
+		pagesCount(0),
+		maxFrameSize(0),
+		windowSize(0),
+		features(0),
+		pipeliningAllowed(true),
+		differential(false)
 	{
 
 	}
@@ -259,15 +274,77 @@ namespace Aseba
 					pageSize = bDescMessage->pageSize;
 					pagesStart = bDescMessage->pagesStart;
 					pagesCount = bDescMessage->pagesCount;
+					maxFrameSize = bDescMessage->maxFrameSize;
+					windowSize = bDescMessage->windowSize;
+					features = bDescMessage->features;
 					break;
 				}
 			}
 		}
 
 		// Build a map of pages out of the map of addresses
-		typedef map<uint32_t, vector<uint8_t> > PageMap;
+		PageMap pageMap(pagesFromHex(hexFile, pageSize));
+
+		if (differential)
+		{
+			const size_t pagesTotal(pageMap.size());
+			removeUnchangedPages(pageMap, simple);
+			writeHexUnchangedPages(pagesTotal - pageMap.size());
+		}
+
+		writeHexGotDescription(pageMap.size());
+
+		if (simple)
+		{
+			// Write pages
+			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			{
+				unsigned pageIndex = it->first;
+				if (pageIndex != 0)
+					if (!writePage(pageIndex, &it->second[0], true))
+						errorWritePageNonFatal(pageIndex);
+			}
+			// Now look for the index 0 page
+			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			{
+				unsigned pageIndex = it->first;
+				if (pageIndex == 0)
+					if (!writePage(pageIndex, &it->second[0], true))
+						errorWritePageNonFatal(pageIndex);
+			}
+		}
+		else if (isPipelined())
+		{
+			writePagesPipelined(pageMap);
+		}
+		else
+		{
+			// Write pages
+			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			{
+				unsigned pageIndex = it->first;
+				if ((pageIndex >= pagesStart) && (pageIndex < pagesStart + pagesCount))
+					if (!writePage(pageIndex, &it->second[0], false))
+						throw Error(FormatableString("Error while writing page %0").arg(pageIndex));
+			}
+		}
+
+		writeHexWritten();
+
+		if (reset) 
+		{
+			BootloaderReset msg(bootloaderDest);
+			msg.serialize(stream);
+			stream->flush();
+
+			writeHexExitingBootloader();
+		}
+	}
+
+	BootloaderInterface::PageMap BootloaderInterface::pagesFromHex(const HexFile& hexFile, unsigned pageSize)
+	{
 		PageMap pageMap;
-		for (HexFile::ChunkMap::iterator it = hexFile.data.begin(); it != hexFile.data.end(); it ++)
+		for (HexFile::ChunkMap::const_iterator it = hexFile.data.begin(); it != hexFile.data.end(); it ++)
 		{
 			// get page number
 			unsigned chunkAddress = it->first;
@@ -292,56 +369,184 @@ namespace Aseba
 				}
 				// copy data
 				unsigned amountToCopy = min(pageSize - byteIndex, chunkSize - chunkDataIndex);
-				copy(it->second.begin() + chunkDataIndex, it->second.begin() + chunkDataIndex + amountToCopy, pageMap[pageIndex].begin() + byteIndex);
+				copy(it->second.cbegin() + chunkDataIndex, it->second.cbegin() + chunkDataIndex + amountToCopy, pageMap[pageIndex].begin() + byteIndex);
 
 				// increment chunk data pointer
 				chunkDataIndex += amountToCopy;
 			}
 			while (chunkDataIndex < chunkSize);
 		}
+		return pageMap;
+	}
 
-		writeHexGotDescription(pageMap.size());
-
-		if (simple)
+	void BootloaderInterface::writePagesPipelined(const PageMap& pageMap)
+	{
+		// a frame must fit in a message along with destination, page number and offset
+		const unsigned frameSize(min<unsigned>(maxFrameSize, ASEBA_MAX_EVENT_ARG_SIZE - 6));
+		writeHexPipelined(frameSize, windowSize);
+
+		// pages to send, page 0 last so that an interrupted update is detected
+		deque<unsigned> toSend;
+		for (const auto& page: pageMap)
+			if ((page.first != 0) && (page.first >= pagesStart) && (page.first < pagesStart + pagesCount))
+				toSend.push_back(page.first);
+		if ((pageMap.find(0) != pageMap.end()) && (pagesStart == 0) && (pagesCount > 0))
+			toSend.push_back(0);
+
+		// pages sent but not acknowledged yet, and number of times pages were sent
+		set<unsigned> pending;
+		map<unsigned, unsigned> attempts;
+		while (!toSend.empty() || !pending.empty())
 		{
-			// Write pages
-			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			// fill the window, but send page 0 only once all others succeeded
+			while (!toSend.empty() && (pending.size() < windowSize) && ((toSend.front() != 0) || pending.empty()))
 			{
-				unsigned pageIndex = it->first;
-				if (pageIndex != 0)
-					if (!writePage(pageIndex, &it->second[0], true))
-						errorWritePageNonFatal(pageIndex);
+				const unsigned pageIndex(toSend.front());
+				toSend.pop_front();
+				sendPagePipelined(pageIndex, &pageMap.at(pageIndex)[0]);
+				pending.insert(pageIndex);
+				++attempts[pageIndex];
 			}
-			// Now look for the index 0 page
-			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+
+			unsigned pageIndex;
+			const bool success(waitPageAck(pageIndex));
+			if (pending.erase(pageIndex) == 0)
+				throw Error(FormatableString("Error, unexpected acknowledgement for page %0").arg(pageIndex));
+			if (!success)
 			{
-				unsigned pageIndex = it->first;
-				if (pageIndex == 0)
-					if (!writePage(pageIndex, &it->second[0], true))
-						errorWritePageNonFatal(pageIndex);
+				if (attempts[pageIndex] >= PAGE_ATTEMPTS_COUNT)
+					throw Error(FormatableString("Error while writing page %0").arg(pageIndex));
+				// send it again before the next ones
+				errorWritePageNonFatal(pageIndex);
+				toSend.push_front(pageIndex);
 			}
 		}
-		else
+	}
+
+	void BootloaderInterface::sendPagePipelined(unsigned pageNumber, const uint8_t *data)
+	{
+		writePageStart(pageNumber, data, false);
+
+		BootloaderWritePage writePage;
+		writePage.dest = bootloaderDest;
+		writePage.pageNumber = pageNumber;
+		writePage.serialize(stream);
+
+		const unsigned frameSize(min<unsigned>(maxFrameSize, ASEBA_MAX_EVENT_ARG_SIZE - 6));
+		for (unsigned dataWritten = 0; dataWritten < pageSize; dataWritten += frameSize)
 		{
-			// Write pages
-			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			BootloaderPageDataWriteBlock block;
+			block.dest = bootloaderDest;
+			block.pageNumber = pageNumber;
+			block.offset = dataWritten;
+			block.data.assign(data + dataWritten, data + min(dataWritten + frameSize, pageSize));
+			block.serialize(stream);
+		}
+
+		// flush once per page to save bandwidth
+		stream->flush();
+	}
+
+	bool BootloaderInterface::waitPageAck(unsigned& pageNumber)
+	{
+		while (true)
+		{
+			writePageWaitAck();
+			unique_ptr<Message> message(Message::receive(stream));
+
+			// handle ack
+			BootloaderAck *ackMessage = dynamic_cast<BootloaderAck *>(message.get());
+			if (ackMessage && (ackMessage->source == bootloaderDest))
 			{
-				unsigned pageIndex = it->first;
-				if ((pageIndex >= pagesStart) && (pageIndex < pagesStart + pagesCount))
-					if (!writePage(pageIndex, &it->second[0], false))
-						throw Error(FormatableString("Error while writing page %0").arg(pageIndex));
+				pageNumber = ackMessage->errorAddress;
+				if (ackMessage->errorCode == BootloaderAck::ErrorCode::SUCCESS)
+				{
+					writePageSuccess();
+					return true;
+				}
+				else
+				{
+					writePageFailure();
+					return false;
+				}
 			}
 		}
+	}
 
-		writeHexWritten();
-
-		if (reset) 
+	vector<uint32_t> BootloaderInterface::readPageChecksums(unsigned first, unsigned count)
+	{
+		vector<uint32_t> checksums;
+		checksums.reserve(count);
+		while (checksums.size() < count)
 		{
-			BootloaderReset msg(bootloaderDest);
-			msg.serialize(stream);
+			// request as many checksums as fit in a reply
+			const unsigned chunkStart(first + checksums.size());
+			const unsigned chunkEnd(chunkStart + min<unsigned>(count - checksums.size(), (ASEBA_MAX_EVENT_ARG_SIZE - 2) / 4));
+			BootloaderGetPageChecksums request(bootloaderDest);
+			request.pagesStart = chunkStart;
+			request.pagesCount = chunkEnd - chunkStart;
+			request.serialize(stream);
 			stream->flush();
 
-			writeHexExitingBootloader();
+			// the bootloader might answer using several messages
+			while (first + checksums.size() < chunkEnd)
+			{
+				unique_ptr<Message> message(Message::receive(stream));
+
+				BootloaderPageChecksums *checksumsMessage = dynamic_cast<BootloaderPageChecksums *>(message.get());
+				if (checksumsMessage && (checksumsMessage->source == bootloaderDest))
+				{
+					if ((checksumsMessage->pagesStart != first + checksums.size()) || checksumsMessage->checksums.empty())
+						throw Error(FormatableString("Error, unexpected checksums for pages starting at %0").arg(checksumsMessage->pagesStart));
+					const size_t usedCount(min<size_t>(checksumsMessage->checksums.size(), chunkEnd - checksumsMessage->pagesStart));
+					copy(checksumsMessage->checksums.begin(), checksumsMessage->checksums.begin() + usedCount, back_inserter(checksums));
+				}
+
+				BootloaderAck *ackMessage = dynamic_cast<BootloaderAck *>(message.get());
+				if (ackMessage && (ackMessage->source == bootloaderDest) && (ackMessage->errorCode != BootloaderAck::ErrorCode::SUCCESS))
+					throw Error(FormatableString("Error, cannot read checksums of pages %0 to %1").arg(chunkStart).arg(chunkEnd - 1));
+			}
+		}
+		return checksums;
+	}
+
+	void BootloaderInterface::removeUnchangedPages(PageMap& pageMap, bool simple)
+	{
+		// page 0 is written last so that an interrupted update is detected, keep it whatever its content
+		if (!simple && (features & BootloaderDescription::PAGE_CHECKSUMS))
+		{
+			// get the checksums of the span of pages in range in one go
+			auto begin(pageMap.lower_bound(max(pagesStart, 1u)));
+			auto end(pageMap.lower_bound(pagesStart + pagesCount));
+			if ((begin == pageMap.end()) || (begin->first >= pagesStart + pagesCount))
+				return;
+			const unsigned first(begin->first);
+			const vector<uint32_t> checksums(readPageChecksums(first, prev(end)->first - first + 1));
+			for (auto it = begin; it != end;)
+			{
+				if (crc32Ieee(0, &it->second[0], pageSize) == checksums[it->first - first])
+					it = pageMap.erase(it);
+				else
+					++it;
+			}
+		}
+		else
+		{
+			// read pages back and compare them
+			vector<uint8_t> buffer(pageSize);
+			for (auto it = pageMap.upper_bound(0); it != pageMap.end();)
+			{
+				const unsigned pageIndex(it->first);
+				bool read(false);
+				if (simple)
+					read = readPageSimple(pageIndex, &buffer[0]);
+				else if ((pageIndex >= pagesStart) && (pageIndex < pagesStart + pagesCount))
+					read = readPage(pageIndex, &buffer[0]);
+				if (read && (buffer == it->second))
+					it = pageMap.erase(it);
+				else
+					++it;
+			}
 		}
 	}
 
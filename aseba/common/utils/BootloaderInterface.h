@@ -22,6 +22,8 @@
 
 #include <string>
 #include <stdexcept>
+#include <map>
+#include <vector>
 #include "../types.h"
 
 
@@ -32,6 +34,8 @@ namespace Dashel
 
 namespace Aseba 
 {
+	class HexFile;
+
 	// TODO: change API to use HexFile instead of file names
 
 	//! Manage interactions with an aseba-compatible bootloader
@@ -41,6 +45,19 @@ namespace Aseba
 		as it transmits all data using the Aseba message protocol.
 		The simple version requires direct access to the device to be flashed,
 		because it breaks the Aseba message protocol for page transmission.
+
+		If the bootloader announces a frame size and a window in its description,
+		the complete version is pipelined: pages are sent in frames of up to that
+		size and up to window pages are written before waiting for their
+		acknowledgements, which come once per page, in any order, with the page
+		number in errorAddress. Pages that fail are sent again a few times, and
+		page 0 is only sent once all others succeeded. Otherwise, each page is
+		sent 4 bytes at a time and acknowledged before the next one.
+
+		In differential mode, pages whose content on the device already matches
+		the hex file are not written. The device content is compared using page
+		CRC-32 if the bootloader announces them, or by reading pages back.
+		Page 0 is always written, as it is written last to mark a complete update.
 	*/
 	class BootloaderInterface
 	{
@@ -51,6 +68,13 @@ namespace Aseba
 			Error(const std::string& what): std::runtime_error(what) {}
 		};
 
+	public:
+		//! Page contents by page number
+		using PageMap = std::map<uint32_t, std::vector<uint8_t>>;
+
+		//! Split the content of an hex file into pages of pageSize bytes, filling gaps with zeros
+		static PageMap pagesFromHex(const HexFile& hexFile, unsigned pageSize);
+
 	public:
 		// main interface
 
@@ -63,6 +87,18 @@ namespace Aseba
 		//! Return the size of a page
 		int getPageSize() const { return pageSize; }
 
+		//! Allow or forbid the pipelined protocol, if the bootloader supports it; allowed by default
+		void setPipeliningAllowed(bool allowed) { pipeliningAllowed = allowed; }
+
+		//! Return whether the pipelined protocol is being used, valid after the bootloader description was received
+		bool isPipelined() const { return pipeliningAllowed && (windowSize != 0) && (maxFrameSize != 0); }
+
+		//! If true, only write pages that differ from the content of the device; disabled by default
+		void setDifferential(bool enabled) { differential = enabled; }
+
+		//! Read the CRC-32 of count pages starting at first, requires a bootloader announcing page checksums
+		std::vector<uint32_t> readPageChecksums(unsigned first, unsigned count);
+
 		//! Read a page
 		bool readPage(unsigned pageNumber, uint8_t* data);
 
@@ -78,6 +114,19 @@ namespace Aseba
 		//! Read an hex file and write it to fileName
 		void readHex(const std::string &fileName);
 
+	protected:
+		//! Write pages within the range given by the bootloader using the pipelined protocol
+		void writePagesPipelined(const PageMap& pageMap);
+
+		//! Send the command and the data frames of a page, without waiting for acknowledgement
+		void sendPagePipelined(unsigned pageNumber, const uint8_t *data);
+
+		//! Wait for the acknowledgement of a page being written, set pageNumber to its number and return whether it succeeded
+		bool waitPageAck(unsigned& pageNumber);
+
+		//! Remove from pageMap the pages other than 0 whose content on the device is the same
+		void removeUnchangedPages(PageMap& pageMap, bool simple);
+
 	protected:
 		// reporting function
 
@@ -90,6 +139,8 @@ namespace Aseba
 		virtual void writeHexStart(const std::string &fileName, bool reset, bool simple) {}
 		virtual void writeHexEnteringBootloader() {}
 		virtual void writeHexGotDescription(unsigned pagesCount) {}
+		virtual void writeHexUnchangedPages(unsigned pagesCount) {}
+		virtual void writeHexPipelined(unsigned frameSize, unsigned windowSize) {}
 		virtual void writeHexWritten() {}
 		virtual void writeHexExitingBootloader() {}
 
@@ -105,6 +156,11 @@ namespace Aseba
 		unsigned pageSize;
 		unsigned pagesStart;
 		unsigned pagesCount;
+		unsigned maxFrameSize;
+		unsigned windowSize;
+		unsigned features;
+		bool pipeliningAllowed;
+		bool differential;
 	};
 } // namespace Aseba
 
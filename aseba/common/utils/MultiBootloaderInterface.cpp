@@ -0,0 +1,474 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MultiBootloaderInterface.h"
+#include "../consts.h"
+#include "../msg/msg.h"
+#include "FormatableString.h"
+#include <memory>
+#include <algorithm>
+
+namespace Aseba
+{
+	using namespace Dashel;
+	using namespace std;
+
+	//! Number of times a page is sent with the pipelined protocol before giving up, as in BootloaderInterface
+	static const unsigned PAGE_ATTEMPTS_COUNT = 3;
+
+	MultiBootloaderInterface::MultiBootloaderInterface(const string& hexFileName, bool reset, bool simple):
+		reset(reset),
+		simple(simple)
+	{
+		hexFile.read(hexFileName);
+	}
+
+	void MultiBootloaderInterface::addTarget(Stream* stream, unsigned dest, unsigned bootloaderDest)
+	{
+		Session session;
+		session.report.stream = stream;
+		session.report.dest = dest;
+		session.report.bootloaderDest = bootloaderDest;
+		sessions.push_back(session);
+	}
+
+	void MultiBootloaderInterface::setDifferential(bool enabled)
+	{
+		// the simple protocol reads pages raw, which cannot be dispatched to nodes
+		if (enabled && simple)
+			throw BootloaderInterface::Error("Differential mode is not supported with the simple protocol");
+		differential = enabled;
+	}
+
+	bool MultiBootloaderInterface::flash(unsigned timeout)
+	{
+		startSessions();
+		// process incoming messages, which drive the state machines
+		do
+			step(10);
+		while (updateSessions(timeout));
+
+		return all_of(sessions.begin(), sessions.end(), [](const Session& session) { return session.report.status == Status::DONE; });
+	}
+
+	//! Reset nodes into bootloader if requested
+	void MultiBootloaderInterface::startSessions()
+	{
+		for (auto& session: sessions)
+		{
+			session.start = UnifiedTime();
+			session.lastActivity = session.start;
+			if (reset)
+			{
+				Reboot message(session.report.dest);
+				message.serialize(session.report.stream);
+				session.report.stream->flush();
+			}
+			notify(session);
+		}
+	}
+
+	//! Handle timers, giving up on nodes silent for more than timeout ms, return whether some nodes are still being flashed
+	bool MultiBootloaderInterface::updateSessions(unsigned timeout)
+	{
+		bool active(false);
+		const UnifiedTime now;
+		for (auto& session: sessions)
+		{
+			const Status status(session.report.status);
+			if (status == Status::DONE || status == Status::FAILED)
+				continue;
+
+			// the simple bootloader does not send any description, give it 10 ms to start
+			if (simple && status == Status::ENTERING_BOOTLOADER && (now - session.start).value >= 10)
+			{
+				session.pageSize = 2048;
+				selectPages(session);
+			}
+			else if ((now - session.lastActivity).value > timeout)
+			{
+				fail(session, "Timeout while waiting for the bootloader");
+			}
+
+			active = active || (session.report.status != Status::DONE && session.report.status != Status::FAILED);
+		}
+		return active;
+	}
+
+	vector<MultiBootloaderInterface::Report> MultiBootloaderInterface::getReports() const
+	{
+		vector<Report> reports;
+		for (const auto& session: sessions)
+			reports.push_back(session.report);
+		return reports;
+	}
+
+	void MultiBootloaderInterface::incomingData(Stream *stream)
+	{
+		unique_ptr<Message> message(Message::receive(stream));
+
+		// find the session this message belongs to
+		auto it(find_if(sessions.begin(), sessions.end(), [&](const Session& session) {
+			return
+				session.report.stream == stream &&
+				session.report.bootloaderDest == message->source &&
+				session.report.status != Status::DONE &&
+				session.report.status != Status::FAILED;
+		}));
+		if (it == sessions.end())
+			return;
+		Session& session(*it);
+
+		const BootloaderDescription *description(dynamic_cast<BootloaderDescription *>(message.get()));
+		if (description && !simple && session.report.status == Status::ENTERING_BOOTLOADER)
+		{
+			session.lastActivity = UnifiedTime();
+			session.pageSize = description->pageSize;
+			session.pagesStart = description->pagesStart;
+			session.pagesCount = description->pagesCount;
+			if (description->windowSize != 0 && description->maxFrameSize != 0)
+			{
+				session.report.pipelined = true;
+				// a frame must fit in a message along with destination, page number and offset
+				session.frameSize = min<unsigned>(description->maxFrameSize, ASEBA_MAX_EVENT_ARG_SIZE - 6);
+				session.windowSize = description->windowSize;
+			}
+			session.checksums = (description->features & BootloaderDescription::PAGE_CHECKSUMS) != 0;
+			selectPages(session);
+			return;
+		}
+
+		if (session.report.status == Status::COMPARING)
+		{
+			session.lastActivity = UnifiedTime();
+			processComparison(session, *message);
+			return;
+		}
+
+		if (dynamic_cast<BootloaderAck *>(message.get()) && session.report.status == Status::WRITING)
+		{
+			session.lastActivity = UnifiedTime();
+			processAck(session, *message);
+		}
+	}
+
+	void MultiBootloaderInterface::connectionClosed(Stream *stream, bool abnormal)
+	{
+		for (auto& session: sessions)
+		{
+			if (session.report.stream != stream)
+				continue;
+			if (session.report.status == Status::DONE || session.report.status == Status::FAILED)
+				continue;
+			fail(session, "Connection closed");
+		}
+	}
+
+	//! Select the pages to write in this session, then compare them with the device in differential mode, or start sending them
+	void MultiBootloaderInterface::selectPages(Session& session)
+	{
+		if (session.pageSize == 0)
+		{
+			fail(session, "Invalid page size");
+			return;
+		}
+
+		// select pages, in the same order as BootloaderInterface::writeHex
+		const BootloaderInterface::PageMap& pageMap(pages(session.pageSize));
+		const bool page0Last(simple || session.report.pipelined);
+		for (const auto& page: pageMap)
+		{
+			if (page0Last && page.first == 0)
+				continue;
+			if (simple || ((page.first >= session.pagesStart) && (page.first < session.pagesStart + session.pagesCount)))
+				session.pages.push_back(page.first);
+		}
+		// the simple and pipelined protocols write page 0 last
+		if (page0Last && pageMap.find(0) != pageMap.end() && (simple || session.pagesStart == 0))
+			session.pages.push_back(0);
+
+		if (differential)
+		{
+			session.report.status = Status::COMPARING;
+			notify(session);
+			compareNextPages(session);
+		}
+		else
+			startWriting(session);
+	}
+
+	//! Ask the device for the content of the next pages to compare, or start writing the pages that changed once all are compared
+	void MultiBootloaderInterface::compareNextPages(Session& session)
+	{
+		// page 0 is written last so that an interrupted update is detected, always write it
+		while (session.nextCompared < session.pages.size() && session.pages[session.nextCompared] == 0)
+			++session.nextCompared;
+
+		if (session.nextCompared == session.pages.size())
+		{
+			const auto& unchanged(session.unchanged);
+			session.pages.erase(remove_if(session.pages.begin(), session.pages.end(), [&](unsigned pageNumber) {
+				return find(unchanged.begin(), unchanged.end(), pageNumber) != unchanged.end();
+			}), session.pages.end());
+			session.report.pagesUnchanged = unchanged.size();
+			startWriting(session);
+			return;
+		}
+
+		const unsigned pageNumber(session.pages[session.nextCompared]);
+		if (session.checksums)
+		{
+			// as many checksums as fit in a reply
+			BootloaderGetPageChecksums request(session.report.bootloaderDest);
+			request.pagesStart = pageNumber;
+			request.pagesCount = min<unsigned>((ASEBA_MAX_EVENT_ARG_SIZE - 2) / 4, session.pagesStart + session.pagesCount - pageNumber);
+			request.serialize(session.report.stream);
+			session.checksumsEnd = pageNumber + request.pagesCount;
+		}
+		else
+		{
+			BootloaderReadPage request(session.report.bootloaderDest);
+			request.pageNumber = pageNumber;
+			request.serialize(session.report.stream);
+			session.readBack.clear();
+		}
+		session.report.stream->flush();
+	}
+
+	//! Process the checksums or the content of pages sent by the device
+	void MultiBootloaderInterface::processComparison(Session& session, const Message& message)
+	{
+		const auto* checksums(dynamic_cast<const BootloaderPageChecksums*>(&message));
+		if (checksums && session.checksums)
+		{
+			// the bootloader might answer using several messages
+			const unsigned end(checksums->pagesStart + checksums->checksums.size());
+			while (session.nextCompared < session.pages.size())
+			{
+				const unsigned pageNumber(session.pages[session.nextCompared]);
+				if (pageNumber != 0)
+				{
+					if (pageNumber < checksums->pagesStart || pageNumber >= end)
+						break;
+					const vector<uint8_t>& data(pages(session.pageSize).at(pageNumber));
+					if (crc32Ieee(0, &data[0], session.pageSize) == checksums->checksums[pageNumber - checksums->pagesStart])
+						session.unchanged.push_back(pageNumber);
+				}
+				++session.nextCompared;
+			}
+			if (session.nextCompared == session.pages.size() || session.pages[session.nextCompared] >= session.checksumsEnd)
+				compareNextPages(session);
+			return;
+		}
+
+		const auto* dataRead(dynamic_cast<const BootloaderDataRead*>(&message));
+		if (dataRead && !session.checksums)
+		{
+			session.readBack.insert(session.readBack.end(), dataRead->data.begin(), dataRead->data.end());
+			return;
+		}
+
+		const auto* ack(dynamic_cast<const BootloaderAck*>(&message));
+		if (ack && (session.checksums && ack->errorCode != BootloaderAck::ErrorCode::SUCCESS))
+		{
+			fail(session, "Cannot read checksums of pages");
+			return;
+		}
+		if (ack && !session.checksums)
+		{
+			// a page that could not be read is written
+			const unsigned pageNumber(session.pages[session.nextCompared]);
+			if (ack->errorCode == BootloaderAck::ErrorCode::SUCCESS && session.readBack == pages(session.pageSize).at(pageNumber))
+				session.unchanged.push_back(pageNumber);
+			++session.nextCompared;
+			compareNextPages(session);
+		}
+	}
+
+	//! Start sending the pages selected in this session
+	void MultiBootloaderInterface::startWriting(Session& session)
+	{
+		session.report.status = Status::WRITING;
+		session.report.pagesCount = session.pages.size();
+		notify(session);
+
+		if (session.pages.empty())
+			finish(session);
+		else
+			sendPages(session);
+	}
+
+	//! Send pages as long as the window allows
+	void MultiBootloaderInterface::sendPages(Session& session)
+	{
+		Stream* stream(session.report.stream);
+		while ((!session.retries.empty() || session.nextPage < session.pages.size()) && session.pending.size() < session.windowSize && !session.waitingCommandAck)
+		{
+			// in pipelined protocol, send page 0 only once all others succeeded
+			const bool retry(!session.retries.empty());
+			const unsigned pageNumber(retry ? session.retries.front() : session.pages[session.nextPage]);
+			if (session.report.pipelined && pageNumber == 0 && !session.pending.empty())
+				break;
+			if (retry)
+				session.retries.pop_front();
+			else
+				++session.nextPage;
+			session.pending.push_back(pageNumber);
+			++session.attempts[pageNumber];
+
+			BootloaderWritePage writePage;
+			writePage.dest = session.report.bootloaderDest;
+			writePage.pageNumber = pageNumber;
+			writePage.serialize(stream);
+
+			if (simple)
+			{
+				// just write the complete page at once
+				stream->write(&pages(session.pageSize).at(pageNumber)[0], session.pageSize);
+			}
+			else if (session.report.pipelined)
+			{
+				sendPageData(session, pageNumber);
+			}
+			else
+			{
+				// stop-and-wait protocol, data are sent once the command is acknowledged
+				session.waitingCommandAck = true;
+			}
+		}
+		stream->flush();
+	}
+
+	//! Send the data frames of a page, using the protocol of this session
+	void MultiBootloaderInterface::sendPageData(Session& session, unsigned pageNumber)
+	{
+		const vector<uint8_t>& data(pages(session.pageSize).at(pageNumber));
+		if (session.report.pipelined)
+		{
+			for (unsigned dataWritten = 0; dataWritten < session.pageSize; dataWritten += session.frameSize)
+			{
+				BootloaderPageDataWriteBlock block(session.report.bootloaderDest);
+				block.pageNumber = pageNumber;
+				block.offset = dataWritten;
+				block.data.assign(data.begin() + dataWritten, data.begin() + min(dataWritten + session.frameSize, session.pageSize));
+				block.serialize(session.report.stream);
+			}
+		}
+		else
+		{
+			for (unsigned dataWritten = 0; dataWritten < session.pageSize;)
+			{
+				BootloaderPageDataWrite pageData(session.report.bootloaderDest);
+				copy(data.begin() + dataWritten, data.begin() + dataWritten + pageData.data.size(), pageData.data.begin());
+				pageData.serialize(session.report.stream);
+				dataWritten += pageData.data.size();
+			}
+		}
+	}
+
+	void MultiBootloaderInterface::processAck(Session& session, const Message& message)
+	{
+		const BootloaderAck& ack(static_cast<const BootloaderAck&>(message));
+		const bool success(ack.errorCode == BootloaderAck::ErrorCode::SUCCESS);
+		if (session.pending.empty())
+			return;
+
+		// acknowledgement of the page command in the stop-and-wait protocol
+		if (session.waitingCommandAck)
+		{
+			session.waitingCommandAck = false;
+			if (!success)
+			{
+				fail(session, FormatableString("Error while writing page %0").arg(session.pending.front()));
+				return;
+			}
+			sendPageData(session, session.pending.front());
+			session.report.stream->flush();
+			return;
+		}
+
+		// acknowledgement of a page, which in pipelined protocol might not be the oldest one
+		unsigned pageNumber(session.pending.front());
+		if (session.report.pipelined)
+		{
+			pageNumber = ack.errorAddress;
+			const auto pendingIt(find(session.pending.begin(), session.pending.end(), pageNumber));
+			if (pendingIt == session.pending.end())
+			{
+				fail(session, FormatableString("Unexpected acknowledgement for page %0").arg(pageNumber));
+				return;
+			}
+			session.pending.erase(pendingIt);
+		}
+		else
+			session.pending.pop_front();
+		if (success)
+			session.report.pagesWritten += 1;
+		else if (simple)
+			session.report.pagesFailed += 1;
+		else if (session.report.pipelined && session.attempts[pageNumber] < PAGE_ATTEMPTS_COUNT)
+			session.retries.push_back(pageNumber);
+		else
+		{
+			fail(session, FormatableString("Error while writing page %0").arg(pageNumber));
+			return;
+		}
+		notify(session);
+
+		if (session.nextPage == session.pages.size() && session.retries.empty() && session.pending.empty())
+			finish(session);
+		else
+			sendPages(session);
+	}
+
+	void MultiBootloaderInterface::finish(Session& session)
+	{
+		if (reset)
+		{
+			BootloaderReset message(session.report.bootloaderDest);
+			message.serialize(session.report.stream);
+			session.report.stream->flush();
+		}
+		session.report.status = Status::DONE;
+		notify(session);
+	}
+
+	void MultiBootloaderInterface::fail(Session& session, const string& error)
+	{
+		session.report.status = Status::FAILED;
+		session.report.error = error;
+		notify(session);
+	}
+
+	void MultiBootloaderInterface::notify(Session& session)
+	{
+		session.report.duration = (UnifiedTime() - session.start).value;
+		nodeProgress(session.report);
+	}
+
+	//! Return the content of the hex file split in pages of pageSize bytes, splitting it if not done yet
+	const BootloaderInterface::PageMap& MultiBootloaderInterface::pages(unsigned pageSize)
+	{
+		auto it(pagesBySize.find(pageSize));
+		if (it == pagesBySize.end())
+			it = pagesBySize.emplace(pageSize, BootloaderInterface::pagesFromHex(hexFile, pageSize)).first;
+		return it->second;
+	}
+
+} // namespace Aseba
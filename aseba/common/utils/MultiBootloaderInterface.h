@@ -0,0 +1,160 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_MULTI_BOOTLOADER_INTERFACE_H
+#define ASEBA_MULTI_BOOTLOADER_INTERFACE_H
+
+#include <dashel/dashel.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "BootloaderInterface.h"
+#include "HexFile.h"
+#include "utils.h"
+
+namespace Aseba
+{
+	class Message;
+
+	//! Write the same hex file to many nodes at the same time
+	/**
+		Each node is driven by its own state machine, following the same
+		protocols as BootloaderInterface: complete, pipelined if the
+		bootloader supports it, or simple. Messages are dispatched to nodes
+		by stream and source, so several nodes can share a stream when using
+		the complete protocol, for instance behind a switch. The simple
+		protocol requires one stream per node.
+
+		In differential mode, each node first compares the pages with its
+		flash, using page checksums if its bootloader announces them or by
+		reading pages back, and only writes the ones that changed, and page 0.
+		This mode is not available with the simple protocol.
+
+		Targets are connected through this hub, then flash() runs until all
+		nodes are done, failed, or stopped answering for longer than timeout.
+	*/
+	class MultiBootloaderInterface: public Dashel::Hub
+	{
+	public:
+		//! State of the flashing of one node
+		enum class Status
+		{
+			ENTERING_BOOTLOADER, //!< waiting for the bootloader to start
+			COMPARING, //!< in differential mode, comparing pages with the content of the device
+			WRITING, //!< writing pages
+			DONE, //!< all pages written
+			FAILED //!< gave up, see Report::error
+		};
+
+		//! Progress of the flashing of one node
+		struct Report
+		{
+			Dashel::Stream* stream;
+			unsigned dest;
+			unsigned bootloaderDest;
+			Status status = Status::ENTERING_BOOTLOADER;
+			unsigned pagesCount = 0; //!< number of pages to write
+			unsigned pagesUnchanged = 0; //!< number of pages not written in differential mode, as the device already has them
+			unsigned pagesWritten = 0; //!< number of pages acknowledged successfully
+			unsigned pagesFailed = 0; //!< number of pages that failed with the simple protocol, which ignores such errors
+			bool pipelined = false; //!< whether the pipelined protocol is used
+			std::string error; //!< reason of failure
+			UnifiedTime::Value duration = 0; //!< time since start, in ms
+		};
+
+	public:
+		//! Prepare to write hexFileName, resetting nodes into and out of bootloader if reset is true, using the simple protocol if simple is true
+		MultiBootloaderInterface(const std::string& hexFileName, bool reset, bool simple);
+
+		//! Add a node to flash, reachable through stream, with bootloaderDest its id within bootloader
+		void addTarget(Dashel::Stream* stream, unsigned dest, unsigned bootloaderDest);
+		//! Add a node to flash, reachable through stream, with the same id within bootloader
+		void addTarget(Dashel::Stream* stream, unsigned dest) { addTarget(stream, dest, dest); }
+
+		//! If true, only write pages that differ from the content of the devices; disabled by default, throws with the simple protocol
+		void setDifferential(bool enabled);
+
+		//! Flash all targets, giving up on a node after timeout ms without answer; return whether all nodes succeeded
+		bool flash(unsigned timeout = 5000);
+
+		//! Return the progress of all nodes, in the order they were added
+		std::vector<Report> getReports() const;
+
+	protected:
+		// reporting function
+
+		//! Called whenever the progress of a node changed
+		virtual void nodeProgress(const Report& report) {}
+
+	protected:
+		// from Dashel::Hub
+		void incomingData(Dashel::Stream *stream) override;
+		void connectionClosed(Dashel::Stream *stream, bool abnormal) override;
+
+	protected:
+		//! Flashing state of one node
+		struct Session
+		{
+			Report report;
+			unsigned pageSize = 0;
+			unsigned pagesStart = 0;
+			unsigned pagesCount = 0;
+			unsigned frameSize = 0; //!< bytes per data frame in pipelined protocol
+			unsigned windowSize = 1; //!< maximum number of pages being written at the same time
+			bool checksums = false; //!< whether the bootloader answers BootloaderGetPageChecksums
+			std::vector<unsigned> pages; //!< pages to write, in order
+			size_t nextPage = 0; //!< index in pages of the next page to send
+			std::deque<unsigned> pending; //!< pages sent but not acknowledged, oldest first
+			std::deque<unsigned> retries; //!< pages that failed in pipelined protocol, to send again before the next ones
+			std::map<unsigned, unsigned> attempts; //!< number of times pages were sent in pipelined protocol
+			bool waitingCommandAck = false; //!< stop-and-wait complete protocol, waiting for the acknowledgement of the page command
+			size_t nextCompared = 0; //!< in differential mode, index in pages of the next page to compare
+			unsigned checksumsEnd = 0; //!< in differential mode, page after the last one whose checksum was requested
+			std::vector<uint8_t> readBack; //!< in differential mode without checksums, content of the page being read
+			std::vector<unsigned> unchanged; //!< in differential mode, pages found identical on the device
+			UnifiedTime start;
+			UnifiedTime lastActivity;
+		};
+
+		void startSessions();
+		bool updateSessions(unsigned timeout);
+		void selectPages(Session& session);
+		void compareNextPages(Session& session);
+		void processComparison(Session& session, const Message& message);
+		void startWriting(Session& session);
+		void sendPages(Session& session);
+		void sendPageData(Session& session, unsigned pageNumber);
+		void processAck(Session& session, const Message& message);
+		void finish(Session& session);
+		void fail(Session& session, const std::string& error);
+		void notify(Session& session);
+		const BootloaderInterface::PageMap& pages(unsigned pageSize);
+
+	protected:
+		HexFile hexFile;
+		const bool reset;
+		const bool simple;
+		bool differential = false;
+		std::vector<Session> sessions;
+		std::map<unsigned, BootloaderInterface::PageMap> pagesBySize; //!< content of the hex file split in pages, by page size
+	};
+} // namespace Aseba
+
+#endif // ASEBA_MULTI_BOOTLOADER_INTERFACE_H
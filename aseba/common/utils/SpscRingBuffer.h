@@ -0,0 +1,108 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_SPSC_RING_BUFFER_H
+#define ASEBA_SPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Aseba
+{
+	/** \addtogroup utils */
+	/*@{*/
+
+	//! Fixed-size queue passing values from one producer thread to one consumer thread without locks
+	/**
+		The producer only writes the tail and the consumer only writes the head, so that
+		neither ever waits for the other. When the queue is full, push() fails and the producer
+		decides what to do with the value. Values stay in their slot once popped, and are
+		overwritten by later pushes, so that their memory can be reused.
+	*/
+	template<typename T>
+	class SpscRingBuffer
+	{
+	public:
+		//! Create a buffer holding up to capacity values, rounded up to a power of two
+		explicit SpscRingBuffer(size_t capacity):
+			slots(roundUpToPowerOfTwo(capacity)),
+			mask(slots.size() - 1)
+		{}
+
+		SpscRingBuffer(const SpscRingBuffer&) = delete;
+		SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+		//! Return the maximum number of values in the buffer
+		size_t capacity() const { return slots.size(); }
+
+		//! Add value, from the producer thread; return false if the buffer is full
+		bool push(T&& value)
+		{
+			const size_t currentTail(tail.load(std::memory_order_relaxed));
+			if (currentTail - head.load(std::memory_order_acquire) == slots.size())
+				return false;
+			slots[currentTail & mask] = std::move(value);
+			tail.store(currentTail + 1, std::memory_order_release);
+			return true;
+		}
+
+		//! Move up to maxCount values to output, from the consumer thread; return the number of values moved
+		template<typename OutputIt>
+		size_t pop(OutputIt output, size_t maxCount)
+		{
+			const size_t currentHead(head.load(std::memory_order_relaxed));
+			const size_t available(tail.load(std::memory_order_acquire) - currentHead);
+			const size_t count(available < maxCount ? available : maxCount);
+			for (size_t i = 0; i < count; ++i)
+				*output++ = std::move(slots[(currentHead + i) & mask]);
+			head.store(currentHead + count, std::memory_order_release);
+			return count;
+		}
+
+		//! Return the number of values in the buffer; exact only when called from the producer or the consumer while the other is idle
+		size_t size() const
+		{
+			return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		}
+
+	protected:
+		static size_t roundUpToPowerOfTwo(size_t value)
+		{
+			assert(value > 0);
+			size_t power(1);
+			while (power < value)
+				power <<= 1;
+			return power;
+		}
+
+	protected:
+		std::vector<T> slots;
+		const size_t mask;
+		// head and tail only grow, their difference being the number of values; on separate cache lines to avoid false sharing
+		alignas(64) std::atomic<size_t> head{0}; //!< index of the next value to pop, written by the consumer
+		alignas(64) std::atomic<size_t> tail{0}; //!< index of the next value to push, written by the producer
+	};
+
+	/*@}*/
+} // namespace Aseba
+
+#endif // ASEBA_SPSC_RING_BUFFER_H
@@ -334,6 +334,23 @@ namespace Aseba
 		return crc_xmodem_update(oldCrc, reinterpret_cast<const uint8_t*>(&v), 2);
 	}
 
+	uint16_t crcXModem(const uint16_t oldCrc, const uint8_t* data, size_t size)
+	{
+		return crc_xmodem_update(oldCrc, data, size);
+	}
+
+	uint32_t crc32Ieee(const uint32_t oldCrc, const uint8_t* data, size_t size)
+	{
+		uint32_t crc = ~oldCrc;
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc ^= data[i];
+			for (int bit = 0; bit < 8; ++bit)
+				crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+		return ~crc;
+	}
+
 	template<typename T>
 	std::vector<T> split(const T& s, const T& delim)
 	{
@@ -185,6 +185,12 @@ namespace Aseba
 	//! Update the XModem CRC (x^16 + x^12 + x^5 + 1 (0x1021)) with a uint16_t value
 	uint16_t crcXModem(const uint16_t oldCrc, const uint16_t v);
 
+	//! Update the XModem CRC (x^16 + x^12 + x^5 + 1 (0x1021)) with a block of bytes
+	uint16_t crcXModem(const uint16_t oldCrc, const uint8_t* data, size_t size);
+
+	//! Update the CRC-32 of IEEE 802.3 (reflected 0xEDB88320, as in zlib) with a block of bytes, start from 0
+	uint32_t crc32Ieee(const uint32_t oldCrc, const uint8_t* data, size_t size);
+
 	//! Split a string using given delimiters
 	template<typename T>
 	std::vector<T> split(const T& s, const T& delim);
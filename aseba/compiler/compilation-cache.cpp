@@ -0,0 +1,423 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "compilation-cache.h"
+#include "common/consts.h"
+#include "common/utils/utils.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace Aseba
+{
+	/** \addtogroup compiler */
+	/*@{*/
+
+	namespace
+	{
+		//! Version of the on-disk format, bump when changing the layout
+		const uint16_t storeFormatVersion = 2;
+
+		//! Incremental 64-bit FNV-1a hash
+		struct Hasher
+		{
+			uint64_t value = 0xcbf29ce484222325ULL;
+
+			void add(uint32_t v)
+			{
+				for (unsigned i = 0; i < 4; ++i)
+				{
+					value ^= (v >> (8 * i)) & 0xff;
+					value *= 0x100000001b3ULL;
+				}
+			}
+			void add(int v) { add(uint32_t(v)); }
+			void add(const std::string& s)
+			{
+				add(uint32_t(s.size()));
+				for (const auto c: s)
+					add(uint32_t(uint8_t(c)));
+			}
+			void add(const std::wstring& s)
+			{
+				add(uint32_t(s.size()));
+				for (const auto c: s)
+					add(uint32_t(c));
+			}
+		};
+
+		void write16(std::ostream& stream, uint16_t v)
+		{
+			const char bytes[2] = { char(v & 0xff), char(v >> 8) };
+			stream.write(bytes, 2);
+		}
+
+		void write32(std::ostream& stream, uint32_t v)
+		{
+			write16(stream, uint16_t(v & 0xffff));
+			write16(stream, uint16_t(v >> 16));
+		}
+
+		void write64(std::ostream& stream, uint64_t v)
+		{
+			write32(stream, uint32_t(v & 0xffffffff));
+			write32(stream, uint32_t(v >> 32));
+		}
+
+		void writeUTF8String(std::ostream& stream, const std::string& utf8)
+		{
+			write32(stream, utf8.size());
+			stream.write(utf8.data(), utf8.size());
+		}
+
+		void writeString(std::ostream& stream, const std::wstring& s)
+		{
+			writeUTF8String(stream, WStringToUTF8(s));
+		}
+
+		uint16_t read16(std::istream& stream)
+		{
+			unsigned char bytes[2] = { 0, 0 };
+			stream.read(reinterpret_cast<char*>(bytes), 2);
+			return uint16_t(bytes[0] | (bytes[1] << 8));
+		}
+
+		uint32_t read32(std::istream& stream)
+		{
+			const uint32_t low(read16(stream));
+			const uint32_t high(read16(stream));
+			return low | (high << 16);
+		}
+
+		uint64_t read64(std::istream& stream)
+		{
+			const uint64_t low(read32(stream));
+			const uint64_t high(read32(stream));
+			return low | (high << 32);
+		}
+
+		std::string readUTF8String(std::istream& stream)
+		{
+			const uint32_t size(read32(stream));
+			if (!stream || size > 0xffff)
+			{
+				stream.setstate(std::ios::failbit);
+				return std::string();
+			}
+			std::string utf8(size, '\0');
+			stream.read(&utf8[0], size);
+			return utf8;
+		}
+
+		std::wstring readString(std::istream& stream)
+		{
+			return UTF8ToWString(readUTF8String(stream));
+		}
+	}
+
+	//! Create a cache holding at most capacity entries in memory; if storeDirectory is not empty, entries are also stored there.
+	//! Stored entries are only loaded if they were produced by a compiler of the same compilerVersion.
+	CompilationCache::CompilationCache(size_t capacity, std::string storeDirectory, std::string compilerVersion):
+		capacity(capacity),
+		storeDirectory(std::move(storeDirectory)),
+		compilerVersion(std::move(compilerVersion))
+	{}
+
+	//! Return the version and revision of this compiler, as the code it generates may change between them
+	std::string CompilationCache::currentCompilerVersion()
+	{
+		return std::string(ASEBA_VERSION) + "-" + ASEBA_REVISION;
+	}
+
+	//! Compute the key of a compilation, covering all inputs that influence its result
+	CompilationCache::Key CompilationCache::key(const std::wstring& source, const TargetDescription& targetDescription, const CommonDefinitions& commonDefinitions)
+	{
+		Hasher hasher;
+		hasher.add(uint32_t(storeFormatVersion));
+		hasher.add(currentCompilerVersion());
+
+		// target description, note that documentation strings do not influence the result
+		hasher.add(targetDescription.name);
+		hasher.add(targetDescription.protocolVersion);
+		hasher.add(targetDescription.bytecodeSize);
+		hasher.add(targetDescription.variablesSize);
+		hasher.add(targetDescription.stackSize);
+		hasher.add(uint32_t(targetDescription.namedVariables.size()));
+		for (const auto& variable: targetDescription.namedVariables)
+		{
+			hasher.add(variable.name);
+			hasher.add(variable.size);
+		}
+		hasher.add(uint32_t(targetDescription.localEvents.size()));
+		for (const auto& event: targetDescription.localEvents)
+			hasher.add(event.name);
+		hasher.add(uint32_t(targetDescription.nativeFunctions.size()));
+		for (const auto& function: targetDescription.nativeFunctions)
+		{
+			hasher.add(function.name);
+			hasher.add(uint32_t(function.parameters.size()));
+			for (const auto& parameter: function.parameters)
+			{
+				hasher.add(parameter.name);
+				hasher.add(parameter.size);
+			}
+		}
+
+		// common definitions
+		hasher.add(uint32_t(commonDefinitions.events.size()));
+		for (const auto& event: commonDefinitions.events)
+		{
+			hasher.add(event.name);
+			hasher.add(event.value);
+		}
+		hasher.add(uint32_t(commonDefinitions.constants.size()));
+		for (const auto& constant: commonDefinitions.constants)
+		{
+			hasher.add(constant.name);
+			hasher.add(constant.value);
+		}
+
+		// source
+		hasher.add(source);
+
+		return hasher.value;
+	}
+
+	//! Look for key, first in memory and then on disk; return true and fill entry if found
+	bool CompilationCache::lookup(Key key, Entry& entry)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it(entries.find(key));
+		if (it != entries.end())
+		{
+			recency.splice(recency.begin(), recency, it->second.second);
+			entry = it->second.first;
+			++hitCount;
+			return true;
+		}
+
+		if (load(key, entry))
+		{
+			insertInMemory(key, entry);
+			++hitCount;
+			return true;
+		}
+
+		++missCount;
+		return false;
+	}
+
+	//! Insert the result of a successful compilation, in memory and on disk if enabled
+	void CompilationCache::insert(Key key, const Entry& entry)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		insertInMemory(key, entry);
+		store(key, entry);
+	}
+
+	//! Remove all entries from memory, the on-disk store is left untouched
+	void CompilationCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		recency.clear();
+	}
+
+	//! Return the number of entries kept in memory
+	size_t CompilationCache::size() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+
+	//! Return the number of successful lookups since creation
+	unsigned CompilationCache::hits() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return hitCount;
+	}
+
+	//! Return the number of failed lookups since creation
+	unsigned CompilationCache::misses() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return missCount;
+	}
+
+	//! Insert or refresh an entry in memory, evicting the least recently used one if full; mutex must be held
+	void CompilationCache::insertInMemory(Key key, const Entry& entry)
+	{
+		if (capacity == 0)
+			return;
+
+		auto it(entries.find(key));
+		if (it != entries.end())
+		{
+			it->second.first = entry;
+			recency.splice(recency.begin(), recency, it->second.second);
+			return;
+		}
+
+		if (entries.size() >= capacity)
+		{
+			entries.erase(recency.back());
+			recency.pop_back();
+		}
+		recency.push_front(key);
+		entries.emplace(key, std::make_pair(entry, recency.begin()));
+	}
+
+	//! Return the name of the file storing the entry for key
+	std::string CompilationCache::entryFileName(Key key) const
+	{
+		std::ostringstream oss;
+		oss << storeDirectory << '/' << std::hex << std::setw(16) << std::setfill('0') << key << ".aesc";
+		return oss.str();
+	}
+
+	//! Load an entry from the on-disk store, return false if not present or invalid
+	bool CompilationCache::load(Key key, Entry& entry) const
+	{
+		if (storeDirectory.empty())
+			return false;
+
+		std::ifstream file(entryFileName(key), std::ios::in | std::ios::binary);
+		if (!file)
+			return false;
+
+		char magic[4];
+		file.read(magic, 4);
+		if (!file || std::string(magic, 4) != "AESC")
+			return false;
+		if (read16(file) != storeFormatVersion || read64(file) != key)
+			return false;
+		if (readUTF8String(file) != compilerVersion || !file)
+			return false;
+
+		Entry loaded;
+		loaded.bytecode.maxStackDepth = read32(file);
+		loaded.bytecode.callDepth = read32(file);
+		const uint32_t bytecodeSize(read32(file));
+		if (!file || bytecodeSize > 0xffff)
+			return false;
+		for (uint32_t i = 0; i < bytecodeSize; ++i)
+		{
+			const uint16_t bytecode(read16(file));
+			const uint16_t line(read16(file));
+			loaded.bytecode.push_back(BytecodeElement(bytecode, line));
+		}
+		loaded.bytecode.lastLine = read32(file);
+		loaded.allocatedVariablesCount = read32(file);
+
+		const uint32_t variablesCount(read32(file));
+		if (!file || variablesCount > 0xffff)
+			return false;
+		for (uint32_t i = 0; i < variablesCount; ++i)
+		{
+			const std::wstring name(readString(file));
+			const unsigned pos(read32(file));
+			const unsigned size(read32(file));
+			loaded.variablesMap[name] = std::make_pair(pos, size);
+		}
+
+		const uint32_t subroutinesCount(read32(file));
+		if (!file || subroutinesCount > 0xffff)
+			return false;
+		for (uint32_t i = 0; i < subroutinesCount; ++i)
+		{
+			const std::wstring name(readString(file));
+			const unsigned address(read32(file));
+			const unsigned line(read32(file));
+			loaded.subroutineTable.emplace_back(name, address, line);
+		}
+
+		if (!file)
+			return false;
+
+		entry = std::move(loaded);
+		return true;
+	}
+
+	//! Store an entry in the on-disk store, if enabled; failures are silently ignored as the store is only an optimisation
+	void CompilationCache::store(Key key, const Entry& entry) const
+	{
+		if (storeDirectory.empty())
+			return;
+
+		// write to a temporary file and rename it, so that concurrent readers never see partial entries
+		const std::string fileName(entryFileName(key));
+		const std::string tempFileName(fileName + ".tmp");
+		{
+			std::ofstream file(tempFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file)
+				return;
+
+			file.write("AESC", 4);
+			write16(file, storeFormatVersion);
+			write64(file, key);
+			writeUTF8String(file, compilerVersion);
+
+			write32(file, entry.bytecode.maxStackDepth);
+			write32(file, entry.bytecode.callDepth);
+			write32(file, entry.bytecode.size());
+			for (const auto& element: entry.bytecode)
+			{
+				write16(file, element.bytecode);
+				write16(file, element.line);
+			}
+			write32(file, entry.bytecode.lastLine);
+			write32(file, entry.allocatedVariablesCount);
+
+			write32(file, entry.variablesMap.size());
+			for (const auto& variable: entry.variablesMap)
+			{
+				writeString(file, variable.first);
+				write32(file, variable.second.first);
+				write32(file, variable.second.second);
+			}
+
+			write32(file, entry.subroutineTable.size());
+			for (const auto& subroutine: entry.subroutineTable)
+			{
+				writeString(file, subroutine.name);
+				write32(file, subroutine.address);
+				write32(file, subroutine.line);
+			}
+
+			if (!file)
+			{
+				file.close();
+				std::remove(tempFileName.c_str());
+				return;
+			}
+		}
+		if (std::rename(tempFileName.c_str(), fileName.c_str()) != 0)
+		{
+			// some platforms refuse to rename over an existing file
+			std::remove(fileName.c_str());
+			if (std::rename(tempFileName.c_str(), fileName.c_str()) != 0)
+				std::remove(tempFileName.c_str());
+		}
+	}
+
+	/*@}*/
+
+} // namespace Aseba
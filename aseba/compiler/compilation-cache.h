@@ -0,0 +1,94 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ASEBA_COMPILATION_CACHE_H
+#define __ASEBA_COMPILATION_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "compiler.h"
+
+namespace Aseba
+{
+	/** \addtogroup compiler */
+	/*@{*/
+
+	//! Cache of successful compilations, keyed by a hash of the source, the target description, the common definitions and the compiler version.
+	//! The cache is always kept in memory, and can optionally be backed by a directory on disk so that
+	//! results survive across program runs. All methods are thread-safe.
+	class CompilationCache
+	{
+	public:
+		//! Key of an entry, a 64-bit FNV-1a hash of everything that influences the compilation result
+		using Key = uint64_t;
+
+		//! The result of a successful compilation
+		struct Entry
+		{
+			BytecodeVector bytecode; //!< linked bytecode
+			unsigned allocatedVariablesCount{0}; //!< amount of allocated variables
+			VariablesMap variablesMap; //!< variables lookup, including user-defined ones
+			Compiler::SubroutineTable subroutineTable; //!< subroutines lookup
+		};
+
+	public:
+		CompilationCache(size_t capacity = 256, std::string storeDirectory = "", std::string compilerVersion = currentCompilerVersion());
+
+		static std::string currentCompilerVersion();
+		static Key key(const std::wstring& source, const TargetDescription& targetDescription, const CommonDefinitions& commonDefinitions);
+
+		bool lookup(Key key, Entry& entry);
+		void insert(Key key, const Entry& entry);
+		void clear();
+
+		size_t size() const;
+		unsigned hits() const;
+		unsigned misses() const;
+
+	protected:
+		std::string entryFileName(Key key) const;
+		bool load(Key key, Entry& entry) const;
+		void store(Key key, const Entry& entry) const;
+		void insertInMemory(Key key, const Entry& entry);
+
+	protected:
+		//! List of keys, most recently used first
+		using Recency = std::list<Key>;
+		//! In-memory storage of the entries and their position in the recency list
+		using Entries = std::unordered_map<Key, std::pair<Entry, Recency::iterator> >;
+
+		const size_t capacity; //!< maximum number of entries kept in memory
+		const std::string storeDirectory; //!< directory of the on-disk store, disabled if empty
+		const std::string compilerVersion; //!< version of the compiler, written in and checked against stored entries
+		mutable std::mutex mutex; //!< protects all the fields below
+		Entries entries; //!< entries in memory
+		Recency recency; //!< keys, most recently used first
+		unsigned hitCount{0}; //!< number of successful lookups
+		unsigned missCount{0}; //!< number of failed lookups
+	};
+
+	/*@}*/
+
+} // namespace Aseba
+
+#endif
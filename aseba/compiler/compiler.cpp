@@ -18,6 +18,7 @@
 */
 
 #include "compiler.h"
+#include "compilation-cache.h"
 #include "tree.h"
 #include "errors_code.h"
 #include "common/consts.h"
@@ -32,6 +33,7 @@
 #include <memory>
 #include <limits>
 #include <iterator>
+#include <algorithm>
 
 namespace Aseba
 {
@@ -64,9 +66,10 @@ namespace Aseba
 	{
 		targetDescription = nullptr;
 		commonDefinitions = nullptr;
+		compilationCache = nullptr;
+		translateCB = nullptr;
 		freeVariableIndex = 0;
 		endVariableIndex = 0;
-		TranslatableError::setTranslateCB(ErrorMessages::defaultCallback);
 	}
 
 	//! Set the description of the target as returned by the microcontroller. You must call this function before any call to compile().
@@ -81,6 +84,12 @@ namespace Aseba
 		commonDefinitions = definitions;
 	}
 
+	//! Set a cache of compilation results, shared between compilers; nullptr disables caching
+	void Compiler::setCompilationCache(CompilationCache *cache)
+	{
+		compilationCache = cache;
+	}
+
 	//! Compile a new condition
 	//! \param source stream to read the source code from
 	//! \param bytecode destination array for bytecode
@@ -90,9 +99,58 @@ namespace Aseba
 	//! \return returns true on success 
 	bool Compiler::compile(std::wistream& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump)
 	{
+		if (compilationCache && !dump)
+		{
+			const std::wstring sourceString((std::istreambuf_iterator<wchar_t>(source)), std::istreambuf_iterator<wchar_t>());
+			return compile(sourceString, bytecode, allocatedVariablesCount, errorDescription, dump);
+		}
+		return compileUncached(source, bytecode, allocatedVariablesCount, errorDescription, dump);
+	}
+
+	//! Compile a new condition from a string, using the compilation cache if set and no dump is requested
+	bool Compiler::compile(const std::wstring& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump)
+	{
+		if (!compilationCache || dump)
+		{
+			std::wistringstream is(source);
+			return compileUncached(is, bytecode, allocatedVariablesCount, errorDescription, dump);
+		}
+
 		assert(targetDescription);
 		assert(commonDefinitions);
 
+		const CompilationCache::Key key(CompilationCache::key(source, *targetDescription, *commonDefinitions));
+		CompilationCache::Entry entry;
+		if (compilationCache->lookup(key, entry))
+		{
+			bytecode = std::move(entry.bytecode);
+			allocatedVariablesCount = entry.allocatedVariablesCount;
+			variablesMap = std::move(entry.variablesMap);
+			subroutineTable = std::move(entry.subroutineTable);
+			return true;
+		}
+
+		std::wistringstream is(source);
+		if (!compileUncached(is, bytecode, allocatedVariablesCount, errorDescription, dump))
+			return false;
+
+		entry.bytecode = bytecode;
+		entry.allocatedVariablesCount = allocatedVariablesCount;
+		entry.variablesMap = variablesMap;
+		entry.subroutineTable = subroutineTable;
+		compilationCache->insert(key, entry);
+		return true;
+	}
+
+	//! Compile a new condition, without looking into the compilation cache
+	bool Compiler::compileUncached(std::wistream& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump)
+	{
+		assert(targetDescription);
+		assert(commonDefinitions);
+
+		// errors are translated per thread, so that several compilers can run concurrently with different languages
+		const TranslatableError::ScopedTranslateCB scopedTranslateCB(translateCB);
+
 		unsigned indent = 0;
 
 		// we need to build maps at each compilation in case previous ones produced errors and messed maps up
@@ -326,6 +384,14 @@ namespace Aseba
 			pc += element.getWordSize();
 		}
 
+		// keep the deepest stack use of any event or subroutine, as computed by verifyStackCalls()
+		bytecode.maxStackDepth = 0;
+		bytecode.callDepth = 0;
+		for (const auto & event : preLinkBytecode.events)
+			bytecode.maxStackDepth = std::max(bytecode.maxStackDepth, event.second.maxStackDepth);
+		for (const auto & subroutine : preLinkBytecode.subroutines)
+			bytecode.maxStackDepth = std::max(bytecode.maxStackDepth, subroutine.second.callDepth + subroutine.second.maxStackDepth);
+
 		// check size
 		return bytecode.size() <= targetDescription->bytecodeSize;
 	}
@@ -49,6 +49,7 @@ namespace Aseba
 	struct AssignmentNode;
 	struct TupleVectorNode;
 	struct MemoryVectorNode;
+	class CompilationCache;
 
 	//! A bytecode element 
 	struct BytecodeElement
@@ -140,8 +141,19 @@ namespace Aseba
 
 		Error toError();
 		static void setTranslateCB(ErrorMessages::ErrorCallback newCB);
+		static std::wstring translate(ErrorCode error);
+
+		//! While alive, makes the current thread translate errors using a specific callback, nullptr meaning the process-wide one
+		struct ScopedTranslateCB
+		{
+			ScopedTranslateCB(ErrorMessages::ErrorCallback cb);
+			~ScopedTranslateCB();
+			ScopedTranslateCB(const ScopedTranslateCB&) = delete;
+			ScopedTranslateCB& operator=(const ScopedTranslateCB&) = delete;
+
+			const ErrorMessages::ErrorCallback previous; //!< callback of the enclosing scope, restored on destruction
+		};
 
-		static ErrorMessages::ErrorCallback translateCB;
 		WFormatableString message;
 	};
 
@@ -307,9 +319,11 @@ namespace Aseba
 		const VariablesMap *getVariablesMap() const { return &variablesMap; }
 		const SubroutineTable *getSubroutineTable() const { return &subroutineTable; }
 		void setCommonDefinitions(const CommonDefinitions *definitions);
+		void setCompilationCache(CompilationCache *cache);
 		bool compile(std::wistream& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump = nullptr);
-		void setTranslateCallback(ErrorMessages::ErrorCallback newCB) { TranslatableError::setTranslateCB(newCB); }
-		static std::wstring translate(ErrorCode error) { return TranslatableError::translateCB(error); }
+		bool compile(const std::wstring& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump = nullptr);
+		void setTranslateCallback(ErrorMessages::ErrorCallback newCB) { translateCB = newCB; }
+		static std::wstring translate(ErrorCode error) { return TranslatableError::translate(error); }
 		static bool isKeyword(const std::wstring& word);
 
 	protected:
@@ -347,6 +361,7 @@ namespace Aseba
 		void tokenize(std::wistream& source);
 		wchar_t getNextCharacter(std::wistream& source, SourcePos& pos);
 		bool testNextCharacter(std::wistream& source, SourcePos& pos, wchar_t test, Token::Type tokenIfTrue);
+		bool compileUncached(std::wistream& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump);
 		void dumpTokens(std::wostream &dest) const;
 		bool verifyStackCalls(PreLinkBytecode& preLinkBytecode);
 		bool link(const PreLinkBytecode& preLinkBytecode, BytecodeVector& bytecode);
@@ -409,6 +424,8 @@ namespace Aseba
 		unsigned endVariableIndex; //!< (endMemory - endVariableIndex) is pointing to the first free variable at the end
 		const TargetDescription *targetDescription; //!< description of the target VM
 		const CommonDefinitions *commonDefinitions; //!< common definitions, such as events or some constants
+		CompilationCache *compilationCache; //!< if not null, cache of previous compilation results
+		ErrorMessages::ErrorCallback translateCB; //!< if not null, translation of error messages for this compiler
 
 		ErrorMessages translator;
 	}; // Compiler
@@ -19,6 +19,8 @@
 
 #include "errors_code.h"
 #include "compiler.h"
+#include <atomic>
+#include <mutex>
 #include <sstream>
 #include <string>
 
@@ -28,8 +30,16 @@ namespace Aseba
 	/*@{*/
 
 	static const wchar_t* error_map[ERROR_END];
+	static std::once_flag error_map_filled;
+
+	static void fillErrorMap();
 
 	ErrorMessages::ErrorMessages()
+	{
+		std::call_once(error_map_filled, fillErrorMap);
+	}
+
+	static void fillErrorMap()
 	{
 		// compiler.cpp
 		error_map[ERROR_BROKEN_TARGET] =			L"Broken target description: not enough room for internal variables";
@@ -185,6 +195,7 @@ namespace Aseba
 
 	const std::wstring ErrorMessages::defaultCallback(ErrorCode error)
 	{
+		std::call_once(error_map_filled, fillErrorMap);
 		if (error >= ERROR_END)
 			return std::wstring(error_map[ERROR_UNKNOWN_ERROR]);
 		else
@@ -202,12 +213,15 @@ namespace Aseba
 		return oss.str();
 	}
 
-	ErrorMessages::ErrorCallback TranslatableError::translateCB = nullptr;
+	//! Translation callback used by threads that did not set their own, nullptr meaning ErrorMessages::defaultCallback
+	static std::atomic<ErrorMessages::ErrorCallback> processTranslateCB(nullptr);
+	//! Translation callback of the current thread, nullptr meaning processTranslateCB
+	static thread_local ErrorMessages::ErrorCallback threadTranslateCB(nullptr);
 
 	TranslatableError::TranslatableError(const SourcePos& pos, ErrorCode error)
 	{
 		this->pos = pos;
-		message = translateCB(error);
+		message = translate(error);
 	}
 
 	Error TranslatableError::toError()
@@ -215,9 +229,32 @@ namespace Aseba
 		return Error(pos, message);
 	}
 
+	//! Set the process-wide translation callback, used by threads not within a ScopedTranslateCB
 	void TranslatableError::setTranslateCB(ErrorMessages::ErrorCallback newCB)
 	{
-		translateCB = newCB;
+		processTranslateCB = newCB;
+	}
+
+	//! Translate an error code using the callback of the current thread
+	std::wstring TranslatableError::translate(ErrorCode error)
+	{
+		ErrorMessages::ErrorCallback cb(threadTranslateCB);
+		if (!cb)
+			cb = processTranslateCB;
+		if (!cb)
+			cb = ErrorMessages::defaultCallback;
+		return cb(error);
+	}
+
+	TranslatableError::ScopedTranslateCB::ScopedTranslateCB(ErrorMessages::ErrorCallback cb):
+		previous(threadTranslateCB)
+	{
+		threadTranslateCB = cb;
+	}
+
+	TranslatableError::ScopedTranslateCB::~ScopedTranslateCB()
+	{
+		threadTranslateCB = previous;
 	}
 
 	TranslatableError &TranslatableError::arg(int value, int fieldWidth, int base, wchar_t fillChar)
@@ -530,8 +530,9 @@ namespace Aseba
             asebaStreams[stream].insert(message->source);
         }
 
-        // if variables, check for pending requests
-        const Variables *variables(dynamic_cast<Variables *>(message));
+        // if variables, check for pending requests; if changed variables, rebuild those that did not change
+        const std::unique_ptr<Variables> changedVariables(variablesMirror.processMessage(message));
+        const Variables *variables(changedVariables ? changedVariables.get() : dynamic_cast<Variables *>(message));
         if (variables)
             incomingVariables(variables);
 
@@ -1059,14 +1060,14 @@ namespace Aseba
             if (!exists)
                 continue;
 
-            VariablesMap vm = allVariables[nodeId];
-            const unsigned length(vm[UTF8ToWString(*it)].second);
+            const VariablesIndex& variablesIndex(allVariablesIndex[nodeId]);
+            const VariablesIndex::const_iterator varIt(variablesIndex.find(*it));
+            const unsigned length(varIt != variablesIndex.end() ? varIt->second.second : getVariableSize(nodeId, *it));
 
             if (verbose)
                 cerr << " (" << nodeId << "," << varPos << "):" << length << "\n";
             // send the message
-            GetVariables getVariables(nodeId, varPos, length);
-            getVariables.serialize(stream);
+            variablesMirror.getVariablesRequest(nodeId, varPos, length)->serialize(stream);
         }
         stream->flush();
         return std::pair<unsigned,unsigned>(nodeId,varPos); // just last one
@@ -1109,12 +1110,12 @@ namespace Aseba
         pos = unsigned(-1);
 
         // check whether variable is known from a compilation, if so, get position
-        const NodeIdVariablesMap::const_iterator allVarMapIt(allVariables.find(nodeId));
-        if (allVarMapIt != allVariables.end())
+        const NodeIdVariablesIndex::const_iterator allVarIndexIt(allVariablesIndex.find(nodeId));
+        if (allVarIndexIt != allVariablesIndex.end())
         {
-            const VariablesMap& varMap(allVarMapIt->second);
-            const VariablesMap::const_iterator varIt(varMap.find(UTF8ToWString(variableName)));
-            if (varIt != varMap.end())
+            const VariablesIndex& varIndex(allVarIndexIt->second);
+            const VariablesIndex::const_iterator varIt(varIndex.find(variableName));
+            if (varIt != varIndex.end())
                 pos = varIt->second.first;
         }
 
@@ -1122,7 +1123,7 @@ namespace Aseba
         if (pos == unsigned(-1))
         {
             bool ok;
-            pos = getVariablePos(nodeId, UTF8ToWString(variableName), &ok);
+            pos = getVariablePos(nodeId, variableName, &ok);
             if (!ok)
             {
                 if (verbose)
@@ -1260,6 +1261,7 @@ namespace Aseba
         commonDefinitions[nodeId].events.clear();
         commonDefinitions[nodeId].constants.clear();
         allVariables[nodeId].clear();
+        allVariablesIndex[nodeId].clear();
         nodeProgram[nodeId].clear();
 
         // load new data
@@ -1393,6 +1395,7 @@ namespace Aseba
         Compiler compiler;
         compiler.setTargetDescription(getDescription(nodeId));
         compiler.setCommonDefinitions(&(commonDefinitions[nodeId]));
+        compiler.setCompilationCache(&compilationCache);
         bool result = compiler.compile(is, bytecode, allocatedVariablesCount, error);
 
         if (result)
@@ -1418,6 +1421,7 @@ namespace Aseba
             }
             // retrieve user-defined variables for use in get/set
             allVariables[nodeId] = *compiler.getVariablesMap();
+            allVariablesIndex[nodeId] = indexVariablesMap(allVariables[nodeId]);
             // remember that this node has received a program
             nodeProgramsSent.insert(nodeId);
             return true;
@@ -26,7 +26,9 @@
 #include <dashel/dashel.h>
 #include "common/msg/msg.h"
 #include "common/msg/NodesManager.h"
+#include "common/msg/VariablesMirror.h"
 #include "compiler/compiler.h"
+#include "compiler/compilation-cache.h"
 #ifdef ZEROCONF_SUPPORT
 #include "common/zeroconf/zeroconf-dashelhub.h"
 #endif // ZEROCONF_SUPPORT
@@ -60,6 +62,7 @@ namespace Aseba
         typedef std::map<uint16_t, uint16_t>      NodeIdSubstitution;
         typedef std::map<std::string, Aseba::VariablesMap>      NodeNameVariablesMap;
         typedef std::map<unsigned, Aseba::VariablesMap>         NodeIdVariablesMap;
+        typedef std::map<unsigned, Aseba::VariablesIndex>       NodeIdVariablesIndex;
         typedef std::map<VariableAddress, ResponseSet>          VariableResponseSetMap;
         typedef std::map<Dashel::Stream*, ResponseQueue>        StreamResponseQueueMap;
         typedef std::map<Dashel::Stream*, HttpRequest>          StreamRequestMap;
@@ -99,9 +102,13 @@ namespace Aseba
         // Extract definitions from AESL files
         NodeIdCommonDefinitionsMap  commonDefinitions;
         NodeIdVariablesMap          allVariables;
+        NodeIdVariablesIndex        allVariablesIndex; // allVariables by UTF-8 name, for lookups from requests
+        CompilationCache            compilationCache;
 
         //variable cache
         std::map<std::pair<unsigned,unsigned>, std::vector<short> > variable_cache;
+        // copy of the variables of nodes, to read only the changed ones
+        VariablesMirror variablesMirror;
 
 #ifdef ZEROCONF_SUPPORT
 		DashelhubZeroconf zeroconf;
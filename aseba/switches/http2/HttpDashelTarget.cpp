@@ -106,8 +106,8 @@ bool HttpDashelTarget::sendGetVariables(unsigned globalNodeId, const std::vector
 		if(getVariableInfo(node, *it, position, size)) {
 			try {
 				// send the message
-				GetVariables getVariables(node.localId, position, size);
-				getVariables.serialize(stream);
+				// read only the changed variables if the node supports it
+				variablesMirror.getVariablesRequest(node.localId, position, size)->serialize(stream);
 				stream->flush();
 			} catch(Dashel::DashelException e) {
 				if(interface->isVerbose()) {
@@ -201,6 +201,7 @@ bool HttpDashelTarget::compileAndRunCode(unsigned globalNodeId, const std::strin
 	Compiler compiler;
 	compiler.setTargetDescription(getDescription(node.localId));
 	compiler.setCommonDefinitions(&interface->getProgram().getCommonDefinitions());
+	compiler.setCompilationCache(&compilationCache);
 
 	if(compiler.compile(is, bytecode, allocatedVariablesCount, error)) {
 		try {
@@ -222,6 +223,7 @@ bool HttpDashelTarget::compileAndRunCode(unsigned globalNodeId, const std::strin
 
 		// retrieve user-defined variables for use in get/set
 		node.variablesMap = *compiler.getVariablesMap();
+		node.variablesIndex = indexVariablesMap(node.variablesMap);
 		return true;
 	} else {
 		errorString = WStringToUTF8(error.toWString());
@@ -249,6 +251,11 @@ bool HttpDashelTarget::removePendingVariable(unsigned globalNodeId, unsigned sta
 	return node.pendingVariables.erase(start) == 1;
 }
 
+std::unique_ptr<Aseba::Variables> HttpDashelTarget::processVariablesMessage(const Aseba::Message *message)
+{
+	return variablesMirror.processMessage(message);
+}
+
 std::set<const HttpDashelTarget::Node *> HttpDashelTarget::getNodesByName(const std::string& name) const
 {
 	set<const HttpDashelTarget::Node *> result;
@@ -288,8 +295,8 @@ const HttpDashelTarget::Node *HttpDashelTarget::getNodeByLocalId(unsigned localN
 
 bool HttpDashelTarget::getVariableInfo(const Node& node, const std::string& variableName, unsigned& position, unsigned& size)
 {
-	VariablesMap::const_iterator query = node.variablesMap.find(UTF8ToWString(variableName));
-	if(query != node.variablesMap.end()) {
+	VariablesIndex::const_iterator query = node.variablesIndex.find(variableName);
+	if(query != node.variablesIndex.end()) {
 		position = query->second.first;
 		size = query->second.second;
 		return true;
@@ -297,9 +304,9 @@ bool HttpDashelTarget::getVariableInfo(const Node& node, const std::string& vari
 
 	// if variable is not user-defined, check whether it is provided by this node
 	bool ok;
-	position = getVariablePos(node.localId, UTF8ToWString(variableName), &ok);
+	position = getVariablePos(node.localId, variableName, &ok);
 	if(ok) {
-		size = getVariableSize(node.localId, UTF8ToWString(variableName), &ok);
+		size = getVariableSize(node.localId, variableName, &ok);
 
 		if(ok) {
 			return true;
@@ -25,6 +25,8 @@
 #include <set>
 #include <dashel/dashel.h>
 #include "common/msg/NodesManager.h"
+#include "common/msg/VariablesMirror.h"
+#include "compiler/compilation-cache.h"
 #include "AeslProgram.h"
 
 namespace Aseba { namespace Http
@@ -50,6 +52,7 @@ namespace Aseba { namespace Http
 				unsigned globalId;
 				std::string name;
 				VariablesMap variablesMap;
+				VariablesIndex variablesIndex; //!< variablesMap by UTF-8 name, for lookups from requests
 				std::map< unsigned, std::set< std::pair<Dashel::Stream *, DashelHttpRequest *> > > pendingVariables;
 			};
 
@@ -98,6 +101,16 @@ namespace Aseba { namespace Http
 			 */
 			virtual bool removePendingVariable(unsigned globalNodeId, unsigned start);
 
+			/**
+			 * Keep track of the variables nodes send with a changed variables message, which only
+			 * holds the variables that changed since the previous one. Must be called with every
+			 * message received from this target, before remapping its source.
+			 *
+			 * Returns the variables message a changed variables message stands for, if all the
+			 * variables it covers are known.
+			 */
+			virtual std::unique_ptr<Variables> processVariablesMessage(const Message *message);
+
 			virtual std::set<const Node *> getNodesByName(const std::string& name) const;
 			virtual const Node *getNodeById(unsigned globalNodeId) const;
 			virtual const Node *getNodeByLocalId(unsigned localNodeId) const;
@@ -119,6 +132,8 @@ namespace Aseba { namespace Http
 
 			std::map<unsigned, Node> nodes;
 			std::map<unsigned, unsigned> globalIds;
+			CompilationCache compilationCache;
+			VariablesMirror variablesMirror;
 	};
 } }
 
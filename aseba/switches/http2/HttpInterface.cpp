@@ -398,6 +398,7 @@ void HttpInterface::incomingData(Dashel::Stream *stream)
 		// pass message to description manager, which builds the node descriptions in background
 		// warning: do this before dynamic casts because otherwise the parsing doesn't work (why?)
 		target->processMessage(message);
+		std::unique_ptr<Variables> changedVariables(target->processVariablesMessage(message));
 
 		// See if we know this node already or if the source is 0 (meaning coming from IDE)
 		const HttpDashelTarget::Node *node = target->getNodeByLocalId(message->source);
@@ -405,6 +406,8 @@ void HttpInterface::incomingData(Dashel::Stream *stream)
 			// remap source node to global node id if not sent from IDE
 			if (node != nullptr)
 				message->source = node->globalId;
+			if (changedVariables)
+				changedVariables->source = message->source;
 
 			// check for execution error messages
 			switch(message->type) {
@@ -415,8 +418,8 @@ void HttpInterface::incomingData(Dashel::Stream *stream)
 					incomingErrorMessage(target, message);
 			}
 
-			// if variables, check for pending requests
-			const Variables *variables(dynamic_cast<Variables *>(message));
+			// if variables, check for pending requests; changed variables were rebuilt as variables
+			const Variables *variables(changedVariables ? changedVariables.get() : dynamic_cast<Variables *>(message));
 			if(variables != nullptr) {
 				incomingVariables(target, variables);
 			}
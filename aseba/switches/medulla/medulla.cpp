@@ -18,6 +18,7 @@
 */
 
 #include <QCoreApplication>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -47,6 +48,13 @@ namespace Aseba
 	/** \addtogroup medulla */
 	/*@{*/
 
+	//! Duration in ms after which a read not answered by the network fails
+	static const qint64 readTimeout = 3000;
+	//! Maximum number of events in an Events signal
+	static const int maxEventsBatchSize = 256;
+	//! D-Bus interface of event filters
+	static const char* eventFilterInterfaceName = "ch.epfl.mobots.EventFilter";
+
 	std::vector<int16_t> toAsebaVector(const Values& values)
 	{
 		std::vector<int16_t> data;
@@ -59,16 +67,12 @@ namespace Aseba
 	Values fromAsebaVector(const std::vector<int16_t>& values)
 	{
 		Values data;
+		data.reserve(values.size());
 		for (size_t i = 0; i < values.size(); ++i)
 			data.push_back(values[i]);
 		return data;
 	}
 
-	void EventFilterInterface::emitEvent(const uint16_t id, const QString& name, const Values& data)
-	{
-		emit Event(id, name, data);
-	}
-
 	void EventFilterInterface::ListenEvent(const uint16_t event)
 	{
 		network->listenEvent(this, event);
@@ -97,19 +101,44 @@ namespace Aseba
 			network->DBusConnectionBus().send(message.createErrorReply(QDBusError::InvalidArgs, QString("no event named %0").arg(name)));
 	}
 
+	//! Send events received together in a single Events signal instead of an Event signal each
+	void EventFilterInterface::SetBatching(bool enabled)
+	{
+		if (!enabled)
+			network->flushEvents(this);
+		batching = enabled;
+	}
+
 	void EventFilterInterface::Free()
 	{
 		network->filterDestroyed(this);
 		deleteLater();
 	}
 
-	AsebaNetworkInterface::AsebaNetworkInterface(Hub* hub, bool systemBus) :
+	bool AsebaNetworkInterface::ReadKey::operator<(const ReadKey& that) const
+	{
+		if (nodeId != that.nodeId)
+			return nodeId < that.nodeId;
+		if (pos != that.pos)
+			return pos < that.pos;
+		return length < that.length;
+	}
+
+	AsebaNetworkInterface::AsebaNetworkInterface(Hub* hub, bool systemBus, int cacheTtl) :
 		QDBusAbstractAdaptor(hub),
 		hub(hub),
+		cacheTtl(cacheTtl),
 		systemBus(systemBus),
 		eventsFiltersCounter(0)
 	{
 		qDBusRegisterMetaType<Values>();
+		qDBusRegisterMetaType<ValuesList>();
+		qDBusRegisterMetaType<EventsIds>();
+		clock.start();
+
+		eventsFlushTimer.setSingleShot(true);
+		eventsFlushTimer.setInterval(0);
+		connect(&eventsFlushTimer, SIGNAL(timeout()), this, SLOT(flushEvents()));
 
 		//FIXME: here no error handling is done, with system bus these calls can fail	
 		DBusConnectionBus().registerObject("/", hub);
@@ -118,9 +147,18 @@ namespace Aseba
 		// regular network pinging
 		QTimer *timer = new QTimer(this);
 		connect(timer, SIGNAL(timeout()), this, SLOT(PingNetwork()));
+		connect(timer, SIGNAL(timeout()), this, SLOT(expireReads()));
 		timer->start(1000);
 	}
 
+	//! Process all messages received by the hub since the previous call
+	void AsebaNetworkInterface::processMessages()
+	{
+		const Hub::IncomingMessages messages(hub->takeMessages());
+		for (const auto& message: messages)
+			processMessage(message.first, message.second);
+	}
+
 	void AsebaNetworkInterface::processMessage(Message *message, const Dashel::Stream* sourceStream)
 	{
 		// send messages to Dashel peers
@@ -129,9 +167,9 @@ namespace Aseba
 		// scan this message for nodes descriptions
 		NodesManager::processMessage(message);
 
-		// if user message, send to D-Bus as well
+		// if user message, send to D-Bus as well, converting it only if some filter listens to it
 		UserMessage *userMessage = dynamic_cast<UserMessage *>(message);
-		if (userMessage)
+		if (userMessage && eventsFilters.contains(userMessage->type))
 		{
 			sendEventOnDBus(userMessage->type, fromAsebaVector(userMessage->data));
 		}
@@ -139,38 +177,68 @@ namespace Aseba
 		// if variables, check for pending answers
 		Variables *variables = dynamic_cast<Variables *>(message);
 		if (variables)
+			processVariables(variables);
+
+		delete message;
+	}
+
+	//! Send event to the filters listening to it, building the arguments once for all of them
+	void AsebaNetworkInterface::sendEventOnDBus(const uint16_t event, const Values& data)
+	{
+		EventsFiltersMap::const_iterator it(eventsFilters.constFind(event));
+		if (it == eventsFilters.constEnd())
+			return;
+
+		const QString name(event < eventsNames.size() ? eventsNames[event] : QString("?"));
+		QDBusConnection bus(DBusConnectionBus());
+		QList<QVariant> arguments;
+		for (; it != eventsFilters.constEnd() && it.key() == event; ++it)
 		{
-			const unsigned nodeId(variables->source);
-			const unsigned pos(variables->start);
-			for (RequestsList::iterator it = pendingReads.begin(); it != pendingReads.end(); ++it)
+			EventFilterInterface* filter(it.value());
+			if (filter->batching)
 			{
-				RequestData* request(*it);
-				if (request->nodeId == nodeId && request->pos == pos)
+				// queue the event until messages received meanwhile are processed, values and names are shared, not copied
+				if (filter->batchIds.isEmpty())
 				{
-					QDBusMessage &reply(request->reply);
-					Values values(fromAsebaVector(variables->variables));
-					reply << QVariant::fromValue(values);
-					DBusConnectionBus().send(reply);
-					delete request;
-					pendingReads.erase(it);
-					break;
+					batchingFilters.push_back(filter);
+					eventsFlushTimer.start();
 				}
+				filter->batchIds.push_back(event);
+				filter->batchNames.push_back(name);
+				filter->batchValues.push_back(data);
+				if (filter->batchIds.size() >= maxEventsBatchSize)
+					flushEvents(filter);
+			}
+			else
+			{
+				if (arguments.isEmpty())
+					arguments << QVariant::fromValue(event) << QVariant(name) << QVariant::fromValue(data);
+				QDBusMessage signal(QDBusMessage::createSignal(filter->getPath(), eventFilterInterfaceName, "Event"));
+				signal.setArguments(arguments);
+				bus.send(signal);
 			}
 		}
+	}
 
-		delete message;
+	//! Send the events waiting in all batching filters
+	void AsebaNetworkInterface::flushEvents()
+	{
+		for (int i = 0; i < batchingFilters.size(); ++i)
+			flushEvents(batchingFilters[i]);
+		batchingFilters.clear();
 	}
 
-	void AsebaNetworkInterface::sendEventOnDBus(const uint16_t event, const Values& data)
+	//! Send the events waiting in filter in a single Events signal
+	void AsebaNetworkInterface::flushEvents(EventFilterInterface* filter)
 	{
-		QList<EventFilterInterface*> filters = eventsFilters.values(event);
-		QString name;
-		if (event < commonDefinitions.events.size())
-			name = QString::fromStdWString(commonDefinitions.events[event].name);
-		else
-			name = "?";
-		for (int i = 0; i < filters.size(); ++i)
-			filters.at(i)->emitEvent(event, name, data);
+		if (filter->batchIds.isEmpty())
+			return;
+		QDBusMessage signal(QDBusMessage::createSignal(filter->getPath(), eventFilterInterfaceName, "Events"));
+		signal << QVariant::fromValue(filter->batchIds) << QVariant(filter->batchNames) << QVariant::fromValue(filter->batchValues);
+		DBusConnectionBus().send(signal);
+		filter->batchIds.clear();
+		filter->batchNames.clear();
+		filter->batchValues.clear();
 	}
 
 	void AsebaNetworkInterface::listenEvent(EventFilterInterface* filter, uint16_t event)
@@ -188,6 +256,125 @@ namespace Aseba
 		QList<uint16_t> events = eventsFilters.keys(filter);
 		for (int i = 0; i < events.size(); ++i)
 			eventsFilters.remove(events.at(i), filter);
+		batchingFilters.removeAll(filter);
+	}
+
+	//! Copy variables into all pending reads they overlap, whoever asked for them, reads sent before a write first, and answer those now complete
+	void AsebaNetworkInterface::processVariables(const Variables* variables)
+	{
+		const unsigned nodeId(variables->source);
+		const unsigned start(variables->start);
+		const unsigned end(start + variables->variables.size());
+
+		// pending reads are sorted by node and position; as nodes split long answers, reads starting before this message can overlap it
+		const PendingReadsMap::iterator first(pendingReads.lower_bound(ReadKey{nodeId, 0, 0}));
+		const auto overlaps = [&](PendingReadsMap::const_iterator it) { return it != pendingReads.end() && it->first.nodeId == nodeId && it->first.pos < end; };
+
+		// nodes answer in order, so values missing in reads detached by a write answer the first of these reads, not those sent after the write
+		std::vector<bool> takenByDetached(variables->variables.size(), false);
+		for (const bool detached: { true, false })
+		{
+			for (PendingReadsMap::iterator it = first; overlaps(it); ++it)
+			{
+				const ReadKey& key(it->first);
+				PendingRead& pending(it->second);
+				if (pending.detached != detached)
+					continue;
+				const unsigned overlapStart(std::max(start, key.pos));
+				const unsigned overlapEnd(std::min(end, key.pos + key.length));
+				for (unsigned pos = overlapStart; pos < overlapEnd; ++pos)
+				{
+					const unsigned i(pos - key.pos);
+					if (takenByDetached[pos - start] || (detached && pending.received[i]))
+						continue;
+					pending.values[i] = variables->variables[pos - start];
+					if (detached)
+						takenByDetached[pos - start] = true;
+					if (!pending.received[i])
+					{
+						pending.received[i] = true;
+						--pending.missingCount;
+					}
+				}
+			}
+		}
+
+		// answer reads now complete, which were all completed by this message as the others were answered before
+		PendingReadsMap::iterator it(first);
+		while (overlaps(it))
+		{
+			const ReadKey& key(it->first);
+			PendingRead& pending(it->second);
+			if (pending.missingCount != 0)
+			{
+				++it;
+				continue;
+			}
+
+			Values values;
+			values.reserve(key.length);
+			for (const qint16 value: pending.values)
+				values.push_back(value);
+			// values of detached reads might be older than the last write
+			if (cacheTtl && !pending.detached)
+				readsCache[key] = CachedRead{ clock.elapsed(), values };
+
+			for (const auto& waiter: it->second.waiters)
+				answerRead(*waiter.first, waiter.second, values);
+			it = pendingReads.erase(it);
+		}
+	}
+
+	//! Set values as the index-th variables read by call, and answer call if it was the last one
+	void AsebaNetworkInterface::answerRead(ReadCall& call, int index, const Values& values)
+	{
+		// the call might have failed already
+		if (call.remaining == 0)
+			return;
+
+		call.values[index] = values;
+		if (--call.remaining != 0)
+			return;
+
+		if (call.batch)
+			DBusConnectionBus().send(call.message.createReply(QVariant::fromValue(call.values)));
+		else
+			DBusConnectionBus().send(call.message.createReply(QVariant::fromValue(call.values[0])));
+	}
+
+	//! Answer call with error, unless it was already answered
+	void AsebaNetworkInterface::failRead(ReadCall& call, const QString& error)
+	{
+		if (call.remaining == 0)
+			return;
+		call.remaining = 0;
+		DBusConnectionBus().send(call.message.createErrorReply(QDBusError::TimedOut, error));
+	}
+
+	//! Fail the reads the network did not answer in time, so that the next reads of these variables ask again, and forget old values
+	void AsebaNetworkInterface::expireReads()
+	{
+		const qint64 now(clock.elapsed());
+		for (PendingReadsMap::iterator it = pendingReads.begin(); it != pendingReads.end();)
+		{
+			if (now - it->second.sentTime > readTimeout)
+			{
+				const QString error(QString("node %0 did not send variables in time").arg(it->first.nodeId));
+				for (const auto& waiter: it->second.waiters)
+					failRead(*waiter.first, error);
+				it = pendingReads.erase(it);
+			}
+			else
+				++it;
+		}
+
+		for (ReadsCache::iterator it = readsCache.begin(); it != readsCache.end();)
+		{
+			if (now - it->second.time > cacheTtl)
+				it = readsCache.erase(it);
+			else
+				++it;
+		}
 	}
 
 	void AsebaNetworkInterface::LoadScripts(const QString& fileName, const QDBusMessage &message)
@@ -293,6 +480,8 @@ namespace Aseba
 			userDefinedVariablesMap.clear();
 		}
 
+		updateEventsNames();
+
 		// check if there was some matching problem
 		if (noNodeCount)
 		{
@@ -300,6 +489,14 @@ namespace Aseba
 		}
 	}
 
+	//! Convert the names of events once, as they are sent with every event
+	void AsebaNetworkInterface::updateEventsNames()
+	{
+		eventsNames.clear();
+		for (size_t i = 0; i < commonDefinitions.events.size(); ++i)
+			eventsNames.push_back(QString::fromStdWString(commonDefinitions.events[i].name));
+	}
+
 	QStringList AsebaNetworkInterface::GetNodesList() const
 	{
 		QStringList list;
@@ -378,7 +575,7 @@ namespace Aseba
 		}
 	}
 
-	void AsebaNetworkInterface::SetVariable(const QString& node, const QString& variable, const Values& data, const QDBusMessage &message) const
+	void AsebaNetworkInterface::SetVariable(const QString& node, const QString& variable, const Values& data, const QDBusMessage &message)
 	{
 		// make sure the node exists
 		NodesNamesMap::const_iterator nodeIt(nodesNames.find(node));
@@ -407,7 +604,7 @@ namespace Aseba
 		if (pos == unsigned(-1))
 		{
 			bool ok;
-			pos = getVariablePos(nodeId, variable.toStdWString(), &ok);
+			pos = getVariablePos(nodeId, variable.toStdString(), &ok);
 			if (!ok)
 			{
 				DBusConnectionBus().send(message.createErrorReply(QDBusError::InvalidArgs, QString("variable %0 does not exists in node %1").arg(variable).arg(node)));
@@ -417,16 +614,33 @@ namespace Aseba
 
 		SetVariables msg(nodeId, pos, toAsebaVector(data));
 		hub->sendMessage(msg);
+
+		// forget cached values that this changes
+		const unsigned end(pos + data.size());
+		ReadsCache::iterator it(readsCache.lower_bound(ReadKey{nodeId, 0, 0}));
+		while (it != readsCache.end() && it->first.nodeId == nodeId && it->first.pos < end)
+		{
+			if (it->first.pos + it->first.length > pos)
+				it = readsCache.erase(it);
+			else
+				++it;
+		}
+
+		// reads in flight still answer their calls, but further reads must ask again to see this write
+		for (PendingReadsMap::iterator readIt(pendingReads.lower_bound(ReadKey{nodeId, 0, 0})); readIt != pendingReads.end() && readIt->first.nodeId == nodeId && readIt->first.pos < end; ++readIt)
+			if (readIt->first.pos + readIt->first.length > pos)
+				readIt->second.detached = true;
 	}
 
-	Values AsebaNetworkInterface::GetVariable(const QString& node, const QString& variable, const QDBusMessage &message)
+	//! Find the position and size of variable in node into key, or answer message with an error and return false
+	bool AsebaNetworkInterface::findVariable(const QString& node, const QString& variable, ReadKey& key, const QDBusMessage &message) const
 	{
 		// make sure the node exists
 		NodesNamesMap::const_iterator nodeIt(nodesNames.find(node));
 		if (nodeIt == nodesNames.end())
 		{
 			DBusConnectionBus().send(message.createErrorReply(QDBusError::InvalidArgs, QString("node %0 does not exists").arg(node)));
-			return Values();
+			return false;
 		}
 		const unsigned nodeId(nodeIt.value());
 
@@ -450,32 +664,99 @@ namespace Aseba
 		if (pos == unsigned(-1))
 		{
 			bool ok1, ok2;
-			pos = getVariablePos(nodeId, variable.toStdWString(), &ok1);
-			length = getVariableSize(nodeId, variable.toStdWString(), &ok2);
+			pos = getVariablePos(nodeId, variable.toStdString(), &ok1);
+			length = getVariableSize(nodeId, variable.toStdString(), &ok2);
 			if (!(ok1 && ok2))
 			{
 				DBusConnectionBus().send(message.createErrorReply(QDBusError::InvalidArgs, QString("variable %0 does not exists in node %1").arg(variable).arg(node)));
-				return Values();
+				return false;
+			}
+		}
+
+		key.nodeId = nodeId;
+		key.pos = pos;
+		key.length = length;
+		return true;
+	}
+
+	//! Read the variables of key as the index-th of call, from the cache, from a read of the same variables already sent, or from the network
+	void AsebaNetworkInterface::readVariables(const ReadKey& key, const std::shared_ptr<ReadCall>& call, int index)
+	{
+		if (key.length == 0)
+		{
+			answerRead(*call, index, Values());
+			return;
+		}
+
+		if (cacheTtl)
+		{
+			const ReadsCache::const_iterator cachedIt(readsCache.find(key));
+			if (cachedIt != readsCache.end() && clock.elapsed() - cachedIt->second.time <= cacheTtl)
+			{
+				answerRead(*call, index, cachedIt->second.values);
+				return;
 			}
 		}
 
-		// send request to aseba network
+		// join a read of the same variables in flight, unless a write was sent after it
+		const auto range(pendingReads.equal_range(key));
+		PendingReadsMap::iterator it(std::find_if(range.first, range.second, [](const PendingReadsMap::value_type& read) { return !read.second.detached; }));
+		if (it == range.second)
 		{
-			GetVariables msg(nodeId, pos, length);
+			// send request to aseba network
+			it = pendingReads.emplace_hint(range.second, key, PendingRead());
+			PendingRead& pending(it->second);
+			pending.sentTime = clock.elapsed();
+			pending.values.assign(key.length, 0);
+			pending.received.assign(key.length, false);
+			pending.missingCount = key.length;
+			pending.detached = false;
+			Aseba::GetVariables msg(key.nodeId, key.pos, key.length);
 			hub->sendMessage(msg);
 		}
+		it->second.waiters.push_back(std::make_pair(call, index));
+	}
 
-		// build bookkeeping for async reply
-		RequestData *request = new RequestData;
-		request->nodeId = nodeId;
-		request->pos = pos;
-		message.setDelayedReply(true);
-		request->reply = message.createReply();
+	Values AsebaNetworkInterface::GetVariable(const QString& node, const QString& variable, const QDBusMessage &message)
+	{
+		ReadKey key;
+		if (!findVariable(node, variable, key, message))
+			return Values();
 
-		pendingReads.push_back(request);
+		// the reply is sent once the network answered
+		message.setDelayedReply(true);
+		std::shared_ptr<ReadCall> call(new ReadCall);
+		call->message = message;
+		call->batch = false;
+		call->values.push_back(Values());
+		call->remaining = 1;
+		readVariables(key, call, 0);
 		return Values();
 	}
 
+	//! Read several variables of a node at once, answering with their values in the same order
+	ValuesList AsebaNetworkInterface::GetVariables(const QString& node, const QStringList& variables, const QDBusMessage &message)
+	{
+		std::vector<ReadKey> keys(variables.size());
+		for (int i = 0; i < variables.size(); ++i)
+			if (!findVariable(node, variables[i], keys[i], message))
+				return ValuesList();
+		if (keys.empty())
+			return ValuesList();
+
+		// the reply is sent once the network answered for all variables
+		message.setDelayedReply(true);
+		std::shared_ptr<ReadCall> call(new ReadCall);
+		call->message = message;
+		call->batch = true;
+		for (size_t i = 0; i < keys.size(); ++i)
+			call->values.push_back(Values());
+		call->remaining = keys.size();
+		for (size_t i = 0; i < keys.size(); ++i)
+			readVariables(keys[i], call, i);
+		return ValuesList();
+	}
+
 	void AsebaNetworkInterface::SendEvent(const uint16_t event, const Values& data)
 	{
 		// send event to DBus listeners
@@ -498,7 +779,7 @@ namespace Aseba
 	QDBusObjectPath AsebaNetworkInterface::CreateEventFilter()
 	{
 		QDBusObjectPath path(QString("/events_filters/%0").arg(eventsFiltersCounter++));
-		DBusConnectionBus().registerObject(path.path(), new EventFilterInterface(this), QDBusConnection::ExportScriptableContents);
+		DBusConnectionBus().registerObject(path.path(), new EventFilterInterface(this, path.path()), QDBusConnection::ExportScriptableContents);
 		return path;
 	}
 
@@ -527,7 +808,7 @@ namespace Aseba
 
 	// the following methods run in the main thread (event loop)
 
-	Hub::Hub(unsigned port, bool verbose, bool dump, bool forward, bool rawTime, bool systemBus) :
+	Hub::Hub(unsigned port, bool verbose, bool dump, bool forward, bool rawTime, bool systemBus, int cacheTtl) :
 		#ifdef DASHEL_VERSION_INT
 		Dashel::Hub(verbose || dump),
 		#endif // DASHEL_VERSION_INT
@@ -537,8 +818,8 @@ namespace Aseba
 		rawTime(rawTime)
 	{
 		// TODO: work in progress to remove ugly delay
-		AsebaNetworkInterface* network(new AsebaNetworkInterface(this, systemBus));
-		QObject::connect(this, SIGNAL(messageAvailable(Message*, const Dashel::Stream*)), network, SLOT(processMessage(Message*, const Dashel::Stream*)));
+		AsebaNetworkInterface* network(new AsebaNetworkInterface(this, systemBus, cacheTtl));
+		QObject::connect(this, SIGNAL(messagesAvailable()), network, SLOT(processMessages()));
 		ostringstream oss;
 		oss << "tcpin:port=" << port;
 		Dashel::Hub::connect(oss.str());
@@ -585,6 +866,14 @@ namespace Aseba
 		sendMessage(&message, sourceStream);
 	}
 
+	Hub::IncomingMessages Hub::takeMessages()
+	{
+		IncomingMessages messages;
+		std::lock_guard<std::mutex> guard(incomingMutex);
+		messages.swap(incomingMessages);
+		return messages;
+	}
+
 	// the following methods run in the blocking reception thread
 
 	// In QThread main function, we just make our Dashel hub switch listen for incoming data
@@ -609,8 +898,18 @@ namespace Aseba
 			std::cerr << "error while reading message" << std::endl;
 		}
 
-		// send on DBus, the receiver can delete it
-		emit messageAvailable(message, stream);
+		if (!message)
+			return;
+
+		// queue for the main thread, which owns it from now on, and notify it only if it has taken the previous ones
+		bool wasEmpty;
+		{
+			std::lock_guard<std::mutex> guard(incomingMutex);
+			wasEmpty = incomingMessages.empty();
+			incomingMessages.push_back(IncomingMessage(message, stream));
+		}
+		if (wasEmpty)
+			emit messagesAvailable();
 	}
 
 	void Hub::connectionCreated(Stream *stream)
@@ -649,6 +948,7 @@ void dumpHelp(std::ostream &stream, const char *programName)
 	stream << "-p port         : listens to incoming connection on this port\n";
 	stream << "--rawtime       : shows time in the form of sec:usec since 1970\n";
 	stream << "--system        : connects medulla to the system d-bus bus\n";	
+	stream << "--cache-ttl ms  : answers reads of variables with values received less than ms ago (default: 0, disabled)\n";
 	stream << "-h, --help      : shows this help\n";
 	stream << "-V, --version   : shows the version number\n";
 	stream << "Additional targets are any valid Dashel targets." << std::endl;
@@ -674,6 +974,7 @@ int main(int argc, char *argv[])
 	bool forward = true;
 	bool rawTime = false;
 	bool systemBus = false;
+	int cacheTtl = 0;
 	std::vector<std::string> additionalTargets;
 
 	int argCounter = 1;
@@ -707,6 +1008,11 @@ int main(int argc, char *argv[])
 		{
 			systemBus = true;
 		}
+		else if (strcmp(arg, "--cache-ttl") == 0)
+		{
+			arg = argv[++argCounter];
+			cacheTtl = atoi(arg);
+		}
 		else if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
 		{
 			dumpHelp(std::cout, argv[0]);
@@ -724,7 +1030,7 @@ int main(int argc, char *argv[])
 		argCounter++;
 	}
 
-	Aseba::Hub hub(port, verbose, dump, forward, rawTime, systemBus);
+	Aseba::Hub hub(port, verbose, dump, forward, rawTime, systemBus, cacheTtl);
 
 	try
 	{
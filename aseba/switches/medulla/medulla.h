@@ -29,11 +29,20 @@
 #include <QDBusMessage>
 #include <QMetaType>
 #include <QList>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include "common/msg/msg.h"
 #include "common/msg/NodesManager.h"
 #include "compiler/compiler.h"
 
 typedef QList<qint16> Values;
+typedef QList<Values> ValuesList;
+typedef QList<quint16> EventsIds;
 
 namespace Aseba
 {
@@ -52,18 +61,21 @@ namespace Aseba
 		Q_CLASSINFO("D-Bus Interface", "ch.epfl.mobots.EventFilter")
 
 		public:
-			EventFilterInterface(AsebaNetworkInterface* network) : network(network) { ListenEvent(0); }
-			void emitEvent(const uint16_t id, const QString& name, const Values& data);
+			EventFilterInterface(AsebaNetworkInterface* network, const QString& path) : network(network), path(path), batching(false) { ListenEvent(0); }
+			const QString& getPath() const { return path; }
 
 		public slots:
 			Q_SCRIPTABLE Q_NOREPLY void ListenEvent(const uint16_t event);
 			Q_SCRIPTABLE Q_NOREPLY void ListenEventName(const QString& name, const QDBusMessage &message);
 			Q_SCRIPTABLE Q_NOREPLY void IgnoreEvent(const uint16_t event);
 			Q_SCRIPTABLE Q_NOREPLY void IgnoreEventName(const QString& name, const QDBusMessage &message);
+			Q_SCRIPTABLE Q_NOREPLY void SetBatching(bool enabled);
 			Q_SCRIPTABLE Q_NOREPLY void Free();
 
 		signals:
 			Q_SCRIPTABLE void Event(const uint16_t, const QString& name, const Values& values);
+			//! Events received since the previous signal, sent instead of Event if batching is enabled
+			Q_SCRIPTABLE void Events(const EventsIds& ids, const QStringList& names, const ValuesList& values);
 			Q_SCRIPTABLE void Test0(const uint16_t);
 			Q_SCRIPTABLE void Test1(const QString& );
 			Q_SCRIPTABLE void Test2(const Values& );
@@ -72,7 +84,14 @@ namespace Aseba
 			Q_SCRIPTABLE void Test1_2(const QString&, const Values& );
 
 		protected:
+			friend class AsebaNetworkInterface;
 			AsebaNetworkInterface* network;
+			const QString path; //!< D-Bus object path of this filter
+			bool batching; //!< whether events are grouped into Events signals
+			// events waiting to be sent in an Events signal, if batching
+			EventsIds batchIds;
+			QStringList batchNames;
+			ValuesList batchValues;
 	};
 
 	//! DBus interface for aseba network
@@ -82,24 +101,57 @@ namespace Aseba
 		Q_CLASSINFO("D-Bus Interface", "ch.epfl.mobots.AsebaNetwork")
 
 		protected:
-			struct RequestData
+			//! Variables read on a node
+			struct ReadKey
 			{
 				unsigned nodeId;
 				unsigned pos;
-				QDBusMessage reply;
+				unsigned length;
+
+				bool operator<(const ReadKey& that) const;
+			};
+
+			//! A D-Bus call reading one or more variables, answered once all of them are received
+			struct ReadCall
+			{
+				QDBusMessage message; //!< the call, to create its reply
+				bool batch; //!< whether the reply is a list of values, otherwise the values of a single variable
+				ValuesList values; //!< values of every variable read
+				unsigned remaining; //!< number of variables not received yet, 0 once answered
+			};
+
+			//! A read sent to the network, and the calls waiting for its answer
+			struct PendingRead
+			{
+				qint64 sentTime; //!< in ms, see clock
+				std::vector<std::pair<std::shared_ptr<ReadCall>, int> > waiters; //!< calls and the index of these variables in them
+				std::vector<qint16> values; //!< values received so far, as nodes split long answers in several messages
+				std::vector<bool> received; //!< which of values have been received
+				unsigned missingCount; //!< number of values not received yet
+				bool detached; //!< whether a write to these variables was sent after this read, so that further reads must not wait for its older values
+			};
+
+			//! Values received from the network, kept shortly to answer further reads directly
+			struct CachedRead
+			{
+				qint64 time; //!< in ms, see clock
+				Values values;
 			};
 
 		public:
-			AsebaNetworkInterface(Hub* hub, bool systemBus);
+			AsebaNetworkInterface(Hub* hub, bool systemBus, int cacheTtl);
 
 		private slots:
 			friend class Hub;
-			void processMessage(Message *message, const Dashel::Stream* sourceStream);
+			void processMessages();
 			friend class EventFilterInterface;
 			void sendEventOnDBus(const uint16_t event, const Values& data);
+			void flushEvents();
+			void flushEvents(EventFilterInterface* filter);
 			void listenEvent(EventFilterInterface* filter, uint16_t event);
 			void ignoreEvent(EventFilterInterface* filter, uint16_t event);
 			void filterDestroyed(EventFilterInterface* filter);
+			void expireReads();
 
 		public slots:
 			Q_NOREPLY void LoadScripts(const QString& fileName, const QDBusMessage &message);
@@ -108,8 +160,9 @@ namespace Aseba
 			QString GetNodeName(const uint16_t nodeId, const QDBusMessage &message) const;
 			bool IsConnected(const QString& node, const QDBusMessage &message) const;
 			QStringList GetVariablesList(const QString& node) const;
-			Q_NOREPLY void SetVariable(const QString& node, const QString& variable, const Values& data, const QDBusMessage &message) const;
+			Q_NOREPLY void SetVariable(const QString& node, const QString& variable, const Values& data, const QDBusMessage &message);
 			Values GetVariable(const QString& node, const QString& variable, const QDBusMessage &message);
+			ValuesList GetVariables(const QString& node, const QStringList& variables, const QDBusMessage &message);
 			Q_NOREPLY void SendEvent(const uint16_t event, const Values& data);
 			Q_NOREPLY void SendEventName(const QString& name, const Values& data, const QDBusMessage &message);
 			QDBusObjectPath CreateEventFilter();
@@ -119,6 +172,13 @@ namespace Aseba
 			virtual void sendMessage(const Message& message);
 			virtual void nodeDescriptionReceived(unsigned nodeId);
 			QDBusConnection DBusConnectionBus() const;
+			void processMessage(Message *message, const Dashel::Stream* sourceStream);
+			void updateEventsNames();
+			bool findVariable(const QString& node, const QString& variable, ReadKey& key, const QDBusMessage &message) const;
+			void readVariables(const ReadKey& key, const std::shared_ptr<ReadCall>& call, int index);
+			void answerRead(ReadCall& call, int index, const Values& values);
+			void failRead(ReadCall& call, const QString& error);
+			void processVariables(const Variables* variables);
 
 		protected:
 			Hub* hub;
@@ -127,10 +187,17 @@ namespace Aseba
 			NodesNamesMap nodesNames;
 			typedef QMap<QString, VariablesMap> UserDefinedVariablesMap;
 			UserDefinedVariablesMap userDefinedVariablesMap;
-			typedef QList<RequestData*> RequestsList;
-			RequestsList pendingReads;
+			typedef std::multimap<ReadKey, PendingRead> PendingReadsMap;
+			PendingReadsMap pendingReads; //!< reads sent to the network and not answered yet, shared by all calls reading the same variables, in the order they were sent
+			typedef std::map<ReadKey, CachedRead> ReadsCache;
+			ReadsCache readsCache; //!< values of recent reads, if cacheTtl is not 0
+			const int cacheTtl; //!< duration in ms during which received values answer further reads, 0 to always ask the network
+			QElapsedTimer clock; //!< time base for pending and cached reads
 			typedef QMultiMap<uint16_t, EventFilterInterface*> EventsFiltersMap;
 			EventsFiltersMap eventsFilters;
+			QStringList eventsNames; //!< names of events of commonDefinitions, converted once
+			QList<EventFilterInterface*> batchingFilters; //!< filters with events waiting to be sent
+			QTimer eventsFlushTimer; //!< sends waiting events once messages received meanwhile are processed
 			bool systemBus;
 			unsigned eventsFiltersCounter;
 	};
@@ -153,8 +220,10 @@ namespace Aseba
 				@param dump should we dump content of each message
 				@param forward should we only forward messages instead of transmit them back to the sender
 				@param rawTime should the time be printed as integer
+				@param systemBus should we connect to the system bus instead of the session bus
+				@param cacheTtl duration in ms during which values of variables read are reused, 0 to disable
 			*/
-			Hub(unsigned port, bool verbose, bool dump, bool forward, bool rawTime, bool systemBus);
+			Hub(unsigned port, bool verbose, bool dump, bool forward, bool rawTime, bool systemBus, int cacheTtl);
 
 			/*! Sends a message to Dashel peers.
 				Does not delete the message, should be called by the main thread.
@@ -167,8 +236,17 @@ namespace Aseba
 			*/
 			void sendMessage(const Message& message, const Dashel::Stream* sourceStream = 0);
 
+			//! A message received by the reception thread, and the stream it comes from
+			typedef std::pair<Message*, const Dashel::Stream*> IncomingMessage;
+			typedef std::vector<IncomingMessage> IncomingMessages;
+			/*! Takes the messages received since the previous call, in order.
+				Should be called by the main thread, which then owns the messages.
+			*/
+			IncomingMessages takeMessages();
+
 		signals:
-			void messageAvailable(Message *message, const Dashel::Stream* sourceStream);
+			//! Messages were received while none were waiting, takeMessages() returns them
+			void messagesAvailable();
 
 		private:
 			virtual void run();
@@ -181,11 +259,15 @@ namespace Aseba
 			bool dump; //!< should we dump content of CAN messages
 			bool forward; //!< should we only forward messages instead of transmit them back to the sender
 			bool rawTime; //!< should displayed timestamps be of the form sec:usec since 1970
+			std::mutex incomingMutex; //!< protects incomingMessages
+			IncomingMessages incomingMessages; //!< received messages not yet taken by the main thread
 	};
 
 	/*@}*/
 };
 
 Q_DECLARE_METATYPE(Values);
+Q_DECLARE_METATYPE(ValuesList);
+Q_DECLARE_METATYPE(EventsIds);
 
 #endif
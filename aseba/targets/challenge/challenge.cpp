@@ -210,6 +210,13 @@ namespace Enki
 
 			vm.variables = reinterpret_cast<int16_t *>(&variables);
 			vm.variablesSize = sizeof(variables) / sizeof(int16_t);
+			vm.variablesShadow = nullptr;
+			vm.watches = nullptr;
+			vm.watchesSize = 0;
+			vm.watchesValues = nullptr;
+			vm.watchesValuesSize = 0;
+			vm.descriptionHash = 0;
+			vm.randomState = 0;
 
 			port = PORT_BASE+id;
 			try
@@ -35,6 +35,14 @@
    128 is luxury */
 #define SEND_QUEUE_SIZE 128
 
+/* Optional separate send queues for user events and bulk packets (descriptions, variables),
+ * so that events are not delayed by bulk transfers. Frames are taken from the same RAM as
+ * SEND_QUEUE_SIZE, which can then be reduced. Only enable the bulk queue if all nodes on
+ * the bus understand low-priority bulk frames, see can-net.h.
+ */
+// #define EVENTS_QUEUE_SIZE 32
+// #define BULK_QUEUE_SIZE 96
+
 /* Warning, at least an aseba message MUST be able to fit into this RECV_QUEUE_SIZE buffer */
 /* 256 is IMHO the minimum, but maybe it can be lowered with a lot of caution.
  * The bigger you have, the best it is. Fill the empty ram with it :)
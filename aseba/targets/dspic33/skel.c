@@ -134,6 +134,12 @@ const AsebaLocalEventDescription * AsebaGetLocalEventsDescriptions(AsebaVMState
 
 /* buffers for can-net */
 static __attribute((far)) CanFrame sendQueue[SEND_QUEUE_SIZE];
+#ifdef EVENTS_QUEUE_SIZE
+static __attribute((far)) CanFrame eventsQueue[EVENTS_QUEUE_SIZE];
+#endif
+#ifdef BULK_QUEUE_SIZE
+static __attribute((far)) CanFrame bulkQueue[BULK_QUEUE_SIZE];
+#endif
 
 static __attribute((far)) CanFrame recvQueue[RECV_QUEUE_SIZE];
 
@@ -499,6 +505,12 @@ void init_aseba_and_can(void) {
 
 	can_init((can_frame_received_callback)AsebaCanFrameReceived, AsebaCanFrameSent, DMA_CAN_RX, DMA_CAN_TX, CAN_SELECT_MODE, 1000, PRIO_CAN);
 	AsebaCanInit(vmState.nodeId, (AsebaCanSendFrameFP)can_send_frame, can_is_frame_room, received_packet_dropped, sent_packet_dropped, sendQueue, SEND_QUEUE_SIZE, recvQueue, RECV_QUEUE_SIZE);
+#ifdef EVENTS_QUEUE_SIZE
+	AsebaCanSetSendQueue(ASEBA_CAN_CLASS_EVENTS, eventsQueue, EVENTS_QUEUE_SIZE);
+#endif
+#ifdef BULK_QUEUE_SIZE
+	AsebaCanSetSendQueue(ASEBA_CAN_CLASS_BULK, bulkQueue, BULK_QUEUE_SIZE);
+#endif
 	AsebaVMInit(&vmState);
 	vmVariables.id = vmState.nodeId;
 
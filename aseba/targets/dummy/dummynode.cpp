@@ -47,6 +47,7 @@ private:
 	AsebaVMState vm;
 	std::valarray<unsigned short> bytecode;
 	std::valarray<signed short> stack;
+	std::valarray<signed short> variablesShadow;
 	struct Variables
 	{
 		int16_t id;
@@ -94,6 +95,15 @@ public:
 
 		vm.variables = reinterpret_cast<int16_t *>(&variables);
 		vm.variablesSize = sizeof(variables) / sizeof(int16_t);
+
+		variablesShadow.resize(vm.variablesSize);
+		vm.variablesShadow = &variablesShadow[0];
+		vm.watches = nullptr;
+		vm.watchesSize = 0;
+		vm.watchesValues = nullptr;
+		vm.watchesValuesSize = 0;
+		vm.descriptionHash = 0;
+		vm.randomState = 0;
 	}
 
 	Dashel::Stream* listen(const int port, const int deltaNodeId)
@@ -116,8 +126,9 @@ public:
 			abort();
 		}
 
-		// init VM
+		// init VM, the description being complete now that it has its name
 		AsebaVMInit(&vm);
+		vm.descriptionHash = AsebaComputeDescriptionHash(&vm);
 
 #ifdef ZEROCONF_SUPPORT
 		// advertise our status
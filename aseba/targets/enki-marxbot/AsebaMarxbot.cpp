@@ -219,24 +219,52 @@ namespace Enki
 		leftMotorVariables.id = 1;
 		leftMotor.vm.variables = reinterpret_cast<int16_t *>(&leftMotorVariables);
 		leftMotor.vm.variablesSize = sizeof(leftMotorVariables) / sizeof(int16_t);
+		leftMotor.vm.variablesShadow = nullptr;
+		leftMotor.vm.watches = nullptr;
+		leftMotor.vm.watchesSize = 0;
+		leftMotor.vm.watchesValues = nullptr;
+		leftMotor.vm.watchesValuesSize = 0;
+		leftMotor.vm.descriptionHash = 0;
+		leftMotor.vm.randomState = 0;
 		modules.push_back(&leftMotor);
 
 		rightMotor.vm.nodeId = 2;
 		rightMotorVariables.id = 2;
 		rightMotor.vm.variables = reinterpret_cast<int16_t *>(&rightMotorVariables);
 		rightMotor.vm.variablesSize = sizeof(rightMotorVariables) / sizeof(int16_t);
+		rightMotor.vm.variablesShadow = nullptr;
+		rightMotor.vm.watches = nullptr;
+		rightMotor.vm.watchesSize = 0;
+		rightMotor.vm.watchesValues = nullptr;
+		rightMotor.vm.watchesValuesSize = 0;
+		rightMotor.vm.descriptionHash = 0;
+		rightMotor.vm.randomState = 0;
 		modules.push_back(&rightMotor);
 
 		proximitySensors.vm.nodeId = 3;
 		proximitySensorVariables.id = 3;
 		proximitySensors.vm.variables = reinterpret_cast<int16_t *>(&proximitySensorVariables);
 		proximitySensors.vm.variablesSize = sizeof(proximitySensorVariables) / sizeof(int16_t);
+		proximitySensors.vm.variablesShadow = nullptr;
+		proximitySensors.vm.watches = nullptr;
+		proximitySensors.vm.watchesSize = 0;
+		proximitySensors.vm.watchesValues = nullptr;
+		proximitySensors.vm.watchesValuesSize = 0;
+		proximitySensors.vm.descriptionHash = 0;
+		proximitySensors.vm.randomState = 0;
 		modules.push_back(&proximitySensors);
 
 		distanceSensors.vm.nodeId = 4;
 		distanceSensorVariables.id = 4;
 		distanceSensors.vm.variables = reinterpret_cast<int16_t *>(&distanceSensorVariables);
 		distanceSensors.vm.variablesSize = sizeof(distanceSensorVariables) / sizeof(int16_t);
+		distanceSensors.vm.variablesShadow = nullptr;
+		distanceSensors.vm.watches = nullptr;
+		distanceSensors.vm.watchesSize = 0;
+		distanceSensors.vm.watchesValues = nullptr;
+		distanceSensors.vm.watchesValuesSize = 0;
+		distanceSensors.vm.descriptionHash = 0;
+		distanceSensors.vm.randomState = 0;
 		modules.push_back(&distanceSensors);
 
 		// fill map
@@ -26,6 +26,7 @@
 #include <typeinfo>
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include "AsebaGlue.h"
 #include "EnkiGlue.h"
@@ -34,9 +35,6 @@
 
 namespace Aseba
 {
-	// Mapping so that Aseba C callbacks can dispatch to the right objects
-	VMStateToEnvironment vmStateToEnvironment;
-
 	NamedRobot::NamedRobot(std::string robotName):
 		robotName(std::move(robotName))
 	{
@@ -48,6 +46,51 @@ namespace Aseba
 		NamedRobot(std::move(robotName))
 	{
 		vm.nodeId = nodeId;
+		vm.userData = &environment;
+		// enough for a few hosts watching a few variables each
+		watches.resize(16);
+		vm.watches = &watches[0];
+		vm.watchesSize = watches.size();
+		watchesValues.resize(1024);
+		vm.watchesValues = &watchesValues[0];
+		vm.watchesValuesSize = watchesValues.size();
+		// robots set it once their description is available
+		vm.descriptionHash = 0;
+		// each robot has its own generator, seeded from the global one so that seeding the latter makes runs reproducible
+		vm.randomState = static_cast<uint16_t>(std::rand());
+		environment.first = this;
+		environment.second = nullptr;
+	}
+
+	void SingleVMNodeGlue::controlOrDefer(double dt)
+	{
+		if (deferredControl)
+			deferredDt += dt;
+		else
+			asebaControlStep(dt);
+	}
+
+	void SingleVMNodeGlue::sendWatchedVariables(double dt)
+	{
+		// keep the fraction of ms for the next call, so that periods do not drift with small time steps
+		watchesTime += dt * 1000.;
+		const uint16_t elapsed(static_cast<uint16_t>(std::min(watchesTime, 65535.)));
+		watchesTime -= elapsed;
+		AsebaVMSendWatchedVariables(&vm, elapsed);
+	}
+
+	// AbstractNodeConnection
+
+	void AbstractNodeConnection::attach(SingleVMNodeGlue& node)
+	{
+		node.environment.second = this;
+		vms.push_back(&node.vm);
+	}
+
+	void AbstractNodeConnection::detach(SingleVMNodeGlue& node)
+	{
+		node.environment.second = nullptr;
+		vms.erase(std::remove(vms.begin(), vms.end(), &node.vm), vms.end());
 	}
 
 	// RecvBufferNodeConnection
@@ -75,7 +118,7 @@ extern "C" void AsebaPutVmToSleep(AsebaVMState *vm)
 
 extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8_t* data, uint16_t length)
 {
-	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.find(vm)->second);
+	const Aseba::NodeEnvironment& environment(Aseba::getNodeEnvironment(vm));
 	Aseba::AbstractNodeConnection* connection(environment.second);
 	assert(connection);
 	connection->sendBuffer(vm->nodeId, data, length);
@@ -83,7 +126,7 @@ extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8_t* data, uint16_t
 
 extern "C" uint16_t AsebaGetBuffer(AsebaVMState *vm, uint8_t* data, uint16_t maxLength, uint16_t* source)
 {
-	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.find(vm)->second);
+	const Aseba::NodeEnvironment& environment(Aseba::getNodeEnvironment(vm));
 	Aseba::AbstractNodeConnection* connection(environment.second);
 	assert(connection);
 	return connection->getBuffer(data, maxLength, source);
@@ -91,7 +134,7 @@ extern "C" uint16_t AsebaGetBuffer(AsebaVMState *vm, uint8_t* data, uint16_t max
 
 extern "C" const AsebaVMDescription* AsebaGetVMDescription(AsebaVMState *vm)
 {
-	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.find(vm)->second);
+	const Aseba::NodeEnvironment& environment(Aseba::getNodeEnvironment(vm));
 	const Aseba::AbstractNodeGlue* glue(environment.first);
 	assert(glue);
 	return glue->getDescription();
@@ -99,7 +142,7 @@ extern "C" const AsebaVMDescription* AsebaGetVMDescription(AsebaVMState *vm)
 
 extern "C" const AsebaLocalEventDescription * AsebaGetLocalEventsDescriptions(AsebaVMState *vm)
 {
-	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.find(vm)->second);
+	const Aseba::NodeEnvironment& environment(Aseba::getNodeEnvironment(vm));
 	const Aseba::AbstractNodeGlue* glue(environment.first);
 	assert(glue);
 	return glue->getLocalEventsDescriptions();
@@ -107,7 +150,7 @@ extern "C" const AsebaLocalEventDescription * AsebaGetLocalEventsDescriptions(As
 
 extern "C" const AsebaNativeFunctionDescription * const * AsebaGetNativeFunctionsDescriptions(AsebaVMState *vm)
 {
-	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.find(vm)->second);
+	const Aseba::NodeEnvironment& environment(Aseba::getNodeEnvironment(vm));
 	const Aseba::AbstractNodeGlue* glue(environment.first);
 	assert(glue);
 	return glue->getNativeFunctionsDescriptions();
@@ -115,7 +158,7 @@ extern "C" const AsebaNativeFunctionDescription * const * AsebaGetNativeFunction
 
 extern "C" void AsebaNativeFunction(AsebaVMState *vm, uint16_t id)
 {
-	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.find(vm)->second);
+	const Aseba::NodeEnvironment& environment(Aseba::getNodeEnvironment(vm));
 	Aseba::AbstractNodeGlue* glue(environment.first);
 	assert(glue);
 	glue->callNativeFunction(id);
@@ -133,7 +176,7 @@ extern "C" void AsebaResetIntoBootloader(AsebaVMState *vm)
 
 extern "C" void AsebaAssert(AsebaVMState *vm, AsebaAssertReason reason)
 {
-	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.find(vm)->second);
+	const Aseba::NodeEnvironment& environment(Aseba::getNodeEnvironment(vm));
 	const Aseba::AbstractNodeGlue* glue(environment.first);
 	assert(glue);
 	std::cerr << Aseba::FormatableString("\nFatal error: glue %0 with node id %1 of type %2 at has produced exception: ").arg(glue).arg(vm->nodeId).arg(typeid(glue).name()) << std::endl;
@@ -26,8 +26,8 @@
 #include "vm/natives.h"
 #include <valarray>
 #include <vector>
-#include <map>
 #include <string>
+#include <utility>
 
 namespace Aseba
 {
@@ -56,28 +56,61 @@ namespace Aseba
 		NamedRobot(std::string robotName);
 	};
 
+	struct AbstractNodeConnection;
+
+	// Mapping so that Aseba C callbacks can dispatch to the right objects, pointed to by the userData of each VM
+
+	typedef std::pair<AbstractNodeGlue*, AbstractNodeConnection*> NodeEnvironment;
+
+	//! Return the environment of a VM owned by a SingleVMNodeGlue
+	inline const NodeEnvironment& getNodeEnvironment(const AsebaVMState* vm)
+	{
+		return *static_cast<const NodeEnvironment*>(vm->userData);
+	}
+
 	struct SingleVMNodeGlue: NamedRobot, AbstractNodeGlue
 	{
 		// VM implementation
 		AsebaVMState vm;
 		std::valarray<unsigned short> bytecode;
 		std::valarray<signed short> stack;
+		std::valarray<signed short> variablesShadow; //!< copy of the variables last sent, to send only the changed ones
+		std::valarray<AsebaVMWatch> watches; //!< variables sent when they change
+		std::valarray<signed short> watchesValues; //!< copies of the watched variables last sent, to detect all their changes
+		double watchesTime = 0; //!< time in ms not yet passed to AsebaVMSendWatchedVariables()
+		NodeEnvironment environment; //!< this glue and the connection of the VM, set as userData of vm
+
+		// Control, run within the physics step or deferred to run in parallel with other robots
+		bool deferredControl = false; //!< whether the Aseba control step is deferred, see Enki::ParallelControl
+		double deferredDt = 0; //!< time elapsed since the last deferred Aseba control step
 
 		SingleVMNodeGlue(std::string robotName, int16_t nodeId);
+
+		//! Read sensors, run the VM and write actuators; must only touch this robot, as robots might be stepped in parallel
+		virtual void asebaControlStep(double dt) = 0;
+
+	protected:
+		//! Run the Aseba control step now, or accumulate dt until it is run if deferred
+		void controlOrDefer(double dt);
+		//! Send the watched variables that changed, dt seconds after the previous call
+		void sendWatchedVariables(double dt);
 	};
 
 	struct AbstractNodeConnection
 	{
-		virtual void sendBuffer(uint16_t nodeId, const uint8_t* data, uint16_t length) = 0;
-		virtual uint16_t getBuffer(uint8_t* data, uint16_t maxLength, uint16_t* source) = 0;
-	};
+		std::vector<AsebaVMState*> vms; //!< VMs linked to this connection, which receive its messages
 
-	// Mapping so that Aseba C callbacks can dispatch to the right objects
+		// default virtual destructor
+		virtual ~AbstractNodeConnection() = default;
 
-	typedef std::pair<AbstractNodeGlue*, AbstractNodeConnection*> NodeEnvironment;
-	typedef std::map<AsebaVMState*, NodeEnvironment> VMStateToEnvironment;
+		//! Link the VM of node to this connection
+		virtual void attach(SingleVMNodeGlue& node);
+		//! Unlink the VM of node from this connection
+		virtual void detach(SingleVMNodeGlue& node);
 
-	extern VMStateToEnvironment vmStateToEnvironment;
+		virtual void sendBuffer(uint16_t nodeId, const uint8_t* data, uint16_t length) = 0;
+		virtual uint16_t getBuffer(uint8_t* data, uint16_t maxLength, uint16_t* source) = 0;
+	};
 
 	// Buffer for data reception
 
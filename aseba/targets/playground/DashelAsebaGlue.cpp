@@ -22,6 +22,7 @@
 #include "EnkiGlue.h"
 #include "common/utils/FormatableString.h"
 #include "transport/buffer/vm-buffer.h"
+#include <algorithm>
 
 namespace Aseba
 {
@@ -106,13 +107,10 @@ namespace Aseba
 			stream->read(&lastMessageData[0], lastMessageData.size());
 
 			// execute event on all VM that are linked to this connection
-			for (auto vmStateToEnvironmentKV: vmStateToEnvironment)
+			for (auto vm: vms)
 			{
-				if (vmStateToEnvironmentKV.second.second == this)
-				{
-					AsebaProcessIncomingEvents(vmStateToEnvironmentKV.first);
-					AsebaVMRun(vmStateToEnvironmentKV.first, 1000);
-				}
+				AsebaProcessIncomingEvents(vm);
+				AsebaVMRun(vm, 1000);
 			}
 		}
 		catch (Dashel::DashelException e)
@@ -142,11 +140,8 @@ namespace Aseba
 	//! Clear breakpoints on all VM that are linked to this connection
 	void SimpleDashelConnection::clearBreakpoints()
 	{
-		for (auto vmStateToEnvironmentKV: vmStateToEnvironment)
-		{
-			if (vmStateToEnvironmentKV.second.second == this)
-				vmStateToEnvironmentKV.first->breakpointsCount = 0;
-		}
+		for (auto vm: vms)
+			vm->breakpointsCount = 0;
 	}
 
 	//! Disconnect old streams
@@ -160,4 +155,146 @@ namespace Aseba
 		toDisconnect.clear();
 	}
 
+	// MultiplexedDashelConnection
+
+	MultiplexedDashelConnection::MultiplexedDashelConnection(unsigned port)
+	{
+		try
+		{
+			listenStream = Dashel::Hub::connect(FormatableString("tcpin:port=%0").arg(port));
+		}
+		catch (const Dashel::DashelException& e)
+		{
+			SEND_NOTIFICATION(FATAL_ERROR, "cannot create listening port", std::to_string(port), e.what());
+			abort();
+		}
+	}
+
+	void MultiplexedDashelConnection::networkStep()
+	{
+		// deliver the events emitted by robots during the last step; events emitted while delivering wait for the next step
+		std::vector<LocalEvent> events;
+		events.swap(localEvents);
+		for (const auto& event: events)
+		{
+			const auto sourceIt(vmsByNodeId.find(event.source));
+			deliverMessage(event.source, event.data.data(), event.data.size(), sourceIt != vmsByNodeId.end() ? sourceIt->second : nullptr);
+		}
+
+		// process messages from clients
+		Hub::step();
+	}
+
+	void MultiplexedDashelConnection::attach(SingleVMNodeGlue& node)
+	{
+		if (vmsByNodeId.find(node.vm.nodeId) != vmsByNodeId.end())
+			SEND_NOTIFICATION(LOG_WARNING, "several robots share the same node id", std::to_string(node.vm.nodeId));
+		RecvBufferNodeConnection::attach(node);
+		vmsByNodeId[node.vm.nodeId] = &node.vm;
+	}
+
+	void MultiplexedDashelConnection::detach(SingleVMNodeGlue& node)
+	{
+		RecvBufferNodeConnection::detach(node);
+		auto vmIt(vmsByNodeId.find(node.vm.nodeId));
+		if (vmIt != vmsByNodeId.end() && vmIt->second == &node.vm)
+			vmsByNodeId.erase(vmIt);
+	}
+
+	void MultiplexedDashelConnection::sendBuffer(uint16_t nodeId, const uint8_t* data, uint16_t length)
+	{
+		// user events are also heard by the other robots of the world
+		const uint16_t type(data[0] | (data[1] << 8));
+		if (type < 0x8000)
+			localEvents.push_back({ nodeId, std::vector<uint8_t>(data, data + length) });
+
+		for (auto stream: dataStreams)
+		{
+			try
+			{
+				uint16_t temp;
+				temp = bswap16(length - 2);
+				stream->write(&temp, 2);
+				temp = bswap16(nodeId);
+				stream->write(&temp, 2);
+				stream->write(data, length);
+				stream->flush();
+			}
+			catch (const Dashel::DashelException& e)
+			{
+				SEND_NOTIFICATION(LOG_ERROR, "cannot write to socket", stream->getTargetName(), e.what());
+			}
+		}
+	}
+
+	void MultiplexedDashelConnection::connectionCreated(Dashel::Stream *stream)
+	{
+		SEND_NOTIFICATION(LOG_INFO, "new client connected", stream->getTargetName());
+	}
+
+	void MultiplexedDashelConnection::incomingData(Dashel::Stream *stream)
+	{
+		try
+		{
+			uint16_t temp;
+			stream->read(&temp, 2);
+			const uint16_t len(bswap16(temp));
+			stream->read(&temp, 2);
+			const uint16_t source(bswap16(temp));
+			std::vector<uint8_t> data(len + 2);
+			stream->read(&data[0], data.size());
+			deliverMessage(source, data.data(), data.size());
+		}
+		catch (const Dashel::DashelException& e)
+		{
+			SEND_NOTIFICATION(LOG_ERROR, "cannot read from socket", stream->getTargetName(), e.what());
+		}
+	}
+
+	void MultiplexedDashelConnection::connectionClosed(Dashel::Stream *stream, bool abnormal)
+	{
+		// the client might have set breakpoints, clear them so that robots do not stay stuck
+		for (auto vm: vms)
+			vm->breakpointsCount = 0;
+		if (abnormal)
+		{
+			SEND_NOTIFICATION(LOG_WARNING, "client disconnected abnormally", stream->getTargetName());
+		}
+		else
+		{
+			SEND_NOTIFICATION(LOG_INFO, "client disconnected properly", stream->getTargetName());
+		}
+	}
+
+	//! Deliver a message to the VM it is addressed to, or if it is not addressed to a specific node, to all VMs but except
+	void MultiplexedDashelConnection::deliverMessage(uint16_t source, const uint8_t* data, size_t length, AsebaVMState* except)
+	{
+		lastMessageSource = source;
+		lastMessageData.resize(length);
+		std::copy(data, data + length, std::begin(lastMessageData));
+
+		// messages from IDE to a specific node carry their destination first
+		const uint16_t type(data[0] | (data[1] << 8));
+		const bool isCommand(type >= ASEBA_MESSAGE_SET_BYTECODE && type != ASEBA_MESSAGE_LIST_NODES);
+		if (isCommand && length >= 4)
+		{
+			const uint16_t dest(data[2] | (data[3] << 8));
+			const auto vmIt(vmsByNodeId.find(dest));
+			if (vmIt != vmsByNodeId.end())
+			{
+				AsebaProcessIncomingEvents(vmIt->second);
+				AsebaVMRun(vmIt->second, 1000);
+			}
+			return;
+		}
+
+		for (auto vm: vms)
+		{
+			if (vm == except)
+				continue;
+			AsebaProcessIncomingEvents(vm);
+			AsebaVMRun(vm, 1000);
+		}
+	}
+
 } // namespace Aseba
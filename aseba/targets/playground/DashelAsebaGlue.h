@@ -24,6 +24,8 @@
 #include "AsebaGlue.h"
 #include "EnkiGlue.h"
 #include <dashel/dashel.h>
+#include <map>
+#include <vector>
 
 #ifdef ZEROCONF_SUPPORT
 #include "common/zeroconf/zeroconf-qt.h"
@@ -54,6 +56,46 @@ namespace Aseba
 		void closeOldStreams();
 	};
 
+	//! A connection through a single port for all robots of a world, delivering messages to their VMs by node id
+	/**
+		Several clients can connect at the same time, all of them receive the messages of all robots.
+		Events emitted by a robot are also delivered to the other robots of the world, at the next network step.
+	*/
+	class MultiplexedDashelConnection: public RecvBufferNodeConnection, public Dashel::Hub
+	{
+	protected:
+		//! An event emitted by a robot, to deliver to the other robots
+		struct LocalEvent
+		{
+			uint16_t source;
+			std::vector<uint8_t> data;
+		};
+
+		Dashel::Stream* listenStream = nullptr;
+		std::map<uint16_t, AsebaVMState*> vmsByNodeId; //!< VMs by node id, to deliver messages to a specific node directly
+		std::vector<LocalEvent> localEvents; //!< events emitted by robots since the last network step
+
+	public:
+		MultiplexedDashelConnection(unsigned port);
+
+		//! Process messages from clients and events between robots, to be called once per physics step
+		void networkStep();
+
+		//! Return the stream listening for clients
+		Dashel::Stream* getListenStream() const { return listenStream; }
+
+		void attach(SingleVMNodeGlue& node) override;
+		void detach(SingleVMNodeGlue& node) override;
+		void sendBuffer(uint16_t nodeId, const uint8_t* data, uint16_t length) override;
+
+	protected:
+		void connectionCreated(Dashel::Stream *stream) override;
+		void incomingData(Dashel::Stream *stream) override;
+		void connectionClosed(Dashel::Stream *stream, bool abnormal) override;
+
+		void deliverMessage(uint16_t source, const uint8_t* data, size_t length, AsebaVMState* except = nullptr);
+	};
+
 } // namespace Aseba
 
 
@@ -78,7 +120,7 @@ namespace Enki
 			Aseba::SimpleDashelConnection(port)
 #endif // ZEROCONF_SUPPORT
 		{
-			Aseba::vmStateToEnvironment[&this->vm] = std::make_pair((Aseba::AbstractNodeGlue*)this, (Aseba::AbstractNodeConnection *)this);
+			this->attach(*this);
 #ifdef ZEROCONF_SUPPORT
 			updateZeroconfStatus();
 #endif // ZEROCONF_SUPPORT
@@ -86,7 +128,7 @@ namespace Enki
 
 		virtual ~DashelConnected()
 		{
-			Aseba::vmStateToEnvironment.erase(&this->vm);
+			this->detach(*this);
 		}
 
 	protected:
@@ -136,6 +178,35 @@ namespace Enki
 #endif // ZEROCONF_SUPPORT
 	};
 
+	//! A robot sharing the connection of its world with other robots
+	template<typename AsebaRobot>
+	class MultiplexedConnected: public AsebaRobot
+	{
+	public:
+		template<typename... Params>
+		MultiplexedConnected(Aseba::MultiplexedDashelConnection& connection, Params... parameters):
+			AsebaRobot(parameters...),
+			connection(connection)
+		{
+			connection.attach(*this);
+		}
+
+		virtual ~MultiplexedConnected()
+		{
+			connection.detach(*this);
+		}
+
+	protected:
+		Aseba::MultiplexedDashelConnection& connection;
+
+		// from AbstractNodeGlue
+
+		virtual void externalInputStep(double dt) override
+		{
+			// nothing to do, the connection is stepped once for all robots
+		}
+	};
+
 } // namespace Enki
 
 
@@ -57,12 +57,12 @@ namespace Enki
 		DirectlyConnected(Params... parameters):
 			AsebaRobot(parameters...)
 		{
-			Aseba::vmStateToEnvironment[&this->vm] = std::make_pair((Aseba::AbstractNodeGlue*)this, (Aseba::AbstractNodeConnection *)this);
+			this->attach(*this);
 		}
 
 		virtual ~DirectlyConnected()
 		{
-			Aseba::vmStateToEnvironment.erase(&this->vm);
+			this->detach(*this);
 		}
 
 	protected:
@@ -83,13 +83,10 @@ namespace Enki
 				std::copy(&content.rawData[0], &content.rawData[content.rawData.size()], &lastMessageData[2]);
 
 				// execute event on all VM that are linked to this connection
-				for (auto vmStateToEnvironmentKV: Aseba::vmStateToEnvironment)
+				for (auto vm: vms)
 				{
-					if (vmStateToEnvironmentKV.second.second == this)
-					{
-						AsebaProcessIncomingEvents(vmStateToEnvironmentKV.first);
-						AsebaVMRun(vmStateToEnvironmentKV.first, 1000);
-					}
+					AsebaProcessIncomingEvents(vm);
+					AsebaVMRun(vm, 1000);
 				}
 
 				// delete message
@@ -26,6 +26,7 @@
 #include <vector>
 #include <enki/PhysicalEngine.h>
 #include "vm/vm.h"
+#include "AsebaGlue.h"
 #include "common/utils/utils.h"
 
 namespace Enki
@@ -70,18 +71,9 @@ namespace Enki
 	template<typename ObjectType>
 	ObjectType *getEnkiObject(AsebaVMState *vm)
 	{
-		if (!Enki::simulatorEnvironment)
+		if (!vm->userData)
 			return nullptr;
-		World* world(Enki::simulatorEnvironment->getWorld());
-		if (!world)
-			return nullptr;
-		for (World::ObjectsIterator objectIt = world->objects.begin(); objectIt != world->objects.end(); ++objectIt)
-		{
-			ObjectType *enkiObject = dynamic_cast<ObjectType*>(*objectIt);
-			if (enkiObject && (&(enkiObject->vm) == vm))
-				return enkiObject;
-		}
-		return nullptr;
+		return dynamic_cast<ObjectType*>(Aseba::getNodeEnvironment(vm).first);
 	}
 
 } // namespace Enki
@@ -0,0 +1,108 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalEventQueue.h"
+#include "common/consts.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace Aseba
+{
+	LocalEventQueue::LocalEventQueue(AsebaVMState& vm, std::vector<uint16_t> priorityOrder):
+		vm(vm),
+		priorityOrder(std::move(priorityOrder))
+	{
+		for (const auto number: this->priorityOrder)
+		{
+			assert(number < 32);
+			scheduled |= uint32_t(1) << number;
+		}
+	}
+
+	void LocalEventQueue::post(uint16_t number)
+	{
+		assert(number < 32);
+		++statistics.posted;
+
+		if (preemptive)
+		{
+			// in step-by-step, only setup an event if none is being executed currently
+			if (AsebaMaskIsSet(vm.flags, ASEBA_VM_STEP_BY_STEP_MASK) && AsebaMaskIsSet(vm.flags, ASEBA_VM_EVENT_ACTIVE_MASK))
+				return;
+			const bool wasActive(AsebaMaskIsSet(vm.flags, ASEBA_VM_EVENT_ACTIVE_MASK));
+			if (AsebaVMSetupEvent(&vm, ASEBA_EVENT_LOCAL_EVENTS_START-number))
+			{
+				++statistics.executed;
+				if (wasActive)
+					++statistics.killed;
+			}
+			AsebaVMRun(&vm, 1000);
+			return;
+		}
+
+		const uint32_t bit((uint32_t(1) << number) & scheduled);
+		if (pending & bit)
+			++statistics.coalesced;
+		pending |= bit;
+	}
+
+	void LocalEventQueue::run(double dt)
+	{
+		// in preemptive mode, events have run when posted
+		if (preemptive)
+			return;
+
+		// unused budget is not kept, otherwise an idle VM would accumulate it for later bursts
+		budget = std::min(budget, 0.) + dt * stepsPerSecond;
+
+		while (budget > 0)
+		{
+			if (AsebaMaskIsClear(vm.flags, ASEBA_VM_EVENT_ACTIVE_MASK) && !startNextEvent())
+				return;
+			// in step-by-step, the debugger runs the event
+			if (AsebaMaskIsSet(vm.flags, ASEBA_VM_STEP_BY_STEP_MASK))
+				return;
+			const uint16_t slice(static_cast<uint16_t>(std::min<double>(sliceSteps, std::ceil(budget))));
+			AsebaVMRun(&vm, slice);
+			budget -= slice;
+		}
+
+		if (pending || AsebaMaskIsSet(vm.flags, ASEBA_VM_EVENT_ACTIVE_MASK))
+			++statistics.overruns;
+	}
+
+	//! Start the pending event of highest priority that the VM handles, return false if none
+	bool LocalEventQueue::startNextEvent()
+	{
+		for (const auto number: priorityOrder)
+		{
+			const uint32_t bit(uint32_t(1) << number);
+			if (!(pending & bit))
+				continue;
+			pending &= ~bit;
+			if (AsebaVMSetupEvent(&vm, ASEBA_EVENT_LOCAL_EVENTS_START-number))
+			{
+				++statistics.executed;
+				return true;
+			}
+		}
+		return false;
+	}
+} // Aseba
@@ -0,0 +1,90 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PLAYGROUND_LOCAL_EVENT_QUEUE_H
+#define __PLAYGROUND_LOCAL_EVENT_QUEUE_H
+
+#include "vm/vm.h"
+#include <cstdint>
+#include <vector>
+
+namespace Aseba
+{
+	//! Pending local events of a VM, executed by priority within a budget of VM steps, as the firmware of real robots does
+	/**
+		A local event posted while the VM is busy does not kill the running event,
+		but is marked as pending. Posting an event already pending coalesces it with
+		the pending one, so the queue is bounded by the number of local events.
+		When the VM is idle, run() starts the pending event of highest priority.
+
+		run() grants the VM a budget of steps proportional to the simulated time,
+		and runs it in slices of sliceSteps steps. A slice is charged in full even if
+		the event finishes earlier, and the overdraft is carried to the next call.
+		Thus, a large time step runs the same events as several small ones, and an
+		event longer than its budget continues at the next call instead of being killed.
+
+		In preemptive mode, posting an event kills the running one and executes the
+		new one immediately, which was the former behaviour of the playground.
+	*/
+	class LocalEventQueue
+	{
+	public:
+		//! Counters of what happened to posted events
+		struct Statistics
+		{
+			unsigned posted = 0; //!< events posted
+			unsigned coalesced = 0; //!< events posted while already pending
+			unsigned executed = 0; //!< events started on the VM
+			unsigned killed = 0; //!< running events killed by a new event, in preemptive mode
+			unsigned overruns = 0; //!< calls to run() that ended with work left because the budget was exhausted
+		};
+
+	public:
+		bool preemptive = false; //!< whether posted events kill the running one and execute immediately
+		double stepsPerSecond = 100000; //!< VM steps granted per simulated second
+		uint16_t sliceSteps = 32; //!< VM steps run between checks of the budget
+
+	public:
+		//! Create a queue for vm, priorityOrder lists local event numbers, highest priority first; events not listed are ignored
+		LocalEventQueue(AsebaVMState& vm, std::vector<uint16_t> priorityOrder);
+
+		//! Post local event number, executing it immediately in preemptive mode
+		void post(uint16_t number);
+		//! Execute pending events within the budget of dt simulated seconds
+		void run(double dt);
+
+		//! Return whether local event number is pending
+		bool isPending(uint16_t number) const { return (pending & (uint32_t(1) << number)) != 0; }
+		//! Return the counters of events posted so far
+		const Statistics& getStatistics() const { return statistics; }
+
+	protected:
+		bool startNextEvent();
+
+	protected:
+		AsebaVMState& vm;
+		const std::vector<uint16_t> priorityOrder;
+		uint32_t scheduled = 0; //!< bit i is set if local event i is in priorityOrder
+		uint32_t pending = 0; //!< bit i is set if local event i is pending
+		double budget = 0; //!< VM steps left, negative if the last slice overdrew it
+		Statistics statistics;
+	};
+} // Aseba
+
+#endif // __PLAYGROUND_LOCAL_EVENT_QUEUE_H
@@ -0,0 +1,104 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ParallelControl.h"
+#include <algorithm>
+
+namespace Enki
+{
+	ParallelControl::ParallelControl(unsigned threadCount):
+		nextNode(0)
+	{
+		for (unsigned i = 1; i < std::max(threadCount, 1u); ++i)
+			threads.emplace_back(&ParallelControl::worker, this);
+	}
+
+	ParallelControl::~ParallelControl()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		startCondition.notify_all();
+		for (auto& thread: threads)
+			thread.join();
+	}
+
+	void ParallelControl::step(World* world, double dt)
+	{
+		// collect robots and make sure their control is deferred, so that the physics step only accumulates time
+		nodes.clear();
+		for (auto object: world->objects)
+		{
+			auto node(dynamic_cast<Aseba::SingleVMNodeGlue*>(object));
+			if (node)
+			{
+				node->deferredControl = true;
+				nodes.push_back(node);
+			}
+		}
+
+		// physics
+		world->step(dt);
+
+		// control, the calling thread takes part in it as well
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			nextNode = 0;
+			busyThreads = threads.size();
+			++phase;
+		}
+		startCondition.notify_all();
+		runNodes();
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this]() { return busyThreads == 0; });
+	}
+
+	void ParallelControl::worker()
+	{
+		unsigned lastPhase(0);
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				startCondition.wait(lock, [&]() { return quit || phase != lastPhase; });
+				if (quit)
+					return;
+				lastPhase = phase;
+			}
+			runNodes();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--busyThreads;
+			}
+			doneCondition.notify_one();
+		}
+	}
+
+	//! Step robots until none is left in this control phase
+	void ParallelControl::runNodes()
+	{
+		for (size_t i = nextNode++; i < nodes.size(); i = nextNode++)
+		{
+			Aseba::SingleVMNodeGlue* node(nodes[i]);
+			node->asebaControlStep(node->deferredDt);
+			node->deferredDt = 0;
+		}
+	}
+} // Enki
@@ -0,0 +1,76 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PLAYGROUND_PARALLEL_CONTROL_H
+#define __PLAYGROUND_PARALLEL_CONTROL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <enki/PhysicalEngine.h>
+#include "AsebaGlue.h"
+
+namespace Enki
+{
+	//! Step a world, running the Aseba control of its robots in parallel between physics steps
+	/**
+		Robots of the world stepped through this object defer their Aseba control step
+		(reading sensors, running the VM, writing actuators), which is then run for all
+		robots on a pool of threads once the physics step is over. Each thread takes the
+		next robot not yet processed, so that threads finishing early take work from the
+		others. As a consequence, actuator commands are applied at the next physics step.
+
+		Robots must only touch their own state during their Aseba control step, and the
+		simulator environment must be thread-safe, as native functions might notify it
+		from several threads at the same time.
+	*/
+	class ParallelControl
+	{
+	public:
+		//! Create a pool of threadCount threads, including the calling one
+		explicit ParallelControl(unsigned threadCount = std::thread::hardware_concurrency());
+		~ParallelControl();
+
+		//! Step the physics of world by dt, then run the Aseba control step of all its robots in parallel
+		void step(World* world, double dt);
+
+		//! Return the number of threads running the control steps, including the calling one
+		unsigned getThreadCount() const { return threads.size() + 1; }
+
+	protected:
+		void worker();
+		void runNodes();
+
+	protected:
+		std::vector<Aseba::SingleVMNodeGlue*> nodes; //!< robots to step during the current control phase
+		std::atomic<size_t> nextNode; //!< index in nodes of the next robot to step
+
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable startCondition; //!< signaled when a control phase starts or when quitting
+		std::condition_variable doneCondition; //!< signaled when a thread has finished its part of the control phase
+		unsigned phase = 0; //!< number of control phases started so far
+		unsigned busyThreads = 0; //!< number of threads still working on the current control phase
+		bool quit = false;
+	};
+} // Enki
+
+#endif // __PLAYGROUND_PARALLEL_CONTROL_H
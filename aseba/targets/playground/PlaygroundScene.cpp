@@ -0,0 +1,237 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PlaygroundScene.h"
+#include "Door.h"
+#include "robots/e-puck/EPuck.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QMap>
+#include <QtDebug>
+#include <iostream>
+#include <iterator>
+
+namespace Enki
+{
+	World* createPlaygroundWorld(const QDomDocument& domDocument, const QString& sceneFileName)
+	{
+		// Scan for colors
+		typedef QMap<QString, Color> ColorsMap;
+		ColorsMap colorsMap;
+		QDomElement colorE = domDocument.documentElement().firstChildElement("color");
+		while (!colorE.isNull())
+		{
+			colorsMap[colorE.attribute("name")] = Color(
+				colorE.attribute("r").toDouble(),
+				colorE.attribute("g").toDouble(),
+				colorE.attribute("b").toDouble()
+			);
+
+			colorE = colorE.nextSiblingElement ("color");
+		}
+
+		// Scan for areas
+		typedef QMap<QString, Polygon> AreasMap;
+		AreasMap areasMap;
+		QDomElement areaE = domDocument.documentElement().firstChildElement("area");
+		while (!areaE.isNull())
+		{
+			Polygon p;
+			QDomElement pointE = areaE.firstChildElement("point");
+			while (!pointE.isNull())
+			{
+				p.push_back(Point(
+					pointE.attribute("x").toDouble(),
+					pointE.attribute("y").toDouble()
+				));
+				pointE = pointE.nextSiblingElement ("point");
+			}
+			areasMap[areaE.attribute("name")] = p;
+			areaE = areaE.nextSiblingElement ("area");
+		}
+
+		// Create the world
+		QDomElement worldE = domDocument.documentElement().firstChildElement("world");
+		Color worldColor(Color::gray);
+		if (!colorsMap.contains(worldE.attribute("color")))
+			std::cerr << "Warning, world walls color " << worldE.attribute("color").toStdString() << " undefined\n";
+		else
+			worldColor = colorsMap[worldE.attribute("color")];
+		World::GroundTexture groundTexture;
+		if (worldE.hasAttribute("groundTexture"))
+		{
+			const QString groundTextureFileName(QFileInfo(sceneFileName).absolutePath() + QDir::separator() + worldE.attribute("groundTexture"));
+			QImage image(groundTextureFileName);
+			if (!image.isNull())
+			{
+				// flip vertically as y-coordinate is inverted in an image
+				image = image.mirrored();
+				// convert to a specific format and copy the underlying data to Enki
+				image = image.convertToFormat(QImage::Format_ARGB32);
+				groundTexture.width = image.width();
+				groundTexture.height = image.height();
+				const uint32_t* imageData(reinterpret_cast<const uint32_t*>(image.constBits()));
+				std::copy(imageData, imageData+image.width()*image.height(), std::back_inserter(groundTexture.data));
+				// Note: this works in little endian, in big endian data should be swapped
+			}
+			else
+			{
+				qDebug() << "Could not load ground texture file named" << groundTextureFileName;
+			}
+		}
+		World* world(new World(
+			worldE.attribute("w").toDouble(),
+			worldE.attribute("h").toDouble(),
+			worldColor,
+			groundTexture
+		));
+
+		// Scan for walls
+		QDomElement wallE = domDocument.documentElement().firstChildElement("wall");
+		while (!wallE.isNull())
+		{
+			PhysicalObject* wall = new PhysicalObject();
+			if (!colorsMap.contains(wallE.attribute("color")))
+				std::cerr << "Warning, color " << wallE.attribute("color").toStdString() << " undefined\n";
+			else
+				wall->setColor(colorsMap[wallE.attribute("color")]);
+			wall->pos.x = wallE.attribute("x").toDouble();
+			wall->pos.y = wallE.attribute("y").toDouble();
+			wall->setRectangular(
+				wallE.attribute("l1").toDouble(),
+				wallE.attribute("l2").toDouble(),
+				wallE.attribute("h").toDouble(),
+				!wallE.attribute("mass").isNull() ? wallE.attribute("mass").toDouble() : -1 // normally -1 because immobile
+			);
+			if (! wallE.attribute("angle").isNull())
+				wall->angle = wallE.attribute("angle").toDouble(); // radians
+			world->addObject(wall);
+
+			wallE  = wallE.nextSiblingElement ("wall");
+		}
+
+		// Scan for cylinders
+		QDomElement cylinderE = domDocument.documentElement().firstChildElement("cylinder");
+		while (!cylinderE.isNull())
+		{
+			PhysicalObject* cylinder = new PhysicalObject();
+			if (!colorsMap.contains(cylinderE.attribute("color")))
+				std::cerr << "Warning, color " << cylinderE.attribute("color").toStdString() << " undefined\n";
+			else
+				cylinder->setColor(colorsMap[cylinderE.attribute("color")]);
+			cylinder->pos.x = cylinderE.attribute("x").toDouble();
+			cylinder->pos.y = cylinderE.attribute("y").toDouble();
+			cylinder->setCylindric(
+				cylinderE.attribute("r").toDouble(), 
+				cylinderE.attribute("h").toDouble(),
+				!cylinderE.attribute("mass").isNull() ? cylinderE.attribute("mass").toDouble() : -1 // normally -1 because immobile
+			);
+			world->addObject(cylinder);
+
+			cylinderE = cylinderE.nextSiblingElement("cylinder");
+		}
+
+		// Scan for feeders
+		QDomElement feederE = domDocument.documentElement().firstChildElement("feeder");
+		while (!feederE.isNull())
+		{
+			EPuckFeeder* feeder = new EPuckFeeder;
+			feeder->pos.x = feederE.attribute("x").toDouble();
+			feeder->pos.y = feederE.attribute("y").toDouble();
+			world->addObject(feeder);
+
+			feederE = feederE.nextSiblingElement ("feeder");
+		}
+		// TODO: if needed, custom color to feeder
+
+		// Scan for doors
+		typedef QMap<QString, SlidingDoor*> DoorsMap;
+		DoorsMap doorsMap;
+		QDomElement doorE = domDocument.documentElement().firstChildElement("door");
+		while (!doorE.isNull())
+		{
+			SlidingDoor *door = new SlidingDoor(
+				Point(
+					doorE.attribute("closedX").toDouble(),
+					doorE.attribute("closedY").toDouble()
+				),
+				Point(
+					doorE.attribute("openedX").toDouble(),
+					doorE.attribute("openedY").toDouble()
+				),
+				Point(
+					doorE.attribute("l1").toDouble(),
+					doorE.attribute("l2").toDouble()
+				),
+				doorE.attribute("h").toDouble(),
+				doorE.attribute("moveDuration").toDouble()
+			);
+			if (!colorsMap.contains(doorE.attribute("color")))
+				std::cerr << "Warning, door color " << doorE.attribute("color").toStdString() << " undefined\n";
+			else
+				door->setColor(colorsMap[doorE.attribute("color")]);
+			doorsMap[doorE.attribute("name")] = door;
+			world->addObject(door);
+
+			doorE = doorE.nextSiblingElement ("door");
+		}
+
+		// Scan for activation, and link them with areas and doors
+		QDomElement activationE = domDocument.documentElement().firstChildElement("activation");
+		while (!activationE.isNull())
+		{
+			if (areasMap.find(activationE.attribute("area")) == areasMap.end())
+			{
+				std::cerr << "Warning, area " << activationE.attribute("area").toStdString() << " undefined\n";
+				activationE = activationE.nextSiblingElement ("activation");
+				continue;
+			}
+
+			if (doorsMap.find(activationE.attribute("door")) == doorsMap.end())
+			{
+				std::cerr << "Warning, door " << activationE.attribute("door").toStdString() << " undefined\n";
+				activationE = activationE.nextSiblingElement ("activation");
+				continue;
+			}
+
+			const Polygon& area = *areasMap.find(activationE.attribute("area"));
+			Door* door = *doorsMap.find(activationE.attribute("door"));
+
+			DoorButton* activation = new DoorButton(
+				Point(
+					activationE.attribute("x").toDouble(),
+					activationE.attribute("y").toDouble()
+				),
+				Point(
+					activationE.attribute("l1").toDouble(),
+					activationE.attribute("l2").toDouble()
+				),
+				area,
+				door
+			);
+
+			world->addObject(activation);
+
+			activationE = activationE.nextSiblingElement ("activation");
+		}
+
+		return world;
+	}
+} // Enki
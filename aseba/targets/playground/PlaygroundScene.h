@@ -0,0 +1,37 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PLAYGROUND_SCENE_H
+#define __PLAYGROUND_SCENE_H
+
+#include <enki/PhysicalEngine.h>
+#include <QDomDocument>
+#include <QString>
+
+namespace Enki
+{
+	//! Create the world described by a playground scene, with its walls, cylinders, feeders, doors and activations, but without robots
+	/**
+		sceneFileName is used to resolve the ground texture relatively to the scene.
+		The caller owns the returned world.
+	*/
+	World* createPlaygroundWorld(const QDomDocument& domDocument, const QString& sceneFileName);
+} // Enki
+
+#endif // __PLAYGROUND_SCENE_H
@@ -283,6 +283,9 @@ namespace Enki
 		if (asebaObject)
 			asebaObject->externalInputStep(double(timerPeriodMs)/1000.);
 
+		if (networkStep)
+			networkStep();
+
 		ViewerWidget::timerEvent(event);
 	}
 
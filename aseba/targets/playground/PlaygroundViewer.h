@@ -51,6 +51,7 @@ namespace Enki
 		bool energyScoringSystemEnabled;
 		unsigned logPos;
 		unsigned energyPool;
+		std::function<void()> networkStep; //!< if set, called before each step of the world, to process the network of all robots at once
 
 	public:
 		PlaygroundViewer(World* world, bool energyScoringSystemEnabled = false);
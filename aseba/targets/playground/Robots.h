@@ -35,6 +35,9 @@ namespace Enki
 
 	typedef DashelConnected<AsebaThymio2> DashelAsebaThymio2;
 	typedef DashelConnected<AsebaFeedableEPuck> DashelAsebaFeedableEPuck;
+
+	typedef MultiplexedConnected<AsebaThymio2> MultiplexedAsebaThymio2;
+	typedef MultiplexedConnected<AsebaFeedableEPuck> MultiplexedAsebaFeedableEPuck;
 }
 
 #endif // __PLAYGROUND_ROBOTS_H
@@ -0,0 +1,565 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/consts.h"
+#include "common/msg/msg.h"
+#include "common/msg/NodesManager.h"
+#include "compiler/compiler.h"
+#include "compiler/compilation-cache.h"
+#include "DirectAsebaGlue.h"
+#include "ParallelControl.h"
+#include "PlaygroundScene.h"
+#include "robots/thymio2/Thymio2.h"
+#include "robots/e-puck/EPuck.h"
+#include <enki/Random.h>
+#include <enki/robots/DifferentialWheeled.h>
+#include <QCoreApplication>
+#include <QDomDocument>
+#include <QFile>
+#include <QStringList>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Enki
+{
+	//! The simulator environment when running without viewer, logging to the standard error
+	class HeadlessSimulatorEnvironment: public SimulatorEnvironment
+	{
+	public:
+		World& world;
+		const bool verbose;
+		std::mutex logMutex; //!< robots might notify from several threads
+
+	public:
+		HeadlessSimulatorEnvironment(World& world, bool verbose):
+			world(world),
+			verbose(verbose)
+		{}
+
+		virtual void notify(const EnvironmentNotificationType type, const std::string& description, const strings& arguments) override
+		{
+			if (!verbose && (type == EnvironmentNotificationType::DISPLAY_INFO || type == EnvironmentNotificationType::LOG_INFO))
+				return;
+			std::lock_guard<std::mutex> lock(logMutex);
+			std::cerr << description;
+			for (const auto& argument: arguments)
+				std::cerr << " " << argument;
+			std::cerr << std::endl;
+		}
+
+		virtual std::string getSDFilePath(const std::string& robotName, unsigned fileNumber) const override
+		{
+			return robotName + "-U" + std::to_string(fileNumber) + ".DAT";
+		}
+
+		virtual World* getWorld() const override
+		{
+			return &world;
+		}
+	};
+} // namespace Enki
+
+namespace Aseba
+{
+	using namespace std;
+
+	/**
+	\defgroup headless Headless playground
+	*/
+	/*@{*/
+
+	//! A simulated robot directly connected to the nodes manager that rebuilds its description
+	struct HeadlessNode: NodesManager
+	{
+		Enki::Robot* robot; //!< the robot in the world, owned by the world
+		SingleVMNodeGlue* glue; //!< the VM of the robot
+		DirectConnection* connection; //!< the message queues of the robot
+		VariablesMap variablesMap; //!< names of variables, from the description and the compiled program
+		bool described = false; //!< whether the description of the robot has been fully received
+
+		HeadlessNode(Enki::Robot* robot, SingleVMNodeGlue* glue, DirectConnection* connection):
+			robot(robot),
+			glue(glue),
+			connection(connection)
+		{}
+
+		//! Return the description of the robot, or nullptr if not yet fully received
+		const TargetDescription* description() const
+		{
+			return described ? getDescription(glue->vm.nodeId) : nullptr;
+		}
+
+		//! Process all messages sent by the robot since the last call
+		void processOutgoing()
+		{
+			while (!connection->outQueue.empty())
+			{
+				processMessage(connection->outQueue.front().get());
+				connection->outQueue.pop();
+			}
+		}
+
+	protected:
+		virtual void sendMessage(const Message& message) override
+		{
+			connection->inQueue.emplace(message.clone());
+		}
+
+		virtual void nodeDescriptionReceived(unsigned nodeId) override
+		{
+			described = true;
+		}
+	};
+
+	//! A function to create a robot of a given type
+	using HeadlessNodeFactory = function<unique_ptr<HeadlessNode>(string, int16_t)>;
+
+	//! A factory function to create a robot with a single VM directly connected
+	template<typename RobotT>
+	unique_ptr<HeadlessNode> createHeadlessNode(string robotName, int16_t nodeId)
+	{
+		auto robot(new Enki::DirectlyConnected<RobotT>(move(robotName), nodeId));
+		return unique_ptr<HeadlessNode>(new HeadlessNode(robot, robot, robot));
+	}
+
+	//! Programs of an .aesl file, by node name
+	struct Programs
+	{
+		CommonDefinitions commonDefinitions;
+		map<wstring, wstring> sources;
+	};
+
+	//! Read the programs and common definitions of an .aesl file, return false on error
+	bool readPrograms(const string& fileName, Programs& programs)
+	{
+		QFile file(QString::fromStdString(fileName));
+		if (!file.open(QFile::ReadOnly))
+		{
+			cerr << "Cannot open file " << fileName << endl;
+			return false;
+		}
+		QDomDocument document("aesl-source");
+		QString errorMsg;
+		int errorLine;
+		int errorColumn;
+		if (!document.setContent(&file, false, &errorMsg, &errorLine, &errorColumn))
+		{
+			cerr << "Error in XML source file " << fileName << ": " << errorMsg.toStdString() << " at line " << errorLine << ", column " << errorColumn << endl;
+			return false;
+		}
+
+		for (QDomElement element(document.documentElement().firstChildElement()); !element.isNull(); element = element.nextSiblingElement())
+		{
+			if (element.tagName() == "event")
+				programs.commonDefinitions.events.push_back(NamedValue(element.attribute("name").toStdWString(), element.attribute("size").toInt()));
+			else if (element.tagName() == "constant")
+				programs.commonDefinitions.constants.push_back(NamedValue(element.attribute("name").toStdWString(), element.attribute("value").toInt()));
+			else if (element.tagName() == "node")
+				programs.sources.emplace(element.attribute("name").toStdWString(), element.firstChild().toText().data().toStdWString());
+		}
+		return true;
+	}
+
+	//! Compile the program for node and load it into its VM, return false on error
+	bool loadProgram(HeadlessNode& node, const Programs& programs, CompilationCache& cache)
+	{
+		const TargetDescription* targetDescription(node.description());
+		const auto sourceIt(programs.sources.find(targetDescription->name));
+		if (sourceIt == programs.sources.end())
+			return true;
+
+		Compiler compiler;
+		compiler.setTargetDescription(targetDescription);
+		compiler.setCommonDefinitions(&programs.commonDefinitions);
+		compiler.setCompilationCache(&cache);
+		BytecodeVector bytecode;
+		unsigned allocatedVariablesCount;
+		Error error;
+		if (!compiler.compile(sourceIt->second, bytecode, allocatedVariablesCount, error))
+		{
+			wcerr << L"Compilation error for " << sourceIt->first << L": " << error.toWString() << endl;
+			return false;
+		}
+		node.variablesMap = *compiler.getVariablesMap();
+
+		const uint16_t nodeId(node.glue->vm.nodeId);
+		vector<unique_ptr<Message>> messages;
+		sendBytecode(messages, nodeId, vector<uint16_t>(bytecode.begin(), bytecode.end()));
+		for (auto& message: messages)
+			node.connection->inQueue.emplace(move(message));
+		node.connection->inQueue.emplace(new Run(nodeId));
+		return true;
+	}
+
+	//! Write one line per robot with the current values of traced variables
+	void writeTrace(ostream& stream, double time, const vector<unique_ptr<HeadlessNode>>& nodes, const vector<wstring>& variables)
+	{
+		for (const auto& node: nodes)
+		{
+			const AsebaVMState& vm(node->glue->vm);
+			stream << time << "," << node->glue->robotName;
+			for (const auto& name: variables)
+			{
+				stream << ",";
+				const auto variableIt(node->variablesMap.find(name));
+				if (variableIt == node->variablesMap.end())
+					continue;
+				const unsigned pos(variableIt->second.first);
+				const unsigned size(variableIt->second.second);
+				for (unsigned i = 0; i < size && pos + i < vm.variablesSize; ++i)
+					stream << (i == 0 ? "" : " ") << vm.variables[pos + i];
+			}
+			stream << "\n";
+		}
+	}
+
+	//! Return the largest wheel speed of all robots, in cm/s
+	double maxWheelSpeed(const vector<unique_ptr<HeadlessNode>>& nodes)
+	{
+		double speed(0);
+		for (const auto& node: nodes)
+		{
+			const auto wheeled(dynamic_cast<Enki::DifferentialWheeled*>(node->robot));
+			if (wheeled)
+				speed = max(speed, max(fabs(wheeled->leftSpeed), fabs(wheeled->rightSpeed)));
+		}
+		return speed;
+	}
+
+	//! Show usage
+	void dumpHelp(ostream &stream, const char *programName)
+	{
+		stream << "Aseba playground without viewer, runs a scene faster than real time, usage:\n";
+		stream << programName << " [options] scene.playground\n";
+		stream << "Options:\n";
+		stream << "    -p, --program FILE        : load the programs of FILE (.aesl) into the robots, by node name\n";
+		stream << "    -d, --duration S          : simulated duration in seconds (default: 60)\n";
+		stream << "    --dt S                    : fixed time step in seconds (default: 0.03)\n";
+		stream << "    --adaptive MIN MAX        : adapt the time step between MIN and MAX seconds to the speed of robots\n";
+		stream << "    --seed N                  : seed of random number generators, for reproducible runs\n";
+		stream << "    -t, --trace VAR[,VAR...]  : trace these variables of all robots\n";
+		stream << "    --trace-period S          : simulated seconds between trace lines (default: every step)\n";
+		stream << "    -o, --output FILE         : write the trace into FILE instead of standard output\n";
+		stream << "    -j, --threads N           : run the VMs of robots on N threads (default: 1)\n";
+		stream << "    --preemptive-events       : local events kill the running one instead of being queued\n";
+		stream << "    -v, --verbose             : show all notifications of robots and statistics of their local events\n";
+		stream << "    -h, --help                : shows this help\n";
+		stream << "    -V, --version             : shows the version number\n";
+		stream << "Report bugs to: aseba-dev@gna.org" << std::endl;
+	}
+
+	//! Show version
+	void dumpVersion(std::ostream &stream)
+	{
+		stream << "Aseba headless playground " << ASEBA_VERSION << std::endl;
+		stream << "Aseba protocol " << ASEBA_PROTOCOL_VERSION << std::endl;
+		stream << "Licence LGPLv3: GNU LGPL version 3 <http://www.gnu.org/licenses/lgpl.html>\n";
+	}
+
+	//! Produce an error message and dump help and quit
+	void errorMissingArgument(const char *programName)
+	{
+		std::cerr << "Error, missing argument.\n";
+		dumpHelp(std::cerr, programName);
+		exit(4);
+	}
+
+	/*@}*/
+}
+
+int main(int argc, char *argv[])
+{
+	// needed by Qt image plugins to load the ground texture
+	QCoreApplication app(argc, argv);
+
+	std::string sceneFileName;
+	std::string programFileName;
+	std::string outputFileName;
+	std::vector<std::wstring> tracedVariables;
+	double duration(60);
+	double fixedDt(0.03);
+	double minDt(0);
+	double maxDt(0);
+	double tracePeriod(0);
+	bool seeded(false);
+	unsigned long seed(0);
+	bool verbose(false);
+	unsigned threadCount(1);
+	bool preemptiveEvents(false);
+
+	int argCounter = 1;
+	while (argCounter < argc)
+	{
+		const char *arg = argv[argCounter];
+		const bool hasNext(argCounter + 1 < argc);
+		if ((strcmp(arg, "-p") == 0) || (strcmp(arg, "--program") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			programFileName = argv[++argCounter];
+		}
+		else if ((strcmp(arg, "-d") == 0) || (strcmp(arg, "--duration") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			duration = atof(argv[++argCounter]);
+		}
+		else if (strcmp(arg, "--dt") == 0)
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			fixedDt = atof(argv[++argCounter]);
+		}
+		else if (strcmp(arg, "--adaptive") == 0)
+		{
+			if (argCounter + 2 >= argc)
+				Aseba::errorMissingArgument(argv[0]);
+			minDt = atof(argv[++argCounter]);
+			maxDt = atof(argv[++argCounter]);
+		}
+		else if (strcmp(arg, "--seed") == 0)
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			seed = strtoul(argv[++argCounter], nullptr, 0);
+			seeded = true;
+		}
+		else if ((strcmp(arg, "-t") == 0) || (strcmp(arg, "--trace") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			for (const auto& name: QString(argv[++argCounter]).split(",", QString::SkipEmptyParts))
+				tracedVariables.push_back(name.trimmed().toStdWString());
+		}
+		else if (strcmp(arg, "--trace-period") == 0)
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			tracePeriod = atof(argv[++argCounter]);
+		}
+		else if ((strcmp(arg, "-o") == 0) || (strcmp(arg, "--output") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			outputFileName = argv[++argCounter];
+		}
+		else if ((strcmp(arg, "-j") == 0) || (strcmp(arg, "--threads") == 0))
+		{
+			if (!hasNext)
+				Aseba::errorMissingArgument(argv[0]);
+			threadCount = std::max(1, atoi(argv[++argCounter]));
+		}
+		else if (strcmp(arg, "--preemptive-events") == 0)
+		{
+			preemptiveEvents = true;
+		}
+		else if ((strcmp(arg, "-v") == 0) || (strcmp(arg, "--verbose") == 0))
+		{
+			verbose = true;
+		}
+		else if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			Aseba::dumpHelp(std::cout, argv[0]);
+			return 0;
+		}
+		else if ((strcmp(arg, "-V") == 0) || (strcmp(arg, "--version") == 0))
+		{
+			Aseba::dumpVersion(std::cout);
+			return 0;
+		}
+		else
+		{
+			sceneFileName = arg;
+		}
+		argCounter++;
+	}
+
+	if (sceneFileName.empty() || fixedDt <= 0 || (maxDt > 0 && (minDt <= 0 || minDt > maxDt)))
+	{
+		Aseba::dumpHelp(std::cerr, argv[0]);
+		return 1;
+	}
+
+	// seed all random number generators, so that runs are reproducible; robots seed their VM from std::rand() when created
+	if (seeded)
+	{
+		Enki::random.setSeed(seed);
+		std::srand(seed);
+	}
+
+	// load scene
+	QDomDocument domDocument("aseba-playground");
+	QFile sceneFile(QString::fromStdString(sceneFileName));
+	QString errorStr;
+	int errorLine, errorColumn;
+	if (!sceneFile.open(QIODevice::ReadOnly) || !domDocument.setContent(&sceneFile, false, &errorStr, &errorLine, &errorColumn))
+	{
+		std::cerr << "Cannot read scene " << sceneFileName << ": " << errorStr.toStdString() << " at line " << errorLine << ", column " << errorColumn << std::endl;
+		return 2;
+	}
+	std::unique_ptr<Enki::World> world(Enki::createPlaygroundWorld(domDocument, QString::fromStdString(sceneFileName)));
+	Enki::simulatorEnvironment.reset(new Enki::HeadlessSimulatorEnvironment(*world, verbose));
+
+	// load all robots in one loop
+	const std::map<std::string, std::pair<std::string, Aseba::HeadlessNodeFactory>> robotTypes {
+		{ "thymio2", { "Thymio II", Aseba::createHeadlessNode<Enki::AsebaThymio2> } },
+		{ "e-puck", { "E-Puck", Aseba::createHeadlessNode<Enki::AsebaFeedableEPuck> } },
+	};
+	std::map<std::string, unsigned> countOfType;
+	std::vector<std::unique_ptr<Aseba::HeadlessNode>> nodes;
+	for (QDomElement robotE(domDocument.documentElement().firstChildElement("robot")); !robotE.isNull(); robotE = robotE.nextSiblingElement("robot"))
+	{
+		const auto type(robotE.attribute("type", "thymio2").toStdString());
+		const auto typeIt(robotTypes.find(type));
+		if (typeIt == robotTypes.end())
+		{
+			std::cerr << "Error, unknown robot type " << type << std::endl;
+			continue;
+		}
+		const auto robotName(robotE.attribute("name", QString("%1 %2").arg(QString::fromStdString(typeIt->second.first)).arg(countOfType[type]++)));
+		const int16_t nodeId(robotE.attribute("nodeId", "1").toInt());
+		auto node(typeIt->second.second(robotName.toStdString(), nodeId));
+		node->robot->pos.x = robotE.attribute("x").toDouble();
+		node->robot->pos.y = robotE.attribute("y").toDouble();
+		node->robot->angle = robotE.attribute("angle").toDouble();
+		auto thymio(dynamic_cast<Enki::AsebaThymio2*>(node->robot));
+		if (thymio)
+			thymio->localEventQueue.preemptive = preemptiveEvents;
+		world->addObject(node->robot);
+		nodes.push_back(std::move(node));
+	}
+
+	// get descriptions, which takes a few steps of round-trips between nodes managers and robots
+	for (auto& node: nodes)
+		node->connection->inQueue.emplace(Aseba::ListNodes().clone());
+	const auto allDescribed([&]() { return std::all_of(nodes.begin(), nodes.end(), [](const std::unique_ptr<Aseba::HeadlessNode>& node) { return node->described; }); });
+	for (unsigned i = 0; i < 100 && !allDescribed(); ++i)
+	{
+		world->step(fixedDt);
+		for (auto& node: nodes)
+			node->processOutgoing();
+	}
+	for (auto& node: nodes)
+	{
+		const Aseba::TargetDescription* description(node->description());
+		if (!description)
+		{
+			std::cerr << "Cannot get the description of robot " << node->glue->robotName << std::endl;
+			return 3;
+		}
+		unsigned freeVariableIndex;
+		node->variablesMap = description->getVariablesMap(freeVariableIndex);
+	}
+
+	// load programs
+	if (!programFileName.empty())
+	{
+		Aseba::Programs programs;
+		if (!Aseba::readPrograms(programFileName, programs))
+			return 2;
+		Aseba::CompilationCache cache;
+		for (auto& node: nodes)
+			if (!Aseba::loadProgram(*node, programs, cache))
+				return 5;
+	}
+
+	// open trace
+	std::ofstream outputFile;
+	if (!outputFileName.empty())
+	{
+		outputFile.open(outputFileName);
+		if (!outputFile)
+		{
+			std::cerr << "Cannot open output file " << outputFileName << std::endl;
+			return 2;
+		}
+	}
+	std::ostream& trace(outputFileName.empty() ? std::cout : outputFile);
+	const bool tracing(!tracedVariables.empty());
+	if (tracing)
+	{
+		trace << "time,robot";
+		for (const auto& name: tracedVariables)
+			trace << "," << Aseba::WStringToUTF8(name);
+		trace << "\n";
+	}
+
+	// run as fast as possible, optionally running the VMs of robots in parallel;
+	// the control of robots is deferred even with one thread, so that runs do not depend on the number of threads
+	Enki::ParallelControl parallelControl(threadCount);
+	const auto start(std::chrono::steady_clock::now());
+	// robots should not move more than this distance in cm during one step when using an adaptive time step
+	const double maxStepDistance(1);
+	double time(0);
+	double nextTraceTime(0);
+	unsigned stepsCount(0);
+	while (time < duration)
+	{
+		double dt(fixedDt);
+		if (maxDt > 0)
+		{
+			const double speed(Aseba::maxWheelSpeed(nodes));
+			dt = speed > 0 ? std::min(std::max(maxStepDistance / speed, minDt), maxDt) : maxDt;
+		}
+		parallelControl.step(world.get(), dt);
+		for (auto& node: nodes)
+			node->processOutgoing();
+		time += dt;
+		++stepsCount;
+
+		if (tracing && time >= nextTraceTime)
+		{
+			Aseba::writeTrace(trace, time, nodes, tracedVariables);
+			nextTraceTime = time + tracePeriod;
+		}
+	}
+	trace.flush();
+
+	const double wallTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	std::cerr << "Simulated " << time << " s in " << stepsCount << " steps and " << wallTime << " s";
+	if (wallTime > 0)
+		std::cerr << ", " << time / wallTime << " times faster than real time";
+	std::cerr << std::endl;
+
+	if (verbose)
+	{
+		for (const auto& node: nodes)
+		{
+			const auto thymio(dynamic_cast<const Enki::AsebaThymio2*>(node->robot));
+			if (!thymio)
+				continue;
+			const auto& statistics(thymio->localEventQueue.getStatistics());
+			std::cerr << node->glue->robotName << ": " << statistics.posted << " local events posted, ";
+			std::cerr << statistics.coalesced << " coalesced, " << statistics.executed << " executed, ";
+			std::cerr << statistics.killed << " killed, " << statistics.overruns << " steps out of VM budget" << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -27,7 +27,7 @@
 
 #include "common/utils/FormatableString.h"
 #include "DashelAsebaGlue.h"
-#include "Door.h"
+#include "PlaygroundScene.h"
 #include "PlaygroundViewer.h"
 #include "Robots.h"
 #include <QtXml>
@@ -113,15 +113,27 @@ Enki::Robot* createRobotSingleVMNode(unsigned port, std::string robotName, std::
 }
 #endif // ZEROCONF_SUPPORT
 
+//! A function to create a robot of a given type sharing the connection of the world
+using MultiplexedRobotFactory = std::function<Enki::Robot*(Aseba::MultiplexedDashelConnection&, std::string, int16_t)>;
+
+//! A factory function to create a robot with a single VM sharing the connection of the world
+template<typename RobotT>
+Enki::Robot* createRobotSingleVMNodeMultiplexed(Aseba::MultiplexedDashelConnection& connection, std::string robotName, int16_t nodeId)
+{
+	return new RobotT(connection, std::move(robotName), nodeId);
+}
+
 //! A type of robot
 struct RobotType
 {
-	RobotType(std::string prettyName, RobotFactory factory):
+	RobotType(std::string prettyName, RobotFactory factory, MultiplexedRobotFactory multiplexedFactory):
 		prettyName(std::move(prettyName)),
-		factory(std::move(factory))
+		factory(std::move(factory)),
+		multiplexedFactory(std::move(multiplexedFactory))
 	{}
 	const std::string prettyName; //!< a nice-looking name of this type
 	const RobotFactory factory; //!< the factory function to create a robot of this type
+	const MultiplexedRobotFactory multiplexedFactory; //!< the factory function to create a robot of this type sharing the connection of the world
 	unsigned number = 0; //!< number of robots of this type instantiated
 };
 
@@ -154,10 +166,16 @@ int main(int argc, char *argv[])
 
 	// Get cmd line arguments
 	bool ask = true;
-	if (argc > 1)
+	bool multiplexed = false;
+	for (int i = 1; i < argc; ++i)
 	{
-		sceneFileName = argv[1];
-		ask = false;
+		if (QString(argv[i]) == "--multiplex")
+			multiplexed = true;
+		else
+		{
+			sceneFileName = argv[i];
+			ask = false;
+		}
 	}
 
 	// Try to load xml config file
@@ -199,79 +217,15 @@ int main(int argc, char *argv[])
 	}
 	while (true);
 
-	// Scan for colors
-	typedef QMap<QString, Enki::Color> ColorsMap;
-	ColorsMap colorsMap;
-	QDomElement colorE = domDocument.documentElement().firstChildElement("color");
-	while (!colorE.isNull())
-	{
-		colorsMap[colorE.attribute("name")] = Enki::Color(
-			colorE.attribute("r").toDouble(),
-			colorE.attribute("g").toDouble(),
-			colorE.attribute("b").toDouble()
-		);
-
-		colorE = colorE.nextSiblingElement ("color");
-	}
-
-	// Scan for areas
-	typedef QMap<QString, Enki::Polygon> AreasMap;
-	AreasMap areasMap;
-	QDomElement areaE = domDocument.documentElement().firstChildElement("area");
-	while (!areaE.isNull())
-	{
-		Enki::Polygon p;
-		QDomElement pointE = areaE.firstChildElement("point");
-		while (!pointE.isNull())
-		{
-			p.push_back(Enki::Point(
-				pointE.attribute("x").toDouble(),
-				pointE.attribute("y").toDouble()
-			));
-			pointE = pointE.nextSiblingElement ("point");
-		}
-		areasMap[areaE.attribute("name")] = p;
-		areaE = areaE.nextSiblingElement ("area");
-	}
+	// If requested, a single connection for all robots, which must outlive them
+	std::unique_ptr<Aseba::MultiplexedDashelConnection> worldConnection;
 
 	// Create the world
+	std::unique_ptr<Enki::World> world(Enki::createPlaygroundWorld(domDocument, sceneFileName));
 	QDomElement worldE = domDocument.documentElement().firstChildElement("world");
-	Enki::Color worldColor(Enki::Color::gray);
-	if (!colorsMap.contains(worldE.attribute("color")))
-		std::cerr << "Warning, world walls color " << worldE.attribute("color").toStdString() << " undefined\n";
-	else
-		worldColor = colorsMap[worldE.attribute("color")];
-	Enki::World::GroundTexture groundTexture;
-	if (worldE.hasAttribute("groundTexture"))
-	{
-		const QString groundTextureFileName(QFileInfo(sceneFileName).absolutePath() + QDir::separator() + worldE.attribute("groundTexture"));
-		QImage image(groundTextureFileName);
-		if (!image.isNull())
-		{
-			// flip vertically as y-coordinate is inverted in an image
-			image = image.mirrored();
-			// convert to a specific format and copy the underlying data to Enki
-			image = image.convertToFormat(QImage::Format_ARGB32);
-			groundTexture.width = image.width();
-			groundTexture.height = image.height();
-			const uint32_t* imageData(reinterpret_cast<const uint32_t*>(image.constBits()));
-			std::copy(imageData, imageData+image.width()*image.height(), std::back_inserter(groundTexture.data));
-			// Note: this works in little endian, in big endian data should be swapped
-		}
-		else
-		{
-			qDebug() << "Could not load ground texture file named" << groundTextureFileName;
-		}
-	}
-	Enki::World world(
-		worldE.attribute("w").toDouble(),
-		worldE.attribute("h").toDouble(),
-		worldColor,
-		groundTexture
-	);
 
 	// Create viewer
-	Enki::PlaygroundViewer viewer(&world, worldE.attribute("energyScoringSystemEnabled", "false").toLower() == "true");
+	Enki::PlaygroundViewer viewer(world.get(), worldE.attribute("energyScoringSystemEnabled", "false").toLower() == "true");
 	if (Enki::simulatorEnvironment)
 		qDebug() << "A simulator environment already exists, replacing";
 	Enki::simulatorEnvironment.reset(new Enki::PlaygroundSimulatorEnvironment(sceneFileName, viewer));
@@ -285,10 +239,10 @@ int main(int argc, char *argv[])
 	QDomElement cameraE = domDocument.documentElement().firstChildElement("camera");
 	if (!cameraE.isNull())
 	{
-		const double largestDim(qMax(world.h, world.w));
+		const double largestDim(qMax(world->h, world->w));
 		viewer.setCamera(
 			QPointF(
-				cameraE.attribute("x", QString::number(world.w / 2)).toDouble(),
+				cameraE.attribute("x", QString::number(world->w / 2)).toDouble(),
 				cameraE.attribute("y", QString::number(0)).toDouble()
 			),
 			cameraE.attribute("altitude", QString::number(0.85 * largestDim)).toDouble(),
@@ -297,139 +251,18 @@ int main(int argc, char *argv[])
 		);
 	}
 
-	// Scan for walls
-	QDomElement wallE = domDocument.documentElement().firstChildElement("wall");
-	while (!wallE.isNull())
-	{
-		Enki::PhysicalObject* wall = new Enki::PhysicalObject();
-		if (!colorsMap.contains(wallE.attribute("color")))
-			std::cerr << "Warning, color " << wallE.attribute("color").toStdString() << " undefined\n";
-		else
-			wall->setColor(colorsMap[wallE.attribute("color")]);
-		wall->pos.x = wallE.attribute("x").toDouble();
-		wall->pos.y = wallE.attribute("y").toDouble();
-		wall->setRectangular(
-			wallE.attribute("l1").toDouble(),
-			wallE.attribute("l2").toDouble(),
-			wallE.attribute("h").toDouble(),
-			!wallE.attribute("mass").isNull() ? wallE.attribute("mass").toDouble() : -1 // normally -1 because immobile
-		);
-		if (! wallE.attribute("angle").isNull())
-			wall->angle = wallE.attribute("angle").toDouble(); // radians
-		world.addObject(wall);
-
-		wallE  = wallE.nextSiblingElement ("wall");
-	}
-
-	// Scan for cylinders
-	QDomElement cylinderE = domDocument.documentElement().firstChildElement("cylinder");
-	while (!cylinderE.isNull())
-	{
-		Enki::PhysicalObject* cylinder = new Enki::PhysicalObject();
-		if (!colorsMap.contains(cylinderE.attribute("color")))
-			std::cerr << "Warning, color " << cylinderE.attribute("color").toStdString() << " undefined\n";
-		else
-			cylinder->setColor(colorsMap[cylinderE.attribute("color")]);
-		cylinder->pos.x = cylinderE.attribute("x").toDouble();
-		cylinder->pos.y = cylinderE.attribute("y").toDouble();
-		cylinder->setCylindric(
-			cylinderE.attribute("r").toDouble(), 
-			cylinderE.attribute("h").toDouble(),
-			!cylinderE.attribute("mass").isNull() ? cylinderE.attribute("mass").toDouble() : -1 // normally -1 because immobile
-		);
-		world.addObject(cylinder);
-
-		cylinderE = cylinderE.nextSiblingElement("cylinder");
-	}
-
-	// Scan for feeders
-	QDomElement feederE = domDocument.documentElement().firstChildElement("feeder");
-	while (!feederE.isNull())
-	{
-		Enki::EPuckFeeder* feeder = new Enki::EPuckFeeder;
-		feeder->pos.x = feederE.attribute("x").toDouble();
-		feeder->pos.y = feederE.attribute("y").toDouble();
-		world.addObject(feeder);
-
-		feederE = feederE.nextSiblingElement ("feeder");
-	}
-	// TODO: if needed, custom color to feeder
-
-	// Scan for doors
-	typedef QMap<QString, Enki::SlidingDoor*> DoorsMap;
-	DoorsMap doorsMap;
-	QDomElement doorE = domDocument.documentElement().firstChildElement("door");
-	while (!doorE.isNull())
-	{
-		Enki::SlidingDoor *door = new Enki::SlidingDoor(
-			Enki::Point(
-				doorE.attribute("closedX").toDouble(),
-				doorE.attribute("closedY").toDouble()
-			),
-			Enki::Point(
-				doorE.attribute("openedX").toDouble(),
-				doorE.attribute("openedY").toDouble()
-			),
-			Enki::Point(
-				doorE.attribute("l1").toDouble(),
-				doorE.attribute("l2").toDouble()
-			),
-			doorE.attribute("h").toDouble(),
-			doorE.attribute("moveDuration").toDouble()
-		);
-		if (!colorsMap.contains(doorE.attribute("color")))
-			std::cerr << "Warning, door color " << doorE.attribute("color").toStdString() << " undefined\n";
-		else
-			door->setColor(colorsMap[doorE.attribute("color")]);
-		doorsMap[doorE.attribute("name")] = door;
-		world.addObject(door);
-
-		doorE = doorE.nextSiblingElement ("door");
-	}
-
-	// Scan for activation, and link them with areas and doors
-	QDomElement activationE = domDocument.documentElement().firstChildElement("activation");
-	while (!activationE.isNull())
+	// Single connection for all robots, stepped once before each step of the world
+	if (multiplexed)
 	{
-		if (areasMap.find(activationE.attribute("area")) == areasMap.end())
-		{
-			std::cerr << "Warning, area " << activationE.attribute("area").toStdString() << " undefined\n";
-			activationE = activationE.nextSiblingElement ("activation");
-			continue;
-		}
-
-		if (doorsMap.find(activationE.attribute("door")) == doorsMap.end())
-		{
-			std::cerr << "Warning, door " << activationE.attribute("door").toStdString() << " undefined\n";
-			activationE = activationE.nextSiblingElement ("activation");
-			continue;
-		}
-
-		const Enki::Polygon& area = *areasMap.find(activationE.attribute("area"));
-		Enki::Door* door = *doorsMap.find(activationE.attribute("door"));
-
-		Enki::DoorButton* activation = new Enki::DoorButton(
-			Enki::Point(
-				activationE.attribute("x").toDouble(),
-				activationE.attribute("y").toDouble()
-			),
-			Enki::Point(
-				activationE.attribute("l1").toDouble(),
-				activationE.attribute("l2").toDouble()
-			),
-			area,
-			door
-		);
-
-		world.addObject(activation);
-
-		activationE = activationE.nextSiblingElement ("activation");
+		worldConnection.reset(new Aseba::MultiplexedDashelConnection(ASEBA_DEFAULT_PORT));
+		viewer.networkStep = [&worldConnection]() { worldConnection->networkStep(); };
+		viewer.log(app.tr("All robots share port %0").arg(ASEBA_DEFAULT_PORT), Qt::white);
 	}
 
 	// load all robots in one loop
 	std::map<std::string, RobotType> robotTypes {
-		{ "thymio2", { "Thymio II", createRobotSingleVMNode<Enki::DashelAsebaThymio2> } },
-		{ "e-puck", { "E-Puck", createRobotSingleVMNode<Enki::DashelAsebaFeedableEPuck> } },
+		{ "thymio2", { "Thymio II", createRobotSingleVMNode<Enki::DashelAsebaThymio2>, createRobotSingleVMNodeMultiplexed<Enki::MultiplexedAsebaThymio2> } },
+		{ "e-puck", { "E-Puck", createRobotSingleVMNode<Enki::DashelAsebaFeedableEPuck>, createRobotSingleVMNodeMultiplexed<Enki::MultiplexedAsebaFeedableEPuck> } },
 	};
 	QDomElement robotE = domDocument.documentElement().firstChildElement("robot");
 	unsigned asebaServerCount(0);
@@ -447,15 +280,24 @@ int main(int argc, char *argv[])
 			const auto qRobotNameFull(QObject::tr("%2 on %3").arg(qRobotNameRaw).arg(QHostInfo::localHostName()));
 			const auto cppRobotName(qRobotNameFull.toStdString());
 			const unsigned port(robotE.attribute("port", QString("%1").arg(ASEBA_DEFAULT_PORT+asebaServerCount)).toUInt());
-			const int16_t nodeId(robotE.attribute("nodeId", "1").toInt());
+			// robots sharing a connection need different node ids
+			const int16_t nodeId(robotE.attribute("nodeId", QString::number(multiplexed ? 1 + asebaServerCount : 1)).toInt());
 
 			// create
-			const auto& creator(typeIt->second.factory);
+			Enki::Robot* robot(nullptr);
+			if (worldConnection)
+			{
+				robot = typeIt->second.multiplexedFactory(*worldConnection, cppRobotName, nodeId);
+			}
+			else
+			{
+				const auto& creator(typeIt->second.factory);
 #ifdef ZEROCONF_SUPPORT
-			auto robot(creator(zeroconf, port, cppRobotName, cppTypeName, nodeId));
+				robot = creator(zeroconf, port, cppRobotName, cppTypeName, nodeId);
 #else // ZEROCONF_SUPPORT
-			auto robot(creator(port, cppRobotName, cppTypeName, nodeId));
+				robot = creator(port, cppRobotName, cppTypeName, nodeId);
 #endif // ZEROCONF_SUPPORT
+			}
 			asebaServerCount++;
 			countOfThisType++;
 
@@ -463,10 +305,13 @@ int main(int argc, char *argv[])
 			robot->pos.x = robotE.attribute("x").toDouble();
 			robot->pos.y = robotE.attribute("y").toDouble();
 			robot->angle = robotE.attribute("angle").toDouble();
-			world.addObject(robot);
+			world->addObject(robot);
 
 			// log
-			viewer.log(app.tr("New robot %0 of type %1 on port %2").arg(qRobotNameRaw).arg(qTypeName).arg(port), Qt::white);
+			if (worldConnection)
+				viewer.log(app.tr("New robot %0 of type %1 with node id %2").arg(qRobotNameRaw).arg(qTypeName).arg(nodeId), Qt::white);
+			else
+				viewer.log(app.tr("New robot %0 of type %1 on port %2").arg(qRobotNameRaw).arg(qTypeName).arg(port), Qt::white);
 		}
 		else
 			viewer.log("Error, unknown robot type " + type, Qt::red);
@@ -474,6 +319,24 @@ int main(int argc, char *argv[])
 		robotE = robotE.nextSiblingElement ("robot");
 	}
 
+#ifdef ZEROCONF_SUPPORT
+	// advertise the single connection with the node ids of all robots
+	if (worldConnection)
+	{
+		std::vector<unsigned> nodeIds;
+		for (auto vm: worldConnection->vms)
+			nodeIds.push_back(vm->nodeId);
+		try
+		{
+			zeroconf.advertise(app.tr("Playground on %0").arg(QHostInfo::localHostName()).toStdString(), worldConnection->getListenStream(), { ASEBA_PROTOCOL_VERSION, "Playground", false, nodeIds });
+		}
+		catch (const std::runtime_error& e)
+		{
+			viewer.log(app.tr("Cannot advertise stream: %0").arg(e.what()), Qt::red);
+		}
+	}
+#endif // ZEROCONF_SUPPORT
+
 	// Scan for external processes
 	QList<QProcess*> processes;
 	QDomElement procssE(domDocument.documentElement().firstChildElement("process"));
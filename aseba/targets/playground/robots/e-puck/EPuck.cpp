@@ -23,6 +23,7 @@
 #include "../../EnkiGlue.h"
 #include "common/productids.h"
 #include "common/utils/utils.h"
+#include "transport/buffer/vm-buffer.h"
 
 // Native functions
 
@@ -177,13 +178,26 @@ namespace Enki
 		vm.variables = reinterpret_cast<int16_t *>(&variables);
 		vm.variablesSize = sizeof(variables) / sizeof(int16_t);
 
+		variablesShadow.resize(vm.variablesSize);
+		vm.variablesShadow = &variablesShadow[0];
+
 		AsebaVMInit(&vm);
+		vm.descriptionHash = AsebaComputeDescriptionHash(&vm);
 
 		variables.id = vm.nodeId;
 		variables.productId = ASEBA_PID_PLAYGROUND_EPUCK;
 	}
 
 	void AsebaFeedableEPuck::controlStep(double dt)
+	{
+		// run Aseba, unless deferred to run in parallel with other robots
+		controlOrDefer(dt);
+
+		// set motion
+		FeedableEPuck::controlStep(dt);
+	}
+
+	void AsebaFeedableEPuck::asebaControlStep(double dt)
 	{
 		// get physical variables
 		variables.prox[0] = static_cast<int16_t>(infraredSensor0.getValue());
@@ -229,8 +243,7 @@ namespace Enki
 			Aseba::clamp<double>(variables.colorB*0.01, 0, 1)
 		));
 
-		// set motion
-		FeedableEPuck::controlStep(dt);
+		sendWatchedVariables(dt);
 	}
 
 
@@ -103,6 +103,10 @@ namespace Enki
 
 		virtual void controlStep(double dt);
 
+		// from SingleVMNodeGlue
+
+		virtual void asebaControlStep(double dt);
+
 		// from AbstractNodeGlue
 
 		virtual const AsebaVMDescription* getDescription() const;
@@ -24,6 +24,7 @@
 #include "../../EnkiGlue.h"
 #include "common/productids.h"
 #include "common/utils/utils.h"
+#include "transport/buffer/vm-buffer.h"
 
 namespace Enki
 {
@@ -33,6 +34,7 @@ namespace Enki
 	AsebaThymio2::AsebaThymio2(std::string robotName, int16_t nodeId):
 		SingleVMNodeGlue(std::move(robotName), nodeId),
 		sdCardFileNumber(-1),
+		localEventQueue(vm, localEventsPriorityOrder()),
 		timer0(bind(&AsebaThymio2::timer0Timeout, this), 0),
 		timer1(bind(&AsebaThymio2::timer1Timeout, this), 0),
 		timer100Hz(bind(&AsebaThymio2::timer100HzTimeout, this), 0.01),
@@ -54,7 +56,11 @@ namespace Enki
 		vm.variables = reinterpret_cast<int16_t *>(&variables);
 		vm.variablesSize = sizeof(variables) / sizeof(int16_t);
 
+		variablesShadow.resize(vm.variablesSize);
+		vm.variablesShadow = &variablesShadow[0];
+
 		AsebaVMInit(&vm);
+		vm.descriptionHash = AsebaComputeDescriptionHash(&vm);
 
 		variables.id = vm.nodeId;
 		variables.fwversion[0] = 11; // this simulated Thymio complies with firmware 11 public API
@@ -148,6 +154,15 @@ namespace Enki
 	}
 
 	void AsebaThymio2::controlStep(double dt)
+	{
+		// run Aseba, unless deferred to run in parallel with other robots
+		controlOrDefer(dt);
+
+		// set motion
+		Thymio2::controlStep(dt);
+	}
+
+	void AsebaThymio2::asebaControlStep(double dt)
 	{
 		// get physical variables
 		variables.proxHorizontal[0] = getSaturatedProxHorizontal(0);
@@ -172,6 +187,16 @@ namespace Enki
 		// process external inputs (incoming event from network or environment, etc.)
 		externalInputStep(dt);
 
+		// trigger tap event
+		if (thisStepCollided && !lastStepCollided)
+			execLocalEvent(EVENT_TAP);
+		lastStepCollided = thisStepCollided;
+		thisStepCollided = false;
+
+		// run pending local events
+		variables.source = vm.nodeId;
+		localEventQueue.run(dt);
+
 		// set physical variables
 		leftSpeed = double(variables.motorLeftTarget) * 16.6 / 500.;
 		rightSpeed = double(variables.motorRightTarget) * 16.6 / 500.;
@@ -188,14 +213,7 @@ namespace Enki
 			timer1.setPeriod(variables.timerPeriod[1] / 1000.);
 		}
 
-		// set motion
-		Thymio2::controlStep(dt);
-
-		// trigger tap event
-		if (thisStepCollided && !lastStepCollided)
-			execLocalEvent(EVENT_TAP);
-		lastStepCollided = thisStepCollided;
-		thisStepCollided = false;
+		sendWatchedVariables(dt);
 	}
 
 	// robot description
@@ -351,16 +369,23 @@ namespace Enki
 		return static_cast<int16_t>(sensor->getValue());
 	}
 
-	//! Execute a local event, killing the execution of the current one if not in step-by-step mode
+	//! Post a local event, executed at the next control step, or immediately if localEventQueue is preemptive
 	void AsebaThymio2::execLocalEvent(uint16_t number)
 	{
-		// in step-by-step, only setup an event if none is being executed currently
-		if (AsebaMaskIsSet(vm.flags, ASEBA_VM_STEP_BY_STEP_MASK) && AsebaMaskIsSet(vm.flags, ASEBA_VM_EVENT_ACTIVE_MASK))
-			return;
-
 		variables.source = vm.nodeId;
-		AsebaVMSetupEvent(&vm, ASEBA_EVENT_LOCAL_EVENTS_START-number);
-		AsebaVMRun(&vm, 1000);
+		localEventQueue.post(number);
+	}
+
+	std::vector<uint16_t> AsebaThymio2::localEventsPriorityOrder()
+	{
+		return {
+			EVENT_MOTOR,
+			EVENT_B_BACKWARD, EVENT_B_LEFT, EVENT_B_CENTER, EVENT_B_FORWARD, EVENT_B_RIGHT, EVENT_BUTTONS,
+			EVENT_PROX, EVENT_PROX_COMM,
+			EVENT_TAP, EVENT_ACC,
+			EVENT_MIC, EVENT_SOUND_FINISHED, EVENT_TEMPERATURE, EVENT_RC5,
+			EVENT_TIMER0, EVENT_TIMER1
+		};
 	}
 
 } // Enki
@@ -22,6 +22,7 @@
 #define __PLAYGROUND_THYMIO2_H
 
 #include "../../AsebaGlue.h"
+#include "../../LocalEventQueue.h"
 #include "common/utils/utils.h"
 #include <enki/PhysicalEngine.h>
 #include <enki/robots/thymio2/Thymio2.h>
@@ -118,6 +119,9 @@ namespace Enki
 		//! Whether thymioNativeCallLog should be filled each time a Thymio native function is called
 		bool logThymioNativeCalls { false } ;
 
+		//! Local events waiting for the VM, executed by the firmware priority order
+		Aseba::LocalEventQueue localEventQueue;
+
 	protected:
 		Aseba::SoftTimer timer0;
 		Aseba::SoftTimer timer1;
@@ -144,6 +148,10 @@ namespace Enki
 
 		virtual void controlStep(double dt);
 
+		// from SingleVMNodeGlue
+
+		virtual void asebaControlStep(double dt);
+
 		// from AbstractNodeGlue
 
 		virtual const AsebaVMDescription* getDescription() const;
@@ -158,6 +166,9 @@ namespace Enki
 		// for debug purposes
 		void execLocalEvent(uint16_t number);
 
+		//! Return the local events in the order the firmware executes them when several are pending
+		static std::vector<uint16_t> localEventsPriorityOrder();
+
 	protected:
 
 		void timer0Timeout();
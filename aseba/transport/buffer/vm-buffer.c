@@ -24,8 +24,24 @@
 #include <string.h>
 #include <assert.h>
 
-static unsigned char buffer[ASEBA_MAX_INNER_PACKET_SIZE];
-static unsigned buffer_pos;
+/* When several VMs run concurrently in the same process, for instance robots
+   stepped in parallel in a simulator, each thread must use its own buffer.
+   A VM is only run by one thread at a time, so this gives each running VM its
+   own buffer, without cost for single-threaded targets. */
+#ifdef ASEBA_VM_BUFFER_THREAD_LOCAL
+	#if defined(_MSC_VER)
+		#define BUFFER_STORAGE static __declspec(thread)
+	#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+		#define BUFFER_STORAGE static _Thread_local
+	#else
+		#define BUFFER_STORAGE static __thread
+	#endif
+#else
+	#define BUFFER_STORAGE static
+#endif
+
+BUFFER_STORAGE unsigned char buffer[ASEBA_MAX_INNER_PACKET_SIZE];
+BUFFER_STORAGE unsigned buffer_pos;
 
 static void buffer_add(const uint8_t* data, const uint16_t len)
 {
@@ -97,17 +113,13 @@ void AsebaSendMessageWords(AsebaVMState *vm, uint16_t type, const uint16_t* data
 
 void AsebaSendVariables(AsebaVMState *vm, uint16_t start, uint16_t length)
 {
-	uint16_t i;
-#ifndef ASEBA_LIMITED_MESSAGE_SIZE  //This is usefull with device that cannot send big packets like Thymio Wireless module.
-	buffer_pos = 0;
-	buffer_add_uint16(ASEBA_MESSAGE_VARIABLES);
-	buffer_add_uint16(start);
-	for (i = start; i < start + length; i++)
-		buffer_add_uint16(vm->variables[i]);
-
-	AsebaSendBuffer(vm, buffer, buffer_pos);
+	// split answers that do not fit in the buffer, leaving room for type and start
+#ifndef ASEBA_LIMITED_MESSAGE_SIZE
+	const uint16_t MAX_VARIABLES_SIZE = 256;
 #else
-	const uint16_t MAX_VARIABLES_SIZE = ((100 - 6)/2);
+	const uint16_t MAX_VARIABLES_SIZE = ((100 - 6)/2);  //This is usefull with device that cannot send big packets like Thymio Wireless module.
+#endif
+	uint16_t i;
 	do {
 		uint16_t size;
 		buffer_pos = 0;
@@ -125,7 +137,108 @@ void AsebaSendVariables(AsebaVMState *vm, uint16_t start, uint16_t length)
 		start += size;
 		length -= size;
 	} while(length);
+}
+
+void AsebaSendChangedVariables(AsebaVMState *vm, uint16_t start, uint16_t length, uint16_t generation)
+{
+	// the mask takes one word per 16 variables, leave room for it and for type, start, length and generation
+#ifndef ASEBA_LIMITED_MESSAGE_SIZE
+	const uint16_t MAX_VARIABLES_SIZE = 239;
+#else
+	const uint16_t MAX_VARIABLES_SIZE = 42;
 #endif
+	// the requester knows the variables as of this generation, and sees all messages we send after it,
+	// so it can rebuild unchanged variables, unless it is newer than ours because we were reset since
+	const uint16_t onlyChanged = (generation != 0) && ((uint16_t)(vm->variablesGeneration - generation) < 0x8000);
+	uint16_t i;
+	do {
+		uint16_t size;
+		unsigned maskPos;
+		if (length > MAX_VARIABLES_SIZE)
+			size = MAX_VARIABLES_SIZE;
+		else
+			size = length;
+
+		// 0 is reserved for requesting all variables
+		vm->variablesGeneration++;
+		if (vm->variablesGeneration == 0)
+			vm->variablesGeneration = 1;
+
+		buffer_pos = 0;
+		buffer_add_uint16(ASEBA_MESSAGE_CHANGED_VARIABLES);
+		buffer_add_uint16(start);
+		buffer_add_uint16(size);
+		buffer_add_uint16(vm->variablesGeneration);
+
+		// bit i of the little-endian mask words is in bit i % 8 of byte i / 8
+		maskPos = buffer_pos;
+		for (i = 0; i < size; i += 16)
+			buffer_add_uint16(0);
+		for (i = 0; i < size; i++)
+		{
+			const int16_t value = vm->variables[start + i];
+			if (!onlyChanged || value != vm->variablesShadow[start + i])
+			{
+				vm->variablesShadow[start + i] = value;
+				buffer[maskPos + i / 8] |= 1 << (i % 8);
+				buffer_add_int16(value);
+			}
+		}
+
+		AsebaSendBuffer(vm, buffer, buffer_pos);
+
+		start += size;
+		length -= size;
+	} while(length);
+}
+
+void AsebaSendTaggedVariables(AsebaVMState *vm, uint16_t tag, uint16_t start, uint16_t length)
+{
+	// leave room for type, tag and start; the requester knows the range, so it knows when all parts arrived
+#ifndef ASEBA_LIMITED_MESSAGE_SIZE
+	const uint16_t MAX_VARIABLES_SIZE = 255;
+#else
+	const uint16_t MAX_VARIABLES_SIZE = ((100 - 8)/2);
+#endif
+	uint16_t i;
+	do {
+		uint16_t size;
+		if (length > MAX_VARIABLES_SIZE)
+			size = MAX_VARIABLES_SIZE;
+		else
+			size = length;
+
+		buffer_pos = 0;
+		buffer_add_uint16(ASEBA_MESSAGE_TAGGED_VARIABLES);
+		buffer_add_uint16(tag);
+		buffer_add_uint16(start);
+		for (i = start; i < start + size; i++)
+			buffer_add_uint16(vm->variables[i]);
+
+		AsebaSendBuffer(vm, buffer, buffer_pos);
+
+		start += size;
+		length -= size;
+	} while(length);
+}
+
+// if set, AsebaSendDescription() hashes its messages into it instead of sending them
+BUFFER_STORAGE uint32_t* description_hash;
+
+static void description_send_buffer(AsebaVMState *vm)
+{
+	unsigned i;
+	if (!description_hash)
+	{
+		AsebaSendBuffer(vm, buffer, buffer_pos);
+		return;
+	}
+	// 32-bit FNV-1a
+	for (i = 0; i < buffer_pos; i++)
+	{
+		*description_hash ^= buffer[i];
+		*description_hash *= 16777619UL;
+	}
 }
 
 void AsebaSendDescription(AsebaVMState *vm)
@@ -164,7 +277,7 @@ void AsebaSendDescription(AsebaVMState *vm)
 	buffer_add_uint16(i);
 
 	// send buffer
-	AsebaSendBuffer(vm, buffer, buffer_pos);
+	description_send_buffer(vm);
 
 	// send named variables description
 	for (i = 0; namedVariables[i].name; i++)
@@ -177,7 +290,7 @@ void AsebaSendDescription(AsebaVMState *vm)
 		buffer_add_string(namedVariables[i].name);
 
 		// send buffer
-		AsebaSendBuffer(vm, buffer, buffer_pos);
+		description_send_buffer(vm);
 	}
 
 	// send local events description
@@ -191,7 +304,7 @@ void AsebaSendDescription(AsebaVMState *vm)
 		buffer_add_string(localEvents[i].doc);
 
 		// send buffer
-		AsebaSendBuffer(vm, buffer, buffer_pos);
+		description_send_buffer(vm);
 	}
 
 	// send native functions description
@@ -216,10 +329,20 @@ void AsebaSendDescription(AsebaVMState *vm)
 		}
 
 		// send buffer
-		AsebaSendBuffer(vm, buffer, buffer_pos);
+		description_send_buffer(vm);
 	}
 }
 
+uint32_t AsebaComputeDescriptionHash(AsebaVMState *vm)
+{
+	uint32_t hash = 2166136261UL;
+	description_hash = &hash;
+	AsebaSendDescription(vm);
+	description_hash = 0;
+	// 0 means that the node does not announce a hash
+	return hash ? hash : 1;
+}
+
 void AsebaProcessIncomingEvents(AsebaVMState *vm)
 {
 	uint16_t source;
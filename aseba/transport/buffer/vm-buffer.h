@@ -34,10 +34,13 @@ extern "C" {
 	This helper provides to the VM:
 	* AsebaSendMessage()
 	* AsebaSendVariables()
+	* AsebaSendChangedVariables()
+	* AsebaSendTaggedVariables()
 	* AsebaSendDescription()
 
 	This helper provides to the glue code:
 	* AsebaProcessIncomingEvents()
+	* AsebaComputeDescriptionHash()
 
 	This helper requires from the lower level transport layer:
 	* AsebaSendBuffer()
@@ -58,6 +61,9 @@ extern "C" {
 /*! Read messages and process messages from transport layer, if any */
 void AsebaProcessIncomingEvents(AsebaVMState *vm);
 
+/*! Return the hash of the messages AsebaSendDescription() would send, never 0, to be set in vm->descriptionHash once the description is known */
+uint32_t AsebaComputeDescriptionHash(AsebaVMState *vm);
+
 // functions this helper needs
 
 extern void AsebaSendBuffer(AsebaVMState *vm, const uint8_t* data, uint16_t length);
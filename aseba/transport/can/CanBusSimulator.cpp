@@ -0,0 +1,312 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CanBusSimulator.h"
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+
+// glue functions required by can-net.c
+
+extern "C" void AsebaIdle(void)
+{
+	// nothing to wait for, the simulator never calls AsebaCanFlushQueue()
+}
+
+extern "C" uint16_t AsebaShouldDropPacket(uint16_t, const uint8_t*)
+{
+	// simulated nodes listen to every packet
+	return 0;
+}
+
+namespace Aseba
+{
+	//! A node on the simulated bus
+	struct CanBusSimulator::Node
+	{
+		const uint16_t id;
+		AsebaCanNode* const can; //!< state of can-net.c for this node
+		std::vector<CanFrame> sendQueue;
+		std::vector<CanFrame> eventsQueue;
+		std::vector<CanFrame> bulkQueue;
+		std::vector<CanFrame> recvQueue;
+		std::deque<CanFrame> mailboxes; //!< frames held by the CAN controller, the first one taking part in arbitration
+		std::vector<double> sendTimes[2]; //!< generation time of events and bulk packets, by sequence number
+
+		Node(uint16_t id, const Parameters& parameters):
+			id(id),
+			can(AsebaCanCreateNode()),
+			sendQueue(parameters.sendQueueSize),
+			eventsQueue(parameters.eventsQueueSize),
+			bulkQueue(parameters.bulkQueueSize),
+			recvQueue(parameters.recvQueueSize)
+		{}
+
+		~Node()
+		{
+			AsebaCanDestroyNode(can);
+		}
+	};
+
+	CanBusSimulator* CanBusSimulator::current = nullptr;
+	CanBusSimulator::Node* CanBusSimulator::currentNode = nullptr;
+
+	//! Bit of the sequence number set on bulk packets
+	static const uint32_t bulkSeqBit(0x80000000);
+
+	//! Byte at position i of packet seq sent by source, after the 4 bytes of the sequence number
+	static uint8_t packetByte(uint16_t source, uint32_t seq, size_t i)
+	{
+		return static_cast<uint8_t>(seq + i + source * 37);
+	}
+
+	CanBusSimulator::CanBusSimulator(const Parameters& parameters):
+		parameters(parameters)
+	{
+		if (parameters.nodesCount < 1 || parameters.nodesCount > 255)
+			throw std::invalid_argument("The number of nodes must be between 1 and 255");
+		if (parameters.packetSize < 4 || (parameters.bulkPacketSize != 0 && parameters.bulkPacketSize < 4))
+			throw std::invalid_argument("Packets must be at least 4 bytes long to hold their sequence number");
+		if (parameters.bitrate <= 0 || parameters.pollPeriod <= 0 || parameters.txMailboxes < 1)
+			throw std::invalid_argument("Bitrate, poll period and number of mailboxes must be positive");
+
+		for (unsigned i = 0; i < parameters.nodesCount; ++i)
+			nodes.emplace_back(new Node(i + 1, parameters));
+	}
+
+	CanBusSimulator::~CanBusSimulator()
+	{
+		AsebaCanSelectNode(nullptr);
+	}
+
+	double CanBusSimulator::frameDuration(unsigned dataLength) const
+	{
+		// standard frame with interframe space, stuff bits can be inserted every 4 bits from start of frame to CRC
+		const unsigned bits(47 + 8 * dataLength + (34 + 8 * dataLength - 1) / 4);
+		return bits / parameters.bitrate;
+	}
+
+	CanBusSimulator::Results CanBusSimulator::run()
+	{
+		current = this;
+
+		for (auto& node: nodes)
+		{
+			selectNode(*node);
+			AsebaCanInit(node->id, sendFrame, isFrameRoom, receivedPacketDropped, sentPacketDropped, node->sendQueue.data(), node->sendQueue.size(), node->recvQueue.data(), node->recvQueue.size());
+			if (!node->eventsQueue.empty())
+				AsebaCanSetSendQueue(ASEBA_CAN_CLASS_EVENTS, node->eventsQueue.data(), node->eventsQueue.size());
+			if (!node->bulkQueue.empty())
+				AsebaCanSetSendQueue(ASEBA_CAN_CLASS_BULK, node->bulkQueue.data(), node->bulkQueue.size());
+		}
+
+		// schedule the first packet and poll of every node
+		enum EventType { GENERATE, GENERATE_BULK, POLL };
+		typedef std::tuple<double, unsigned, EventType> Event;
+		std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+		std::mt19937 generator(parameters.seed);
+		std::exponential_distribution<double> interval(parameters.packetRate > 0 ? parameters.packetRate : 1);
+		std::exponential_distribution<double> bulkInterval(parameters.bulkPacketRate > 0 ? parameters.bulkPacketRate : 1);
+		const bool generateBulk(parameters.bulkPacketSize != 0 && parameters.bulkPacketRate > 0);
+		std::uniform_real_distribution<double> phase(0, parameters.pollPeriod);
+		for (unsigned i = 0; i < nodes.size(); ++i)
+		{
+			if (parameters.packetRate > 0)
+				events.emplace(interval(generator), i, GENERATE);
+			if (generateBulk)
+				events.emplace(bulkInterval(generator), i, GENERATE_BULK);
+			events.emplace(phase(generator), i, POLL);
+		}
+
+		// run events and transmissions in time order
+		while (true)
+		{
+			const double nextEventTime(events.empty() ? std::numeric_limits<double>::infinity() : std::get<0>(events.top()));
+			if (transmittingNode && transmissionEnd <= nextEventTime)
+			{
+				if (transmissionEnd > parameters.duration)
+					break;
+				now = transmissionEnd;
+				endTransmission();
+			}
+			else
+			{
+				if (nextEventTime > parameters.duration)
+					break;
+				const Event event(events.top());
+				events.pop();
+				now = std::get<0>(event);
+				Node& node(*nodes[std::get<1>(event)]);
+				if (std::get<2>(event) == GENERATE)
+				{
+					generatePacket(node, false);
+					events.emplace(now + interval(generator), std::get<1>(event), GENERATE);
+				}
+				else if (std::get<2>(event) == GENERATE_BULK)
+				{
+					generatePacket(node, true);
+					events.emplace(now + bulkInterval(generator), std::get<1>(event), GENERATE_BULK);
+				}
+				else
+				{
+					pollNode(node);
+					events.emplace(now + parameters.pollPeriod, std::get<1>(event), POLL);
+				}
+			}
+			if (!transmittingNode)
+				startTransmission();
+		}
+
+		// compute statistics
+		results.busLoad = std::min(busBusyTime / parameters.duration, 1.);
+		if (nodes.size() > 1)
+			results.goodput = deliveredBytes / parameters.duration / (nodes.size() - 1);
+		const auto percentile([](std::vector<double>& values, double p) {
+			if (values.empty())
+				return 0.;
+			std::sort(values.begin(), values.end());
+			return values[std::min(values.size() - 1, size_t(p * values.size()))];
+		});
+		results.latencyP50 = percentile(latencies, 0.5);
+		results.latencyP90 = percentile(latencies, 0.9);
+		results.latencyP99 = percentile(latencies, 0.99);
+		results.latencyMax = percentile(latencies, 1);
+		results.bulkLatencyP50 = percentile(bulkLatencies, 0.5);
+		results.bulkLatencyP90 = percentile(bulkLatencies, 0.9);
+		results.bulkLatencyP99 = percentile(bulkLatencies, 0.99);
+		results.bulkLatencyMax = percentile(bulkLatencies, 1);
+
+		current = nullptr;
+		return results;
+	}
+
+	//! Create a new event or bulk packet on node and pass it to the transport layer
+	void CanBusSimulator::generatePacket(Node& node, bool bulk)
+	{
+		std::vector<double>& sendTimes(node.sendTimes[bulk]);
+		const uint32_t seq(sendTimes.size() | (bulk ? bulkSeqBit : 0));
+		sendTimes.push_back(now);
+
+		std::vector<uint8_t> data(bulk ? parameters.bulkPacketSize : parameters.packetSize);
+		data[0] = seq;
+		data[1] = seq >> 8;
+		data[2] = seq >> 16;
+		data[3] = seq >> 24;
+		for (size_t i = 4; i < data.size(); ++i)
+			data[i] = packetByte(node.id, seq, i);
+
+		++results.packetsGenerated;
+		selectNode(node);
+		AsebaCanSendSpecificClass(data.data(), data.size(), node.id, bulk ? ASEBA_CAN_CLASS_BULK : ASEBA_CAN_CLASS_EVENTS);
+	}
+
+	//! Read all packets node has received, checking their content and measuring their latency
+	void CanBusSimulator::pollNode(Node& node)
+	{
+		selectNode(node);
+		// larger than packets, to detect wrongly reassembled ones
+		uint8_t data[1024];
+		uint16_t source;
+		while (const uint16_t length = AsebaCanRecv(data, sizeof(data), &source))
+		{
+			const uint32_t seq(data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t(data[3]) << 24));
+			const bool bulk((seq & bulkSeqBit) != 0);
+			const uint32_t index(seq & ~bulkSeqBit);
+			bool valid(length == (bulk ? parameters.bulkPacketSize : parameters.packetSize) && source >= 1 && source <= nodes.size() && index < nodes[source - 1]->sendTimes[bulk].size());
+			for (size_t i = 4; valid && i < length; ++i)
+				valid = data[i] == packetByte(source, seq, i);
+			if (!valid)
+			{
+				++results.packetsCorrupted;
+				continue;
+			}
+			++results.packetsDelivered;
+			deliveredBytes += length;
+			(bulk ? bulkLatencies : latencies).push_back(now - nodes[source - 1]->sendTimes[bulk][index]);
+		}
+	}
+
+	//! Arbitrate between nodes with pending frames and start transmitting the winner, return false if the bus stays idle
+	bool CanBusSimulator::startTransmission()
+	{
+		assert(!transmittingNode);
+		for (auto& node: nodes)
+			if (!node->mailboxes.empty() && (!transmittingNode || node->mailboxes.front().id < transmittingNode->mailboxes.front().id))
+				transmittingNode = node.get();
+		if (!transmittingNode)
+			return false;
+
+		const double duration(frameDuration(transmittingNode->mailboxes.front().len));
+		transmissionEnd = now + duration;
+		busBusyTime += duration;
+		return true;
+	}
+
+	//! Deliver the frame on the bus to all other nodes, and let its sender queue the next one
+	void CanBusSimulator::endTransmission()
+	{
+		Node& sender(*transmittingNode);
+		const CanFrame frame(sender.mailboxes.front());
+		for (auto& node: nodes)
+		{
+			if (node.get() == &sender)
+				continue;
+			selectNode(*node);
+			AsebaCanFrameReceived(&frame);
+		}
+		++results.framesTransmitted;
+
+		sender.mailboxes.pop_front();
+		transmittingNode = nullptr;
+		selectNode(sender);
+		AsebaCanFrameSent();
+	}
+
+	void CanBusSimulator::selectNode(Node& node)
+	{
+		currentNode = &node;
+		AsebaCanSelectNode(node.can);
+	}
+
+	void CanBusSimulator::sendFrame(const CanFrame *frame)
+	{
+		currentNode->mailboxes.push_back(*frame);
+	}
+
+	int CanBusSimulator::isFrameRoom()
+	{
+		return currentNode->mailboxes.size() < current->parameters.txMailboxes;
+	}
+
+	void CanBusSimulator::receivedPacketDropped()
+	{
+		++current->results.receivedDropped;
+	}
+
+	void CanBusSimulator::sentPacketDropped()
+	{
+		++current->results.sentDropped;
+	}
+} // namespace Aseba
@@ -0,0 +1,141 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_CAN_BUS_SIMULATOR
+#define ASEBA_CAN_BUS_SIMULATOR
+
+#include "can-net.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace Aseba
+{
+	/**
+		\addtogroup can
+
+		Simulation of a CAN bus on a host, running the transport layer of can-net.c
+		for many virtual nodes in a single process.
+	*/
+	/*@{*/
+
+	//! Simulate nodes exchanging packets through the Aseba CAN transport layer over an arbitrated bus
+	/**
+		Each node has its own send and receive queues in can-net.c, and a CAN controller
+		holding up to txMailboxes frames. When the bus is idle, the controller whose first
+		frame has the lowest identifier wins the arbitration. The frame then occupies the
+		bus for its worst-case length in bits, stuff bits included, at the given bitrate,
+		and is delivered to all other nodes at the end of its transmission.
+
+		Nodes generate user events of packetSize bytes following a Poisson process of packetRate
+		packets per second, and read the packets they received every pollPeriod seconds.
+		Optionally, they also generate bulk packets, such as variables, of bulkPacketSize bytes
+		at bulkPacketRate packets per second. Events and bulk packets share the send queue of
+		can-net.c, unless eventsQueueSize or bulkQueueSize give them their own.
+		The simulation is deterministic for a given seed.
+
+		As can-net.c uses global callbacks, only one simulator can run at a time.
+	*/
+	class CanBusSimulator
+	{
+	public:
+		//! Configuration of a simulation
+		struct Parameters
+		{
+			unsigned nodesCount = 8; //!< number of nodes on the bus, at most 255
+			double bitrate = 1000000; //!< bitrate of the bus in bit/s
+			size_t sendQueueSize = 64; //!< size in frames of the send queue of each node
+			size_t eventsQueueSize = 0; //!< size in frames of a separate send queue for events, 0 to use the send queue
+			size_t bulkQueueSize = 0; //!< size in frames of a separate send queue for bulk packets, 0 to use the send queue
+			size_t recvQueueSize = 64; //!< size in frames of the receive queue of each node
+			unsigned txMailboxes = 1; //!< number of frames each CAN controller can hold for transmission
+			double pollPeriod = 0.001; //!< period in s at which nodes read the packets they received
+			size_t packetSize = 20; //!< size in bytes of generated packets, at least 4
+			double packetRate = 10; //!< packets generated by each node per second
+			size_t bulkPacketSize = 0; //!< size in bytes of generated bulk packets, at least 4, 0 for none
+			double bulkPacketRate = 0; //!< bulk packets generated by each node per second
+			double duration = 10; //!< simulated time in s
+			unsigned long seed = 0; //!< seed of the random number generator
+		};
+
+		//! Measurements of a simulation
+		struct Results
+		{
+			unsigned long packetsGenerated = 0; //!< packets the nodes tried to send
+			unsigned long sentDropped = 0; //!< packets refused by AsebaCanSend(), counted by sentPacketDroppedFP
+			unsigned long receivedDropped = 0; //!< calls to receivedPacketDroppedFP, one per frame that did not fit in a receive queue
+			unsigned long packetsDelivered = 0; //!< packets read by receiving nodes, each receiver counting once
+			unsigned long packetsCorrupted = 0; //!< packets read with unexpected content or length
+			unsigned long framesTransmitted = 0; //!< frames that went on the bus
+			double busLoad = 0; //!< fraction of time the bus was busy
+			double goodput = 0; //!< payload bytes per second read by each receiving node, on average
+			double latencyP50 = 0; //!< median time in s from generation to reading by a receiver
+			double latencyP90 = 0; //!< 90th percentile of latency in s
+			double latencyP99 = 0; //!< 99th percentile of latency in s
+			double latencyMax = 0; //!< maximum latency in s
+			double bulkLatencyP50 = 0; //!< median latency of bulk packets in s, other latencies are of events
+			double bulkLatencyP90 = 0; //!< 90th percentile of latency of bulk packets in s
+			double bulkLatencyP99 = 0; //!< 99th percentile of latency of bulk packets in s
+			double bulkLatencyMax = 0; //!< maximum latency of bulk packets in s
+		};
+
+	public:
+		explicit CanBusSimulator(const Parameters& parameters);
+		~CanBusSimulator();
+
+		//! Run the simulation and return its measurements
+		Results run();
+
+		//! Return the time in s a frame of dataLength bytes occupies the bus, including worst-case bit stuffing and interframe space
+		double frameDuration(unsigned dataLength) const;
+
+	protected:
+		struct Node;
+
+		void generatePacket(Node& node, bool bulk);
+		void pollNode(Node& node);
+		bool startTransmission();
+		void endTransmission();
+		void selectNode(Node& node);
+
+		static void sendFrame(const CanFrame *frame);
+		static int isFrameRoom();
+		static void receivedPacketDropped();
+		static void sentPacketDropped();
+
+	protected:
+		const Parameters parameters;
+		std::vector<std::unique_ptr<Node>> nodes;
+		double now = 0;
+		Node* transmittingNode = nullptr; //!< node whose frame is on the bus, if any
+		double transmissionEnd = 0;
+		double busBusyTime = 0;
+		std::vector<double> latencies;
+		std::vector<double> bulkLatencies;
+		size_t deliveredBytes = 0;
+		Results results;
+
+		static CanBusSimulator* current; //!< simulator running, for can-net.c callbacks
+		static Node* currentNode; //!< node selected in can-net.c
+	};
+
+	/*@}*/
+} // namespace Aseba
+
+#endif // ASEBA_CAN_BUS_SIMULATOR
@@ -19,6 +19,7 @@
 */
 
 #include "can-net.h"
+#include "common/consts.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -27,15 +28,33 @@
 #define TYPE_PACKET_START 0x1
 #define TYPE_PACKET_STOP 0x2
 
-#define CANID_TO_TYPE(canid) ((canid) >> 8)
+#define CANID_TO_TYPE(canid) (((canid) >> 8) & 0x3)
 #define CANID_TO_ID(canid) ((canid) & 0xff)
 #define TO_CANID(type, id) (((type) << 8) | (id))
 
+// set on frames of bulk packets when they have their own send queue, so that they lose arbitration
+#define CANID_LOW_PRIORITY 0x400
+// frames of a packet share their source and priority, packets of different priorities can interleave
+#define CANID_TO_SENDER(canid) ((canid) & (CANID_LOW_PRIORITY | 0xff))
+
 #define ASEBA_MIN(a, b) (((a) < (b)) ? (a) : (b))
 
 
+// senders are the 256 ids at two priorities
+#define SENDERS_COUNT 512
+#define SENDER_TO_INDEX(sender) (((sender) & 0xff) | (((sender) & CANID_LOW_PRIORITY) >> 2))
+
+/*! A circular queue of frames waiting to be passed to the physical layer */
+typedef struct
+{
+	CanFrame* frames; /*!< NULL if the class of this queue uses the control one */
+	size_t size;
+	uint16_t insertPos;
+	uint16_t consumePos;
+} AsebaCanSendQueue;
+
 /*!	This contains the state of the CAN implementation of Aseba network */
-static struct AsebaCan
+struct AsebaCan
 {
 	// data
 	uint16_t id; /*!< identifier of this node on CAN */
@@ -46,11 +65,10 @@ static struct AsebaCan
 	AsebaCanVoidVoidFP receivedPacketDroppedFP;
 	AsebaCanVoidVoidFP sentPacketDroppedFP;
 
-	// send buffer
-	CanFrame* sendQueue;
-	size_t sendQueueSize;
-	uint16_t sendQueueInsertPos;
-	uint16_t sendQueueConsumePos;
+	// send buffers, by class of packets, in decreasing order of priority
+	AsebaCanSendQueue sendQueues[ASEBA_CAN_CLASS_COUNT];
+	// for normal and low priority, queue whose multi-frame packet is being passed to the physical layer plus one, 0 if none
+	uint16_t sendingPacketQueue[2];
 
 	// reception buffer
 	CanFrame* recvQueue;
@@ -60,7 +78,17 @@ static struct AsebaCan
 
 	uint16_t volatile sendQueueLock;
 
-} asebaCan;
+	// bitfield of senders (see CANID_TO_SENDER) whose packet being received is filtered out, one bit per sender
+	uint16_t dropping[SENDERS_COUNT / 16];
+};
+
+#ifdef ASEBA_CAN_MULTIPLE_NODES
+// several nodes run in the same process, the functions below work on the one selected by AsebaCanSelectNode()
+static struct AsebaCan* asebaCanNode;
+#define asebaCan (*asebaCanNode)
+#else // ASEBA_CAN_MULTIPLE_NODES
+static struct AsebaCan asebaCan;
+#endif // ASEBA_CAN_MULTIPLE_NODES
 
 /** \addtogroup can */
 /*@{*/
@@ -74,60 +102,104 @@ uint16_t AsebaCanGetMinMultipleOfHeight(uint16_t v)
 	return m;
 }
 
-/*! Returned the number of used frames in the send queue*/
-static uint16_t AsebaCanSendQueueGetUsedFrames(void)
+/*! Returned the number of used frames in a send queue*/
+static uint16_t AsebaCanSendQueueGetUsedFrames(const AsebaCanSendQueue* queue)
 {
 	uint16_t ipos, cpos;
-	ipos = asebaCan.sendQueueInsertPos;
-	cpos =  asebaCan.sendQueueConsumePos;
+	ipos = queue->insertPos;
+	cpos = queue->consumePos;
 
 	if (ipos >= cpos)
 		return ipos - cpos;
 	else
-		return asebaCan.sendQueueSize - cpos + ipos;
+		return queue->size - cpos + ipos;
 }
 
-/*! Returned the number of free frames in the send queue */
-static uint16_t AsebaCanSendQueueGetFreeFrames(void)
+/*! Returned the number of free frames in a send queue */
+static uint16_t AsebaCanSendQueueGetFreeFrames(const AsebaCanSendQueue* queue)
 {
-	return asebaCan.sendQueueSize - AsebaCanSendQueueGetUsedFrames();
+	return queue->size - AsebaCanSendQueueGetUsedFrames(queue);
 }
 
-/*! Insert a frame in the send queue, do not check for overwrite */
-static void AsebaCanSendQueueInsert(uint16_t canid, const uint8_t *data, size_t size)
+/*! Return the queue where packets of a given class are stored */
+static AsebaCanSendQueue* AsebaCanSendQueueOfClass(AsebaCanPacketClass packetClass)
+{
+	if (asebaCan.sendQueues[packetClass].frames)
+		return &asebaCan.sendQueues[packetClass];
+	return &asebaCan.sendQueues[ASEBA_CAN_CLASS_CONTROL];
+}
+
+/*! Insert a frame in a send queue, do not check for overwrite */
+static void AsebaCanSendQueueInsert(AsebaCanSendQueue* queue, uint16_t canid, const uint8_t *data, size_t size)
 {
 	uint16_t temp;
-	memcpy(asebaCan.sendQueue[asebaCan.sendQueueInsertPos].data, data, size);
-	asebaCan.sendQueue[asebaCan.sendQueueInsertPos].id = canid;
-	asebaCan.sendQueue[asebaCan.sendQueueInsertPos].len = size;
+	memcpy(queue->frames[queue->insertPos].data, data, size);
+	queue->frames[queue->insertPos].id = canid;
+	queue->frames[queue->insertPos].len = size;
 
 
-	temp = asebaCan.sendQueueInsertPos + 1;
-	if (temp >= asebaCan.sendQueueSize)
+	temp = queue->insertPos + 1;
+	if (temp >= queue->size)
 		temp = 0;
-	asebaCan.sendQueueInsertPos = temp;
+	queue->insertPos = temp;
+}
+
+/*! Return the index of the queue of highest priority that can pass a frame to the physical layer, or -1 if none */
+static int AsebaCanSendQueueSelect(void)
+{
+	int i;
+	for (i = 0; i < ASEBA_CAN_CLASS_COUNT; i++)
+	{
+		const AsebaCanSendQueue* queue = &asebaCan.sendQueues[i];
+		uint16_t priority, sending;
+		if (!queue->frames || queue->consumePos == queue->insertPos)
+			continue;
+
+		// receivers reassemble packets by sender, so a packet must not start while another of the same priority is being sent
+		priority = (queue->frames[queue->consumePos].id & CANID_LOW_PRIORITY) ? 1 : 0;
+		sending = asebaCan.sendingPacketQueue[priority];
+		if (sending && sending != i + 1)
+			continue;
+
+		return i;
+	}
+	return -1;
 }
 
-/*! Send frames in send queue to physical layer until it is full */
+/*! Send frames in send queues to physical layer until it is full, most urgent classes first */
 static void AsebaCanSendQueueToPhysicalLayer(void)
 {
 	uint16_t temp;
+	int i;
 
-	while (asebaCan.isFrameRoomFP() && (asebaCan.sendQueueConsumePos != asebaCan.sendQueueInsertPos))
+	while (asebaCan.isFrameRoomFP() && (AsebaCanSendQueueSelect() >= 0))
 	{
+		AsebaCanSendQueue* queue;
+		const CanFrame* frame;
+		uint16_t priority;
+
 		asebaCan.sendQueueLock = 1;
-		if(!(asebaCan.isFrameRoomFP() && (asebaCan.sendQueueConsumePos != asebaCan.sendQueueInsertPos))) 
+		i = AsebaCanSendQueueSelect();
+		if(!(asebaCan.isFrameRoomFP() && (i >= 0)))
 		{
 			asebaCan.sendQueueLock = 0;
 			continue;
 		}
+		queue = &asebaCan.sendQueues[i];
+		frame = queue->frames + queue->consumePos;
 
-		asebaCan.sendFrameFP(asebaCan.sendQueue + asebaCan.sendQueueConsumePos);
+		priority = (frame->id & CANID_LOW_PRIORITY) ? 1 : 0;
+		if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_START)
+			asebaCan.sendingPacketQueue[priority] = i + 1;
+		else if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_STOP)
+			asebaCan.sendingPacketQueue[priority] = 0;
 
-		temp = asebaCan.sendQueueConsumePos + 1;
-		if (temp >= asebaCan.sendQueueSize)
+		asebaCan.sendFrameFP(frame);
+
+		temp = queue->consumePos + 1;
+		if (temp >= queue->size)
 			temp = 0;
-		asebaCan.sendQueueConsumePos = temp; 
+		queue->consumePos = temp;
 		asebaCan.sendQueueLock = 0;
 	}
 
@@ -167,16 +239,16 @@ static void AsebaCanRecvQueueGarbageCollect(void)
 	}
 }
 
-/*! Free frames associated with an id in the reception queue */
-static void AsebaCanRecvQueueFreeFrames(uint16_t id)
+/*! Free frames associated with a sender in the reception queue */
+static void AsebaCanRecvQueueFreeFrames(uint16_t sender)
 {
 	uint16_t i;
 
 	// for all used frames...
 	for (i = asebaCan.recvQueueConsumePos; i != asebaCan.recvQueueInsertPos;)
 	{
-		// if frame is of a specific id, mark frame as unused
-		if (CANID_TO_ID(asebaCan.recvQueue[i].id) == id)
+		// if frame is of a specific sender, mark frame as unused
+		if (CANID_TO_SENDER(asebaCan.recvQueue[i].id) == sender)
 			asebaCan.recvQueue[i].used = 0;
 
 		i++;
@@ -185,6 +257,27 @@ static void AsebaCanRecvQueueFreeFrames(uint16_t id)
 	}
 }
 
+/*! Filter out the frames of sender up to the stop of its current packet */
+static void AsebaCanRecvStartDropping(uint16_t sender)
+{
+	const uint16_t index = SENDER_TO_INDEX(sender);
+	asebaCan.dropping[index >> 4] |= 1 << (index & 0xf);
+}
+
+/*! Stop filtering out the frames of sender */
+static void AsebaCanRecvStopDropping(uint16_t sender)
+{
+	const uint16_t index = SENDER_TO_INDEX(sender);
+	asebaCan.dropping[index >> 4] &= ~(1 << (index & 0xf));
+}
+
+/*! Return whether the frames of sender are filtered out */
+static uint16_t AsebaCanRecvIsDropping(uint16_t sender)
+{
+	const uint16_t index = SENDER_TO_INDEX(sender);
+	return (asebaCan.dropping[index >> 4] >> (index & 0xf)) & 1;
+}
+
 
 void AsebaCanInit(uint16_t id, AsebaCanSendFrameFP sendFrameFP, AsebaCanIntVoidFP isFrameRoomFP, AsebaCanVoidVoidFP receivedPacketDroppedFP, AsebaCanVoidVoidFP sentPacketDroppedFP, CanFrame* sendQueue, size_t sendQueueSize, CanFrame* recvQueue, size_t recvQueueSize)
 {
@@ -195,10 +288,11 @@ void AsebaCanInit(uint16_t id, AsebaCanSendFrameFP sendFrameFP, AsebaCanIntVoidF
 	asebaCan.receivedPacketDroppedFP = receivedPacketDroppedFP;
 	asebaCan.sentPacketDroppedFP = sentPacketDroppedFP;
 
-	asebaCan.sendQueue = sendQueue;
-	asebaCan.sendQueueSize = sendQueueSize;
-	asebaCan.sendQueueInsertPos = 0;
-	asebaCan.sendQueueConsumePos = 0;
+	memset(asebaCan.sendQueues, 0, sizeof(asebaCan.sendQueues));
+	asebaCan.sendQueues[ASEBA_CAN_CLASS_CONTROL].frames = sendQueue;
+	asebaCan.sendQueues[ASEBA_CAN_CLASS_CONTROL].size = sendQueueSize;
+	asebaCan.sendingPacketQueue[0] = 0;
+	asebaCan.sendingPacketQueue[1] = 0;
 
 	asebaCan.recvQueue = recvQueue;
 	asebaCan.recvQueueSize = recvQueueSize;
@@ -208,6 +302,47 @@ void AsebaCanInit(uint16_t id, AsebaCanSendFrameFP sendFrameFP, AsebaCanIntVoidF
 	asebaCan.sendQueueLock = 0;
 }
 
+void AsebaCanSetSendQueue(AsebaCanPacketClass packetClass, CanFrame* sendQueue, size_t sendQueueSize)
+{
+	AsebaCanSendQueue* queue = &asebaCan.sendQueues[packetClass];
+	int i;
+	for (i = 0; i < 2; i++)
+		if (asebaCan.sendingPacketQueue[i] == packetClass + 1)
+			asebaCan.sendingPacketQueue[i] = 0;
+	queue->frames = sendQueue;
+	queue->size = sendQueueSize;
+	queue->insertPos = 0;
+	queue->consumePos = 0;
+}
+
+AsebaCanPacketClass AsebaCanGetPacketClass(const uint8_t *data, size_t size)
+{
+	uint16_t type;
+	if (size < 2)
+		return ASEBA_CAN_CLASS_CONTROL;
+
+	type = data[0] | (data[1] << 8);
+	if (type < 0x8000)
+		return ASEBA_CAN_CLASS_EVENTS;
+
+	switch (type)
+	{
+		case ASEBA_MESSAGE_BOOTLOADER_DESCRIPTION:
+		case ASEBA_MESSAGE_BOOTLOADER_PAGE_DATA_READ:
+		case ASEBA_MESSAGE_BOOTLOADER_PAGE_CHECKSUMS:
+		case ASEBA_MESSAGE_DESCRIPTION:
+		case ASEBA_MESSAGE_NAMED_VARIABLE_DESCRIPTION:
+		case ASEBA_MESSAGE_LOCAL_EVENT_DESCRIPTION:
+		case ASEBA_MESSAGE_NATIVE_FUNCTION_DESCRIPTION:
+		case ASEBA_MESSAGE_VARIABLES:
+		case ASEBA_MESSAGE_CHANGED_VARIABLES:
+		case ASEBA_MESSAGE_TAGGED_VARIABLES:
+			return ASEBA_CAN_CLASS_BULK;
+		default:
+			return ASEBA_CAN_CLASS_CONTROL;
+	}
+}
+
 uint16_t AsebaCanSend(const uint8_t *data, size_t size)
 {
 	return AsebaCanSendSpecificSource(data, size, asebaCan.id);
@@ -215,12 +350,24 @@ uint16_t AsebaCanSend(const uint8_t *data, size_t size)
 
 uint16_t AsebaCanSendSpecificSource(const uint8_t *data, size_t size, uint16_t source)
 {
+	return AsebaCanSendSpecificClass(data, size, source, AsebaCanGetPacketClass(data, size));
+}
+
+uint16_t AsebaCanSendSpecificClass(const uint8_t *data, size_t size, uint16_t source, AsebaCanPacketClass packetClass)
+{
+	AsebaCanSendQueue* queue = AsebaCanSendQueueOfClass(packetClass);
+	uint16_t frameRequired;
+
+	// bulk packets lose arbitration against others only if they have their own queue, otherwise they would block it anyway
+	if (packetClass == ASEBA_CAN_CLASS_BULK && queue == &asebaCan.sendQueues[ASEBA_CAN_CLASS_BULK])
+		source |= CANID_LOW_PRIORITY;
+
 	// send everything we can to maximize the space in the buffer
 	AsebaCanSendQueueToPhysicalLayer();
 
 	// check free space
-	uint16_t frameRequired = AsebaCanGetMinMultipleOfHeight(size);
-	if (AsebaCanSendQueueGetFreeFrames() <= frameRequired)
+	frameRequired = AsebaCanGetMinMultipleOfHeight(size);
+	if (AsebaCanSendQueueGetFreeFrames(queue) <= frameRequired)
 	{
 		asebaCan.sentPacketDroppedFP();
 		return 0;
@@ -229,19 +376,19 @@ uint16_t AsebaCanSendSpecificSource(const uint8_t *data, size_t size, uint16_t s
 	// insert
 	if (size <= 8)
 	{
-		AsebaCanSendQueueInsert(TO_CANID(TYPE_SMALL_PACKET, source), data, size);
+		AsebaCanSendQueueInsert(queue, TO_CANID(TYPE_SMALL_PACKET, source), data, size);
 	}
 	else
 	{
 		size_t pos = 8;
 
-		AsebaCanSendQueueInsert(TO_CANID(TYPE_PACKET_START, source), data, 8);
+		AsebaCanSendQueueInsert(queue, TO_CANID(TYPE_PACKET_START, source), data, 8);
 		while (pos + 8 < size)
 		{
-			AsebaCanSendQueueInsert(TO_CANID(TYPE_PACKET_NORMAL, source), data + pos, 8);
+			AsebaCanSendQueueInsert(queue, TO_CANID(TYPE_PACKET_NORMAL, source), data + pos, 8);
 			pos += 8;
 		}
-		AsebaCanSendQueueInsert(TO_CANID(TYPE_PACKET_STOP, source), data + pos, size - pos);
+		AsebaCanSendQueueInsert(queue, TO_CANID(TYPE_PACKET_STOP, source), data + pos, size - pos);
 	}
 
 	// send everything we can to minimize the transmission delay
@@ -263,9 +410,19 @@ void AsebaCanFrameSent()
 		AsebaCanSendQueueToPhysicalLayer();
 }
 
+/*! Return true if all send queues are empty */
+static uint16_t AsebaCanSendQueuesEmpty(void)
+{
+	int i;
+	for (i = 0; i < ASEBA_CAN_CLASS_COUNT; i++)
+		if (asebaCan.sendQueues[i].consumePos != asebaCan.sendQueues[i].insertPos)
+			return 0;
+	return 1;
+}
+
 void AsebaCanFlushQueue(void)
 {
-	while(asebaCan.sendQueueConsumePos != asebaCan.sendQueueInsertPos || !asebaCan.isFrameRoomFP())
+	while(!AsebaCanSendQueuesEmpty() || !asebaCan.isFrameRoomFP())
 		AsebaIdle();
 }
 
@@ -298,7 +455,7 @@ uint16_t AsebaCanRecv(uint8_t *data, size_t size, uint16_t *source)
 			else if (CANID_TO_TYPE(asebaCan.recvQueue[i].id) == TYPE_PACKET_STOP)
 			{
 				stopPos = i;
-				stopId = CANID_TO_ID(asebaCan.recvQueue[i].id);
+				stopId = CANID_TO_SENDER(asebaCan.recvQueue[i].id);
 				break;
 			}
 		}
@@ -318,7 +475,7 @@ uint16_t AsebaCanRecv(uint8_t *data, size_t size, uint16_t *source)
 	{
 		if(asebaCan.recvQueue[i].used) {
 
-			if (CANID_TO_ID(asebaCan.recvQueue[i].id) == stopId)
+			if (CANID_TO_SENDER(asebaCan.recvQueue[i].id) == stopId)
 			{
 			if (pos < size)
 					{
@@ -344,13 +501,11 @@ uint16_t AsebaCanRecv(uint8_t *data, size_t size, uint16_t *source)
 	return pos;
 }
 
-#define MAX_DROPPING_SOURCE 20
-static uint16_t dropping[MAX_DROPPING_SOURCE];
-
 void AsebaCanFrameReceived(const CanFrame *frame)
 {
 
 	uint16_t source = CANID_TO_ID(frame->id);
+	uint16_t sender = CANID_TO_SENDER(frame->id);
 
 	// check whether this packet should be filtered or not
 	if (CANID_TO_TYPE(frame->id) == TYPE_SMALL_PACKET)
@@ -360,41 +515,33 @@ void AsebaCanFrameReceived(const CanFrame *frame)
 	}
 	else if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_START)
 	{
+		// a new packet starts, in case the stop of the previous one was lost
+		AsebaCanRecvStopDropping(sender);
 		if (AsebaShouldDropPacket(source, frame->data))
 		{
-			uint16_t i;
-			for (i = 0; i < MAX_DROPPING_SOURCE; i++)
-			{
-				if (dropping[i] == 0)
-				{
-					dropping[i] = source + 1;
-					return;
-				}
-			}
+			AsebaCanRecvStartDropping(sender);
+			return;
 		}
 	}
-	else
+	else if (AsebaCanRecvIsDropping(sender))
 	{
-		uint16_t i;
-		for (i = 0; i < MAX_DROPPING_SOURCE; i++)
-		{
-			if (dropping[i] == source + 1)
-			{
-				if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_STOP)
-					dropping[i] = 0;
-				return;
-			}
-		}
+		if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_STOP)
+			AsebaCanRecvStopDropping(sender);
+		return;
 	}
 
 	if (AsebaCanRecvQueueGetMinFreeFrames() <= 1)
 	{
-		// if packet is stop, free associated frames, otherwise this could lead to everlasting used frames
-		if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_STOP) {
-			AsebaCanRecvQueueFreeFrames(source);
+		// for multi-frame packets, free associated frames, otherwise this could lead to everlasting used frames
+		if (CANID_TO_TYPE(frame->id) != TYPE_SMALL_PACKET) {
+			AsebaCanRecvQueueFreeFrames(sender);
 			AsebaCanRecvQueueGarbageCollect();
 		}
 
+		// and filter out the rest of the packet, otherwise its stop would reassemble it without this frame
+		if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_START || CANID_TO_TYPE(frame->id) == TYPE_PACKET_NORMAL)
+			AsebaCanRecvStartDropping(sender);
+
 		// notify user
 		asebaCan.receivedPacketDroppedFP();
 	}
@@ -419,8 +566,29 @@ void AsebaCanRecvFreeQueue(void)
 	asebaCan.recvQueueInsertPos = 0;
 	asebaCan.recvQueueConsumePos = 0;
 
-	for(i = 0; i < MAX_DROPPING_SOURCE; i++) 
-		dropping[i] = 0;
+	for(i = 0; i < SENDERS_COUNT / 16; i++)
+		asebaCan.dropping[i] = 0;
 }
 
+#ifdef ASEBA_CAN_MULTIPLE_NODES
+
+AsebaCanNode* AsebaCanCreateNode(void)
+{
+	return (AsebaCanNode*)calloc(1, sizeof(struct AsebaCan));
+}
+
+void AsebaCanDestroyNode(AsebaCanNode* node)
+{
+	if (asebaCanNode == node)
+		asebaCanNode = NULL;
+	free(node);
+}
+
+void AsebaCanSelectNode(AsebaCanNode* node)
+{
+	asebaCanNode = node;
+}
+
+#endif // ASEBA_CAN_MULTIPLE_NODES
+
 /*@}*/
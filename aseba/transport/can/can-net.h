@@ -40,6 +40,18 @@ extern "C" {
 
 	This transport layer only works on little-endian systems for now,
 	as it does not perform endian correction.
+
+	Packets to send are sorted in classes, each of which can have its
+	own send queue: control packets first, then user events, then bulk
+	transfers such as descriptions and variables. By default, all
+	classes share the queue given to AsebaCanInit(), and the order of
+	packets is preserved. Once AsebaCanSetSendQueue() gives a class its
+	own queue, its packets can overtake or be overtaken by packets of
+	other classes. If bulk packets have their own queue, their frames
+	additionally use a lower-priority CAN identifier, so that they lose
+	the arbitration against frames of other classes from all nodes;
+	as receivers older than this feature do not understand these
+	identifiers, only do so on buses where all nodes are up to date.
 */
 /*@{*/
 
@@ -54,6 +66,15 @@ typedef struct
 	unsigned used:1; /*!< when frame is in a circular buffer, tell if it frame is used */
 } CanFrame;
 
+/*! Classes of packets, in decreasing order of sending priority */
+typedef enum
+{
+	ASEBA_CAN_CLASS_CONTROL = 0, /*!< debug and bootloader protocol, except bulk transfers */
+	ASEBA_CAN_CLASS_EVENTS, /*!< user events */
+	ASEBA_CAN_CLASS_BULK, /*!< descriptions, variables and bootloader pages sent by nodes */
+	ASEBA_CAN_CLASS_COUNT
+} AsebaCanPacketClass;
+
 /*! Pointer to a void function */
 typedef void (*AsebaCanVoidVoidFP)(void);
 
@@ -69,13 +90,27 @@ typedef void (*AsebaCanSendFrameFP)(const CanFrame *frame);
 	@param isFrameRoomFP pointer to a function that returns if the data layer is ready to send frames
 	@param receivedPacketDroppedFP pointer to a function that is called when a received packet has been dropped, for various reasons but mostly related to insufficient memory
 	@param sentPacketDroppedFP pointer to a function that is called when a sent packet has been dropped (AsebaCanSend() returned 0), for various reasons but mostly related to insufficient memory
-	@param sendQueue pointer to send queue data
+	@param sendQueue pointer to send queue data, used for control packets and for classes without their own queue
 	@param sendQueueSize number of frame in sendQueue
 	@param recvQueue pointer to receive queue data
 	@param recvQueueSize number of frame in recvQueue
 */
 void AsebaCanInit(uint16_t id, AsebaCanSendFrameFP sendFrameFP, AsebaCanIntVoidFP isFrameRoomFP, AsebaCanVoidVoidFP receivedPacketDroppedFP, AsebaCanVoidVoidFP sentPacketDroppedFP, CanFrame* sendQueue, size_t sendQueueSize, CanFrame* recvQueue, size_t recvQueueSize);
 
+/*! Give a class of packets its own send queue, must be called after AsebaCanInit().
+	On RAM-limited targets, the queues of all classes can be small, or only some classes can have their own.
+	@param packetClass class of packets to store in this queue, ASEBA_CAN_CLASS_CONTROL replaces the queue given to AsebaCanInit()
+	@param sendQueue pointer to send queue data, NULL to share the control queue again
+	@param sendQueueSize number of frame in sendQueue
+*/
+void AsebaCanSetSendQueue(AsebaCanPacketClass packetClass, CanFrame* sendQueue, size_t sendQueueSize);
+
+/*! Return the class of an aseba packet, from its message type.
+	@param data pointer to the packet
+	@param size amount of data in the packet
+*/
+AsebaCanPacketClass AsebaCanGetPacketClass(const uint8_t *data, size_t size);
+
 /*! Send data as an aseba packet.
 	@param data pointer to the data to send
 	@param size amount of data to send
@@ -91,6 +126,15 @@ uint16_t AsebaCanSend(const uint8_t *data, size_t size);
 */
 uint16_t AsebaCanSendSpecificSource(const uint8_t *data, size_t size, uint16_t source);
 
+/*! Send data as an aseba packet of a given class, regardless of its message type.
+	@param data pointer to the data to send
+	@param size amount of data to send
+	@param source identifier to use as source
+	@param packetClass class of the packet, selecting its send queue and priority
+	@return 1 on success, 0 on failure
+*/
+uint16_t AsebaCanSendSpecificClass(const uint8_t *data, size_t size, uint16_t source, AsebaCanPacketClass packetClass);
+
 /*! Copy data from a received packet to the caller-provided buffer.
 	Remove the packet from the reception queue afterwards.
 	@param data pointer where to copy the data
@@ -100,7 +144,7 @@ uint16_t AsebaCanSendSpecificSource(const uint8_t *data, size_t size, uint16_t s
 */
 uint16_t AsebaCanRecv(uint8_t *data, size_t size, uint16_t *source);
 
-/*! Wait until the send queue is empty
+/*! Wait until the send queues are empty
 */
 void AsebaCanFlushQueue(void);
 
@@ -127,6 +171,24 @@ void AsebaCanFrameSent(void);
 /*! Return true if the recv buffer is empty, false otherwise */
 uint16_t AsebaCanRecvBufferEmpty(void);
 
+#ifdef ASEBA_CAN_MULTIPLE_NODES
+
+// to run several nodes in the same process, for instance to simulate a bus on a host
+
+/*! Opaque state of the CAN layer of one node */
+typedef struct AsebaCan AsebaCanNode;
+
+/*! Allocate the state of a node, to be initialized by AsebaCanInit() once selected */
+AsebaCanNode* AsebaCanCreateNode(void);
+
+/*! Free the state of a node */
+void AsebaCanDestroyNode(AsebaCanNode* node);
+
+/*! Select the node all other functions of this layer work on, until the next call */
+void AsebaCanSelectNode(AsebaCanNode* node);
+
+#endif // ASEBA_CAN_MULTIPLE_NODES
+
 /*@}*/
 
 #ifdef __cplusplus
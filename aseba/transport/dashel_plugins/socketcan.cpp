@@ -76,9 +76,11 @@ class CanStream: public SelectableStream
 #define TYPE_PACKET_START 0x1
 #define TYPE_PACKET_STOP 0x2
 
-#define CANID_TO_TYPE(canid) ((canid) >> 8)
+#define CANID_TO_TYPE(canid) (((canid) >> 8) & 0x3)
 #define CANID_TO_ID(canid) ((int) ((canid) & 0xFF))
 #define TO_CANID(type,id) (((type) << 8) | (id))
+// bulk packets sent by nodes with a separate bulk queue have this bit set, see can-net.h
+#define CANID_TO_SENDER(canid) ((int) ((canid) & 0x4FF))
 
 	protected:
 		unsigned char tx_buffer[ASEBA_MAX_OUTER_PACKET_SIZE];
@@ -87,19 +89,32 @@ class CanStream: public SelectableStream
 		unsigned int rx_len;
 		unsigned int rx_p;
 
-		struct iovec iov;
-		struct msghdr msg;
 		struct sockaddr_can addr;
-		char ctrlmsg[CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(__u32))];
-		struct can_frame rframe;
 
+// Frames of outgoing packets, sent together with sendmmsg
+#define TX_CAN_SIZE 256
+// Time to wait for room in the socket buffer, in ms
+#define TX_TIMEOUT 1000
+// Delay before retrying when the queue of the interface is full, in us, and number of retries
+#define TX_BACKOFF 200
+#define TX_BACKOFF_RETRIES 5000
+		struct can_frame tx_frames[TX_CAN_SIZE];
+		struct iovec tx_iov[TX_CAN_SIZE];
+		struct mmsghdr tx_msgs[TX_CAN_SIZE];
+		int tx_frames_count;
+
+// Incoming frames are received with recvmmsg directly into the free slots of rx_fifo, at most RX_BATCH at once
 #define RX_CAN_SIZE 1000
+#define RX_BATCH 64
 		struct {
 			struct can_frame f;
 			int used;
 		} rx_fifo[RX_CAN_SIZE];
 		int rx_insert;
 		int rx_consume;
+		struct iovec rx_iov[RX_BATCH];
+		struct mmsghdr rx_msgs[RX_BATCH];
+		char rx_ctrlmsg[RX_BATCH][CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(__u32))];
 	public:
 		CanStream(const string &targetName) :
 			Stream("can"),
@@ -143,17 +158,25 @@ class CanStream: public SelectableStream
 
 			rx_insert = rx_consume = 0;
 			tx_len = 0;
+			tx_frames_count = 0;
 			rx_len = 0;
 			rx_p = 0;
 			memset(rx_fifo, 0, sizeof(rx_fifo));
-			iov.iov_base = &rframe;
-			msg.msg_iov = &iov;
-			msg.msg_name = &addr;
-			msg.msg_namelen = sizeof(addr);
-			msg.msg_iovlen = 1;
-			msg.msg_control = ctrlmsg;
-			msg.msg_controllen = sizeof(ctrlmsg);
-			msg.msg_flags = 0;
+			memset(tx_msgs, 0, sizeof(tx_msgs));
+			for(int i = 0; i < TX_CAN_SIZE; i++)
+			{
+				tx_iov[i].iov_base = &tx_frames[i];
+				tx_iov[i].iov_len = sizeof(tx_frames[i]);
+				tx_msgs[i].msg_hdr.msg_iov = &tx_iov[i];
+				tx_msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			memset(rx_msgs, 0, sizeof(rx_msgs));
+			for(int i = 0; i < RX_BATCH; i++)
+			{
+				rx_iov[i].iov_len = sizeof(struct can_frame);
+				rx_msgs[i].msg_hdr.msg_iov = &rx_iov[i];
+				rx_msgs[i].msg_hdr.msg_iovlen = 1;
+			}
 		}
 	private:
 		int is_packet_tx(void)
@@ -167,27 +190,60 @@ class CanStream: public SelectableStream
 			return 0;
 		}
 
-		void can_write_frame(struct can_frame * f)
+		// Send all queued frames, with as few syscalls as possible
+		void send_frames(void)
 		{
-			ssize_t ret;
-
-			do {
-				ret = ::write(fd, f, sizeof(*f));
+			int sent = 0;
+			int retries = 0;
+			while(sent < tx_frames_count)
+			{
+				int ret = sendmmsg(fd, &tx_msgs[sent], tx_frames_count - sent, MSG_DONTWAIT);
+				if(ret > 0)
+				{
+					sent += ret;
+					retries = 0;
+					continue;
+				}
 
-				if(ret == -1 && errno == ENOBUFS)
+				if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
 				{
+					// Socket buffer is full, wait until there is room
 					struct pollfd pf;
 					pf.fd = fd;
-					pf.events = POLLOUT | POLLHUP;
+					pf.events = POLLOUT;
 					pf.revents = 0;
-					if (poll(&pf, 1, 0) == -1)
-						perror("socketcan: can_write_frame: error while polling the socket");
+					ret = poll(&pf, 1, TX_TIMEOUT);
+					if(ret == 0)
+						throw DashelException(DashelException::IOError, 0, "Write timeout", this);
+					if(ret == -1 && errno != EINTR)
+						throw DashelException(DashelException::IOError, errno, "Poll error", this);
+					if(pf.revents & (POLLERR | POLLHUP))
+						throw DashelException(DashelException::ConnectionLost, 0, "Interface error", this);
 					continue;
 				}
 
-				if(ret != sizeof(*f))
-					throw DashelException(DashelException::IOError, 0, "Write error", this);
-			} while(0);
+				if(ret == -1 && errno == ENOBUFS)
+				{
+					// Queue of the interface is full, which poll does not report, so back off a little
+					if(++retries > TX_BACKOFF_RETRIES)
+						throw DashelException(DashelException::IOError, 0, "Write timeout", this);
+					usleep(TX_BACKOFF);
+					continue;
+				}
+
+				if(ret == -1 && errno == EINTR)
+					continue;
+
+				throw DashelException(DashelException::IOError, errno, "Write error", this);
+			}
+			tx_frames_count = 0;
+		}
+
+		void can_write_frame(struct can_frame * f)
+		{
+			if(tx_frames_count == TX_CAN_SIZE)
+				send_frames();
+			tx_frames[tx_frames_count++] = *f;
 		}
 
 		void send_aseba_packet()
@@ -246,10 +302,15 @@ class CanStream: public SelectableStream
 				if(is_packet_tx())
 					send_aseba_packet();
 			}
+			// Send the frames of all packets completed by this write at once
+			if(tx_frames_count)
+				send_frames();
 		}
 
 		virtual void flush() 
 		{
+			if(tx_frames_count)
+				send_frames();
 		}
 	private:
 		void pack_fifo()
@@ -293,7 +354,7 @@ class CanStream: public SelectableStream
 					if(CANID_TO_TYPE(rx_fifo[i].f.can_id) == TYPE_PACKET_STOP)
 					{
 						stopPos = i;
-						stopId = CANID_TO_ID(rx_fifo[i].f.can_id);
+						stopId = CANID_TO_SENDER(rx_fifo[i].f.can_id);
 						break;
 					}
 				}
@@ -306,12 +367,12 @@ class CanStream: public SelectableStream
 
 			i = rx_consume;
 			// Len will be filled lated
-			rx_buffer[2] = stopId;
+			rx_buffer[2] = CANID_TO_ID(stopId);
 			rx_buffer[3] = 0;
 			rx_len = 4;
 			while(1) 
 			{
-				if(rx_fifo[i].used && CANID_TO_ID(rx_fifo[i].f.can_id) == stopId)
+				if(rx_fifo[i].used && CANID_TO_SENDER(rx_fifo[i].f.can_id) == stopId)
 				{
 					if(rx_len == 4 && CANID_TO_TYPE(rx_fifo[i].f.can_id) != TYPE_PACKET_START)
 						// We got a stop, but not a start, let's ignore this packet
@@ -344,14 +405,6 @@ class CanStream: public SelectableStream
 				return 1;
 			}
 		}
-		int fifo_full() 
-		{
-			int i = rx_insert + 1;
-			if(i == RX_CAN_SIZE)
-				i = 0;
-			return i == rx_consume;
-		}
-
 		void read_iface(void)
 		{
 			int def;
@@ -361,15 +414,57 @@ class CanStream: public SelectableStream
 				if(def == 1)
 					break;
 
+				recv_frames();
+			}
+			pack_fifo();
+		}
+
+		// Number of free slots in the fifo after rx_insert, before it wraps or reaches rx_consume
+		int fifo_contiguous_free()
+		{
+			int end;
+			if(rx_insert >= rx_consume)
+				end = rx_consume ? RX_CAN_SIZE : RX_CAN_SIZE - 1;
+			else
+				end = rx_consume - 1;
+			return end - rx_insert;
+		}
+
+		// Wait for at least one frame, then receive all available ones, up to RX_BATCH, directly into the fifo
+		void recv_frames(void)
+		{
+			int count = fifo_contiguous_free();
+			if(count == 0)
+				throw DashelException(DashelException::IOError, 0, "Fifo full", this);
+			if(count > RX_BATCH)
+				count = RX_BATCH;
+
+			for(int i = 0; i < count; i++)
+			{
+				rx_iov[i].iov_base = &rx_fifo[rx_insert + i].f;
+				rx_msgs[i].msg_hdr.msg_name = &addr;
+				rx_msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+				rx_msgs[i].msg_hdr.msg_control = rx_ctrlmsg[i];
+				rx_msgs[i].msg_hdr.msg_controllen = sizeof(rx_ctrlmsg[i]);
+				rx_msgs[i].msg_hdr.msg_flags = 0;
+			}
+
+			int received;
+			do {
+				received = recvmmsg(fd, rx_msgs, count, MSG_WAITFORONE, nullptr);
+			} while(received == -1 && errno == EINTR);
+			if(received <= 0)
+				throw DashelException(DashelException::IOError, 0, "Read error", this);
+
+			for(int i = 0; i < received; i++)
+			{
 				struct cmsghdr *cmsg;
-				iov.iov_len = sizeof(rframe);
-				msg.msg_flags = 0;
-				if(recvmsg(fd, &msg, 0) < (int) sizeof(rframe))
+				if(rx_msgs[i].msg_len < sizeof(struct can_frame))
 					throw DashelException(DashelException::IOError, 0, "Read error", this);
 
-				for(cmsg = CMSG_FIRSTHDR(&msg); 
+				for(cmsg = CMSG_FIRSTHDR(&rx_msgs[i].msg_hdr);
 					cmsg && (cmsg->cmsg_level == SOL_SOCKET);
-					cmsg = CMSG_NXTHDR(&msg,cmsg))
+					cmsg = CMSG_NXTHDR(&rx_msgs[i].msg_hdr,cmsg))
 				{
 					if(cmsg->cmsg_type == SO_RXQ_OVFL)
 					{
@@ -379,16 +474,11 @@ class CanStream: public SelectableStream
 					}
 				}
 
-				if(fifo_full())
-					throw DashelException(DashelException::IOError, 0, "Fifo full", this);
-
 				// push to fifo ...
-				memcpy(&rx_fifo[rx_insert].f,&rframe,sizeof(rframe));
 				rx_fifo[rx_insert++].used = 1;
 				if(rx_insert == RX_CAN_SIZE)
 					rx_insert = 0;
 			}
-			pack_fifo();
 		}
 	public:
 		virtual void read(void *data, size_t size) 
@@ -1105,17 +1105,16 @@ const AsebaNativeFunctionDescription AsebaNativeDescription_vecnonzerosequence =
 	}
 };
 
-static uint16_t rnd_state;
-
-void AsebaSetRandomSeed(uint16_t seed)
+// the state is in the VM, so that VMs run on different threads do not share it
+void AsebaSetRandomSeed(AsebaVMState *vm, uint16_t seed)
 {
-	rnd_state = seed;
+	vm->randomState = seed;
 }
 
-uint16_t AsebaGetRandom()
+uint16_t AsebaGetRandom(AsebaVMState *vm)
 {
-	rnd_state = 25173 * rnd_state + 13849;
-	return rnd_state;
+	vm->randomState = 25173 * vm->randomState + 13849;
+	return vm->randomState;
 }
 
 void AsebaNative_rand(AsebaVMState *vm)
@@ -1129,7 +1128,7 @@ void AsebaNative_rand(AsebaVMState *vm)
 	uint16_t i;
 	for (i = 0; i < length; i++)
 	{
-		vm->variables[destIndex++] = (int16_t)AsebaGetRandom();
+		vm->variables[destIndex++] = (int16_t)AsebaGetRandom(vm);
 	}
 }
 
@@ -196,10 +196,10 @@ void AsebaNative_vecnonzerosequence(AsebaVMState *vm);
 /*! Description of AsebaNative_vecnonzerosequence */
 extern const AsebaNativeFunctionDescription AsebaNativeDescription_vecnonzerosequence;
 
-/*! Functon to set the seed of random generator */
-void AsebaSetRandomSeed(uint16_t seed);
-/*! Functon to get a random number */
-uint16_t AsebaGetRandom(void);
+/*! Functon to set the seed of the random generator of a VM */
+void AsebaSetRandomSeed(AsebaVMState *vm, uint16_t seed);
+/*! Functon to get a random number from the random generator of a VM */
+uint16_t AsebaGetRandom(AsebaVMState *vm);
 /*! Function to get a 16-bit signed random number */
 void AsebaNative_rand(AsebaVMState *vm);
 /*! Description of AsebaNative_rand */
@@ -46,6 +46,8 @@ void AsebaVMInit(AsebaVMState *vm)
 	vm->pc = 0;
 	vm->flags = 0;
 	vm->breakpointsCount = 0;
+	vm->variablesGeneration = 0;
+	vm->watchesCount = 0;
 
 	// fill with no event
 	vm->bytecode[0] = 0;
@@ -710,6 +712,136 @@ void AsebaVMClearBreakpoints(AsebaVMState *vm)
 	vm->breakpointsCount = 0;
 }
 
+/*! Return a checksum of some variables, to detect their changes when there is no room for a copy of them.
+	This is a Fletcher checksum but modulo 65536 instead of 65535, as with the latter 0 and -1 have the same sum,
+	and any change of a single variable must be detected. Changes of several variables can be missed. */
+static uint32_t AsebaVMWatchChecksum(AsebaVMState *vm, uint16_t start, uint16_t length)
+{
+	uint16_t sum1 = 0, sum2 = 0;
+	uint16_t i;
+	for (i = 0; i < length; i++)
+	{
+		sum1 += (uint16_t)vm->variables[start + i];
+		sum2 += sum1;
+	}
+	return ((uint32_t)sum2 << 16) | sum1;
+}
+
+/*! Return the position in watchesValues for a copy of length variables, after the copies of the other watches,
+	or ASEBA_WATCH_NO_COPY if there is no room for it. Copies are kept in the order of the watches. */
+static uint16_t AsebaVMWatchAllocate(AsebaVMState *vm, uint16_t length)
+{
+	uint16_t used = 0;
+	uint16_t i;
+	if (!vm->watchesValues)
+		return ASEBA_WATCH_NO_COPY;
+	for (i = 0; i < vm->watchesCount; i++)
+		if (vm->watches[i].valuesPos != ASEBA_WATCH_NO_COPY)
+			used = vm->watches[i].valuesPos + vm->watches[i].length;
+	if (length > vm->watchesValuesSize - used)
+		return ASEBA_WATCH_NO_COPY;
+	return used;
+}
+
+/*! Return whether the variables of a watch differ from when they were last sent. */
+static uint8_t AsebaVMWatchChanged(AsebaVMState *vm, AsebaVMWatch *watch)
+{
+	if (watch->valuesPos != ASEBA_WATCH_NO_COPY)
+		return memcmp(vm->watchesValues + watch->valuesPos, vm->variables + watch->start, watch->length * sizeof(int16_t)) != 0;
+	return AsebaVMWatchChecksum(vm, watch->start, watch->length) != watch->checksum;
+}
+
+/*! Send the variables of a watch and remember them to detect their changes. */
+static void AsebaVMWatchSend(AsebaVMState *vm, AsebaVMWatch *watch)
+{
+	if (watch->valuesPos != ASEBA_WATCH_NO_COPY)
+		memcpy(vm->watchesValues + watch->valuesPos, vm->variables + watch->start, watch->length * sizeof(int16_t));
+	else
+		watch->checksum = AsebaVMWatchChecksum(vm, watch->start, watch->length);
+	watch->unsentTime = 0;
+	watch->wait = watch->period;
+	AsebaSendVariables(vm, watch->start, watch->length);
+}
+
+/*! Watch some variables, or change the period if they are already watched, and send them. */
+static uint8_t AsebaVMSetWatch(AsebaVMState *vm, uint16_t start, uint16_t length, uint16_t period)
+{
+	AsebaVMWatch *watch = 0;
+	uint16_t i;
+
+	#ifdef ASEBA_ASSERT
+	if (start + length > vm->variablesSize)
+		AsebaAssert(vm, ASEBA_ASSERT_OUT_OF_VARIABLES_BOUNDS);
+	#endif
+
+	for (i = 0; i < vm->watchesCount; i++)
+		if (vm->watches[i].start == start && vm->watches[i].length == length)
+			watch = &vm->watches[i];
+	if (!watch)
+	{
+		uint16_t valuesPos;
+		if (vm->watchesCount >= vm->watchesSize)
+			return 0;
+		valuesPos = AsebaVMWatchAllocate(vm, length);
+		watch = &vm->watches[vm->watchesCount++];
+		watch->start = start;
+		watch->length = length;
+		watch->valuesPos = valuesPos;
+	}
+
+	// send the current values, the next ones will only be sent on changes
+	watch->period = period;
+	AsebaVMWatchSend(vm, watch);
+	return 1;
+}
+
+/*! Stop watching some variables, or all variables if length is 0.
+	The remaining watches keep their order and their copies are moved down, so that the room left is at the end of watchesValues. */
+static void AsebaVMClearWatch(AsebaVMState *vm, uint16_t start, uint16_t length)
+{
+	uint16_t count = 0;
+	uint16_t used = 0;
+	uint16_t i;
+	for (i = 0; i < vm->watchesCount; i++)
+	{
+		AsebaVMWatch watch = vm->watches[i];
+		if (length == 0 || (watch.start == start && watch.length == length))
+			continue;
+		if (watch.valuesPos != ASEBA_WATCH_NO_COPY)
+		{
+			memmove(vm->watchesValues + used, vm->watchesValues + watch.valuesPos, watch.length * sizeof(int16_t));
+			watch.valuesPos = used;
+			used += watch.length;
+		}
+		vm->watches[count++] = watch;
+	}
+	vm->watchesCount = count;
+}
+
+void AsebaVMSendWatchedVariables(AsebaVMState *vm, uint16_t elapsed)
+{
+	uint16_t i;
+	for (i = 0; i < vm->watchesCount; i++)
+	{
+		AsebaVMWatch *watch = &vm->watches[i];
+
+		if (elapsed >= ASEBA_WATCH_REFRESH_DELAY - watch->unsentTime)
+			watch->unsentTime = ASEBA_WATCH_REFRESH_DELAY;
+		else
+			watch->unsentTime += elapsed;
+		if (watch->wait > elapsed)
+		{
+			watch->wait -= elapsed;
+			continue;
+		}
+		watch->wait = 0;
+
+		if (AsebaVMWatchChanged(vm, watch) ||
+			(watch->valuesPos == ASEBA_WATCH_NO_COPY && watch->unsentTime >= ASEBA_WATCH_REFRESH_DELAY))
+			AsebaVMWatchSend(vm, watch);
+	}
+}
+
 /*! Send an execution state changed message */
 void AsebaVMSendExecutionStateChanged(AsebaVMState *vm)
 {
@@ -768,8 +900,21 @@ void AsebaVMDebugMessage(AsebaVMState *vm, uint16_t id, uint16_t *data, uint16_t
 	// react to global list nodes
 	if (id == ASEBA_MESSAGE_LIST_NODES)
 	{
-		const uint16_t protocolVersion = ASEBA_PROTOCOL_VERSION;
-		AsebaSendMessageWords(vm, ASEBA_MESSAGE_NODE_PRESENT, &protocolVersion, 1);
+		// optional features follow the protocol version, older hosts ignore them
+		uint16_t presence[4];
+		presence[0] = ASEBA_PROTOCOL_VERSION;
+		presence[1] = ASEBA_NODE_FEATURE_TAGGED_VARIABLES;
+		if (vm->variablesShadow)
+			presence[1] |= ASEBA_NODE_FEATURE_CHANGED_VARIABLES;
+		if (vm->watchesSize)
+			presence[1] |= ASEBA_NODE_FEATURE_WATCH_VARIABLES;
+		if (vm->descriptionHash)
+		{
+			presence[1] |= ASEBA_NODE_FEATURE_DESCRIPTION_HASH;
+			presence[2] = (uint16_t)(vm->descriptionHash & 0xffff);
+			presence[3] = (uint16_t)(vm->descriptionHash >> 16);
+		}
+		AsebaSendMessageWords(vm, ASEBA_MESSAGE_NODE_PRESENT, presence, vm->descriptionHash ? 4 : 2);
 		return;
 	}
 
@@ -869,6 +1014,44 @@ void AsebaVMDebugMessage(AsebaVMState *vm, uint16_t id, uint16_t *data, uint16_t
 		}
 		break;
 
+		case ASEBA_MESSAGE_GET_CHANGED_VARIABLES:
+		{
+			uint16_t start = bswap16(data[0]);
+			uint16_t length = bswap16(data[1]);
+			uint16_t generation = dataLength > 2 ? bswap16(data[2]) : 0;
+			#ifdef ASEBA_ASSERT
+			if (start + length > vm->variablesSize)
+				AsebaAssert(vm, ASEBA_ASSERT_OUT_OF_VARIABLES_BOUNDS);
+			#endif
+			// without shadow, answer like to ASEBA_MESSAGE_GET_VARIABLES
+			if (vm->variablesShadow)
+				AsebaSendChangedVariables(vm, start, length, generation);
+			else
+				AsebaSendVariables(vm, start, length);
+		}
+		break;
+
+		case ASEBA_MESSAGE_GET_TAGGED_VARIABLES:
+		{
+			uint16_t start = bswap16(data[0]);
+			uint16_t length = bswap16(data[1]);
+			uint16_t tag = bswap16(data[2]);
+			#ifdef ASEBA_ASSERT
+			if (start + length > vm->variablesSize)
+				AsebaAssert(vm, ASEBA_ASSERT_OUT_OF_VARIABLES_BOUNDS);
+			#endif
+			AsebaSendTaggedVariables(vm, tag, start, length);
+		}
+		break;
+
+		case ASEBA_MESSAGE_WATCH_VARIABLES:
+		AsebaVMSetWatch(vm, bswap16(data[0]), bswap16(data[1]), bswap16(data[2]));
+		break;
+
+		case ASEBA_MESSAGE_UNWATCH_VARIABLES:
+		AsebaVMClearWatch(vm, bswap16(data[0]), bswap16(data[1]));
+		break;
+
 		case ASEBA_MESSAGE_SET_VARIABLES:
 		{
 			uint16_t start = bswap16(data[0]);
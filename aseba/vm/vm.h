@@ -52,9 +52,23 @@ else
 
 enum
 {
-	ASEBA_MAX_BREAKPOINTS = 16		//!< maximum number of simultaneous breakpoints the target supports
+	ASEBA_MAX_BREAKPOINTS = 16,		//!< maximum number of simultaneous breakpoints the target supports
+	ASEBA_WATCH_NO_COPY = 0xffff,		//!< AsebaVMWatch::valuesPos of watches without a copy of their values
+	ASEBA_WATCH_REFRESH_DELAY = 1000	//!< maximum time in ms between two sends of watches without a copy of their values
 };
 
+/*! A range of variables that the VM sends when it changes, see ASEBA_MESSAGE_WATCH_VARIABLES */
+typedef struct
+{
+	uint16_t start; /*!< address of the first variable */
+	uint16_t length; /*!< number of variables */
+	uint16_t period; /*!< minimum time between two sends, in ms */
+	uint16_t wait; /*!< time left before the variables can be sent again, in ms */
+	uint16_t valuesPos; /*!< position in AsebaVMState::watchesValues of the variables when last sent, ASEBA_WATCH_NO_COPY if there was no room for them */
+	uint16_t unsentTime; /*!< time since the variables were last sent, in ms, saturated; only used without a copy */
+	uint32_t checksum; /*!< checksum of the variables when last sent; only used without a copy */
+} AsebaVMWatch;
+
 /*! This structure contains the state of the Aseba VM.
 	This is the required and the sufficient data for the VM to run.
 	This is not sufficient for the compiler to build bytecode, as there is
@@ -90,6 +104,26 @@ typedef struct
 	// breakpoint
 	uint16_t breakpoints[ASEBA_MAX_BREAKPOINTS];
 	uint16_t breakpointsCount;
+
+	// variables as last sent by AsebaSendChangedVariables()
+	int16_t * variablesShadow; /*!< copy of variables of size variablesSize, NULL if ASEBA_MESSAGE_GET_CHANGED_VARIABLES is not supported; must be set before AsebaVMInit() */
+	uint16_t variablesGeneration; /*!< number of the last ASEBA_MESSAGE_CHANGED_VARIABLES sent, 0 if none since AsebaVMInit() */
+
+	// variables sent when they change by AsebaVMSendWatchedVariables()
+	AsebaVMWatch * watches; /*!< array of watchesSize watches, NULL if ASEBA_MESSAGE_WATCH_VARIABLES is not supported; must be set before AsebaVMInit() */
+	uint16_t watchesSize;
+	uint16_t watchesCount; /*!< number of watches in use, at the beginning of watches */
+	int16_t * watchesValues; /*!< copies of the watched variables when last sent, of size watchesValuesSize, NULL if none; must be set before AsebaVMInit()
+		Watches whose variables do not fit detect changes with a checksum, which misses some changes of several variables,
+		so these are also sent every ASEBA_WATCH_REFRESH_DELAY ms. */
+	uint16_t watchesValuesSize;
+
+	uint32_t descriptionHash; /*!< hash of the messages sent by AsebaSendDescription(), announced in ASEBA_MESSAGE_NODE_PRESENT, 0 if none; not changed by AsebaVMInit() */
+
+	uint16_t randomState; /*!< state of the random number generator of this VM, see AsebaSetRandomSeed(); not changed by AsebaVMInit() */
+
+	// context
+	void * userData; /*!< data of the program embedding the VM, for instance to find the object owning it in callbacks; not used by the VM */
 } AsebaVMState;
 
 // Macros to work with masks
@@ -114,6 +148,11 @@ typedef struct
 */
 void AsebaVMInit(AsebaVMState *vm);
 
+/*! Send the watched variables that changed, if their period has elapsed.
+	Must be called regularly from the main loop of nodes that set watches, with the time in ms since the previous call.
+*/
+void AsebaVMSendWatchedVariables(AsebaVMState *vm, uint16_t elapsed);
+
 /*!	Return the starting address of an event, or 0 if the event is not handled. */
 uint16_t AsebaVMGetEventAddress(AsebaVMState *vm, uint16_t event);
 
@@ -155,6 +194,13 @@ void AsebaSendMessageWords(AsebaVMState *vm, uint16_t type, const uint16_t* data
 /*! Called by AsebaVMDebugMessage when some variables must be sent efficiently */
 void AsebaSendVariables(AsebaVMState *vm, uint16_t start, uint16_t length);
 
+/*! Called by AsebaVMDebugMessage when the variables that changed since the ASEBA_MESSAGE_CHANGED_VARIABLES of a given generation must be sent,
+	all of them if generation is 0; only called if vm->variablesShadow is set */
+void AsebaSendChangedVariables(AsebaVMState *vm, uint16_t start, uint16_t length, uint16_t generation);
+
+/*! Called by AsebaVMDebugMessage when some variables must be sent along with the tag of the request asking for them */
+void AsebaSendTaggedVariables(AsebaVMState *vm, uint16_t tag, uint16_t start, uint16_t length);
+
 /*! Called by AsebaVMDebugMessage when VM must send its description on the network. */
 void AsebaSendDescription(AsebaVMState *vm);
 
@@ -148,6 +148,13 @@ class Aseba(object):
         else:
             return [int(dbus_array[x]) for x in range(0,size)]
 
+    def get_many(self, node, vars):
+        """ Read several variables of node with a single D-Bus call, returns a list of lists of values.
+        """
+        if self.dummy: return [[0] * 10 for var in vars]
+        dbus_arrays = self.network.GetVariables(node, vars)
+        return [[int(x) for x in dbus_array] for dbus_array in dbus_arrays]
+
     def send_event(self, event_id, event_args):
 
         if isinstance(event_id, basestring):
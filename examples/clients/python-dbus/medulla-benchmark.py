@@ -0,0 +1,199 @@
+#!/usr/bin/python
+# -*- coding: utf-8 -*-
+
+"""
+Measure the rate at which asebamedulla answers D-Bus calls.
+
+Run it against a medulla connected to a node, for instance on a private session bus
+with a dummy node, so that other programs do not interfere:
+
+    asebadummynode -p 33334 0 &
+    dbus-run-session -- sh -c 'asebamedulla -p 33335 "tcp:localhost;33334" & sleep 2; python medulla-benchmark.py reads dummynode-0 id source args'
+
+The reads benchmark reads the variables one by one, then concurrently, which
+medulla coalesces when several calls read the same variables, and finally with
+the batched GetVariables call.
+
+With --check VARIABLE, the reads benchmark first checks that concurrent reads
+of VARIABLE, which medulla coalesces, all get the same values, and that a read
+following a write gets the written values even while an earlier read of the
+same variable is in flight, which medulla must not let the later read join:
+
+    python medulla-benchmark.py --check args reads dummynode-0 id source args
+
+The events benchmark sends events through medulla and measures the rate at
+which several event filters receive them, with one Event signal per event and
+then with batching enabled:
+
+    dbus-run-session -- sh -c 'asebamedulla & sleep 2; python medulla-benchmark.py events'
+"""
+
+from __future__ import print_function
+
+import sys
+import time
+import dbus
+from dbus.mainloop.glib import DBusGMainLoop
+import gobject
+
+def network_interface(bus):
+    return dbus.Interface(bus.get_object('ch.epfl.mobots.Aseba', '/'), dbus_interface='ch.epfl.mobots.AsebaNetwork')
+
+def report(what, count, duration, unit="calls"):
+    print("%-40s %8d %s in %6.2f s: %8.1f %s/s" % (what, count, unit, duration, count / duration, unit))
+
+def bench_reads(network, node, variables, rounds, concurrency):
+    # one by one, every call waits for the network
+    start = time.time()
+    for i in range(rounds):
+        for variable in variables:
+            network.GetVariable(node, variable)
+    report("GetVariable, sequential", rounds * len(variables), time.time() - start)
+
+    # concurrent calls, replies are handled by the main loop
+    loop = gobject.MainLoop()
+    state = { 'pending': 0, 'sent': 0, 'errors': 0 }
+    total = rounds * len(variables)
+    def send():
+        while state['pending'] < concurrency and state['sent'] < total:
+            variable = variables[state['sent'] % len(variables)]
+            state['sent'] += 1
+            state['pending'] += 1
+            network.GetVariable(node, variable, reply_handler=reply, error_handler=error)
+    def reply(values):
+        state['pending'] -= 1
+        if state['sent'] == total and state['pending'] == 0:
+            loop.quit()
+        else:
+            send()
+    def error(e):
+        state['errors'] += 1
+        reply(None)
+    start = time.time()
+    send()
+    loop.run()
+    report("GetVariable, %d concurrent" % concurrency, total, time.time() - start)
+    if state['errors']:
+        print("  %d calls failed" % state['errors'])
+
+    # all variables in a single call
+    start = time.time()
+    for i in range(rounds):
+        network.GetVariables(node, variables)
+    report("GetVariables, %d variables per call" % len(variables), rounds, time.time() - start)
+
+def check_reads(network, node, variable, rounds, concurrency):
+    loop = gobject.MainLoop()
+    length = len(network.GetVariable(node, variable))
+    state = { 'round': 0, 'pending': 0, 'failures': 0 }
+
+    def done():
+        state['pending'] -= 1
+        if state['pending'] == 0:
+            next_round()
+    def error(e):
+        state['failures'] += 1
+        print("  read failed: %s" % e)
+        done()
+    def check_coalesced(results, values):
+        results.append(list(values))
+        if len(results) == concurrency and any(result != results[0] for result in results):
+            state['failures'] += 1
+            print("  coalesced reads got different values")
+        done()
+    def check_written(expected, values):
+        if list(values) != expected:
+            state['failures'] += 1
+            print("  read after write got %s instead of %s" % (list(values), expected))
+        done()
+
+    def next_round():
+        i = state['round']
+        if i == rounds:
+            loop.quit()
+            return
+        state['round'] += 1
+        # concurrent reads of the same variable, joining a single request
+        results = []
+        for j in range(concurrency):
+            network.GetVariable(node, variable, reply_handler=lambda values: check_coalesced(results, values), error_handler=error)
+        # a write then a read, while the reads above are in flight
+        expected = [(i * 7 + k) % 100 for k in range(length)]
+        network.SetVariable(node, variable, expected, ignore_reply=True)
+        network.GetVariable(node, variable, reply_handler=lambda values: check_written(expected, values), error_handler=error)
+        state['pending'] = concurrency + 1
+
+    gobject.idle_add(next_round)
+    loop.run()
+    print("%-40s %8d rounds, %d failures" % ("Coalesced reads and read after write", rounds, state['failures']))
+    return state['failures'] == 0
+
+def bench_events(bus, network, count, filters_count, batching):
+    loop = gobject.MainLoop()
+    state = { 'received': 0 }
+    expected = count * filters_count
+
+    def received(count):
+        state['received'] += count
+        if state['received'] >= expected:
+            loop.quit()
+
+    filters = []
+    for i in range(filters_count):
+        filter = dbus.Interface(bus.get_object('ch.epfl.mobots.Aseba', network.CreateEventFilter()), dbus_interface='ch.epfl.mobots.EventFilter')
+        filter.ListenEvent(1)
+        if batching:
+            filter.SetBatching(True)
+            filter.connect_to_signal('Events', lambda ids, names, values: received(len(ids)))
+        else:
+            filter.connect_to_signal('Event', lambda id, name, values: received(1))
+        filters.append(filter)
+
+    def send():
+        for i in range(count):
+            network.SendEvent(1, [i, i, i, i], ignore_reply=True)
+        return False
+
+    # stop after a while if some signals are lost
+    gobject.timeout_add(30000, loop.quit)
+    gobject.idle_add(send)
+    start = time.time()
+    loop.run()
+    duration = time.time() - start
+    report("%d filters, %s" % (filters_count, "Events, batched" if batching else "Event"), state['received'], duration, "events")
+    if state['received'] < expected:
+        print("  %d events not received" % (expected - state['received']))
+
+    for filter in filters:
+        filter.Free()
+
+if __name__ == '__main__':
+    from optparse import OptionParser
+    parser = OptionParser(usage="usage: %prog [options] reads NODE VARIABLE... | events")
+    parser.add_option("-s", "--system", action="store_true", dest="system", default=False,
+            help="use the system bus instead of the session bus")
+    parser.add_option("-n", "--rounds", type="int", dest="rounds", default=200,
+            help="number of times every variable is read")
+    parser.add_option("-c", "--concurrency", type="int", dest="concurrency", default=16,
+            help="number of calls in flight in concurrent benchmarks")
+    parser.add_option("--check", dest="check", default=None, metavar="VARIABLE",
+            help="before the reads benchmark, check coalesced reads and reads following writes of VARIABLE, which is overwritten")
+    parser.add_option("-e", "--events", type="int", dest="events", default=10000,
+            help="number of events sent by the events benchmark")
+    parser.add_option("-f", "--filters", type="int", dest="filters", default=4,
+            help="number of event filters in the events benchmark")
+    (options, args) = parser.parse_args()
+    if not ((len(args) >= 3 and args[0] == 'reads') or (len(args) == 1 and args[0] == 'events')):
+        parser.print_usage()
+        sys.exit(1)
+
+    DBusGMainLoop(set_as_default=True)
+    bus = dbus.SystemBus() if options.system else dbus.SessionBus()
+    network = network_interface(bus)
+    if args[0] == 'reads':
+        if options.check and not check_reads(network, args[1], options.check, options.rounds, options.concurrency):
+            sys.exit(2)
+        bench_reads(network, args[1], args[2:], options.rounds, options.concurrency)
+    else:
+        bench_events(bus, network, options.events, options.filters, False)
+        bench_events(bus, network, options.events, options.filters, True)
@@ -0,0 +1,319 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ASEBA_TEST_FAKE_BOOTLOADER_H
+#define ASEBA_TEST_FAKE_BOOTLOADER_H
+
+#include "common/consts.h"
+#include "common/msg/msg.h"
+#include "common/utils/BootloaderInterface.h"
+#include "common/utils/HexFile.h"
+#include "common/utils/utils.h"
+#include <dashel/dashel.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Aseba
+{
+	//! Write a hex file of pagesCount pages of pageSize bytes, each filled with a pattern depending on its number, return its pages
+	inline BootloaderInterface::PageMap writeTestHexFile(const std::string& fileName, unsigned pageSize, unsigned pagesCount)
+	{
+		HexFile hexFile;
+		auto& data(hexFile.data[0]);
+		for (unsigned i = 0; i < pageSize * pagesCount; ++i)
+			data.push_back(uint8_t(i * 7 + i / pageSize));
+		hexFile.write(fileName);
+		return BootloaderInterface::pagesFromHex(hexFile, pageSize);
+	}
+
+	//! Stream collecting what is written to it
+	class BufferStream: public Dashel::Stream
+	{
+	public:
+		std::deque<uint8_t> buffer;
+
+		BufferStream(): Stream("buffer") {}
+		void write(const void *data, const size_t size) override
+		{
+			const auto* bytes(reinterpret_cast<const uint8_t*>(data));
+			buffer.insert(buffer.end(), bytes, bytes + size);
+		}
+		void flush() override {}
+		void read(void *data, size_t size) override
+		{
+			throw Dashel::DashelException(Dashel::DashelException::InvalidOperation, 0, "Cannot read from a buffer stream", this);
+		}
+	};
+
+	//! A node in bootloader, answering the commands written to it through this stream
+	/**
+		Pages written with the pipelined protocol are acknowledged only when the
+		host reads or polls while having nothing left to read, that is once it
+		waits for an acknowledgement, so that the host fills its window first.
+		Reading when nothing is left to answer throws, as the host would block
+		forever.
+	*/
+	class FakeBootloader: public Dashel::Stream
+	{
+	public:
+		// behaviour
+		const uint16_t id;
+		BootloaderDescription description;
+		const bool simple; //!< pages are read and written raw, without description
+		std::map<unsigned, unsigned> failures; //!< number of times the writing of a page fails before succeeding
+		bool reverseAcks = false; //!< acknowledge the pages being written newest first
+		std::map<unsigned, uint32_t> reportedChecksums; //!< checksums reported instead of the ones of the flash
+
+		// state
+		std::map<unsigned, std::vector<uint8_t>> flash; //!< content of the pages, 0 if missing
+		std::vector<unsigned> writtenPages; //!< pages written successfully, in order
+		std::vector<unsigned> readPages; //!< pages read back, in order
+		unsigned checksumsRequests = 0;
+		unsigned maxPagesInFlight = 0; //!< maximum number of pipelined pages received before the host waited for an acknowledgement
+		bool rebooted = false;
+		bool reset = false;
+
+	public:
+		//! Create a bootloader with id and a flash of pagesCount pages of pageSize bytes starting at pagesStart, pipelined if windowSize is not 0
+		FakeBootloader(uint16_t id, unsigned pageSize, unsigned pagesStart, unsigned pagesCount, unsigned windowSize = 0, bool simple = false):
+			Stream("fake-bootloader"),
+			id(id),
+			simple(simple)
+		{
+			description.source = id;
+			description.pageSize = pageSize;
+			description.pagesStart = pagesStart;
+			description.pagesCount = pagesCount;
+			description.maxFrameSize = windowSize ? pageSize / 2 : 0;
+			description.windowSize = windowSize;
+		}
+
+		//! Return the content of page
+		std::vector<uint8_t> page(unsigned pageNumber) const
+		{
+			const auto pageIt(flash.find(pageNumber));
+			return pageIt == flash.end() ? std::vector<uint8_t>(description.pageSize, 0) : pageIt->second;
+		}
+
+		//! Return the number of bytes the host can read, answering first if needed
+		size_t available()
+		{
+			prepareOutput();
+			return output.buffer.size();
+		}
+
+		void write(const void *data, const size_t size) override
+		{
+			const auto* bytes(reinterpret_cast<const uint8_t*>(data));
+			input.insert(input.end(), bytes, bytes + size);
+			processInput();
+		}
+
+		void flush() override {}
+
+		void read(void *data, size_t size) override
+		{
+			if (output.buffer.size() < size)
+				prepareOutput();
+			if (output.buffer.size() < size)
+				throw Dashel::DashelException(Dashel::DashelException::ConnectionLost, 0, "Fake bootloader has nothing left to answer", this);
+			auto* bytes(reinterpret_cast<uint8_t*>(data));
+			std::copy(output.buffer.begin(), output.buffer.begin() + size, bytes);
+			output.buffer.erase(output.buffer.begin(), output.buffer.begin() + size);
+		}
+
+	protected:
+		//! The host waits for an answer, announce the bootloader or acknowledge pages being written
+		void prepareOutput()
+		{
+			// the bootloader announces itself when it starts, the description can be changed until then
+			if (!simple && !announced)
+			{
+				description.serialize(&output);
+				announced = true;
+			}
+			if (output.buffer.empty())
+				acknowledgePages();
+		}
+
+		//! Process the complete messages and raw pages in input
+		void processInput()
+		{
+			while (true)
+			{
+				if (rawPage >= 0)
+				{
+					if (input.size() < description.pageSize)
+						return;
+					const std::vector<uint8_t> data(input.begin(), input.begin() + description.pageSize);
+					input.erase(input.begin(), input.begin() + description.pageSize);
+					writePage(unsigned(rawPage), data);
+					rawPage = -1;
+					continue;
+				}
+				if (input.size() < 6)
+					return;
+				const uint16_t length(input[0] | (input[1] << 8));
+				if (input.size() < 6u + length)
+					return;
+				Message::SerializationBuffer buffer;
+				buffer.rawData.assign(input.begin() + 6, input.begin() + 6 + length);
+				const std::unique_ptr<Message> message(Message::create(input[2] | (input[3] << 8), input[4] | (input[5] << 8), buffer));
+				input.erase(input.begin(), input.begin() + 6 + length);
+				process(*message);
+			}
+		}
+
+		//! Answer a command
+		void process(const Message& message)
+		{
+			const auto* command(dynamic_cast<const CmdMessage*>(&message));
+			if (!command || (command->dest != id))
+				return;
+
+			if (dynamic_cast<const Reboot*>(&message))
+				rebooted = true;
+			else if (dynamic_cast<const BootloaderReset*>(&message))
+				reset = true;
+			else if (const auto* readPage = dynamic_cast<const BootloaderReadPage*>(&message))
+			{
+				readPages.push_back(readPage->pageNumber);
+				const std::vector<uint8_t> data(page(readPage->pageNumber));
+				if (simple)
+				{
+					output.write(&data[0], data.size());
+					return;
+				}
+				for (size_t i = 0; i < data.size(); i += 4)
+				{
+					BootloaderDataRead dataRead;
+					dataRead.source = id;
+					std::copy(data.begin() + i, data.begin() + i + 4, dataRead.data.begin());
+					dataRead.serialize(&output);
+				}
+				sendAck(BootloaderAck::ErrorCode::SUCCESS, 0);
+			}
+			else if (const auto* writePage = dynamic_cast<const BootloaderWritePage*>(&message))
+			{
+				incoming = { writePage->pageNumber, std::vector<uint8_t>(), 0 };
+				incoming.data.resize(description.pageSize);
+				if (simple)
+					rawPage = writePage->pageNumber;
+				else if (description.windowSize == 0)
+					sendAck(BootloaderAck::ErrorCode::SUCCESS, 0);
+			}
+			else if (const auto* dataWrite = dynamic_cast<const BootloaderPageDataWrite*>(&message))
+			{
+				std::copy(dataWrite->data.begin(), dataWrite->data.end(), incoming.data.begin() + incoming.received);
+				incoming.received += dataWrite->data.size();
+				if (incoming.received == description.pageSize)
+					this->writePage(incoming.pageNumber, incoming.data);
+			}
+			else if (const auto* block = dynamic_cast<const BootloaderPageDataWriteBlock*>(&message))
+			{
+				if ((block->pageNumber != incoming.pageNumber) || (block->offset != incoming.received) || (block->data.size() > description.maxFrameSize))
+				{
+					sendAck(BootloaderAck::ErrorCode::INVALID_FRAME_SIZE, block->pageNumber);
+					return;
+				}
+				std::copy(block->data.begin(), block->data.end(), incoming.data.begin() + incoming.received);
+				incoming.received += block->data.size();
+				if (incoming.received == description.pageSize)
+				{
+					inFlight.push_back(incoming);
+					maxPagesInFlight = std::max<unsigned>(maxPagesInFlight, inFlight.size());
+				}
+			}
+			else if (const auto* getChecksums = dynamic_cast<const BootloaderGetPageChecksums*>(&message))
+			{
+				++checksumsRequests;
+				for (unsigned first = getChecksums->pagesStart; first < getChecksums->pagesStart + getChecksums->pagesCount; first += (ASEBA_MAX_EVENT_ARG_SIZE - 2) / 4)
+				{
+					BootloaderPageChecksums checksums;
+					checksums.source = id;
+					checksums.pagesStart = first;
+					for (unsigned pageNumber = first; pageNumber < std::min<unsigned>(first + (ASEBA_MAX_EVENT_ARG_SIZE - 2) / 4, getChecksums->pagesStart + getChecksums->pagesCount); ++pageNumber)
+					{
+						const std::vector<uint8_t> data(page(pageNumber));
+						const auto reportedIt(reportedChecksums.find(pageNumber));
+						checksums.checksums.push_back(reportedIt == reportedChecksums.end() ? crc32Ieee(0, &data[0], data.size()) : reportedIt->second);
+					}
+					checksums.serialize(&output);
+				}
+			}
+		}
+
+		//! Program a page and acknowledge it, unless it is scheduled to fail
+		void writePage(unsigned pageNumber, const std::vector<uint8_t>& data)
+		{
+			auto& failuresCount(failures[pageNumber]);
+			if (failuresCount > 0)
+			{
+				--failuresCount;
+				sendAck(BootloaderAck::ErrorCode::PROGRAMMING_FAILED, pageNumber);
+				return;
+			}
+			flash[pageNumber] = data;
+			writtenPages.push_back(pageNumber);
+			sendAck(BootloaderAck::ErrorCode::SUCCESS, pageNumber);
+		}
+
+		//! Program the pipelined pages received so far
+		void acknowledgePages()
+		{
+			if (reverseAcks)
+				std::reverse(inFlight.begin(), inFlight.end());
+			for (const auto& page: inFlight)
+				writePage(page.pageNumber, page.data);
+			inFlight.clear();
+		}
+
+		void sendAck(BootloaderAck::ErrorCode errorCode, uint16_t errorAddress)
+		{
+			BootloaderAck ack;
+			ack.source = id;
+			ack.errorCode = errorCode;
+			ack.errorAddress = errorAddress;
+			ack.serialize(&output);
+		}
+
+	protected:
+		//! A page being received
+		struct IncomingPage
+		{
+			unsigned pageNumber;
+			std::vector<uint8_t> data;
+			unsigned received;
+		};
+
+		std::deque<uint8_t> input; //!< bytes written by the host not processed yet
+		BufferStream output; //!< bytes to be read by the host
+		IncomingPage incoming = { 0, {}, 0 }; //!< page being received
+		std::deque<IncomingPage> inFlight; //!< pipelined pages received, not acknowledged yet
+		int rawPage = -1; //!< in simple protocol, the page whose data is expected, -1 if none
+		bool announced = false; //!< whether the description was sent
+	};
+} // namespace Aseba
+
+#endif // ASEBA_TEST_FAKE_BOOTLOADER_H
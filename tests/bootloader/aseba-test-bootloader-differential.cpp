@@ -0,0 +1,98 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FakeBootloader.h"
+#include "../common/check.h"
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+using namespace Aseba;
+using namespace std;
+
+//! Change page so that its XModem CRC stays the same
+static void changeKeepingXModem(vector<uint8_t>& page)
+{
+	// with an initial value of 0, the CRC of a message followed by its CRC is 0, as is the one of zeros around
+	const uint8_t message(1);
+	const uint16_t crc(crcXModem(0, &message, 1));
+	page[4] ^= message;
+	page[5] ^= uint8_t(crc >> 8);
+	page[6] ^= uint8_t(crc);
+}
+
+//! Flash the hex file to a device whose pages 3, 5 and 6 differ, using checksums if checksums is true
+static void testComplete(const string& fileName, const BootloaderInterface::PageMap& pages, bool checksums)
+{
+	FakeBootloader device(1, 32, 0, 8);
+	if (checksums)
+		device.description.features = BootloaderDescription::PAGE_CHECKSUMS;
+	device.flash = pages;
+	device.flash[3][0] ^= 1;
+	device.flash[5][31] ^= 0x80;
+	changeKeepingXModem(device.flash[6]);
+	check(crcXModem(0, &device.flash[6][0], 32) == crcXModem(0, &pages.at(6)[0], 32), "page 6 has the XModem CRC of the new one");
+
+	BootloaderInterface bootloader(&device, 1);
+	bootloader.setDifferential(true);
+	bootloader.writeHex(fileName, true, false);
+
+	check(device.writtenPages == vector<unsigned>({ 0, 3, 5, 6 }), "only changed pages and page 0 are written");
+	check(device.flash == pages, "device has the content of the hex file");
+	if (checksums)
+	{
+		check(device.checksumsRequests == 1, "checksums are read in one request");
+		check(device.readPages.empty(), "pages are not read back if their checksums are available");
+	}
+	else
+		check(device.readPages == vector<unsigned>({ 1, 2, 3, 4, 5, 6, 7 }), "pages but 0 are read back without checksums");
+	check(device.rebooted && device.reset, "device is rebooted into and out of bootloader");
+}
+
+//! Flash the hex file with the simple protocol to a device whose page 2 differs
+static void testSimple(const string& fileName, const BootloaderInterface::PageMap& pages)
+{
+	FakeBootloader device(1, 2048, 0, 4, 0, true);
+	device.flash = pages;
+	device.flash[2][100] ^= 1;
+
+	BootloaderInterface bootloader(&device, 1);
+	bootloader.setDifferential(true);
+	bootloader.writeHex(fileName, false, true);
+
+	check(device.writtenPages == vector<unsigned>({ 2, 0 }), "changed page is written, page 0 is written last even if unchanged");
+	check(device.flash == pages, "device has the content of the hex file");
+}
+
+int main()
+{
+	const char reference[] = "123456789";
+	check(crc32Ieee(0, reinterpret_cast<const uint8_t*>(reference), 9) == 0xCBF43926, "CRC-32 of reference string");
+
+	const string fileName("aseba-test-bootloader-differential.hex");
+	const BootloaderInterface::PageMap pages(writeTestHexFile(fileName, 32, 8));
+	testComplete(fileName, pages, true);
+	testComplete(fileName, pages, false);
+	testSimple(fileName, writeTestHexFile(fileName, 2048, 4));
+
+	remove(fileName.c_str());
+	cout << "Differential firmware update: all tests passed" << endl;
+	return 0;
+}
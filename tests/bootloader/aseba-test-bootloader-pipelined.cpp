@@ -0,0 +1,135 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FakeBootloader.h"
+#include "../common/check.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+using namespace Aseba;
+using namespace std;
+
+//! Bootloader interface counting the pages sent again
+class RetryingBootloaderInterface: public BootloaderInterface
+{
+public:
+	unsigned retries = 0;
+
+	RetryingBootloaderInterface(Dashel::Stream* stream, int dest): BootloaderInterface(stream, dest) {}
+
+protected:
+	void errorWritePageNonFatal(unsigned pageNumber) override { ++retries; }
+};
+
+static const unsigned pageSize(64);
+static const unsigned pagesCount(12);
+static const unsigned windowSize(4);
+
+//! Pages written in order, but page 0 last
+static vector<unsigned> expectedOrder()
+{
+	vector<unsigned> order;
+	for (unsigned i = 1; i < pagesCount; ++i)
+		order.push_back(i);
+	order.push_back(0);
+	return order;
+}
+
+//! Flash a device acknowledging pages in order, the window being refilled as pages are acknowledged
+static void testWindow(const string& fileName, const BootloaderInterface::PageMap& pages)
+{
+	FakeBootloader device(1, pageSize, 0, pagesCount, windowSize);
+	RetryingBootloaderInterface bootloader(&device, 1);
+	bootloader.writeHex(fileName, true, false);
+
+	check(bootloader.isPipelined(), "pipelined protocol is used");
+	check(device.maxPagesInFlight == windowSize, "window is filled");
+	check(device.writtenPages == expectedOrder(), "pages are written in order, page 0 last");
+	check(device.flash == pages, "device has the content of the hex file");
+	check(bootloader.retries == 0, "no page is sent again");
+	check(device.reset, "device is reset out of bootloader");
+}
+
+//! Flash a device acknowledging the pages of a window newest first
+static void testOutOfOrderAcks(const string& fileName, const BootloaderInterface::PageMap& pages)
+{
+	FakeBootloader device(1, pageSize, 0, pagesCount, windowSize);
+	device.reverseAcks = true;
+	RetryingBootloaderInterface bootloader(&device, 1);
+	bootloader.writeHex(fileName, true, false);
+
+	check(device.writtenPages.size() == pagesCount, "every page is written once");
+	check(device.writtenPages.back() == 0, "page 0 is written alone, after all others succeeded");
+	check(device.flash == pages, "device has the content of the hex file");
+	check(bootloader.retries == 0, "no page is sent again");
+}
+
+//! Flash a device failing to write some pages a few times
+static void testRetries(const string& fileName, const BootloaderInterface::PageMap& pages)
+{
+	FakeBootloader device(1, pageSize, 0, pagesCount, windowSize);
+	device.failures[5] = 2;
+	device.failures[0] = 1;
+	RetryingBootloaderInterface bootloader(&device, 1);
+	bootloader.writeHex(fileName, true, false);
+
+	check(bootloader.retries == 3, "failed pages are sent again");
+	check(device.writtenPages.back() == 0, "page 0 is written last");
+	check(device.flash == pages, "device has the content of the hex file");
+}
+
+//! Flash a device that keeps failing to write a page
+static void testFailure(const string& fileName)
+{
+	FakeBootloader device(1, pageSize, 0, pagesCount, windowSize);
+	device.failures[7] = 3;
+	RetryingBootloaderInterface bootloader(&device, 1);
+	bool failed(false);
+	try
+	{
+		bootloader.writeHex(fileName, true, false);
+	}
+	catch (const BootloaderInterface::Error& e)
+	{
+		failed = true;
+	}
+
+	check(failed, "writing fails once a page failed too many times");
+	check(bootloader.retries == 2, "failed page is sent up to three times");
+	check(device.flash.find(7) == device.flash.end(), "failed page is not written");
+	check(find(device.writtenPages.begin(), device.writtenPages.end(), 0) == device.writtenPages.end(), "page 0 is not written if another page failed");
+	check(!device.reset, "device stays in bootloader");
+}
+
+int main()
+{
+	const string fileName("aseba-test-bootloader-pipelined.hex");
+	const BootloaderInterface::PageMap pages(writeTestHexFile(fileName, pageSize, pagesCount));
+	testWindow(fileName, pages);
+	testOutOfOrderAcks(fileName, pages);
+	testRetries(fileName, pages);
+	testFailure(fileName);
+
+	remove(fileName.c_str());
+	cout << "Pipelined firmware update: all tests passed" << endl;
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FakeBootloader.h"
+#include "common/utils/MultiBootloaderInterface.h"
+#include "../common/check.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+using namespace Aseba;
+using namespace std;
+
+//! Flash fake bootloaders, polling them instead of waiting on the streams of the hub
+class FakeMultiBootloaderInterface: public MultiBootloaderInterface
+{
+public:
+	vector<FakeBootloader*> devices;
+
+	FakeMultiBootloaderInterface(const string& hexFileName): MultiBootloaderInterface(hexFileName, true, false) {}
+
+	//! Add device to the nodes to flash
+	void addDevice(FakeBootloader* device)
+	{
+		devices.push_back(device);
+		addTarget(device, device->id);
+	}
+
+	//! Flash all targets, giving up on a node after timeout ms without answer; return whether all nodes succeeded
+	bool flashDevices(unsigned timeout)
+	{
+		startSessions();
+		do
+		{
+			bool received(false);
+			for (auto* device: devices)
+			{
+				while (device->available())
+				{
+					incomingData(device);
+					received = true;
+				}
+			}
+			if (!received)
+				UnifiedTime(1).sleep();
+		}
+		while (updateSessions(timeout));
+
+		return all_of(sessions.begin(), sessions.end(), [](const Session& session) { return session.report.status == Status::DONE; });
+	}
+};
+
+static const unsigned pageSize(64);
+static const unsigned pagesCount(12);
+
+//! Flash three nodes, one succeeding, one failing to write a page, and one not answering
+static void testFailures(const string& fileName, const BootloaderInterface::PageMap& pages)
+{
+	FakeBootloader working(1, pageSize, 0, pagesCount, 4);
+	FakeBootloader failing(2, pageSize, 0, pagesCount, 4);
+	failing.failures[5] = 3;
+	BufferStream silent;
+
+	FakeMultiBootloaderInterface bootloader(fileName);
+	bootloader.addDevice(&working);
+	bootloader.addDevice(&failing);
+	bootloader.addTarget(&silent, 3);
+	check(!bootloader.flashDevices(200), "flashing fails if some nodes fail");
+
+	const auto reports(bootloader.getReports());
+	check(reports.size() == 3, "every node has a report");
+
+	check(reports[0].status == MultiBootloaderInterface::Status::DONE, "working node is flashed");
+	check(reports[0].pipelined, "working node uses the pipelined protocol");
+	check(reports[0].pagesCount == pagesCount && reports[0].pagesWritten == pagesCount, "working node has all pages written");
+	check(working.flash == pages, "working node has the content of the hex file");
+	check(working.writtenPages.back() == 0, "page 0 is written last");
+	check(working.reset, "working node is reset out of bootloader");
+
+	check(reports[1].status == MultiBootloaderInterface::Status::FAILED, "failing node fails");
+	check(reports[1].error == "Error while writing page 5", "failing node reports the page that failed");
+	check(reports[1].pagesWritten < pagesCount, "failing node did not write all pages");
+	check(find(failing.writtenPages.begin(), failing.writtenPages.end(), 0) == failing.writtenPages.end(), "page 0 of failing node is not written");
+	check(!failing.reset, "failing node stays in bootloader");
+
+	check(reports[2].status == MultiBootloaderInterface::Status::FAILED, "silent node fails");
+	check(reports[2].error == "Timeout while waiting for the bootloader", "silent node reports a timeout");
+	check(reports[2].pagesWritten == 0, "silent node has no page written");
+}
+
+//! Flash two nodes whose pages 3 and 5 differ, comparing pages using checksums and by reading them back
+static void testDifferential(const string& fileName, const BootloaderInterface::PageMap& pages)
+{
+	FakeBootloader withChecksums(1, pageSize, 0, pagesCount, 4);
+	withChecksums.description.features = BootloaderDescription::PAGE_CHECKSUMS;
+	FakeBootloader withoutChecksums(2, pageSize, 0, pagesCount);
+	for (auto* device: { &withChecksums, &withoutChecksums })
+	{
+		device->flash = pages;
+		device->flash[3][0] ^= 1;
+		device->flash[5][10] ^= 1;
+	}
+
+	FakeMultiBootloaderInterface bootloader(fileName);
+	bootloader.setDifferential(true);
+	bootloader.addDevice(&withChecksums);
+	bootloader.addDevice(&withoutChecksums);
+	check(bootloader.flashDevices(1000), "flashing succeeds");
+
+	for (const auto& report: bootloader.getReports())
+	{
+		check(report.status == MultiBootloaderInterface::Status::DONE, "nodes are flashed");
+		check(report.pagesCount == 3 && report.pagesWritten == 3, "changed pages and page 0 are written");
+		check(report.pagesUnchanged == pagesCount - 3, "other pages are unchanged");
+	}
+	check(withChecksums.writtenPages == vector<unsigned>({ 3, 5, 0 }), "pipelined protocol writes page 0 last");
+	check(withChecksums.checksumsRequests == 1 && withChecksums.readPages.empty(), "checksums are used when available");
+	check(withoutChecksums.writtenPages == vector<unsigned>({ 0, 3, 5 }), "complete protocol writes pages in order");
+	check(withoutChecksums.readPages.size() == pagesCount - 1, "pages but 0 are read back without checksums");
+	check(withChecksums.flash == pages && withoutChecksums.flash == pages, "nodes have the content of the hex file");
+}
+
+int main()
+{
+	const string fileName("aseba-test-multi-bootloader.hex");
+	const BootloaderInterface::PageMap pages(writeTestHexFile(fileName, pageSize, pagesCount));
+	testFailures(fileName, pages);
+	testDifferential(fileName, pages);
+
+	bool rejected(false);
+	try
+	{
+		MultiBootloaderInterface(fileName, false, true).setDifferential(true);
+	}
+	catch (const BootloaderInterface::Error& e)
+	{
+		rejected = true;
+	}
+	check(rejected, "differential mode is rejected with the simple protocol");
+
+	remove(fileName.c_str());
+	cout << "Multiple nodes firmware update: all tests passed" << endl;
+	return 0;
+}
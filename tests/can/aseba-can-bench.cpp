@@ -0,0 +1,171 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transport/can/CanBusSimulator.h"
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Aseba;
+using namespace std;
+
+//! Show usage
+static void dumpHelp(ostream &stream, const char *programName)
+{
+	stream << "Benchmark of the Aseba CAN transport layer on a simulated bus, usage:\n";
+	stream << programName << " [options]\n";
+	stream << "Options:\n";
+	stream << "    -n, --nodes N           : number of nodes (default: 8)\n";
+	stream << "    -b, --bitrate B         : bitrate of the bus in bit/s (default: 1000000)\n";
+	stream << "    -s, --size S            : size of event packets in bytes (default: 20)\n";
+	stream << "    -r, --rates R[,R...]    : packets per second per node, one simulation per rate (default: 10,50,100,200,500)\n";
+	stream << "    -d, --duration S        : simulated seconds per rate (default: 10)\n";
+	stream << "    --bulk-size S           : size of bulk packets in bytes, 0 for none (default: 0)\n";
+	stream << "    --bulk-rate R           : bulk packets per second per node (default: 0)\n";
+	stream << "    --send-queue F          : frames in the send queue of each node (default: 64)\n";
+	stream << "    --events-queue F        : frames in a separate send queue for events, 0 for none (default: 0)\n";
+	stream << "    --bulk-queue F          : frames in a separate send queue for bulk packets, 0 for none (default: 0)\n";
+	stream << "    --recv-queue F          : frames in the receive queue of each node (default: 64)\n";
+	stream << "    --mailboxes F           : frames each CAN controller holds for transmission (default: 1)\n";
+	stream << "    --poll S                : period in seconds at which nodes read their packets (default: 0.001)\n";
+	stream << "    --seed N                : seed of the random number generator (default: 0)\n";
+	stream << "    --expect-lossless       : fail if any packet is dropped\n";
+	stream << "    -h, --help              : shows this help\n";
+}
+
+int main(int argc, char *argv[])
+{
+	CanBusSimulator::Parameters parameters;
+	vector<double> rates { 10, 50, 100, 200, 500 };
+	bool expectLossless(false);
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		const bool hasNext(i + 1 < argc);
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			dumpHelp(cout, argv[0]);
+			return 0;
+		}
+		else if (strcmp(arg, "--expect-lossless") == 0)
+		{
+			expectLossless = true;
+		}
+		else if (!hasNext)
+		{
+			cerr << "Error, missing argument or unknown option " << arg << endl;
+			dumpHelp(cerr, argv[0]);
+			return 1;
+		}
+		else if ((strcmp(arg, "-n") == 0) || (strcmp(arg, "--nodes") == 0))
+			parameters.nodesCount = atoi(argv[++i]);
+		else if ((strcmp(arg, "-b") == 0) || (strcmp(arg, "--bitrate") == 0))
+			parameters.bitrate = atof(argv[++i]);
+		else if ((strcmp(arg, "-s") == 0) || (strcmp(arg, "--size") == 0))
+			parameters.packetSize = atoi(argv[++i]);
+		else if ((strcmp(arg, "-r") == 0) || (strcmp(arg, "--rates") == 0))
+		{
+			rates.clear();
+			istringstream ratesStream(argv[++i]);
+			string rate;
+			while (getline(ratesStream, rate, ','))
+				rates.push_back(atof(rate.c_str()));
+		}
+		else if ((strcmp(arg, "-d") == 0) || (strcmp(arg, "--duration") == 0))
+			parameters.duration = atof(argv[++i]);
+		else if (strcmp(arg, "--bulk-size") == 0)
+			parameters.bulkPacketSize = atoi(argv[++i]);
+		else if (strcmp(arg, "--bulk-rate") == 0)
+			parameters.bulkPacketRate = atof(argv[++i]);
+		else if (strcmp(arg, "--send-queue") == 0)
+			parameters.sendQueueSize = atoi(argv[++i]);
+		else if (strcmp(arg, "--events-queue") == 0)
+			parameters.eventsQueueSize = atoi(argv[++i]);
+		else if (strcmp(arg, "--bulk-queue") == 0)
+			parameters.bulkQueueSize = atoi(argv[++i]);
+		else if (strcmp(arg, "--recv-queue") == 0)
+			parameters.recvQueueSize = atoi(argv[++i]);
+		else if (strcmp(arg, "--mailboxes") == 0)
+			parameters.txMailboxes = atoi(argv[++i]);
+		else if (strcmp(arg, "--poll") == 0)
+			parameters.pollPeriod = atof(argv[++i]);
+		else if (strcmp(arg, "--seed") == 0)
+			parameters.seed = strtoul(argv[++i], nullptr, 0);
+		else
+		{
+			cerr << "Error, unknown option " << arg << endl;
+			dumpHelp(cerr, argv[0]);
+			return 1;
+		}
+	}
+
+	const bool bulk(parameters.bulkPacketSize && parameters.bulkPacketRate > 0);
+	cout << parameters.nodesCount << " nodes, " << parameters.bitrate << " bit/s, " << parameters.packetSize << " bytes per packet";
+	if (bulk)
+		cout << ", " << parameters.bulkPacketRate << " bulk packets of " << parameters.bulkPacketSize << " bytes per second";
+	cout << "\n";
+	cout << setw(8) << "rate" << setw(8) << "load" << setw(12) << "goodput" << setw(10) << "p50 ms" << setw(10) << "p90 ms" << setw(10) << "p99 ms" << setw(10) << "max ms";
+	if (bulk)
+		cout << setw(10) << "bulk p50" << setw(10) << "bulk p99";
+	cout << setw(10) << "sent" << setw(10) << "tx drop" << setw(10) << "rx drop" << setw(10) << "corrupt" << endl;
+
+	bool failed(false);
+	for (const double rate: rates)
+	{
+		parameters.packetRate = rate;
+		CanBusSimulator::Results results;
+		try
+		{
+			CanBusSimulator simulator(parameters);
+			results = simulator.run();
+		}
+		catch (const exception& e)
+		{
+			cerr << "Error: " << e.what() << endl;
+			return 1;
+		}
+
+		cout << fixed << setprecision(1);
+		cout << setw(8) << rate << setw(7) << results.busLoad * 100 << "%" << setw(12) << results.goodput;
+		cout << setprecision(3);
+		cout << setw(10) << results.latencyP50 * 1000 << setw(10) << results.latencyP90 * 1000 << setw(10) << results.latencyP99 * 1000 << setw(10) << results.latencyMax * 1000;
+		if (bulk)
+			cout << setw(10) << results.bulkLatencyP50 * 1000 << setw(10) << results.bulkLatencyP99 * 1000;
+		cout << setw(10) << results.packetsGenerated << setw(10) << results.sentDropped << setw(10) << results.receivedDropped << setw(10) << results.packetsCorrupted << endl;
+
+		// a reassembled packet must never differ from the sent one, even when frames are dropped
+		if (results.packetsCorrupted)
+			failed = true;
+		if (expectLossless && (results.sentDropped || results.receivedDropped))
+			failed = true;
+		// otherwise the checks above would pass trivially
+		if (results.packetsGenerated && !results.packetsDelivered)
+		{
+			cerr << "Error, no packet was delivered at rate " << rate << endl;
+			failed = true;
+		}
+	}
+
+	return failed ? 2 : 0;
+}
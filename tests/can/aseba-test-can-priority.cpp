@@ -0,0 +1,75 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transport/can/CanBusSimulator.h"
+#include <iostream>
+
+using namespace Aseba;
+using namespace std;
+
+//! Run nodes sending small events while streaming large bulk packets, with the given send queues
+static CanBusSimulator::Results simulate(size_t sendQueueSize, size_t eventsQueueSize, size_t bulkQueueSize)
+{
+	CanBusSimulator::Parameters parameters;
+	parameters.nodesCount = 8;
+	parameters.packetSize = 8;
+	parameters.packetRate = 50;
+	parameters.bulkPacketSize = 200;
+	parameters.bulkPacketRate = 5;
+	parameters.sendQueueSize = sendQueueSize;
+	parameters.eventsQueueSize = eventsQueueSize;
+	parameters.bulkQueueSize = bulkQueueSize;
+	parameters.recvQueueSize = 256;
+	parameters.duration = 4;
+	parameters.seed = 1;
+
+	CanBusSimulator simulator(parameters);
+	const CanBusSimulator::Results results(simulator.run());
+	cout << "send queues " << sendQueueSize << "/" << eventsQueueSize << "/" << bulkQueueSize;
+	cout << ": bus load " << results.busLoad * 100 << "%, events p99 " << results.latencyP99 * 1000 << " ms, bulk p99 " << results.bulkLatencyP99 * 1000 << " ms";
+	cout << ", " << results.sentDropped << " tx drop, " << results.receivedDropped << " rx drop, " << results.packetsCorrupted << " corrupted" << endl;
+	return results;
+}
+
+int main()
+{
+	// same total amount of memory in both configurations
+	const CanBusSimulator::Results shared(simulate(128, 0, 0));
+	const CanBusSimulator::Results separate(simulate(16, 16, 96));
+
+	bool failed(false);
+	if (shared.packetsCorrupted || separate.packetsCorrupted)
+	{
+		cerr << "Packets were corrupted" << endl;
+		failed = true;
+	}
+	if (shared.sentDropped || shared.receivedDropped || separate.sentDropped || separate.receivedDropped)
+	{
+		cerr << "Packets were dropped" << endl;
+		failed = true;
+	}
+	// with separate queues, events no longer wait behind bulk packets of their own node nor lose arbitration against bulk frames of others,
+	// they only wait for the bulk frame already in the CAN controller
+	if (separate.latencyP99 * 2 > shared.latencyP99)
+	{
+		cerr << "Separate queues did not reduce the latency of events enough" << endl;
+		failed = true;
+	}
+	return failed ? 1 : 0;
+}
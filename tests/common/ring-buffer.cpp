@@ -0,0 +1,49 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include "common/utils/SpscRingBuffer.h"
+#include <thread>
+
+TEST_CASE("Ring buffer keeps order and capacity [ring-buffer]") {
+    using namespace Aseba;
+    SpscRingBuffer<int> ring(5);
+    REQUIRE(ring.capacity() == 8);
+
+    for (int i = 0; i < 8; ++i)
+        REQUIRE(ring.push(int(i)));
+    REQUIRE(!ring.push(8));
+    REQUIRE(ring.size() == 8);
+
+    std::vector<int> values;
+    REQUIRE(ring.pop(std::back_inserter(values), 3) == 3);
+    REQUIRE(values == std::vector<int>({0, 1, 2}));
+
+    // wrap around the end of the slots
+    REQUIRE(ring.push(8));
+    REQUIRE(ring.push(9));
+    values.clear();
+    REQUIRE(ring.pop(std::back_inserter(values), 100) == 7);
+    REQUIRE(values == std::vector<int>({3, 4, 5, 6, 7, 8, 9}));
+    REQUIRE(ring.size() == 0);
+    REQUIRE(ring.pop(std::back_inserter(values), 100) == 0);
+}
+
+TEST_CASE("Ring buffer passes values between threads [ring-buffer]") {
+    using namespace Aseba;
+    SpscRingBuffer<std::vector<int>> ring(64);
+    const int count(100000);
+
+    std::thread producer([&]() {
+        for (int i = 0; i < count; ++i)
+            while (!ring.push(std::vector<int>(1 + i % 4, i)))
+                std::this_thread::yield();
+    });
+
+    std::vector<std::vector<int>> received;
+    while (received.size() < size_t(count))
+        if (ring.pop(std::back_inserter(received), 16) == 0)
+            std::this_thread::yield();
+    producer.join();
+
+    for (int i = 0; i < count; ++i)
+        REQUIRE(received[i] == std::vector<int>(1 + i % 4, i));
+}
@@ -0,0 +1,212 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <dashel/dashel.h>
+#include "common/consts.h"
+#include "common/msg/msg.h"
+#include "common/utils/utils.h"
+#include "compiler/compiler.h"
+#include "../common/check.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace Aseba;
+using namespace std;
+
+//! Stream writing to a file, to save description messages as asebac --save-descriptions does
+class FileStream: public Dashel::Stream
+{
+public:
+	ofstream file;
+
+	explicit FileStream(const string& fileName): Stream("file"), file(fileName, ios::binary | ios::trunc) {}
+	void write(const void *data, const size_t size) override { file.write(reinterpret_cast<const char*>(data), size); }
+	void flush() override { file.flush(); }
+	void read(void *data, size_t size) override
+	{
+		throw Dashel::DashelException(Dashel::DashelException::InvalidOperation, 0, "Cannot read from a file stream", this);
+	}
+};
+
+//! Return the description of a node named name, with firmware identification variables
+static TargetDescription makeDescription(const wstring& name)
+{
+	TargetDescription description;
+	description.name = name;
+	description.protocolVersion = ASEBA_PROTOCOL_VERSION;
+	description.bytecodeSize = 512;
+	description.variablesSize = 64;
+	description.stackSize = 32;
+	description.namedVariables.emplace_back(L"_id", 1);
+	description.namedVariables.emplace_back(L"_productId", 1);
+	description.namedVariables.emplace_back(L"_fwversion", 1);
+	description.namedVariables.emplace_back(L"args", 8);
+	description.namedVariables.emplace_back(L"x", 4);
+	return description;
+}
+
+//! Write the description of a node, followed by the values of its _productId and _fwversion variables if productId is not negative
+static void writeDescription(Dashel::Stream* stream, const TargetDescription& targetDescription, uint16_t nodeId, int productId, int firmwareVersion)
+{
+	Description description;
+	static_cast<TargetDescription&>(description) = targetDescription;
+	description.source = nodeId;
+	description.serialize(stream);
+	for (const auto& variable: targetDescription.namedVariables)
+	{
+		NamedVariableDescription message;
+		static_cast<TargetDescription::NamedVariable&>(message) = variable;
+		message.source = nodeId;
+		message.serialize(stream);
+	}
+	if (productId < 0)
+		return;
+	Variables variables;
+	variables.source = nodeId;
+	variables.start = 1;
+	variables.variables = { int16_t(productId), int16_t(firmwareVersion) };
+	variables.serialize(stream);
+}
+
+//! Write an .aesl file with one node program per name
+static void writeSource(const string& fileName, const vector<string>& nodeNames, const string& program)
+{
+	ofstream file(fileName, ios::trunc);
+	file << "<!DOCTYPE aesl-source>\n<network>\n";
+	file << "<event size=\"1\" name=\"ping\"/>\n";
+	file << "<constant value=\"3\" name=\"STEP\"/>\n";
+	for (size_t i = 0; i < nodeNames.size(); ++i)
+		file << "<node nodeId=\"" << 5 + i << "\" name=\"" << nodeNames[i] << "\">" << program << "</node>\n";
+	file << "</network>\n";
+}
+
+//! Run asebac with arguments, return whether it succeeded
+static bool runAsebac(const string& asebac, const string& arguments)
+{
+	const string command("\"" + asebac + "\" " + arguments + " -r aseba-test-asebac.json");
+	return system(command.c_str()) == 0;
+}
+
+//! Return the content of a file, empty if it does not exist
+static vector<uint8_t> readFile(const string& fileName)
+{
+	ifstream file(fileName, ios::binary);
+	return vector<uint8_t>((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+}
+
+//! Return the 16-bit little-endian word at index i of content
+static uint16_t word(const vector<uint8_t>& content, size_t i)
+{
+	return uint16_t(content.at(i * 2) | (content.at(i * 2 + 1) << 8));
+}
+
+//! Check that fileName is the .abo of program compiled for description as node nodeId named name
+static void checkAbo(const string& fileName, const TargetDescription& description, const wstring& program, uint16_t nodeId, uint16_t productId, uint16_t firmwareVersion)
+{
+	// compile the same program in process
+	CommonDefinitions commonDefinitions;
+	commonDefinitions.events.push_back(NamedValue(L"ping", 1));
+	commonDefinitions.constants.push_back(NamedValue(L"STEP", 3));
+	Compiler compiler;
+	compiler.setTargetDescription(&description);
+	compiler.setCommonDefinitions(&commonDefinitions);
+	BytecodeVector bytecode;
+	unsigned allocatedVariablesCount;
+	Error error;
+	check(compiler.compile(program, bytecode, allocatedVariablesCount, error), "sample program compiles");
+
+	const vector<uint8_t> content(readFile(fileName));
+	check(content.size() == 2 * (10 + bytecode.size() + 1), ".abo has the header, the bytecode and the CRC");
+	check(content[0] == 'A' && content[1] == 'B' && content[2] == 'O' && content[3] == 0, ".abo starts with its magic number");
+	check(word(content, 2) == 0, "binary format version");
+	check(word(content, 3) == ASEBA_PROTOCOL_VERSION, "protocol version");
+	check(word(content, 4) == productId, "product identifier");
+	check(word(content, 5) == firmwareVersion, "firmware version");
+	check(word(content, 6) == nodeId, "node identifier");
+	check(word(content, 7) == crcXModem(0, description.name), "CRC of the node name");
+	check(word(content, 8) == description.crc(), "CRC of the target description");
+	check(word(content, 9) == bytecode.size(), "bytecode size");
+	uint16_t crc(0);
+	for (size_t i = 0; i < bytecode.size(); ++i)
+	{
+		check(word(content, 10 + i) == bytecode[i].bytecode, "bytecode is the one of the compiler");
+		crc = crcXModem(crc, bytecode[i].bytecode);
+	}
+	check(word(content, 10 + bytecode.size()) == crc, "CRC of the bytecode");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " asebac" << endl;
+		return 1;
+	}
+	const string asebac(argv[1]);
+
+	// descriptions saved from two nodes, only the first one providing its firmware identification
+	const TargetDescription node(makeDescription(L"node"));
+	const TargetDescription bare(makeDescription(L"bare"));
+	{
+		FileStream stream("aseba-test-asebac.bin");
+		writeDescription(&stream, node, 3, 8, 13);
+		writeDescription(&stream, bare, 4, -1, -1);
+	}
+
+	const string program("var y = 2\nonevent ping\n\ty = y + args[0] * STEP\n\tx[1] = y\n");
+	const wstring wideProgram(UTF8ToWString(program));
+
+	// the firmware identification is taken from the descriptions
+	writeSource("aseba-test-asebac.aesl", { "node" }, program);
+	remove("aseba-test-asebac-node.abo");
+	check(runAsebac(asebac, "-d aseba-test-asebac.bin -o . aseba-test-asebac.aesl"), "asebac compiles the sample");
+	checkAbo("aseba-test-asebac-node.abo", node, wideProgram, 5, 8, 13);
+
+	// options override the firmware identification
+	check(runAsebac(asebac, "-d aseba-test-asebac.bin -o . -p 9 -f 14 aseba-test-asebac.aesl"), "asebac compiles the sample with options");
+	checkAbo("aseba-test-asebac-node.abo", node, wideProgram, 5, 9, 14);
+
+	// .abo files are not written without the firmware identification, but text files are
+	writeSource("aseba-test-asebac.aesl", { "bare" }, program);
+	remove("aseba-test-asebac-bare.abo");
+	check(!runAsebac(asebac, "-d aseba-test-asebac.bin -o . aseba-test-asebac.aesl"), "asebac fails without firmware identification");
+	check(readFile("aseba-test-asebac-bare.abo").empty(), "no .abo is written without firmware identification");
+	check(runAsebac(asebac, "-d aseba-test-asebac.bin -o . -t aseba-test-asebac.aesl"), "asebac writes text without firmware identification");
+	check(!readFile("aseba-test-asebac-bare.txt").empty(), "text is written without firmware identification");
+	check(runAsebac(asebac, "-d aseba-test-asebac.bin -o . --product-id 8 --firmware-version 13 aseba-test-asebac.aesl"), "asebac compiles the sample with options only");
+	checkAbo("aseba-test-asebac-bare.abo", bare, wideProgram, 5, 8, 13);
+
+	// several robots of the same kind share a name, so their files are told apart by their id
+	writeSource("aseba-test-asebac.aesl", { "node", "node" }, program);
+	remove("aseba-test-asebac-node.abo");
+	check(runAsebac(asebac, "-d aseba-test-asebac.bin -o . aseba-test-asebac.aesl"), "asebac compiles two nodes with the same name");
+	checkAbo("aseba-test-asebac-node-5.abo", node, wideProgram, 5, 8, 13);
+	checkAbo("aseba-test-asebac-node-6.abo", node, wideProgram, 6, 8, 13);
+	check(readFile("aseba-test-asebac-node.abo").empty(), "files of nodes sharing a name carry their id");
+
+	for (const char* fileName: { "aseba-test-asebac.bin", "aseba-test-asebac.aesl", "aseba-test-asebac.json", "aseba-test-asebac-node.abo", "aseba-test-asebac-node-5.abo", "aseba-test-asebac-node-6.abo", "aseba-test-asebac-bare.abo", "aseba-test-asebac-bare.txt" })
+		remove(fileName);
+
+	cout << "asebac: all tests passed" << endl;
+	return 0;
+}
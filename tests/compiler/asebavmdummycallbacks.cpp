@@ -65,6 +65,16 @@ extern "C" void AsebaSendVariables(AsebaVMState *vm, uint16_t start, uint16_t le
 	std::cerr << "AsebaSendVariables at pos " << start << ", length " << length << std::endl;
 }
 
+extern "C" void AsebaSendChangedVariables(AsebaVMState *vm, uint16_t start, uint16_t length, uint16_t generation)
+{
+	std::cerr << "AsebaSendChangedVariables at pos " << start << ", length " << length << ", since generation " << generation << std::endl;
+}
+
+extern "C" void AsebaSendTaggedVariables(AsebaVMState *vm, uint16_t tag, uint16_t start, uint16_t length)
+{
+	std::cerr << "AsebaSendTaggedVariables with tag " << tag << " at pos " << start << ", length " << length << std::endl;
+}
+
 extern "C" void AsebaSendDescription(AsebaVMState *vm)
 {
 	std::cerr << "AsebaSendDescription" << std::endl;
@@ -0,0 +1,157 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include "compiler/compiler.h"
+#include "compiler/compilation-cache.h"
+
+using namespace Aseba;
+
+static TargetDescription testTargetDescription()
+{
+	TargetDescription d;
+	d.name = L"testvm";
+	d.bytecodeSize = 512;
+	d.variablesSize = 256;
+	d.stackSize = 64;
+	d.namedVariables.emplace_back(L"id", 1);
+	d.namedVariables.emplace_back(L"source", 1);
+	d.namedVariables.emplace_back(L"args", 32);
+	return d;
+}
+
+static const std::wstring testSource(L"var a = 1\nvar b[3] = [1, 2, 3]\nsub inc\n\ta = a + 1\nonevent ping\n\tcallsub inc\n\tb[1] = a\n");
+
+TEST_CASE("Compilation results are cached [compilation-cache]") {
+	const TargetDescription description(testTargetDescription());
+	CommonDefinitions definitions;
+	definitions.events.push_back(NamedValue(L"ping", 0));
+
+	CompilationCache cache;
+
+	BytecodeVector referenceBytecode;
+	unsigned referenceAllocated;
+	Error error;
+	Compiler reference;
+	reference.setTargetDescription(&description);
+	reference.setCommonDefinitions(&definitions);
+	REQUIRE(reference.compile(testSource, referenceBytecode, referenceAllocated, error));
+
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		BytecodeVector bytecode;
+		unsigned allocated;
+		Compiler compiler;
+		compiler.setTargetDescription(&description);
+		compiler.setCommonDefinitions(&definitions);
+		compiler.setCompilationCache(&cache);
+		REQUIRE(compiler.compile(testSource, bytecode, allocated, error));
+		REQUIRE(allocated == referenceAllocated);
+		REQUIRE(std::vector<uint16_t>(bytecode.begin(), bytecode.end()) == std::vector<uint16_t>(referenceBytecode.begin(), referenceBytecode.end()));
+		REQUIRE(*compiler.getVariablesMap() == *reference.getVariablesMap());
+		REQUIRE(compiler.getSubroutineTable()->size() == 1);
+		REQUIRE(compiler.getSubroutineTable()->front().address == reference.getSubroutineTable()->front().address);
+	}
+	REQUIRE(cache.misses() == 1);
+	REQUIRE(cache.hits() == 1);
+	REQUIRE(cache.size() == 1);
+}
+
+TEST_CASE("Cache keys depend on all inputs [compilation-cache]") {
+	const TargetDescription description(testTargetDescription());
+	CommonDefinitions definitions;
+	const CompilationCache::Key key(CompilationCache::key(testSource, description, definitions));
+	REQUIRE(key == CompilationCache::key(testSource, description, definitions));
+
+	REQUIRE(key != CompilationCache::key(testSource + L" ", description, definitions));
+
+	TargetDescription otherDescription(description);
+	otherDescription.variablesSize = 128;
+	REQUIRE(key != CompilationCache::key(testSource, otherDescription, definitions));
+
+	CommonDefinitions otherDefinitions;
+	otherDefinitions.constants.push_back(NamedValue(L"K", 3));
+	REQUIRE(key != CompilationCache::key(testSource, description, otherDefinitions));
+}
+
+TEST_CASE("Failed compilations are not cached [compilation-cache]") {
+	const TargetDescription description(testTargetDescription());
+	CommonDefinitions definitions;
+	CompilationCache cache;
+
+	BytecodeVector bytecode;
+	unsigned allocated;
+	Error error;
+	Compiler compiler;
+	compiler.setTargetDescription(&description);
+	compiler.setCommonDefinitions(&definitions);
+	compiler.setCompilationCache(&cache);
+	REQUIRE_FALSE(compiler.compile(std::wstring(L"var a = \n"), bytecode, allocated, error));
+	REQUIRE(cache.size() == 0);
+}
+
+TEST_CASE("Least recently used entries are evicted [compilation-cache]") {
+	const TargetDescription description(testTargetDescription());
+	CommonDefinitions definitions;
+	CompilationCache cache(2);
+
+	CompilationCache::Entry entry;
+	cache.insert(1, entry);
+	cache.insert(2, entry);
+	REQUIRE(cache.lookup(1, entry));
+	cache.insert(3, entry);
+	REQUIRE(cache.size() == 2);
+	REQUIRE(cache.lookup(1, entry));
+	REQUIRE_FALSE(cache.lookup(2, entry));
+	REQUIRE(cache.lookup(3, entry));
+}
+
+TEST_CASE("Entries survive in the on-disk store [compilation-cache]") {
+	const TargetDescription description(testTargetDescription());
+	CommonDefinitions definitions;
+	definitions.events.push_back(NamedValue(L"ping", 0));
+
+	BytecodeVector referenceBytecode;
+	unsigned referenceAllocated;
+	Error error;
+	{
+		CompilationCache cache(16, COMPILATION_CACHE_TEST_DIR);
+		Compiler compiler;
+		compiler.setTargetDescription(&description);
+		compiler.setCommonDefinitions(&definitions);
+		compiler.setCompilationCache(&cache);
+		REQUIRE(compiler.compile(testSource, referenceBytecode, referenceAllocated, error));
+	}
+
+	CompilationCache cache(16, COMPILATION_CACHE_TEST_DIR);
+	CompilationCache::Entry entry;
+	REQUIRE(cache.lookup(CompilationCache::key(testSource, description, definitions), entry));
+	REQUIRE(entry.allocatedVariablesCount == referenceAllocated);
+	REQUIRE(entry.bytecode.size() == referenceBytecode.size());
+	for (size_t i = 0; i < entry.bytecode.size(); ++i)
+	{
+		REQUIRE(entry.bytecode[i].bytecode == referenceBytecode[i].bytecode);
+		REQUIRE(entry.bytecode[i].line == referenceBytecode[i].line);
+	}
+	REQUIRE(entry.variablesMap.count(L"b") == 1);
+	REQUIRE(entry.subroutineTable.size() == 1);
+	REQUIRE(entry.subroutineTable[0].name == L"inc");
+}
+
+TEST_CASE("Entries stored by other compiler versions are rejected [compilation-cache]") {
+	const TargetDescription description(testTargetDescription());
+	CommonDefinitions definitions;
+	definitions.events.push_back(NamedValue(L"ping", 0));
+	const CompilationCache::Key key(CompilationCache::key(testSource, description, definitions));
+
+	CompilationCache::Entry entry;
+	entry.allocatedVariablesCount = 42;
+	{
+		CompilationCache cache(16, COMPILATION_CACHE_TEST_DIR, "old-version");
+		cache.insert(key, entry);
+	}
+
+	CompilationCache otherCache(16, COMPILATION_CACHE_TEST_DIR);
+	REQUIRE_FALSE(otherCache.lookup(key, entry));
+	CompilationCache sameCache(16, COMPILATION_CACHE_TEST_DIR, "old-version");
+	REQUIRE(sameCache.lookup(key, entry));
+	REQUIRE(entry.allocatedVariablesCount == 42);
+}
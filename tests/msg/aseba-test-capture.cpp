@@ -0,0 +1,140 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/msg/CaptureFile.h"
+#include "../common/check.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace Aseba;
+using namespace std;
+
+//! Time in µs of message i in the test capture, several of them sharing the same time
+static uint64_t messageTime(unsigned i)
+{
+	return 1000 + (i / 3) * 2500;
+}
+
+//! Write count user messages to fileName, in small chunks to have many of them
+static void writeCapture(const string& fileName, unsigned count, bool compress)
+{
+	CaptureWriter writer(fileName, compress, 256);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		UserMessage message(i % 7, VariablesDataVector(i % 10, int16_t(i)));
+		message.source = 1 + i % 3;
+		writer.write(messageTime(i), message);
+	}
+}
+
+//! Check that the records of reader are messages first to count of writeCapture()
+static void checkRecords(CaptureReader& reader, unsigned first, unsigned count, const char* what)
+{
+	CaptureReader::Record record;
+	unsigned i(first);
+	while (reader.next(record))
+	{
+		check(i < count, what);
+		check(record.time == messageTime(i), what);
+		check(record.source == 1 + i % 3, what);
+		const unique_ptr<Message> message(record.createMessage());
+		const auto* userMessage(dynamic_cast<const UserMessage*>(message.get()));
+		check(userMessage != nullptr, what);
+		check(userMessage->type == i % 7 && userMessage->data == VariablesDataVector(i % 10, int16_t(i)), what);
+		++i;
+	}
+	check(i == count, what);
+}
+
+static void testCapture(bool compress)
+{
+	const string fileName("aseba-test-capture.bin");
+	const unsigned count(1000);
+	writeCapture(fileName, count, compress);
+
+	// read all messages
+	{
+		CaptureReader reader(fileName);
+		check(!reader.isIndexRebuilt(), "closed capture has an index");
+		check(reader.getChunksCount() > 10, "capture is split in chunks");
+		check(reader.getRecordsCount() == count, "index counts all records");
+		check(reader.getEndTime() == messageTime(count - 1), "index gives the end time");
+		checkRecords(reader, 0, count, "all messages are read back");
+
+		// seek to the first of messages sharing a time, and between times
+		reader.seek(messageTime(500));
+		checkRecords(reader, 498, count, "seek to a time");
+		reader.seek(messageTime(500) - 1);
+		checkRecords(reader, 498, count, "seek between times");
+		reader.seek(0);
+		checkRecords(reader, 0, count, "seek to the start");
+		reader.seek(messageTime(count - 1) + 1);
+		checkRecords(reader, count, count, "seek after the end");
+	}
+
+	// an interrupted capture lacks its index and possibly the end of its last chunk
+	{
+		ifstream in(fileName, ios::binary);
+		vector<char> content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		in.close();
+		ofstream out(fileName, ios::binary | ios::trunc);
+		out.write(content.data(), content.size() / 2);
+	}
+	{
+		CaptureReader reader(fileName);
+		check(reader.isIndexRebuilt(), "index is rebuilt for interrupted captures");
+		const unsigned recordsCount(reader.getRecordsCount());
+		check(recordsCount > 0 && recordsCount < count, "complete chunks are kept");
+		checkRecords(reader, 0, recordsCount, "messages of interrupted captures are read back");
+		reader.seek(messageTime(recordsCount / 2));
+		checkRecords(reader, (recordsCount / 2) / 3 * 3, recordsCount, "seek in interrupted captures");
+	}
+
+	remove(fileName.c_str());
+}
+
+int main()
+{
+	testCapture(false);
+	if (Capture::isCompressionSupported())
+		testCapture(true);
+
+	// other files are rejected
+	{
+		ofstream out("aseba-test-capture.bin");
+		out << "1500000000.000 0001 0010 0\n";
+	}
+	check(!Capture::isCaptureFile("aseba-test-capture.bin"), "text recordings are not captures");
+	bool thrown(false);
+	try
+	{
+		CaptureReader reader("aseba-test-capture.bin");
+	}
+	catch (const runtime_error&)
+	{
+		thrown = true;
+	}
+	check(thrown, "text recordings are rejected");
+	remove("aseba-test-capture.bin");
+
+	return 0;
+}
@@ -136,6 +136,26 @@ int main()
 		}
 	);
 
+	testMessage<BootloaderDescription>(
+		[](BootloaderDescription& m) { m.pageSize = 128; m.pagesStart = 10; m.pagesCount = 20; m.maxFrameSize = 64; m.windowSize = 4; },
+		{
+			[](BootloaderDescription& m) { m.maxFrameSize = 32; },
+			[](BootloaderDescription& m) { m.windowSize = 2; },
+			[](BootloaderDescription& m) { m.maxFrameSize = 0; m.windowSize = 0; },
+			[](BootloaderDescription& m) { m.features = BootloaderDescription::PAGE_CHECKSUMS; }
+		}
+	);
+
+	testMessage<BootloaderPageChecksums>(
+		[](BootloaderPageChecksums& m) { m.pagesStart = 8; m.checksums = {0x12345678, 0xabcdef01}; },
+		{
+			[](BootloaderPageChecksums& m) { m.pagesStart = 9; },
+			[](BootloaderPageChecksums& m) { m.checksums[1] = 0; },
+			[](BootloaderPageChecksums& m) { m.checksums[0] = 0x5678; },
+			[](BootloaderPageChecksums& m) { m.checksums.pop_back(); }
+		}
+	);
+
 	testMessage<BootloaderDataRead>(
 		[](BootloaderDataRead& m) { m.data = {{1, 2, 3, 4}}; },
 		{
@@ -149,7 +169,8 @@ int main()
 	testMessage<BootloaderAck>(
 		[](BootloaderAck& m) { m.errorCode = BootloaderAck::ErrorCode::PROGRAMMING_FAILED; m.errorAddress = 0xff; },
 		{
-			[](BootloaderAck& m) { m.errorCode = BootloaderAck::ErrorCode::SUCCESS; m.errorAddress = 0; }
+			[](BootloaderAck& m) { m.errorCode = BootloaderAck::ErrorCode::SUCCESS; m.errorAddress = 0; },
+			[](BootloaderAck& m) { m.errorCode = BootloaderAck::ErrorCode::SUCCESS; }
 		}
 	);
 
@@ -161,7 +182,11 @@ int main()
 
 	testMessageNoInit<NodePresent>(
 		{
-			[](NodePresent& m) { m.version = 1; }
+			[](NodePresent& m) { m.version = 1; },
+			[](NodePresent& m) { m.features = NodePresent::CHANGED_VARIABLES; },
+			[](NodePresent& m) { m.features = NodePresent::CHANGED_VARIABLES | NodePresent::WATCH_VARIABLES; },
+			[](NodePresent& m) { m.features = NodePresent::TAGGED_VARIABLES; },
+			[](NodePresent& m) { m.features = NodePresent::DESCRIPTION_HASH; m.descriptionHash = 0x12345678; }
 		}
 	);
 
@@ -247,6 +272,36 @@ int main()
 		}
 	);
 
+	testMessage<ChangedVariables>(
+		[](ChangedVariables& m) {
+			m.start = 10;
+			m.length = 20;
+			m.generation = 3;
+			m.mask = {0x0005, 0x0008};
+			m.values = {1, 2, 3};
+		},
+		{
+			[](ChangedVariables& m) { m.start = 20; },
+			[](ChangedVariables& m) { m.generation = 4; },
+			[](ChangedVariables& m) { m.mask[1] = 0x0009; m.values.push_back(4); },
+			[](ChangedVariables& m) { m.values[2] = 5; }
+		}
+	);
+
+	testMessage<TaggedVariables>(
+		[](TaggedVariables& m) {
+			m.tag = 7;
+			m.start = 10;
+			m.variables = {1, 2};
+		},
+		{
+			[](TaggedVariables& m) { m.tag = 8; },
+			[](TaggedVariables& m) { m.start = 20; },
+			[](TaggedVariables& m) { m.variables[1] = 4; },
+			[](TaggedVariables& m) { m.variables.push_back(5); }
+		}
+	);
+
 	testMessage<ArrayAccessOutOfBounds>(
 		[](ArrayAccessOutOfBounds& m) {
 			m.pc = 10;
@@ -356,6 +411,31 @@ int main()
 		}
 	);
 
+	testMessage<BootloaderPageDataWriteBlock>(
+		[](BootloaderPageDataWriteBlock& m) {
+			m.dest = 1;
+			m.pageNumber = 12;
+			m.offset = 64;
+			m.data = {1, 2, 3, 4, 5, 6};
+		},
+		{
+			[](BootloaderPageDataWriteBlock& m) { m.dest = 3; },
+			[](BootloaderPageDataWriteBlock& m) { m.pageNumber = 13; },
+			[](BootloaderPageDataWriteBlock& m) { m.offset = 0; },
+			[](BootloaderPageDataWriteBlock& m) { m.data[0] = 6; },
+			[](BootloaderPageDataWriteBlock& m) { m.data.push_back(7); }
+		}
+	);
+
+	testMessage<BootloaderGetPageChecksums>(
+		[](BootloaderGetPageChecksums& m) { m.dest = 1; m.pagesStart = 8; m.pagesCount = 40; },
+		{
+			[](BootloaderGetPageChecksums& m) { m.dest = 3; },
+			[](BootloaderGetPageChecksums& m) { m.pagesStart = 9; },
+			[](BootloaderGetPageChecksums& m) { m.pagesCount = 41; }
+		}
+	);
+
 	testMessage<SetBytecode>(
 		[](SetBytecode& m) {
 			m.dest = 1;
@@ -467,6 +547,64 @@ int main()
 		}
 	);
 
+	testMessage<GetChangedVariables>(
+		[](GetChangedVariables& m) {
+			m.dest = 1;
+			m.start = 10;
+			m.length = 10;
+			m.generation = 0;
+		},
+		{
+			[](GetChangedVariables& m) { m.dest = 3; },
+			[](GetChangedVariables& m) { m.start = 20; },
+			[](GetChangedVariables& m) { m.length = 20; },
+			[](GetChangedVariables& m) { m.generation = 42; }
+		}
+	);
+
+	testMessage<WatchVariables>(
+		[](WatchVariables& m) {
+			m.dest = 1;
+			m.start = 10;
+			m.length = 10;
+			m.period = 100;
+		},
+		{
+			[](WatchVariables& m) { m.dest = 3; },
+			[](WatchVariables& m) { m.start = 20; },
+			[](WatchVariables& m) { m.length = 20; },
+			[](WatchVariables& m) { m.period = 0; }
+		}
+	);
+
+	testMessage<UnwatchVariables>(
+		[](UnwatchVariables& m) {
+			m.dest = 1;
+			m.start = 10;
+			m.length = 10;
+		},
+		{
+			[](UnwatchVariables& m) { m.dest = 3; },
+			[](UnwatchVariables& m) { m.start = 20; },
+			[](UnwatchVariables& m) { m.length = 0; }
+		}
+	);
+
+	testMessage<GetTaggedVariables>(
+		[](GetTaggedVariables& m) {
+			m.dest = 1;
+			m.start = 10;
+			m.length = 10;
+			m.tag = 0;
+		},
+		{
+			[](GetTaggedVariables& m) { m.dest = 3; },
+			[](GetTaggedVariables& m) { m.start = 20; },
+			[](GetTaggedVariables& m) { m.length = 20; },
+			[](GetTaggedVariables& m) { m.tag = 42; }
+		}
+	);
+
 	testMessage<SetVariables>(
 		[](SetVariables& m) {
 			m.dest = 1;
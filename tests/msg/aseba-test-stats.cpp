@@ -0,0 +1,99 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "clients/stats/CaptureStatistics.h"
+#include "common/msg/msg.h"
+#include "../common/check.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace Aseba;
+using namespace std;
+
+//! Write the variables of node from start to start + length as the reply to a GetVariables, split like by the VM, a µs apart
+static void writeVariables(CaptureWriter& writer, uint64_t time, uint16_t node, uint16_t start, uint16_t length)
+{
+	const uint16_t maxLength(256);
+	for (uint16_t sent = 0; sent < length; sent += maxLength)
+	{
+		Variables message;
+		message.source = node;
+		message.start = start + sent;
+		message.variables.resize(min<uint16_t>(maxLength, length - sent), 1);
+		writer.write(time++, message);
+	}
+}
+
+//! Write a capture of a host polling node 2 with pipelined requests, some unanswered and some replies unsolicited
+static void writeCapture(const string& fileName)
+{
+	CaptureWriter writer(fileName, false, 256);
+	uint64_t time(1000);
+	for (unsigned i = 0; i < 200; ++i)
+	{
+		// two identical requests in flight, and a short one
+		GetVariables requests[] = { GetVariables(2, 0, 600), GetVariables(2, 0, 600), GetVariables(2, 1000, 3) };
+		for (auto& request: requests)
+		{
+			request.source = 0;
+			writer.write(time, request);
+		}
+		if (i % 25 == 0)
+			writeVariables(writer, time + 1000, 2, 5000, 2);
+		if (i % 20 == 19)
+		{
+			// node does not answer, requests time out
+			time += 2000000;
+			continue;
+		}
+		writeVariables(writer, time + 5000, 2, 1000, 3);
+		writeVariables(writer, time + 10000, 2, 0, 600);
+		writeVariables(writer, time + 20000, 2, 0, 600);
+		time += 50000;
+	}
+}
+
+int main()
+{
+	const string fileName("aseba-test-stats.capture");
+	writeCapture(fileName);
+
+	Statistics statistics(computeStatistics(fileName, 1, 1000000));
+	check(statistics.latencies[GET_VARIABLES].size() == 570, "all received replies, split or not, are paired with their request");
+	check(statistics.unanswered[GET_VARIABLES] == 30, "requests without reply are unanswered");
+	check(statistics.unsolicited[GET_VARIABLES] == 8, "replies without request are unsolicited");
+	check(statistics.latencies[GET_VARIABLES].back() == 20002, "latency is measured until the last part of a split reply");
+
+	ostringstream reference;
+	writeReport(reference, statistics);
+	for (const unsigned threadCount: { 2, 3, 8 })
+	{
+		ostringstream report;
+		Statistics parallelStatistics(computeStatistics(fileName, threadCount, 1000000));
+		writeReport(report, parallelStatistics);
+		check(report.str() == reference.str(), "report does not depend on the number of threads");
+	}
+
+	remove(fileName.c_str());
+	cout << "Statistics of captures: all tests passed" << endl;
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "targets/playground/EnkiGlue.h"
+#include "targets/playground/ParallelControl.h"
+#include "targets/playground/Robots.h"
+#include "common/msg/NodesManager.h"
+#include "compiler/compiler.h"
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+using namespace Aseba;
+using namespace Enki;
+using namespace std;
+
+//! Nodes manager connected to all robots of a world, sending its messages to all of them
+struct TestNodesManager: NodesManager
+{
+	vector<DirectAsebaThymio2*> thymios;
+
+	void sendMessage(const Message& message) override
+	{
+		for (auto thymio: thymios)
+			thymio->inQueue.emplace(message.clone());
+	}
+
+	void step()
+	{
+		for (auto thymio: thymios)
+		{
+			while (!thymio->outQueue.empty())
+			{
+				processMessage(thymio->outQueue.front().get());
+				thymio->outQueue.pop();
+			}
+		}
+	}
+};
+
+struct TestSimulatorEnvironment: SimulatorEnvironment
+{
+	World& world;
+
+	TestSimulatorEnvironment(World& world): world(world) {}
+
+	void notify(const EnvironmentNotificationType type, const string& description, const strings& arguments) override {}
+
+	string getSDFilePath(const string& robotName, unsigned fileNumber) const override
+	{
+		return string();
+	}
+
+	World* getWorld() const override
+	{
+		return &world;
+	}
+};
+
+//! State of the robots at the end of a run
+struct Result
+{
+	vector<Point> positions;
+	vector<int16_t> randomValues;
+};
+
+//! Simulate robots driving randomly, with their VMs stepped on threadCount threads
+static Result simulate(unsigned threadCount, unsigned seed)
+{
+	const double dt(0.03);
+	const unsigned robotsCount(8);
+
+	// robots seed their VM when created, so the global generator must be seeded before
+	srand(seed);
+	World world(200, 200);
+	simulatorEnvironment.reset(new TestSimulatorEnvironment(world));
+	TestNodesManager manager;
+	for (unsigned i = 0; i < robotsCount; ++i)
+	{
+		DirectAsebaThymio2* thymio(new DirectAsebaThymio2("thymio2_" + to_string(i), i + 1));
+		thymio->pos = Point(30 + 45 * (i % 4), 50 + 100 * (i / 4));
+		world.addObject(thymio);
+		manager.thymios.push_back(thymio);
+	}
+
+	// get descriptions and load the program, running the VMs within the physics step
+	manager.pingNetwork();
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		world.step(dt);
+		manager.step();
+	}
+	for (unsigned i = 0; i < robotsCount; ++i)
+	{
+		const unsigned nodeId(i + 1);
+		const TargetDescription* description(manager.getDescription(nodeId));
+		if (!description)
+		{
+			cerr << "Robot " << nodeId << " did not send its description" << endl;
+			exit(1);
+		}
+		Compiler compiler;
+		CommonDefinitions commonDefinitions;
+		compiler.setTargetDescription(description);
+		compiler.setCommonDefinitions(&commonDefinitions);
+		wistringstream programStream(
+			L"var r[2]\n"
+			L"onevent prox\n"
+			L"call math.rand(r)\n"
+			L"motor.left.target = abs(r[0]) % 300\n"
+			L"motor.right.target = abs(r[1]) % 300\n"
+		);
+		BytecodeVector bytecode;
+		unsigned allocatedVariablesCount;
+		Error error;
+		if (!compiler.compile(programStream, bytecode, allocatedVariablesCount, error))
+		{
+			wcerr << L"compilation error: " << error.toWString() << endl;
+			exit(1);
+		}
+		vector<unique_ptr<Message>> messages;
+		sendBytecode(messages, nodeId, vector<uint16_t>(bytecode.begin(), bytecode.end()));
+		for (auto& message: messages)
+			manager.sendMessage(*message);
+		manager.sendMessage(Run(nodeId));
+	}
+
+	// run the VMs in parallel
+	ParallelControl parallelControl(threadCount);
+	for (unsigned i = 0; i < 300; ++i)
+	{
+		parallelControl.step(&world, dt);
+		manager.step();
+	}
+
+	Result result;
+	for (auto thymio: manager.thymios)
+	{
+		result.positions.push_back(thymio->pos);
+		result.randomValues.push_back(thymio->variables.freeSpace[0]);
+		result.randomValues.push_back(thymio->variables.freeSpace[1]);
+	}
+	return result;
+}
+
+int main()
+{
+	const unsigned seed(42);
+	const Result reference(simulate(1, seed));
+	if (reference.randomValues == vector<int16_t>(reference.randomValues.size(), 0))
+	{
+		cerr << "Robots did not run math.rand" << endl;
+		return 1;
+	}
+	for (const unsigned threadCount: { 1u, 4u })
+	{
+		const Result result(simulate(threadCount, seed));
+		if (result.randomValues != reference.randomValues)
+		{
+			cerr << "Random values with " << threadCount << " threads differ from those with 1 thread" << endl;
+			return 2;
+		}
+		for (size_t i = 0; i < result.positions.size(); ++i)
+		{
+			if (result.positions[i].x != reference.positions[i].x || result.positions[i].y != reference.positions[i].y)
+			{
+				cerr << "Position of robot " << i << " with " << threadCount << " threads differs from that with 1 thread" << endl;
+				return 3;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/msg/msg.h"
+#include "transport/dashel_plugins/dashel-plugins.h"
+#include <dashel/dashel.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+using namespace Aseba;
+using namespace std;
+
+// Return code telling ctest that the test was skipped
+const int SKIPPED(77);
+
+// Send messages of various sizes from one CAN stream to another over a virtual CAN interface,
+// check that they are received unchanged, and report the throughput
+int main(int argc, char *argv[])
+{
+	const string interfaceName(argc > 1 ? argv[1] : "vcan0");
+	const unsigned messagesCount(argc > 2 ? atoi(argv[2]) : 5000);
+	// messages sent before reading them back, small enough not to overflow the socket buffer
+	const unsigned window(16);
+
+	Dashel::initPlugins();
+	Dashel::Hub hub;
+	Dashel::Stream* sender;
+	Dashel::Stream* receiver;
+	try
+	{
+		sender = hub.connect("can:if=" + interfaceName);
+		receiver = hub.connect("can:if=" + interfaceName);
+	}
+	catch (const Dashel::DashelException& e)
+	{
+		cerr << "Cannot open CAN interface " << interfaceName << ", skipping test: " << e.what() << endl;
+		cerr << "To create it: ip link add dev " << interfaceName << " type vcan && ip link set up " << interfaceName << endl;
+		return SKIPPED;
+	}
+
+	// sizes cover small packets (one frame), and packets with start, normal and stop frames
+	auto makeMessage = [](unsigned i)
+	{
+		UserMessage message(i % 128, VariablesDataVector(i % 50));
+		for (size_t j = 0; j < message.data.size(); ++j)
+			message.data[j] = static_cast<int16_t>(i * 31 + j);
+		message.source = 1 + i % 8;
+		return message;
+	};
+
+	const auto start(chrono::steady_clock::now());
+	size_t bytesCount(0);
+	for (unsigned sent = 0; sent < messagesCount; sent += window)
+	{
+		const unsigned end(min(sent + window, messagesCount));
+		for (unsigned i = sent; i < end; ++i)
+		{
+			const UserMessage message(makeMessage(i));
+			message.serialize(sender);
+			bytesCount += 6 + message.data.size() * 2;
+		}
+		sender->flush();
+		for (unsigned i = sent; i < end; ++i)
+		{
+			unique_ptr<Message> received(Message::receive(receiver));
+			const auto userMessage(dynamic_cast<UserMessage*>(received.get()));
+			const UserMessage expected(makeMessage(i));
+			if (!userMessage || !(*userMessage == expected))
+			{
+				wcerr << L"Message " << i << L" differs, expected ";
+				expected.dump(wcerr);
+				wcerr << L", received ";
+				received->dump(wcerr);
+				wcerr << endl;
+				return 1;
+			}
+		}
+	}
+	const double duration(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+	cout << messagesCount << " messages, " << bytesCount << " bytes in " << duration << " s";
+	if (duration > 0)
+		cout << ": " << messagesCount / duration << " messages/s, " << bytesCount / duration << " bytes/s";
+	cout << endl;
+
+	return 0;
+}
@@ -0,0 +1,286 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "transport/buffer/vm-buffer.h"
+#include "vm/vm.h"
+#include "vm/natives.h"
+#include "common/consts.h"
+#include "common/msg/msg.h"
+#include "common/msg/NodesManager.h"
+#include "common/msg/DescriptionsCache.h"
+#include "../common/check.h"
+
+// C++
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace Aseba;
+using namespace std;
+
+// glue of the VM, which answers through the message helpers of vm-buffer.c
+
+static vector<uint8_t> incomingBuffer; //!< message to be read by the VM
+static deque<unique_ptr<Message>> sentMessages; //!< messages sent by the VM
+
+extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8_t* data, uint16_t length)
+{
+	Message::SerializationBuffer buffer;
+	buffer.rawData.assign(data + 2, data + length);
+	sentMessages.emplace_back(Message::create(vm->nodeId, data[0] | (data[1] << 8), buffer));
+}
+
+extern "C" uint16_t AsebaGetBuffer(AsebaVMState *vm, uint8_t* data, uint16_t maxLength, uint16_t* source)
+{
+	const uint16_t length(static_cast<uint16_t>(min<size_t>(incomingBuffer.size(), maxLength)));
+	copy(incomingBuffer.begin(), incomingBuffer.begin() + length, data);
+	incomingBuffer.clear();
+	*source = ASEBA_DEST_DEBUG;
+	return length;
+}
+
+// same layout as AsebaVMDescription, whose variables cannot be initialized in C++
+static const struct
+{
+	const char* name;
+	AsebaVariableDescription variables[4];
+} vmDescription = {
+	"test-node",
+	{
+		{ 1, "id" },
+		{ 5, "values" },
+		{ 3, "\xc3\xa9l\xc3\xa9ments" },
+		{ 0, nullptr }
+	}
+};
+
+extern "C" const AsebaVMDescription* AsebaGetVMDescription(AsebaVMState *vm)
+{
+	return reinterpret_cast<const AsebaVMDescription*>(&vmDescription);
+}
+
+static const AsebaLocalEventDescription localEvents[] = {
+	{ "tick", "Timer elapsed" },
+	{ "button", "Button pressed" },
+	{ nullptr, nullptr }
+};
+
+extern "C" const AsebaLocalEventDescription * AsebaGetLocalEventsDescriptions(AsebaVMState *vm)
+{
+	return localEvents;
+}
+
+static const AsebaNativeFunctionDescription* nativeFunctionsDescriptions[] =
+{
+	&AsebaNativeDescription_veccopy,
+	&AsebaNativeDescription_vecfill,
+	0
+};
+
+extern "C" const AsebaNativeFunctionDescription * const * AsebaGetNativeFunctionsDescriptions(AsebaVMState *vm)
+{
+	return nativeFunctionsDescriptions;
+}
+
+extern "C" void AsebaNativeFunction(AsebaVMState *vm, uint16_t id) {}
+extern "C" void AsebaWriteBytecode(AsebaVMState *vm) {}
+extern "C" void AsebaResetIntoBootloader(AsebaVMState *vm) {}
+extern "C" void AsebaPutVmToSleep(AsebaVMState *vm) {}
+
+extern "C" void AsebaAssert(AsebaVMState *vm, AsebaAssertReason reason)
+{
+	throw runtime_error("VM assertion failed");
+}
+
+// test
+
+//! Nodes manager connected to a single VM, counting the description messages it receives
+class TestNodesManager: public NodesManager
+{
+public:
+	AsebaVMState& vm;
+	unsigned descriptionMessagesCount = 0;
+	bool described = false;
+
+	TestNodesManager(AsebaVMState& vm, const string& cacheDirectory): vm(vm)
+	{
+		setDescriptionsCacheDirectory(cacheDirectory);
+	}
+
+	//! Ping the network and process the answers of the VM until it has nothing more to say
+	void connect()
+	{
+		pingNetwork();
+		while (!sentMessages.empty())
+		{
+			const unique_ptr<Message> message(move(sentMessages.front()));
+			sentMessages.pop_front();
+			if (dynamic_cast<const Description*>(message.get()) ||
+				dynamic_cast<const NamedVariableDescription*>(message.get()) ||
+				dynamic_cast<const LocalEventDescription*>(message.get()) ||
+				dynamic_cast<const NativeFunctionDescription*>(message.get()))
+				++descriptionMessagesCount;
+			processMessage(message.get());
+		}
+	}
+
+protected:
+	void sendMessage(const Message& message) override
+	{
+		Message::SerializationBuffer buffer;
+		message.serializeSpecific(buffer);
+		incomingBuffer = { uint8_t(message.type), uint8_t(message.type >> 8) };
+		incomingBuffer.insert(incomingBuffer.end(), buffer.rawData.begin(), buffer.rawData.end());
+		AsebaProcessIncomingEvents(&vm);
+	}
+
+	void nodeDescriptionReceived(unsigned nodeId) override
+	{
+		described = true;
+	}
+};
+
+static bool operator ==(const TargetDescription& lhs, const TargetDescription& rhs)
+{
+	return DescriptionsCache::computeHash(lhs) == DescriptionsCache::computeHash(rhs) &&
+		lhs.name == rhs.name &&
+		lhs.variablesSize == rhs.variablesSize &&
+		lhs.namedVariables.size() == rhs.namedVariables.size() &&
+		lhs.namedVariables.back().name == rhs.namedVariables.back().name &&
+		lhs.localEvents.size() == rhs.localEvents.size() &&
+		lhs.nativeFunctions.size() == rhs.nativeFunctions.size() &&
+		lhs.nativeFunctions[1].parameters.size() == rhs.nativeFunctions[1].parameters.size();
+}
+
+//! Check that nodes and variables of the VM are found by name, whether UTF-8 or wide
+static void checkNamesLookup(const TestNodesManager& manager, unsigned nodeId)
+{
+	bool ok(false);
+	check(manager.getNodeId("test-node", 0, &ok) == nodeId && ok, "node is found by UTF-8 name");
+	check(manager.getNodeId(L"test-node", 0, &ok) == nodeId && ok, "node is found by wide name");
+	manager.getNodeId("other-node", 0, &ok);
+	check(!ok, "unknown nodes are not found");
+
+	check(!manager.getDescription(nodeId)->variablesIndex.empty(), "variables are indexed once the description is complete");
+	check(manager.getVariablePos(nodeId, "values") == 1 && manager.getVariableSize(nodeId, "values") == 5, "variable is found by UTF-8 name");
+	check(manager.getVariablePos(nodeId, "\xc3\xa9l\xc3\xa9ments") == 6 && manager.getVariableSize(nodeId, "\xc3\xa9l\xc3\xa9ments") == 3, "variable with non-ASCII name is found by UTF-8 name");
+	check(manager.getVariablePos(nodeId, L"\u00e9l\u00e9ments") == 6 && manager.getVariableSize(nodeId, L"\u00e9l\u00e9ments") == 3, "variable is found by wide name");
+	manager.getVariablePos(nodeId, "missing", &ok);
+	check(!ok, "unknown variables are not found");
+	manager.getVariableSize(nodeId + 1, "values", &ok);
+	check(!ok, "variables of unknown nodes are not found");
+}
+
+//! Return the file in which DescriptionsCache saves the description with hash
+static string savedFileName(const string& directory, uint32_t hash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/description-%d-%08x.bin", ASEBA_PROTOCOL_VERSION, hash);
+	return directory + name;
+}
+
+int main()
+{
+	vector<uint16_t> bytecode(64);
+	vector<int16_t> stack(32);
+	vector<int16_t> variables(9);
+
+	AsebaVMState vm;
+	vm.nodeId = 3;
+	vm.bytecode = bytecode.data();
+	vm.bytecodeSize = bytecode.size();
+	vm.stack = stack.data();
+	vm.stackSize = stack.size();
+	vm.variables = variables.data();
+	vm.variablesSize = variables.size();
+	vm.variablesShadow = nullptr;
+	vm.watches = nullptr;
+	vm.watchesSize = 0;
+	vm.watchesValues = nullptr;
+	vm.watchesValuesSize = 0;
+	vm.descriptionHash = 0;
+	AsebaVMInit(&vm);
+
+	const string cacheDirectory(".");
+	vm.descriptionHash = AsebaComputeDescriptionHash(&vm);
+	check(vm.descriptionHash != 0, "description hash is computed");
+	const DescriptionsCache cache(cacheDirectory);
+	TargetDescription saved;
+	const string fileName(savedFileName(cacheDirectory, vm.descriptionHash));
+	remove(fileName.c_str());
+	check(!cache.load(ASEBA_PROTOCOL_VERSION, vm.descriptionHash, saved), "nothing saved at first");
+
+	// first session, the description is received and saved
+	TargetDescription received;
+	{
+		TestNodesManager manager(vm, cacheDirectory);
+		manager.connect();
+		check(manager.described, "node is described in the first session");
+		check(manager.descriptionMessagesCount == 1 + 3 + 2 + 2, "node sends its description in the first session");
+		received = *manager.getDescription(vm.nodeId);
+		check(DescriptionsCache::computeHash(received) == vm.descriptionHash, "hosts and nodes hash descriptions the same way");
+		check(cache.load(ASEBA_PROTOCOL_VERSION, vm.descriptionHash, saved), "description is saved");
+		check(saved == received, "saved description is the received one");
+		checkNamesLookup(manager, vm.nodeId);
+	}
+
+	// next sessions reuse the saved description
+	{
+		TestNodesManager manager(vm, cacheDirectory);
+		manager.connect();
+		check(manager.described, "node is described in the next session");
+		check(manager.descriptionMessagesCount == 0, "node does not send its description in the next session");
+		check(*manager.getDescription(vm.nodeId) == received, "saved description is used");
+		checkNamesLookup(manager, vm.nodeId);
+	}
+
+	// a saved description that does not match the hash is not used
+	check(!cache.load(ASEBA_PROTOCOL_VERSION, vm.descriptionHash + 1, saved), "description of other hashes are not loaded");
+	check(!cache.load(ASEBA_PROTOCOL_VERSION + 1, vm.descriptionHash, saved), "description of other protocol versions are not loaded");
+	{
+		ifstream in(fileName, ios::binary);
+		vector<char> content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		in.close();
+		ofstream out(fileName, ios::binary | ios::trunc);
+		out.write(content.data(), content.size() - 3);
+		out.close();
+		check(!cache.load(ASEBA_PROTOCOL_VERSION, vm.descriptionHash, saved), "truncated descriptions are not loaded");
+
+		TestNodesManager manager(vm, cacheDirectory);
+		manager.connect();
+		check(manager.described && manager.descriptionMessagesCount > 0, "node sends its description if the saved one is invalid");
+		check(cache.load(ASEBA_PROTOCOL_VERSION, vm.descriptionHash, saved), "description is saved again");
+		remove(fileName.c_str());
+	}
+
+	// nodes without hash always send their description
+	vm.descriptionHash = 0;
+	{
+		TestNodesManager manager(vm, cacheDirectory);
+		manager.connect();
+		check(manager.described && manager.descriptionMessagesCount > 0, "nodes without hash send their description");
+	}
+
+	return 0;
+}
@@ -0,0 +1,247 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "targets/playground/LocalEventQueue.h"
+#include "vm/vm.h"
+#include "common/consts.h"
+#include "compiler/compiler.h"
+#include "../common/check.h"
+
+// C++
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace Aseba;
+using namespace std;
+
+//! Local events of the test node, in the order of their numbers
+enum LocalEvent
+{
+	EVENT_A = 0,
+	EVENT_B,
+	EVENT_C,
+	EVENT_UNSCHEDULED,
+	EVENT_SLOW
+};
+
+//! Each event logs its number, but slow which counts iterations of a long loop before logging it
+static const wchar_t* program =
+	L"var i\n"
+	L"onevent a\n"
+	L"\tlog[n] = 0\n\tn = n + 1\n"
+	L"onevent b\n"
+	L"\tlog[n] = 1\n\tn = n + 1\n"
+	L"onevent c\n"
+	L"\tlog[n] = 2\n\tn = n + 1\n"
+	L"onevent unscheduled\n"
+	L"\tlog[n] = 3\n\tn = n + 1\n"
+	L"onevent slow\n"
+	L"\tfor i in 1:100 do\n\t\tloops = loops + 1\n\tend\n"
+	L"\tlog[n] = 4\n\tn = n + 1\n";
+
+//! Size of the log variable, followed by n and loops
+static const unsigned LOG_SIZE = 16;
+
+//! A VM running program, with a queue scheduling c, then a, then b, then slow
+struct TestNode
+{
+	AsebaVMState vm;
+	vector<uint16_t> bytecode;
+	vector<int16_t> stack;
+	vector<int16_t> variables;
+	LocalEventQueue queue;
+
+	TestNode():
+		bytecode(512),
+		stack(32),
+		variables(64),
+		queue(vm, { EVENT_C, EVENT_A, EVENT_B, EVENT_SLOW })
+	{
+		vm.nodeId = 1;
+		vm.bytecode = bytecode.data();
+		vm.bytecodeSize = bytecode.size();
+		vm.stack = stack.data();
+		vm.stackSize = stack.size();
+		vm.variables = variables.data();
+		vm.variablesSize = variables.size();
+		vm.variablesShadow = nullptr;
+		vm.watches = nullptr;
+		vm.watchesSize = 0;
+		vm.watchesValues = nullptr;
+		vm.watchesValuesSize = 0;
+		vm.descriptionHash = 0;
+		vm.randomState = 0;
+		AsebaVMInit(&vm);
+
+		TargetDescription description;
+		description.name = L"test";
+		description.protocolVersion = ASEBA_PROTOCOL_VERSION;
+		description.bytecodeSize = vm.bytecodeSize;
+		description.variablesSize = vm.variablesSize;
+		description.stackSize = vm.stackSize;
+		description.namedVariables.emplace_back(L"log", LOG_SIZE);
+		description.namedVariables.emplace_back(L"n", 1);
+		description.namedVariables.emplace_back(L"loops", 1);
+		for (const wchar_t* name: { L"a", L"b", L"c", L"unscheduled", L"slow" })
+			description.localEvents.push_back({ name, L"" });
+
+		Compiler compiler;
+		CommonDefinitions commonDefinitions;
+		compiler.setTargetDescription(&description);
+		compiler.setCommonDefinitions(&commonDefinitions);
+		BytecodeVector compiled;
+		unsigned allocatedVariablesCount;
+		Error error;
+		if (!compiler.compile(program, compiled, allocatedVariablesCount, error))
+		{
+			wcerr << error.toWString() << endl;
+			throw logic_error("test program does not compile");
+		}
+		copy(compiled.begin(), compiled.end(), bytecode.begin());
+	}
+
+	//! Return the numbers of the events that completed, in order
+	vector<int16_t> log() const
+	{
+		return vector<int16_t>(variables.begin(), variables.begin() + min<unsigned>(variables[LOG_SIZE], LOG_SIZE));
+	}
+
+	int16_t loops() const { return variables[LOG_SIZE + 1]; }
+	bool isRunning() const { return AsebaMaskIsSet(vm.flags, ASEBA_VM_EVENT_ACTIVE_MASK); }
+};
+
+//! Pending events run by priority, whatever the order they were posted
+static void testPriorityOrder()
+{
+	TestNode node;
+	node.queue.post(EVENT_B);
+	node.queue.post(EVENT_A);
+	node.queue.post(EVENT_C);
+	check(node.queue.isPending(EVENT_A) && node.queue.isPending(EVENT_B) && node.queue.isPending(EVENT_C), "posted events are pending");
+	check(node.log().empty(), "events do not run when posted");
+	node.queue.run(1);
+	check(node.log() == vector<int16_t>({ EVENT_C, EVENT_A, EVENT_B }), "events run by priority");
+	check(!node.queue.isPending(EVENT_A) && !node.queue.isPending(EVENT_B) && !node.queue.isPending(EVENT_C), "run events are not pending any more");
+	check(node.queue.getStatistics().executed == 3 && node.queue.getStatistics().overruns == 0, "statistics of events run by priority");
+
+	// an event posted while a longer one runs waits for it, even with a higher priority
+	node.queue.post(EVENT_SLOW);
+	node.queue.run(0.0001);
+	check(node.isRunning(), "slow event is still running");
+	node.queue.post(EVENT_C);
+	node.queue.run(1);
+	check(node.loops() == 100, "slow event is not killed by a new one");
+	check(node.log() == vector<int16_t>({ EVENT_C, EVENT_A, EVENT_B, EVENT_SLOW, EVENT_C }), "new event runs after the slow one");
+	check(node.queue.getStatistics().killed == 0, "no event is killed");
+}
+
+//! Events run within a budget of steps proportional to the simulated time
+static void testStepBudget()
+{
+	// measure the steps of the slow event in small budgets
+	TestNode node;
+	node.queue.stepsPerSecond = 1000;
+	node.queue.post(EVENT_SLOW);
+	unsigned runsCount(0);
+	int16_t previousLoops(0);
+	while (node.log().empty())
+	{
+		// 50 steps run a few iterations of the loop, which take several steps each
+		node.queue.run(0.05);
+		check(node.loops() > previousLoops || !node.log().empty(), "each call makes progress");
+		check(node.loops() - previousLoops <= 10, "each call runs at most its budget");
+		previousLoops = node.loops();
+		++runsCount;
+		check(runsCount < 1000, "slow event completes");
+	}
+	check(runsCount > 10, "slow event spans many calls");
+	check(node.loops() == 100 && node.log() == vector<int16_t>({ EVENT_SLOW }), "slow event completes once");
+	check(node.queue.getStatistics().executed == 1 && node.queue.getStatistics().overruns == runsCount - 1, "calls ending before the slow event are overruns");
+
+	// a large time step runs the same events as several small ones
+	TestNode bigStepNode;
+	bigStepNode.queue.stepsPerSecond = 1000;
+	bigStepNode.queue.post(EVENT_SLOW);
+	bigStepNode.queue.run(0.05 * (runsCount - 1));
+	check(bigStepNode.isRunning() && bigStepNode.log().empty(), "one large step runs as far as its small steps");
+	bigStepNode.queue.run(0.05);
+	check(bigStepNode.log() == vector<int16_t>({ EVENT_SLOW }), "one more small step completes the event");
+
+	// a slice is charged in full, so one slice per call only runs one short event
+	TestNode sliceNode;
+	sliceNode.queue.stepsPerSecond = 1000;
+	sliceNode.queue.sliceSteps = 32;
+	sliceNode.queue.run(1);
+	sliceNode.queue.post(EVENT_A);
+	sliceNode.queue.post(EVENT_B);
+	sliceNode.queue.run(0.032);
+	check(sliceNode.log() == vector<int16_t>({ EVENT_A }), "unused budget of an idle VM is not kept, and a slice is charged in full");
+	check(sliceNode.queue.isPending(EVENT_B), "event beyond the budget stays pending");
+	sliceNode.queue.run(0.032);
+	check(sliceNode.log() == vector<int16_t>({ EVENT_A, EVENT_B }), "pending event runs at the next call");
+}
+
+//! Posting a pending event coalesces it, and events not in the priority order are dropped
+static void testOverflow()
+{
+	TestNode node;
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		node.queue.post(EVENT_A);
+		node.queue.post(EVENT_B);
+	}
+	node.queue.post(EVENT_UNSCHEDULED);
+	check(!node.queue.isPending(EVENT_UNSCHEDULED), "unscheduled event is dropped");
+	check(node.queue.getStatistics().posted == 201, "all posts are counted");
+	check(node.queue.getStatistics().coalesced == 198, "posts of pending events are coalesced");
+	node.queue.run(1);
+	check(node.log() == vector<int16_t>({ EVENT_A, EVENT_B }), "coalesced events run once");
+	check(node.queue.getStatistics().executed == 2, "unscheduled event never runs");
+
+	// once run, an event can be posted again
+	node.queue.post(EVENT_A);
+	node.queue.run(1);
+	check(node.log() == vector<int16_t>({ EVENT_A, EVENT_B, EVENT_A }), "event posted again runs again");
+}
+
+//! In preemptive mode, posting an event kills the running one and runs the new one at once
+static void testPreemptive()
+{
+	TestNode node;
+	node.queue.preemptive = true;
+	node.queue.post(EVENT_SLOW);
+	check(node.isRunning(), "slow event runs when posted");
+	node.queue.post(EVENT_A);
+	check(node.log() == vector<int16_t>({ EVENT_A }) && node.loops() < 100, "new event kills the slow one");
+	check(node.queue.getStatistics().executed == 2 && node.queue.getStatistics().killed == 1, "statistics of killed events");
+	node.queue.run(1);
+	check(node.log() == vector<int16_t>({ EVENT_A }), "run does nothing in preemptive mode");
+}
+
+int main()
+{
+	testPriorityOrder();
+	testStepBudget();
+	testOverflow();
+	testPreemptive();
+	cout << "local event queue: all tests passed" << endl;
+	return 0;
+}
@@ -0,0 +1,558 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Created by Stéphane Magnenat <stephane at magnenat dot net> (http://stephane.magnenat.net)
+	with contributions from the community.
+	Copyright (C) 2007--2018 the authors, see authors.txt for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "transport/buffer/vm-buffer.h"
+#include "vm/vm.h"
+#include "vm/natives.h"
+#include "common/consts.h"
+#include "common/msg/msg.h"
+#include "common/msg/VariablesMirror.h"
+#include "common/msg/NodesManager.h"
+#include "../common/check.h"
+
+// C++
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Aseba;
+using namespace std;
+
+// glue of the VM, which answers through the message helpers of vm-buffer.c
+
+static vector<uint8_t> incomingBuffer; //!< message to be read by the VM
+static vector<unique_ptr<Message>> sentMessages; //!< messages sent by the VM
+
+extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8_t* data, uint16_t length)
+{
+	Message::SerializationBuffer buffer;
+	buffer.rawData.assign(data + 2, data + length);
+	sentMessages.emplace_back(Message::create(vm->nodeId, data[0] | (data[1] << 8), buffer));
+}
+
+extern "C" uint16_t AsebaGetBuffer(AsebaVMState *vm, uint8_t* data, uint16_t maxLength, uint16_t* source)
+{
+	const uint16_t length(static_cast<uint16_t>(min<size_t>(incomingBuffer.size(), maxLength)));
+	copy(incomingBuffer.begin(), incomingBuffer.begin() + length, data);
+	incomingBuffer.clear();
+	*source = ASEBA_DEST_DEBUG;
+	return length;
+}
+
+static AsebaVMDescription vmDescription;
+
+extern "C" const AsebaVMDescription* AsebaGetVMDescription(AsebaVMState *vm)
+{
+	return &vmDescription;
+}
+
+static const AsebaLocalEventDescription localEvents[] = {
+	{ nullptr, nullptr }
+};
+
+extern "C" const AsebaLocalEventDescription * AsebaGetLocalEventsDescriptions(AsebaVMState *vm)
+{
+	return localEvents;
+}
+
+static const AsebaNativeFunctionDescription* nativeFunctionsDescriptions[] =
+{
+	0
+};
+
+extern "C" const AsebaNativeFunctionDescription * const * AsebaGetNativeFunctionsDescriptions(AsebaVMState *vm)
+{
+	return nativeFunctionsDescriptions;
+}
+
+extern "C" void AsebaNativeFunction(AsebaVMState *vm, uint16_t id) {}
+extern "C" void AsebaWriteBytecode(AsebaVMState *vm) {}
+extern "C" void AsebaResetIntoBootloader(AsebaVMState *vm) {}
+extern "C" void AsebaPutVmToSleep(AsebaVMState *vm) {}
+
+extern "C" void AsebaAssert(AsebaVMState *vm, AsebaAssertReason reason)
+{
+	throw runtime_error("VM assertion failed");
+}
+
+// test
+
+//! Pass message to the VM, as sent by a host
+static void deliver(AsebaVMState& vm, const Message& message)
+{
+	Message::SerializationBuffer buffer;
+	message.serializeSpecific(buffer);
+	incomingBuffer = { uint8_t(message.type), uint8_t(message.type >> 8) };
+	incomingBuffer.insert(incomingBuffer.end(), buffer.rawData.begin(), buffer.rawData.end());
+	AsebaProcessIncomingEvents(&vm);
+}
+
+//! Result of reading variables through a mirror
+struct ReadResult
+{
+	uint16_t requestGeneration = 0xFFFF; //!< generation in GetChangedVariables, 0xFFFF if GetVariables was sent
+	size_t valuesSent = 0; //!< number of values in the ChangedVariables the node sent
+	VariablesDataVector values; //!< values rebuilt by the mirror
+};
+
+//! Read length variables from start on vm, passing the answer to mirror unless lost is true
+static ReadResult read(AsebaVMState& vm, VariablesMirror& mirror, uint16_t start, uint16_t length, bool lost = false)
+{
+	ReadResult result;
+	const unique_ptr<CmdMessage> request(mirror.getVariablesRequest(vm.nodeId, start, length));
+	const auto* getChangedVariables(dynamic_cast<const GetChangedVariables*>(request.get()));
+	if (getChangedVariables)
+		result.requestGeneration = getChangedVariables->generation;
+	deliver(vm, *request);
+
+	for (const auto& message: sentMessages)
+	{
+		const auto* changedVariables(dynamic_cast<const ChangedVariables*>(message.get()));
+		if (changedVariables)
+			result.valuesSent += changedVariables->values.size();
+		if (lost)
+			continue;
+		const auto* variables(dynamic_cast<const Variables*>(message.get()));
+		const unique_ptr<Variables> rebuilt(mirror.processMessage(message.get()));
+		if (rebuilt)
+			variables = rebuilt.get();
+		if (variables)
+			result.values.insert(result.values.end(), variables->variables.begin(), variables->variables.end());
+	}
+	sentMessages.clear();
+	return result;
+}
+
+//! Read variables with GetChangedVariables through a VariablesMirror
+static void testChangedVariables(AsebaVMState& vm, vector<int16_t>& variables)
+{
+	const uint16_t variablesCount(variables.size());
+	VariablesMirror mirror;
+	const VariablesDataVector& expected(variables);
+
+	// before knowing the features of the node, the mirror reads with GetVariables
+	ReadResult result(read(vm, mirror, 0, variablesCount));
+	check(result.requestGeneration == 0xFFFF, "GetVariables is used for nodes of unknown features");
+
+	// the node announces it supports GetChangedVariables
+	deliver(vm, ListNodes());
+	check(sentMessages.size() == 1, "node answers ListNodes");
+	mirror.processMessage(sentMessages[0].get());
+	sentMessages.clear();
+	check(mirror.supportsChangedVariables(vm.nodeId), "NodePresent announces changed variables");
+
+	// first read gets all variables
+	result = read(vm, mirror, 0, variablesCount);
+	check(result.requestGeneration == 0, "first read asks for all variables");
+	check(result.valuesSent == variablesCount, "first read sends all variables");
+	check(result.values == expected, "first read rebuilds all variables");
+
+	// further reads only get the changed ones
+	variables[5] = -1;
+	variables[250] = 1234;
+	result = read(vm, mirror, 0, variablesCount);
+	check(result.requestGeneration != 0, "further reads ask for changes");
+	check(result.valuesSent == 2, "further reads only send changed variables");
+	check(result.values == expected, "further reads rebuild all variables");
+
+	result = read(vm, mirror, 10, 20);
+	check(result.valuesSent == 0, "nothing sent if nothing changed");
+	check(result.values == VariablesDataVector(expected.begin() + 10, expected.begin() + 30), "partial read rebuilds variables");
+
+	// after a lost answer, the mirror cannot rebuild the variables and asks for all of them
+	variables[7] = 42;
+	read(vm, mirror, 0, variablesCount, true);
+	variables[8] = 43;
+	result = read(vm, mirror, 0, variablesCount);
+	check(result.values.empty(), "lost answer detected");
+	result = read(vm, mirror, 0, variablesCount);
+	check(result.requestGeneration == 0, "all variables requested after a lost answer");
+	check(result.values == expected, "all variables rebuilt after a lost answer");
+
+	// after a reset of the node, the node sends all variables again
+	AsebaVMInit(&vm);
+	variables[0] = 99;
+	result = read(vm, mirror, 0, variablesCount);
+	check(result.requestGeneration != 0, "mirror does not know about the reset");
+	check(result.valuesSent == variablesCount, "reset node sends all variables");
+	check(result.values == expected, "all variables rebuilt after a reset");
+}
+
+//! Nodes manager passing watches and reads to a single VM
+class TestNodesManager: public NodesManager
+{
+public:
+	AsebaVMState& vm;
+
+	TestNodesManager(AsebaVMState& vm): vm(vm) {}
+
+protected:
+	void sendMessage(const Message& message) override
+	{
+		// descriptions are not needed to watch and read variables
+		if (message.type == ASEBA_MESSAGE_WATCH_VARIABLES || message.type == ASEBA_MESSAGE_UNWATCH_VARIABLES ||
+			message.type == ASEBA_MESSAGE_GET_VARIABLES || message.type == ASEBA_MESSAGE_GET_TAGGED_VARIABLES)
+			deliver(vm, message);
+	}
+};
+
+//! Return the variables the VM sent since the last call, concatenated
+static VariablesDataVector sentVariables()
+{
+	VariablesDataVector values;
+	for (const auto& message: sentMessages)
+	{
+		const auto* variables(dynamic_cast<const Variables*>(message.get()));
+		if (variables)
+			values.insert(values.end(), variables->variables.begin(), variables->variables.end());
+	}
+	sentMessages.clear();
+	return values;
+}
+
+//! Have the VM send variables when they change, through a NodesManager
+static void testWatchVariables(AsebaVMState& vm, vector<int16_t>& variables)
+{
+	vector<AsebaVMWatch> watches(2);
+	vm.watches = watches.data();
+	vm.watchesSize = watches.size();
+	// exactly room for copies of the two watched ranges
+	vector<int16_t> watchesValues(8);
+	vm.watchesValues = watchesValues.data();
+	vm.watchesValuesSize = watchesValues.size();
+	AsebaVMInit(&vm);
+	for (size_t i = 0; i < variables.size(); ++i)
+		variables[i] = int16_t(i * 3);
+
+	TestNodesManager manager(vm);
+	check(!manager.watchVariables(vm.nodeId, 10, 5, 100), "variables of nodes of unknown features are not watched");
+
+	// the node announces it supports watches
+	deliver(vm, ListNodes());
+	check(sentMessages.size() == 1, "node answers ListNodes");
+	manager.processMessage(sentMessages[0].get());
+	sentMessages.clear();
+	check(manager.supportsWatchVariables(vm.nodeId), "NodePresent announces watch variables");
+
+	// watching sends the current values immediately
+	check(manager.watchVariables(vm.nodeId, 10, 5, 100), "variables are watched");
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "watched variables are sent immediately");
+
+	// nothing is sent while the variables do not change
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables().empty(), "unchanged variables are not sent");
+
+	// changes are sent, but not more often than the period
+	variables[12] = -7;
+	AsebaVMSendWatchedVariables(&vm, 100);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "changed variables are sent");
+	variables[13] = -8;
+	AsebaVMSendWatchedVariables(&vm, 60);
+	check(sentVariables().empty(), "changes are not sent before the period elapsed");
+	AsebaVMSendWatchedVariables(&vm, 60);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "changes are sent once the period elapsed");
+
+	// changes outside the watched variables are not sent
+	variables[20] = 1;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables().empty(), "changes of other variables are not sent");
+
+	// every value of a variable is told apart, in particular 0 and -1 whose words are 0x0000 and 0xFFFF
+	variables[11] = 0;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	sentVariables();
+	variables[11] = -1;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "change from 0 to -1 is sent");
+	variables[11] = 0;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "change from -1 to 0 is sent");
+
+	// changes of several variables that keep their checksum are sent, as they are compared with a copy
+	variables[10] = variables[11] = variables[12] = 0;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	sentVariables();
+	variables[10] = 1;
+	variables[11] = -2;
+	variables[12] = 1;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "change from [0,0,0] to [1,-2,1] is sent");
+	variables[10] = variables[12] = 0;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	sentVariables();
+	variables[10] = variables[12] = -32768;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "change of the sign of two variables is sent");
+
+	// the node has a limited number of watches
+	check(manager.watchVariables(vm.nodeId, 200, 3, 0), "second range is watched");
+	check(sentVariables().size() == 3, "second range is sent immediately");
+	manager.watchVariables(vm.nodeId, 250, 3, 0);
+	check(sentVariables().empty(), "node ignores watches beyond its capacity");
+	manager.unwatchVariables(vm.nodeId, 250, 3);
+
+	// after unwatching, changes are not sent any more
+	manager.unwatchVariables(vm.nodeId, 10, 5);
+	variables[10] = 5;
+	variables[200] = 5;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables().size() == 3, "only the still watched variables are sent");
+
+	// unwatching leaves room for copies of new watches
+	check(manager.watchVariables(vm.nodeId, 100, 5, 0), "range is watched again after unwatching");
+	check(sentVariables().size() == 5, "new range is sent immediately");
+	variables[100] = variables[102] = -32768;
+	variables[200] = 0;
+	variables[202] = -32768;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables().size() == 8, "changes of both ranges are sent after moving their copies");
+	manager.unwatchVariables(vm.nodeId);
+	variables[201] = 5;
+	AsebaVMSendWatchedVariables(&vm, 1000);
+	check(sentVariables().empty(), "nothing is sent after unwatching all variables");
+
+	vm.watches = nullptr;
+	vm.watchesSize = 0;
+	vm.watchesValues = nullptr;
+	vm.watchesValuesSize = 0;
+}
+
+//! Have the VM send variables without room to copy them, detecting changes with a checksum and sending them regularly
+static void testWatchVariablesRefresh(AsebaVMState& vm, vector<int16_t>& variables)
+{
+	vector<AsebaVMWatch> watches(1);
+	vm.watches = watches.data();
+	vm.watchesSize = watches.size();
+	vector<int16_t> watchesValues(2);
+	vm.watchesValues = watchesValues.data();
+	vm.watchesValuesSize = watchesValues.size();
+	AsebaVMInit(&vm);
+	for (size_t i = 0; i < variables.size(); ++i)
+		variables[i] = int16_t(i * 3);
+
+	TestNodesManager manager(vm);
+	deliver(vm, ListNodes());
+	manager.processMessage(sentMessages[0].get());
+	sentMessages.clear();
+	check(manager.watchVariables(vm.nodeId, 10, 3, 0), "variables are watched without room to copy them");
+	sentVariables();
+
+	// single changes are detected by the checksum
+	variables[11] = -1;
+	AsebaVMSendWatchedVariables(&vm, 10);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 13), "change is sent without copy");
+
+	// some changes of several variables are missed, but sent after ASEBA_WATCH_REFRESH_DELAY
+	variables[10] = variables[11] = variables[12] = 0;
+	AsebaVMSendWatchedVariables(&vm, 10);
+	sentVariables();
+	variables[10] = 1;
+	variables[11] = -2;
+	variables[12] = 1;
+	AsebaVMSendWatchedVariables(&vm, ASEBA_WATCH_REFRESH_DELAY / 2);
+	check(sentVariables().empty(), "change keeping the checksum is not detected");
+	AsebaVMSendWatchedVariables(&vm, ASEBA_WATCH_REFRESH_DELAY / 2);
+	check(sentVariables() == VariablesDataVector(variables.begin() + 10, variables.begin() + 13), "variables are sent again after the refresh delay");
+	AsebaVMSendWatchedVariables(&vm, ASEBA_WATCH_REFRESH_DELAY - 1);
+	check(sentVariables().empty(), "variables are not sent again before the refresh delay");
+	AsebaVMSendWatchedVariables(&vm, 60000);
+	check(sentVariables().size() == 3, "long delays also send the variables again");
+
+	manager.unwatchVariables(vm.nodeId);
+	vm.watches = nullptr;
+	vm.watchesSize = 0;
+	vm.watchesValues = nullptr;
+	vm.watchesValuesSize = 0;
+}
+
+//! Pass the messages the VM sent since the last call to manager, and return them
+static vector<unique_ptr<Message>> answer(NodesManager& manager)
+{
+	vector<unique_ptr<Message>> messages(move(sentMessages));
+	sentMessages.clear();
+	for (const auto& message: messages)
+		manager.processMessage(message.get());
+	return messages;
+}
+
+//! Have many reads in flight through a NodesManager, told apart by their tags
+static void testTaggedVariables(AsebaVMState& vm, vector<int16_t>& variables)
+{
+	TestNodesManager manager(vm);
+
+	// reads only complete for known nodes
+	Description description;
+	description.source = vm.nodeId;
+	description.name = L"test";
+	description.protocolVersion = ASEBA_PROTOCOL_VERSION;
+	description.variablesSize = variables.size();
+	manager.processMessage(&description);
+
+	// before knowing the features of the node, reads use GetVariables and are matched by range
+	bool done(false);
+	VariablesDataVector values;
+	manager.readVariables(vm.nodeId, 10, 5, [&](bool ok, const VariablesDataVector& readValues) {
+		done = ok;
+		values = readValues;
+	});
+	check(sentMessages.size() == 1 && sentMessages[0]->type == ASEBA_MESSAGE_VARIABLES, "GetVariables is used for nodes of unknown features");
+	answer(manager);
+	check(done && values == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "untagged read completes");
+
+	// the node announces it supports tagged reads
+	deliver(vm, ListNodes());
+	answer(manager);
+	check(manager.supportsTaggedVariables(vm.nodeId), "NodePresent announces tagged variables");
+
+	// overlapping reads are answered in reverse order, each getting the values at the time of its request
+	const VariablesDataVector before(variables.begin(), variables.end());
+	VariablesDataVector allValues;
+	const uint16_t allTag(manager.readVariables(vm.nodeId, 0, variables.size(), [&](bool ok, const VariablesDataVector& readValues) {
+		check(ok, "read of all variables succeeds");
+		allValues = readValues;
+	}));
+	vector<unique_ptr<Message>> allAnswer(move(sentMessages));
+	sentMessages.clear();
+	check(allAnswer.size() == 2, "answers too large for a message are split");
+	for (const auto& message: allAnswer)
+		check(dynamic_cast<const TaggedVariables*>(message.get())->tag == allTag, "split answers share the tag");
+
+	variables[12] = -5;
+	values.clear();
+	const uint16_t partTag(manager.readVariables(vm.nodeId, 10, 5, [&](bool ok, const VariablesDataVector& readValues) {
+		check(ok, "partial read succeeds");
+		values = readValues;
+	}));
+	check(partTag != allTag, "reads in flight have different tags");
+	answer(manager);
+	check(values == VariablesDataVector(variables.begin() + 10, variables.begin() + 15), "later read completes first");
+	check(allValues.empty(), "earlier read is not completed by the answer of a later one");
+	for (const auto& message: allAnswer)
+		manager.processMessage(message.get());
+	check(allValues == before, "earlier read gets the values at the time of its request");
+
+	// futures hold the values, or an exception if the node goes away
+	auto future(manager.readVariables(vm.nodeId, 200, 3));
+	answer(manager);
+	check(future.get() == VariablesDataVector(variables.begin() + 200, variables.begin() + 203), "future holds the read values");
+
+	future = manager.readVariables(vm.nodeId, 200, 3);
+	sentMessages.clear();
+	Disconnected disconnected;
+	disconnected.source = vm.nodeId;
+	manager.processMessage(&disconnected);
+	bool thrown(false);
+	try
+	{
+		future.get();
+	}
+	catch (const runtime_error&)
+	{
+		thrown = true;
+	}
+	check(thrown, "reads of disconnected nodes fail");
+}
+
+//! Wait for a read from one thread while another one processes the answers, calls being serialized by a hub lock
+static void testThreadedRead(AsebaVMState& vm, vector<int16_t>& variables)
+{
+	TestNodesManager manager(vm);
+	Description description;
+	description.source = vm.nodeId;
+	description.name = L"test";
+	description.protocolVersion = ASEBA_PROTOCOL_VERSION;
+	description.variablesSize = variables.size();
+	manager.processMessage(&description);
+
+	mutex hubLock; // protects manager, vm and sentMessages
+	atomic<bool> stop(false);
+
+	// the network thread, passing the answers of the node to the manager
+	thread network([&]() {
+		while (!stop)
+		{
+			{
+				lock_guard<mutex> lock(hubLock);
+				answer(manager);
+			}
+			this_thread::yield();
+		}
+	});
+
+	// the future must be waited for without holding the lock, as processMessage() fulfills it
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		future<VariablesDataVector> values;
+		{
+			lock_guard<mutex> lock(hubLock);
+			values = manager.readVariables(vm.nodeId, 200, 3);
+		}
+		if (values.wait_for(chrono::seconds(10)) != future_status::ready)
+		{
+			check(false, "read from another thread completes");
+			break;
+		}
+		check(values.get() == VariablesDataVector(variables.begin() + 200, variables.begin() + 203), "read from another thread gets the values");
+	}
+
+	stop = true;
+	network.join();
+}
+
+int main()
+{
+	// more variables than fit in a message, to test splitting
+	const uint16_t variablesCount(300);
+	vector<uint16_t> bytecode(64);
+	vector<int16_t> stack(32);
+	vector<int16_t> variables(variablesCount);
+	vector<int16_t> variablesShadow(variablesCount);
+
+	AsebaVMState vm;
+	vm.nodeId = 1;
+	vm.bytecode = bytecode.data();
+	vm.bytecodeSize = bytecode.size();
+	vm.stack = stack.data();
+	vm.stackSize = stack.size();
+	vm.variables = variables.data();
+	vm.variablesSize = variables.size();
+	vm.variablesShadow = variablesShadow.data();
+	vm.watches = nullptr;
+	vm.watchesSize = 0;
+	vm.watchesValues = nullptr;
+	vm.watchesValuesSize = 0;
+	vm.descriptionHash = 0;
+	AsebaVMInit(&vm);
+	for (size_t i = 0; i < variables.size(); ++i)
+		variables[i] = int16_t(i * 3);
+
+	testChangedVariables(vm, variables);
+	testWatchVariables(vm, variables);
+	testWatchVariablesRefresh(vm, variables);
+	testTaggedVariables(vm, variables);
+	testThreadedRead(vm, variables);
+
+	return 0;
+}